@@ -35,7 +35,7 @@ ENDMACRO()
 foreach(_fl "dirent.h" "fenv.h"
     "inttypes.h" "limits.h"
     "memory.h" "stdint.h" "stdlib.h" "stdbool.h" "strings.h" "string.h"
-    "sys/stat.h" "sys/types.h" "unistd.h" "windows.h" "sys/times.h")
+    "sys/mman.h" "sys/stat.h" "sys/types.h" "unistd.h" "windows.h" "sys/times.h")
   string(REGEX REPLACE "[/\\.]" "_" _var ${_fl})
   string(TOUPPER "${_var}" _FLN)
   check_include_file_cxx("${_fl}" "HAVE_${_FLN}" )
@@ -45,7 +45,7 @@ endforeach()
 #Check for functions
 set(CMAKE_REQUIRED_LIBRARIES -lm)
 foreach(_fc atexit fesetround floor fseeko lrint lrintf
-    memset mkstemp pow select sqrt malloc
+    memset mkstemp posix_fallocate pow select sqrt malloc
     strchr strcspn strdup strerror strerror_r strpbrk strrchr strtol strtok_r strerror_r strtoul)
   string(TOUPPER "${_fc}" _FC)
   check_function_exists(${_fc} "HAVE_${_FC}")
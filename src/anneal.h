@@ -27,6 +27,8 @@
 #endif
 
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <limits>
 #include <vector>
 
@@ -97,8 +99,68 @@ schraudolph_exp(double x)
 }
 
 
+// Same as schraudolph_exp(), but without any range checks.  The
+// caller must guarantee that -708 <= x <= 709.  Without branches
+// compilers can vectorize loops that call this function.
+inline static double
+schraudolph_exp_unchecked(double x)
+{
+    const std::uint64_t bits =
+        static_cast<std::uint64_t>(static_cast<std::uint32_t>(static_cast<int>(SCHRAUDOLPH_EXPONENT_A * x +
+                                                                                (0x3ff00000 - 60801)))) << 32;
+    double result;
+
+    std::memcpy(&result, &bits, sizeof(double));
+
+    return result;
+}
+
+
 namespace enblend {
 
+// Update the probabilities p of the k states of one point, where e
+// holds the states' energies, pi must be all zero, and an is k
+// elements of scratch space:
+//     An(i, j) = 1 / (1 + exp(e[j] - e[i]))
+//     p[j]' = 1/k * sum_(i = 0)^(k - 1) An(i, j) * (p[i] + p[j])
+// The inner loop stores its terms in an instead of summing them up
+// right away, which leaves it without branches and without a
+// loop-carried dependency.  The summation order stays as it was, so
+// the result is the same, bit for bit.
+inline static void
+update_state_probabilities(unsigned k, double* RESTRICT p, const double* RESTRICT e,
+                           double* RESTRICT pi, double* RESTRICT an)
+{
+    for (unsigned j = 0U; j < k; ++j) {
+        const double piTj = p[j];
+        const double ej = e[j];
+        const int n = static_cast<int>(k - j - 1U);
+        const double* const RESTRICT p_tail = p + j + 1U;
+        const double* const RESTRICT e_tail = e + j + 1U;
+        double* const RESTRICT pi_tail = pi + j + 1U;
+
+        for (int i = 0; i < n; ++i) {
+            const double piT = p_tail[i] + piTj;
+            const double x = ej - e_tail[i];
+            const double exp_x = schraudolph_exp_unchecked(std::min(std::max(x, -708.0), 709.0));
+            // Beyond the range of schraudolph_exp_unchecked() the
+            // exponential is infinity or zero.
+            const double piTAn = x > 709.0 ? 0.0 : (x < -708.0 ? piT : piT / (1.0 + exp_x));
+            an[i] = piTAn;
+            pi_tail[i] += piT - piTAn;
+        }
+
+        double pij = pi[j] + piTj;
+        for (int i = 0; i < n; ++i) {
+            pij += an[i];
+        }
+        pi[j] = pij;
+
+        p[j] = pij / k;
+    }
+}
+
+
 inline static vigra::Diff2D
 normal_vector(const vigra::Point2D& a_previous_point,
               const vigra::Point2D& a_current_point,
@@ -136,6 +198,12 @@ public:
         // Determine state space of currentPoint
         const int stateSpaceWidth = costImageShortDimension / 3;
 
+        auto addState = [this](const vigra::Point2D& point, int distance) {
+            stateX.push_back(point.x);
+            stateY.push_back(point.y);
+            stateDistances.push_back(distance);
+        };
+
         vigra::Point2D previousPoint = v->back().second;
         for (Segment::iterator current = v->begin(); current != v->end();) {
             bool currentMoveable = current->first;
@@ -145,11 +213,8 @@ public:
 
             mfEstimates.push_back(currentPoint);
 
-            std::vector<vigra::Point2D>* stateSpace = new std::vector<vigra::Point2D>();
-            pointStateSpaces.push_back(stateSpace);
-
-            std::vector<int>* stateDistances = new std::vector<int>();
-            pointStateDistances.push_back(stateDistances);
+            const unsigned int offset = stateX.size();
+            stateOffsets.push_back(offset);
 
             vigra::Diff2D normal = normal_vector(previousPoint, currentPoint, nextPoint);
             const double normal_magnitude = normal.magnitude();
@@ -175,9 +240,9 @@ public:
                     } else if ((*costImage)[*linePoint] == vigra::NumericTraits<CostImagePixelType>::max()) {
                         break;
                     } else if (i % spaceBetweenPoints == 0) {
-                        stateSpace->push_back(vigra::Point2D(*linePoint));
-                        stateDistances->push_back(std::max(std::abs(linePoint->x - currentPoint.x),
-                                                           std::abs(linePoint->y - currentPoint.y)) / 2);
+                        addState(vigra::Point2D(*linePoint),
+                                 std::max(std::abs(linePoint->x - currentPoint.x),
+                                          std::abs(linePoint->y - currentPoint.y)) / 2);
                         if (visualizeStateSpaceImage) {
                             (*visualizeStateSpaceImage)[*linePoint] = VISUALIZE_STATE_SPACE;
                         }
@@ -193,9 +258,9 @@ public:
                     } else if ((*costImage)[*linePoint] == vigra::NumericTraits<CostImagePixelType>::max()) {
                         break;
                     } else if (i % spaceBetweenPoints == 0) {
-                        stateSpace->push_back(vigra::Point2D(*linePoint));
-                        stateDistances->push_back(std::max(std::abs(linePoint->x - currentPoint.x),
-                                                           std::abs(linePoint->y - currentPoint.y)) / 2);
+                        addState(vigra::Point2D(*linePoint),
+                                 std::max(std::abs(linePoint->x - currentPoint.x),
+                                          std::abs(linePoint->y - currentPoint.y)) / 2);
                         if (visualizeStateSpaceImage) {
                             (*visualizeStateSpaceImage)[*linePoint] = VISUALIZE_STATE_SPACE;
                         }
@@ -203,15 +268,14 @@ public:
                 }
             }
 
-            if (stateSpace->size() == 0) {
-                stateSpace->push_back(currentPoint);
-                stateDistances->push_back(0);
+            if (stateX.size() == offset) {
+                addState(currentPoint, 0);
                 if (visualizeStateSpaceImage && costImage->isInside(currentPoint)) {
                     (*visualizeStateSpaceImage)[currentPoint] = VISUALIZE_STATE_SPACE_INSIDE;
                 }
             }
 
-            const unsigned int localK = stateSpace->size();
+            const unsigned int localK = stateX.size() - offset;
             if (localK > AnnealPara.kmax) {
                 std::cerr << command
                      << ": local k = " << localK << " > k_max = " << AnnealPara.kmax
@@ -221,7 +285,8 @@ public:
 
             kMax = std::max(kMax, localK);
 
-            pointStateProbabilities.push_back(new std::vector<double>(localK, 1.0 / localK));
+            stateCounts.push_back(localK);
+            stateProbabilities.insert(stateProbabilities.end(), localK, 1.0 / localK);
 
             convergedPoints.push_back(localK < 2);
 
@@ -241,14 +306,7 @@ public:
         }
     }
 
-    virtual ~GDAConfiguration() {
-        std::for_each(pointStateSpaces.begin(), pointStateSpaces.end(),
-                      [](std::vector<vigra::Point2D>* x) {delete x;});
-        std::for_each(pointStateProbabilities.begin(), pointStateProbabilities.end(),
-                      [](std::vector<double>* x) {delete x;});
-        std::for_each(pointStateDistances.begin(), pointStateDistances.end(),
-                      [](std::vector<int>* x) {delete x;});
-    }
+    virtual ~GDAConfiguration() {}
 
     void run() {
         int progressIndicator = 1;
@@ -305,10 +363,9 @@ public:
 
         if (visualizeStateSpaceImage) {
             // Remaining unconverged state space points
-            for (unsigned int i = 0; i < pointStateSpaces.size(); ++i) {
-                std::vector<vigra::Point2D>* stateSpace = pointStateSpaces[i];
-                for (unsigned int j = 0; j < stateSpace->size(); ++j) {
-                    vigra::Point2D point = (*stateSpace)[j];
+            for (unsigned int i = 0; i < stateOffsets.size(); ++i) {
+                for (unsigned int j = stateOffsets[i]; j < stateOffsets[i] + stateCounts[i]; ++j) {
+                    const vigra::Point2D point(stateX[j], stateY[j]);
                     if (visualizeStateSpaceImage->isInside(point)) {
                         (*visualizeStateSpaceImage)[point] = VISUALIZE_STATE_SPACE_UNCONVERGED;
                     }
@@ -323,13 +380,10 @@ public:
                     std::cerr << command
                          << ": info: unconverged point: "
                          << std::endl;
-                    std::vector<vigra::Point2D>* stateSpace = pointStateSpaces[i];
-                    std::vector<double>* stateProbabilities = pointStateProbabilities[i];
-                    const unsigned int localK = stateSpace->size();
-                    for (unsigned int state = 0; state < localK; ++state) {
+                    for (unsigned int state = stateOffsets[i]; state < stateOffsets[i] + stateCounts[i]; ++state) {
                         std::cerr << command
-                             << ": info: state " << (*stateSpace)[state]
-                             << ", weight = " << (*stateProbabilities)[state]
+                             << ": info: state " << vigra::Point2D(stateX[state], stateY[state])
+                             << ", weight = " << stateProbabilities[state]
                              << std::endl;
                     }
                     std::cerr << command
@@ -360,30 +414,29 @@ public:
 protected:
     virtual void calculateStateProbabilities() {
         const int mf_size = static_cast<int>(mfEstimates.size());
+        timer::WallClock wall_clock;
+
+        wall_clock.start();
 
 #ifdef OPENMP
 #pragma omp parallel
 #endif
         {
-            double* E = new double[kMax];
-            double* Pi = new double[kMax];
+            std::vector<double> E(kMax);
+            std::vector<double> Pi(kMax);
+            std::vector<double> An(kMax);
 
 #ifdef OPENMP
 #pragma omp for nowait schedule(guided)
 #endif
             for (int index = 0; index < mf_size; ++index) {
                 // Skip updating points that have already converged.
-                convergedPointsLock.set();
                 if (convergedPoints[index]) {
-                    convergedPointsLock.unset();
                     continue;
                 }
-                convergedPointsLock.unset();
 
-                const std::vector<vigra::Point2D>* stateSpace = pointStateSpaces[index];
-                std::vector<double>* stateProbabilities = pointStateProbabilities[index];
-                const std::vector<int>* stateDistances = pointStateDistances[index];
-                const unsigned int localK = stateSpace->size();
+                const unsigned int offset = stateOffsets[index];
+                const unsigned int localK = stateCounts[index];
 
                 const int lastIndex = index == 0 ? mf_size - 1 : index - 1;
                 const unsigned int nextIndex = (index + 1) % mf_size;
@@ -394,8 +447,8 @@ protected:
 
                 // Calculate E values.
                 for (unsigned i = 0U; i < localK; ++i) {
-                    const vigra::Point2D currentPoint = (*stateSpace)[i];
-                    const int distanceCost = (*stateDistances)[i];
+                    const vigra::Point2D currentPoint(stateX[offset + i], stateY[offset + i]);
+                    const int distanceCost = stateDistances[offset + i];
                     int mismatchCost = 0;
                     if (lastPointInCostImage) {
                         mismatchCost += costImageCost(lastPointEstimate, currentPoint);
@@ -411,159 +464,122 @@ protected:
                     Pi[i] = 0.0;
                 }
 
-                timer::WallClock wall_clock;
-                wall_clock.start();
-                // Calculate new stateProbabilities
-                // An = 1 / (1 + exp((E[j] - E[i]) / tCurrent))
-                // pi[j]' = 1/K * sum_(0)_(k-1) An(i,j) * (pi[i] + pi[j])
-                for (unsigned j = 0U; j < localK; ++j) {
-                    const double piTj = (*stateProbabilities)[j];
-                    Pi[j] += piTj;
-                    const double ej = E[j];
-                    for (unsigned i = j + 1U; i < localK; ++i) {
-                        const double piT = (*stateProbabilities)[i] + piTj;
-                        double piTAn = piT / (1.0 + schraudolph_exp(ej - E[i]));
-                        if (EXPECT_RESULT(std::isnan(piTAn), false)) {
-                            // exp term is infinity or zero.
-                            piTAn = ej > E[i] ? 0.0 : piT;
-                        }
-                        Pi[j] += piTAn;
-                        Pi[i] += piT - piTAn;
-                    }
-                    (*stateProbabilities)[j] = Pi[j] / localK;
-                }
-                wall_clock.stop();
-                if (parameter::as_boolean("time-state-probabilities", false))
-                {
-                    ocl::StowFormatFlags _;
-
-                    std::cerr <<
-                        "\n" <<
-                        command << ": timing: wall-clock runtime of `Calculate New State Probabilities' (CPU): " <<
-                        std::setprecision(3) << 1e6 * wall_clock.value() << " µs\n" <<
-                        std::endl;
-                }
+                update_state_probabilities(localK, &stateProbabilities[offset], &E[0], &Pi[0], &An[0]);
             }
-
-            delete [] E;
-            delete [] Pi;
         } // omp parallel
+
+        wall_clock.stop();
+        if (parameter::time_state_probabilities.value())
+        {
+            ocl::StowFormatFlags _;
+
+            std::cerr <<
+                "\n" <<
+                command << ": timing: wall-clock runtime of `Calculate New State Probabilities' (CPU): " <<
+                std::setprecision(3) << 1e6 * wall_clock.value() << " µs\n" <<
+                std::endl;
+        }
     }
 
     void iterate() {
         calculateStateProbabilities();
 
-        kMax = 1;
-        size_t kmax_local = 1;
+        const int mf_size = static_cast<int>(mfEstimates.size());
+        unsigned int kmax_local = 1U;
 
 #ifdef OPENMP
-#pragma omp parallel firstprivate(kmax_local)
+#pragma omp parallel for schedule(guided) reduction(max: kmax_local)
 #endif
-        {
-#ifdef OPENMP
-#pragma omp for nowait schedule(guided)
-#endif
-            for (int index = 0; index < static_cast<int>(pointStateSpaces.size()); ++index) {
-                convergedPointsLock.set();
-                if (convergedPoints[index]) {
-                    convergedPointsLock.unset();
-                    continue;
-                }
-                convergedPointsLock.unset();
-
-                std::vector<vigra::Point2D>* stateSpace = pointStateSpaces[index];
-                std::vector<double>* stateProbabilities = pointStateProbabilities[index];
-                std::vector<int>* stateDistances = pointStateDistances[index];
-                unsigned int localK = stateSpace->size();
-                double estimateX = 0.0;
-                double estimateY = 0.0;
-
-                // Make new mean field estimates.
-                double totalWeight = 0.0;
-                bool hasHighWeightState = false;
-                for (unsigned int k = 0; k < localK; ++k) {
-                    const double weight = (*stateProbabilities)[k];
-                    totalWeight += weight;
-                    if (weight > 0.99) {
-                        hasHighWeightState = true;
-                    }
-                    const vigra::Point2D state = (*stateSpace)[k];
-                    estimateX += weight * static_cast<double>(state.x);
-                    estimateY += weight * static_cast<double>(state.y);
+        for (int index = 0; index < mf_size; ++index) {
+            if (convergedPoints[index]) {
+                continue;
+            }
+
+            const unsigned int offset = stateOffsets[index];
+            unsigned int localK = stateCounts[index];
+            int* const x = &stateX[offset];
+            int* const y = &stateY[offset];
+            int* const distances = &stateDistances[offset];
+            double* const probabilities = &stateProbabilities[offset];
+            double estimateX = 0.0;
+            double estimateY = 0.0;
+
+            // Make new mean field estimates.
+            double totalWeight = 0.0;
+            bool hasHighWeightState = false;
+            for (unsigned int k = 0; k < localK; ++k) {
+                const double weight = probabilities[k];
+                totalWeight += weight;
+                if (weight > 0.99) {
+                    hasHighWeightState = true;
                 }
-                estimateX /= totalWeight;
-                estimateY /= totalWeight;
+                estimateX += weight * static_cast<double>(x[k]);
+                estimateY += weight * static_cast<double>(y[k]);
+            }
+            estimateX /= totalWeight;
+            estimateY /= totalWeight;
 
-                vigra::Point2D newEstimate(vigra::NumericTraits<int>::fromRealPromote(estimateX),
-                                           vigra::NumericTraits<int>::fromRealPromote(estimateY));
+            vigra::Point2D newEstimate(vigra::NumericTraits<int>::fromRealPromote(estimateX),
+                                       vigra::NumericTraits<int>::fromRealPromote(estimateY));
 
-                // Sanity check
-                if (!costImage->isInside(newEstimate)) {
-                    cerrLock.set();
-                    std::cerr << command
-                              << ": warning: new mean field estimate outside cost image"
-                              << std::endl;
-                    for (unsigned int state = 0; state < localK; ++state) {
-                        std::cerr << command
-                                  << ": note: state " << (*stateSpace)[state]
-                                  << " weight = "
-                                  << (*stateProbabilities)[state]
-                                  << std::endl;
-                    }
+            // Sanity check
+            if (!costImage->isInside(newEstimate)) {
+                cerrLock.set();
+                std::cerr << command
+                          << ": warning: new mean field estimate outside cost image"
+                          << std::endl;
+                for (unsigned int state = 0; state < localK; ++state) {
                     std::cerr << command
-                              << ": note: new estimate = " << newEstimate
+                              << ": note: state " << vigra::Point2D(x[state], y[state])
+                              << " weight = "
+                              << probabilities[state]
                               << std::endl;
-                    cerrLock.unset();
-
-                    // Skip this point from now on.
-                    convergedPointsLock.set();
-                    convergedPoints[index] = true;
-                    convergedPointsLock.unset();
-                    continue;
                 }
+                std::cerr << command
+                          << ": note: new estimate = " << newEstimate
+                          << std::endl;
+                cerrLock.unset();
 
-                mfEstimates[index] = newEstimate;
-
-                // Remove improbable solutions from the search space
-                double totalWeights = 0.0;
-                const double cutoffWeight = hasHighWeightState ? 0.50 : 0.00001;
-                for (unsigned int k = 0; k < stateSpace->size(); ) {
-                    const double weight = (*stateProbabilities)[k];
-                    if (weight < cutoffWeight) {
-                        // Replace this state with last state
-                        (*stateProbabilities)[k] = (*stateProbabilities)[stateProbabilities->size() - 1];
-                        (*stateSpace)[k] = (*stateSpace)[stateSpace->size() - 1];
-                        (*stateDistances)[k] = (*stateDistances)[stateDistances->size() - 1];
-
-                        // Delete last state
-                        stateProbabilities->pop_back();
-                        stateSpace->pop_back();
-                        stateDistances->pop_back();
-                    } else {
-                        totalWeights += weight;
-                        ++k;
-                    }
-                }
+                // Skip this point from now on.
+                convergedPoints[index] = true;
+                continue;
+            }
 
-                // Renormalize
-                for (unsigned int k = 0; k < stateSpace->size(); ++k) {
-                    (*stateProbabilities)[k] /= totalWeights;
+            mfEstimates[index] = newEstimate;
+
+            // Remove improbable solutions from the search space
+            double totalWeights = 0.0;
+            const double cutoffWeight = hasHighWeightState ? 0.50 : 0.00001;
+            for (unsigned int k = 0; k < localK; ) {
+                const double weight = probabilities[k];
+                if (weight < cutoffWeight) {
+                    // Replace this state with last state and delete
+                    // the last state.
+                    --localK;
+                    probabilities[k] = probabilities[localK];
+                    x[k] = x[localK];
+                    y[k] = y[localK];
+                    distances[k] = distances[localK];
+                } else {
+                    totalWeights += weight;
+                    ++k;
                 }
+            }
+            stateCounts[index] = localK;
 
-                localK = stateSpace->size();
-                if (localK < 2) {
-                    convergedPointsLock.set();
-                    convergedPoints[index] = true;
-                    convergedPointsLock.unset();
-                }
+            // Renormalize
+            for (unsigned int k = 0; k < localK; ++k) {
+                probabilities[k] /= totalWeights;
+            }
 
-                kmax_local = std::max(kmax_local, stateProbabilities->size());
+            if (localK < 2) {
+                convergedPoints[index] = true;
             }
 
-            kMaxLock.set();
-            kMax = std::max(kMax, static_cast<unsigned int>(kmax_local));
-            kMaxLock.unset();
-        } // omp parallel
+            kmax_local = std::max(kmax_local, localK);
+        }
+
+        kMax = kmax_local;
     }
 
     int costImageCost(const vigra::Point2D& start_point, const vigra::Point2D& end_point) const {
@@ -617,17 +633,24 @@ protected:
     // Mean-field estimates of current point locations
     std::vector<vigra::Point2D> mfEstimates;
 
-    // State spaces of each point
-    std::vector<std::vector<vigra::Point2D>*> pointStateSpaces;
-
-    // Probability vectors for each state space
-    std::vector<std::vector<double>*> pointStateProbabilities;
-
-    std::vector<std::vector<int>*> pointStateDistances;
-
-    // Flags indicate which points have converged
-    std::vector<bool> convergedPoints;
-    omp::lock convergedPointsLock;
+    // The state spaces of all points, stored back to back as
+    // structure of arrays.  The states of point i occupy the indices
+    // from stateOffsets[i] to stateOffsets[i] + stateCounts[i] - 1.
+    // States only ever get removed, so the slot of each point never
+    // moves.
+    std::vector<unsigned int> stateOffsets;
+    std::vector<unsigned int> stateCounts;
+    std::vector<int> stateX;
+    std::vector<int> stateY;
+    std::vector<int> stateDistances;
+
+    // Probability of each state
+    std::vector<double> stateProbabilities;
+
+    // Flags indicate which points have converged.  Unlike
+    // std::vector<bool> each flag has a byte of its own, which lets
+    // all threads update the flags of their points concurrently.
+    std::vector<unsigned char> convergedPoints;
 
     // Initial Temperature
     double tInitial;
@@ -649,7 +672,6 @@ protected:
 
     // Largest state space over all points
     unsigned int kMax;
-    omp::lock kMaxLock;
 
     // Weight factors for the distance of a point from the initial
     // seam line and the total mismatch accumulated along the seam
@@ -682,10 +704,7 @@ protected:
         const int mf_size = static_cast<int>(super::mfEstimates.size());
 
         const size_t maximum_probability_vector_size =
-            (*std::max_element(super::pointStateProbabilities.begin(),
-                               super::pointStateProbabilities.end(),
-                               [] (const std::vector<double>* x, const std::vector<double>* y)
-        {return x->size() < y->size();}))->size();
+            *std::max_element(super::stateCounts.begin(), super::stateCounts.end());
 
         // Method GPU::StateProbabilities->setup() allocates space for
         // `E' and `Pi' for us.  In particular it will use the GPU's
@@ -702,10 +721,12 @@ protected:
                 continue;
             }
 
-            const std::vector<vigra::Point2D>* stateSpace = super::pointStateSpaces[index];
-            std::vector<double>* stateProbabilities = super::pointStateProbabilities[index];
-            const std::vector<int>* stateDistances = super::pointStateDistances[index];
-            const int localK = static_cast<int>(stateSpace->size());
+            const unsigned int offset = super::stateOffsets[index];
+            const int localK = static_cast<int>(super::stateCounts[index]);
+            // The OpenCL interface wants the probabilities in a vector
+            // of their own.
+            std::vector<double> stateProbabilities(super::stateProbabilities.begin() + offset,
+                                                   super::stateProbabilities.begin() + offset + localK);
 
             const int lastIndex = (index == 0 ? mf_size : index) - 1;
             const int nextIndex = (index + 1) % mf_size;
@@ -717,8 +738,8 @@ protected:
             // Calculate E values.
             for (int i = 0; i < localK; ++i)
             {
-                const vigra::Point2D currentPoint = (*stateSpace)[i];
-                const int distanceCost = (*stateDistances)[i];
+                const vigra::Point2D currentPoint(super::stateX[offset + i], super::stateY[offset + i]);
+                const int distanceCost = super::stateDistances[offset + i];
                 int mismatchCost = 0;
                 if (lastPointInCostImage)
                 {
@@ -738,10 +759,13 @@ protected:
 
             timer::WallClock wall_clock;
             wall_clock.start();
-            GPU::StateProbabilities->run(localK, stateProbabilities, super::kMax, E, Pi);
+            GPU::StateProbabilities->run(localK, &stateProbabilities, super::kMax, E, Pi);
             wall_clock.stop();
 
-            if (parameter::as_boolean("time-state-probabilities", false))
+            std::copy(stateProbabilities.begin(), stateProbabilities.end(),
+                      super::stateProbabilities.begin() + offset);
+
+            if (parameter::time_state_probabilities.value())
             {
                 ocl::StowFormatFlags _;
 
@@ -771,7 +795,7 @@ void annealSnake(const CostImage* const ci,
     wall_clock.start();
 
 #ifdef OPENCL
-    const bool enable_kernel = parameter::as_boolean("gpu-kernel-anneal", true);
+    const bool enable_kernel = parameter::gpu_kernel_anneal.value();
 
     std::unique_ptr<GDAConfiguration<CostImage, VisualizeImage> >
         cfg((GPUContext && enable_kernel) ?
@@ -799,7 +823,7 @@ void annealSnake(const CostImage* const ci,
     }
 
     wall_clock.stop();
-    if (parameter::as_boolean("time-anneal-snake", false))
+    if (parameter::time_anneal_snake.value())
     {
         ocl::StowFormatFlags _;
 
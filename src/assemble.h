@@ -25,8 +25,13 @@
 #include <config.h>
 #endif
 
+#include <algorithm>
 #include <iostream>
 #include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
 
 #ifndef _WIN32
 #include <unistd.h>
@@ -44,6 +49,7 @@
 
 #include "common.h"
 #include "fixmath.h"
+#include "mapped_storage.h"
 
 
 namespace enblend {
@@ -103,8 +109,7 @@ exportImagePreferablyWithAlpha(const ImageType* image,
         vigra::ImageExportInfo mask_info(mask_filename.c_str());
 
         if (!enblend::has_known_image_extension(mask_filename)) {
-            std::string fallback_file_type {parameter::as_string("fallback-output-mask-file-type",
-                                                                 DEFAULT_FALLBACK_OUTPUT_MASK_FILE_TYPE)};
+            std::string fallback_file_type {parameter::fallback_output_mask_file_type.value()};
             if (mask_filename == "-")
             {
                 mask_info.setFileName("/dev/stdout");
@@ -244,17 +249,15 @@ import(const vigra::ImageImportInfo& info,
         // contributing or not contributing.
         vigra_ext::WriteFunctorAccessor<vigra::Threshold<ImagePixelComponentType, AlphaPixelType>, AlphaAccessor>
             threshing_alpha_accessor(vigra::Threshold<ImagePixelComponentType, AlphaPixelType>
-                (static_cast<ImagePixelComponentType>(parameter::as_double("import-alpha-lower-threshold",
-                                                                           inputRange.second / 2.0)),
-                 static_cast<ImagePixelComponentType>(parameter::as_double("import-alpha-upper-threshold",
-                                                                           inputRange.second)),
+                (static_cast<ImagePixelComponentType>(parameter::import_alpha_lower_threshold.value_or(inputRange.second / 2.0)),
+                 static_cast<ImagePixelComponentType>(parameter::import_alpha_upper_threshold.value_or(inputRange.second)),
                  AlphaTraits<AlphaPixelType>::zero(),
                  AlphaTraits<AlphaPixelType>::max()),
                 alpha.second);
 
         vigra::importImageAlpha(info, image, vigra::destIter(alpha.first, threshing_alpha_accessor));
 
-        if (parameter::as_boolean("import-alpha-save-threshed", false)) {
+        if (parameter::import_alpha_save_threshed.value()) {
             static unsigned index {0};
             std::ostringstream mask_image_name;
 
@@ -291,19 +294,127 @@ import(const vigra::ImageImportInfo& info,
 }
 
 
+/** Footprint of an input image: the runs of non-zero alpha in each
+ *  row, in panorama coordinates, and their bounding box.  Testing a
+ *  footprint against the alpha channel of an assembled image gives
+ *  the same answer as testing the input image's alpha channel pixel
+ *  by pixel, but without decoding the input image again.
+ */
+class AlphaFootprint
+{
+public:
+    AlphaFootprint() = delete;
+
+    template <typename AlphaType>
+    AlphaFootprint(const vigra::ImageImportInfo& info, const AlphaType& alpha) :
+        fileName_(info.getFileName()), imageIndex_(info.getImageIndex()),
+        position_(info.getPosition()), size_(info.size()),
+        rowStart_(1U, 0U)
+    {
+        typedef typename AlphaType::PixelType AlphaPixelType;
+
+        const AlphaPixelType zero(vigra::NumericTraits<AlphaPixelType>::zero());
+
+        rowStart_.reserve(size_.y + 1);
+        for (int y = 0; y < size_.y; ++y) {
+            const AlphaPixelType* const row = alpha[y];
+            int x = 0;
+            while (x < size_.x) {
+                while (x < size_.x && row[x] == zero) {
+                    ++x;
+                }
+                const int begin = x;
+                while (x < size_.x && row[x] != zero) {
+                    ++x;
+                }
+                if (begin != x) {
+                    runs_.push_back(std::make_pair(begin, x));
+                    boundingBox_ |= vigra::Rect2D(position_.x + begin, position_.y + y,
+                                                  position_.x + x, position_.y + y + 1);
+                }
+            }
+            rowStart_.push_back(runs_.size());
+        }
+    }
+
+    // Answer whether the footprint still describes info.
+    bool describes(const vigra::ImageImportInfo& info) const
+    {
+        return fileName_ == info.getFileName() && imageIndex_ == info.getImageIndex() &&
+            position_ == info.getPosition() && size_ == info.size();
+    }
+
+    const vigra::Rect2D& boundingBox() const {return boundingBox_;}
+
+    // Answer whether the footprint overlaps any non-zero pixel of
+    // alpha, which covers inputUnion and is zero outside of
+    // alphaBB.
+    template <typename AlphaType>
+    bool overlaps(const AlphaType& alpha, const vigra::Rect2D& inputUnion, const vigra::Rect2D& alphaBB) const
+    {
+        typedef typename AlphaType::PixelType AlphaPixelType;
+
+        const vigra::Rect2D common(boundingBox_ & alphaBB);
+        if (common.isEmpty()) {
+            return false;
+        }
+
+        const AlphaPixelType zero(vigra::NumericTraits<AlphaPixelType>::zero());
+
+        for (int y = common.top(); y < common.bottom(); ++y) {
+            const int row = y - position_.y;
+            const AlphaPixelType* const a = alpha[y - inputUnion.top()];
+
+            for (size_t r = rowStart_[row]; r != rowStart_[row + 1]; ++r) {
+                const int begin = std::max(position_.x + runs_[r].first, common.left());
+                const int end = std::min(position_.x + runs_[r].second, common.right());
+
+                for (int x = begin; x < end; ++x) {
+                    if (a[x - inputUnion.left()] != zero) {
+                        return true;
+                    }
+                }
+            }
+        }
+
+        return false;
+    }
+
+private:
+    std::string fileName_;
+    int imageIndex_;
+    vigra::Diff2D position_;
+    vigra::Size2D size_;
+    vigra::Rect2D boundingBox_;
+    std::vector<size_t> rowStart_;
+    std::vector<std::pair<int, int> > runs_;
+};
+
+
+/** Footprints of the input images that assemble() has decoded but
+ *  could not use yet because they overlapped.  An entry lives until
+ *  its image gets assembled.  Whoever assembles from one image list
+ *  owns the index that goes with it and must not share it between
+ *  concurrent calls.
+ */
+typedef std::map<const vigra::ImageImportInfo*, AlphaFootprint> AlphaFootprintIndex;
+
+
 /** Find images that do not overlap and assemble them into one image.
  *  Uses a greedy heuristic.
  *  Removes used images from given list of ImageImportInfos.
+ *  Remembers in footprints the alpha footprints of the images it
+ *  decodes but cannot use, so that later calls with the same list
+ *  and index test them for overlap without decoding them again.
+ *  Every image is decoded at most once per call.
  *  Returns an ImageImportInfo for the temporary file.
  *  memory xsection = 2 * (ImageType*inputUnion + AlphaType*inputUnion)
  */
 template <typename ImageType, typename AlphaType>
 std::pair<ImageType*, AlphaType*>
-assemble(std::list<vigra::ImageImportInfo*>& imageInfoList, vigra::Rect2D& inputUnion, vigra::Rect2D& bb)
+assemble(std::list<vigra::ImageImportInfo*>& imageInfoList, vigra::Rect2D& inputUnion, vigra::Rect2D& bb,
+         AlphaFootprintIndex& footprints)
 {
-    typedef typename AlphaType::traverser AlphaIteratorType;
-    typedef typename AlphaType::Accessor AlphaAccessor;
-
     // No more images to assemble?
     if (imageInfoList.empty()) {
         return std::pair<ImageType*, AlphaType*>(static_cast<ImageType*>(nullptr),
@@ -331,50 +442,52 @@ assemble(std::list<vigra::ImageImportInfo*>& imageInfoList, vigra::Rect2D& input
     }
 
     const vigra::Diff2D imagePos = imageInfoList.front()->getPosition();
+    const vigra::Size2D imageSize = imageInfoList.front()->size();
     import(*imageInfoList.front(),
            vigra::destIter(image->upperLeft() + imagePos - inputUnion.upperLeft()),
            vigra::destIter(imageA->upperLeft() + imagePos - inputUnion.upperLeft()));
+    footprints.erase(imageInfoList.front());
     imageInfoList.erase(imageInfoList.begin());
 
     if (!OneAtATime) {
         // Attempt to assemble additional non-overlapping images.
 
+        // imageA is zero outside of assembledBB.
+        vigra::Rect2D assembledBB(imagePos, imageSize);
+
         // List of ImageImportInfos we decide to assemble.
         std::list<std::list<vigra::ImageImportInfo*>::iterator> toBeRemoved;
 
         std::list<vigra::ImageImportInfo*>::iterator i;
         for (i = imageInfoList.begin(); i != imageInfoList.end(); i++) {
             vigra::ImageImportInfo* info = *i;
+            std::unique_ptr<ImageType> src;
+            std::unique_ptr<AlphaType> srcA;
 
-            // Load the next image.
-            std::unique_ptr<ImageType> src {new ImageType(info->size())};
-            std::unique_ptr<AlphaType> srcA {new AlphaType(info->size())};
+            AlphaFootprintIndex::iterator footprint = footprints.find(info);
+            if (footprint != footprints.end() && !footprint->second.describes(*info)) {
+                footprints.erase(footprint);
+                footprint = footprints.end();
+            }
 
-            import(*info, destImage(*src), destImage(*srcA));
+            if (footprint == footprints.end()) {
+                // Load the next image to learn its footprint.
+                src.reset(new ImageType(info->size()));
+                srcA.reset(new AlphaType(info->size()));
+                import(*info, destImage(*src), destImage(*srcA));
+                footprint = footprints.insert(std::make_pair(info, AlphaFootprint(*info, *srcA))).first;
+            }
 
             // Check for overlap.
-            bool overlapFound = false;
-            AlphaIteratorType dy = imageA->upperLeft() - inputUnion.upperLeft() + info->getPosition();
-            AlphaAccessor da = imageA->accessor();
-            AlphaIteratorType sy = srcA->upperLeft();
-            AlphaIteratorType send = srcA->lowerRight();
-            AlphaAccessor sa = srcA->accessor();
-
-            for(; sy.y < send.y; ++sy.y, ++dy.y) {
-                AlphaIteratorType sx = sy;
-                AlphaIteratorType dx = dy;
-                for(; sx.x < send.x; ++sx.x, ++dx.x) {
-                    if (sa(sx) && da(dx)) {
-                        overlapFound = true;
-                        break;
-                    }
-                }
-                if (overlapFound) {
-                    break;
-                }
-            }
+            const bool overlapFound = footprint->second.overlaps(*imageA, inputUnion, assembledBB);
 
             if (!overlapFound) {
+                if (!src) {
+                    src.reset(new ImageType(info->size()));
+                    srcA.reset(new AlphaType(info->size()));
+                    import(*info, destImage(*src), destImage(*srcA));
+                }
+
                 // Copy src and srcA into image and imageA.
 
                 if (Verbose >= VERBOSE_ASSEMBLE_MESSAGES) {
@@ -402,6 +515,9 @@ assemble(std::list<vigra::ImageImportInfo*>& imageInfoList, vigra::Rect2D& input
                 } // omp parallel
 #endif
 
+                assembledBB |= footprint->second.boundingBox();
+                footprints.erase(footprint);
+
                 // Remove info from list later.
                 toBeRemoved.push_back(i);
             }
@@ -435,6 +551,17 @@ assemble(std::list<vigra::ImageImportInfo*>& imageInfoList, vigra::Rect2D& input
     return std::pair<ImageType*, AlphaType*>(image, imageA);
 }
 
+
+/** Assemble like above, but forget the footprints after the call.
+ */
+template <typename ImageType, typename AlphaType>
+inline std::pair<ImageType*, AlphaType*>
+assemble(std::list<vigra::ImageImportInfo*>& imageInfoList, vigra::Rect2D& inputUnion, vigra::Rect2D& bb)
+{
+    AlphaFootprintIndex footprints;
+    return assemble<ImageType, AlphaType>(imageInfoList, inputUnion, bb, footprints);
+}
+
 } // namespace enblend
 
 #endif /* __ASSEMBLE_H__ */
@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2009-2017 Christoph Spiel
+ *
+ * This file is part of Enblend.
+ *
+ * Enblend is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Enblend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Enblend; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef BANDED_BLEND_H_INCLUDED_
+#define BANDED_BLEND_H_INCLUDED_
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <algorithm>
+#include <list>
+#include <utility>
+#include <vector>
+
+#include <vigra/copyimage.hxx>
+#include <vigra/initimage.hxx>
+
+#include "rect2d.hxx"
+
+#include "blend.h"
+#include "fixmath.h"
+#include "masktiles.h"
+#include "numerictraits.h"
+#include "parameter.h"
+#include "pyramid.h"
+
+
+namespace enblend {
+
+/** Answer the number of extra rows that must surround a band of
+ *  numLevels pyramid levels so that the band's borders do not
+ *  influence its core rows.
+ *
+ *  The apron is the filter half-width rounded up to the decimation
+ *  grid of the coarsest level.  Thus the extended band and the core
+ *  band start on rows that map onto the same pyramid-sample
+ *  positions as in the monolithic pyramid of the whole ROI.
+ */
+inline int
+bandApron(unsigned numLevels)
+{
+    const int alignment = 1 << (numLevels - 1U);
+    const int halfWidth = static_cast<int>(filterHalfWidth(numLevels));
+
+    return ((halfWidth + alignment - 1) / alignment) * alignment;
+}
+
+
+/** Answer the number of core rows of a band such that the three
+ *  pyramids (mask, white, and black) of one band fit into
+ *  aMemoryLimit, given that residentBytes are already taken by the
+ *  canvas, the alpha channels, and the mask.
+ *
+ *  A return value of at least roiBB.height() means that the whole
+ *  ROI fits and no banding is necessary.
+ */
+template <typename ImagePixelType>
+int
+bandHeight(const vigra::Rect2D& roiBB, unsigned numLevels,
+           unsigned long long aMemoryLimit, unsigned long long residentBytes)
+{
+    typedef typename EnblendNumericTraits<ImagePixelType>::ImagePyramidPixelType ImagePyramidPixelType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::MaskPyramidPixelType MaskPyramidPixelType;
+
+    if (aMemoryLimit == 0ULL) {
+        return roiBB.height();
+    }
+
+    const int alignment = 1 << (numLevels - 1U);
+    const int apron = bandApron(numLevels);
+    // A band of n rows carries three pyramids, each 4/3 the size of
+    // its base, plus the collapsed core that waits for write-back.
+    const double bytesPerRow =
+        roiBB.width() * ((4.0 / 3.0) * (sizeof(MaskPyramidPixelType) + 2 * sizeof(ImagePyramidPixelType)) +
+                         sizeof(ImagePyramidPixelType));
+    const double available =
+        aMemoryLimit > residentBytes ? static_cast<double>(aMemoryLimit - residentBytes) : 0.0;
+    const long long rows = static_cast<long long>(available / bytesPerRow) - 2LL * apron;
+    const int minimumHeight = std::max(2, alignment);
+
+    if (rows >= roiBB.height()) {
+        return roiBB.height();
+    } else if (rows < minimumHeight) {
+        std::cerr << command << ": warning: memory limit of " << aMemoryLimit / (1024ULL * 1024ULL) <<
+            "MB too small for " << numLevels << " levels over ROI of width " << roiBB.width() << ";\n" <<
+            command << ": warning: will use minimum band height of " << minimumHeight << " rows" << std::endl;
+        return minimumHeight;
+    } else {
+        return std::max(minimumHeight, static_cast<int>(rows / alignment) * alignment);
+    }
+}
+
+
+/** Blend whitePair into blackPair inside of roiBB in horizontal bands
+ *  of aBandHeight core rows each.
+ *
+ *  This is the bounded-memory counterpart of the monolithic
+ *  reduce-expand-blend-collapse sequence in enblendMain().  Each band
+ *  is extended by an apron of bandApron(numLevels) rows on either side,
+ *  its three pyramids are built, blended, and collapsed, and only the
+ *  core rows of the result are retained.  Because the following band's
+ *  apron reaches back into the black image, a collapsed core is
+ *  written back only when no later band needs the original black
+ *  pixels of its rows.
+ *
+ *  Bands span the full ROI width, so horizontal wrap-around works as
+ *  in the monolithic case.
+ *
+ *  maskTiles summarizes mask; it is kept in sync when the ROI of the
+ *  mask is cleared.
+ *
+ *  On return, blackPair holds the blended result and the union alpha
+ *  channel.  The white image, its alpha channel, and the mask are
+ *  left to the caller to delete.
+ */
+template <typename ImagePixelType, typename ImageType, typename AlphaType, typename MaskType>
+void
+blendInBands(std::pair<ImageType*, AlphaType*> whitePair,
+             std::pair<ImageType*, AlphaType*> blackPair,
+             MaskType* mask, MaskTiles<MaskType>* maskTiles,
+             const vigra::Rect2D& uBB, const vigra::Rect2D& whiteBB, const vigra::Rect2D& roiBB,
+             unsigned numLevels, bool wraparound, int aBandHeight)
+{
+    typedef typename EnblendNumericTraits<ImagePixelType>::AlphaPixelType AlphaPixelType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::MaskPixelType MaskPixelType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::ImagePyramidType ImagePyramidType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::MaskPyramidPixelType MaskPyramidPixelType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::MaskPyramidType MaskPyramidType;
+
+    enum {ImagePyramidIntegerBits = EnblendNumericTraits<ImagePixelType>::ImagePyramidIntegerBits};
+    enum {ImagePyramidFractionBits = EnblendNumericTraits<ImagePixelType>::ImagePyramidFractionBits};
+    enum {MaskPyramidIntegerBits = EnblendNumericTraits<ImagePixelType>::MaskPyramidIntegerBits};
+    enum {MaskPyramidFractionBits = EnblendNumericTraits<ImagePixelType>::MaskPyramidFractionBits};
+    typedef typename EnblendNumericTraits<ImagePixelType>::SKIPSMImagePixelType SKIPSMImagePixelType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::SKIPSMAlphaPixelType SKIPSMAlphaPixelType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::SKIPSMMaskPixelType SKIPSMMaskPixelType;
+
+    // Collapsed core rows that wait for write-back; first is the row
+    // offset relative to roiBB.
+    typedef std::list<std::pair<int, ImagePyramidType*> > pending_list;
+
+    const int roiHeight = roiBB.height();
+    const int apron = bandApron(numLevels);
+    const bool fuseBlendAndCollapse = parameter::fuse_blend_collapse.value();
+    pending_list pending;
+
+    // Write back all pending cores that end at or above row limit.
+    auto flush = [&](int limit)
+    {
+        while (!pending.empty() &&
+               pending.front().first + pending.front().second->height() <= limit) {
+            const int y = pending.front().first;
+            ImagePyramidType* core = pending.front().second;
+            const vigra::Rect2D rowsBB(roiBB.left(), roiBB.top() + y,
+                                       roiBB.right(), roiBB.top() + y + core->height());
+
+            // No later band reads these rows, so the black alpha can
+            // become the union of white and black alpha here.
+            vigra::initImageIf(vigra_ext::apply(rowsBB, destImageRange(*(blackPair.second))),
+                               vigra_ext::apply(rowsBB, maskImage(*(whitePair.second))),
+                               vigra::NumericTraits<AlphaPixelType>::max());
+
+            copyFromPyramidImageIf<ImagePyramidType, MaskType, ImageType,
+                                   ImagePyramidIntegerBits, ImagePyramidFractionBits>
+                (srcImageRange(*core),
+                 vigra_ext::apply(rowsBB, maskImage(*(blackPair.second))),
+                 vigra_ext::apply(rowsBB, destImage(*(blackPair.first))));
+
+            delete core;
+            pending.pop_front();
+        }
+    };
+
+    ConvertScalarToPyramidFunctor<MaskPixelType, MaskPyramidPixelType,
+                                  MaskPyramidIntegerBits, MaskPyramidFractionBits> whiteMask;
+
+    for (int y = 0; y < roiHeight; y += aBandHeight) {
+        const int coreEnd = std::min(y + aBandHeight, roiHeight);
+        const int extendedBegin = std::max(y - apron, 0);
+        const int extendedEnd = std::min(coreEnd + apron, roiHeight);
+
+        flush(extendedBegin);
+
+        if (Verbose >= VERBOSE_BLEND_MESSAGES) {
+            std::cerr << command << ": info: blending band of rows " <<
+                roiBB.top() + y << " to " << roiBB.top() + coreEnd - 1 << std::endl;
+        }
+
+        const vigra::Rect2D bandBB(roiBB.left(), roiBB.top() + extendedBegin,
+                                   roiBB.right(), roiBB.top() + extendedEnd);
+        vigra::Rect2D bandBB_uBB(bandBB);
+        bandBB_uBB.moveBy(-uBB.upperLeft());
+
+        std::vector<MaskPyramidType*>* maskGP =
+            gaussianPyramid<MaskType, MaskPyramidType,
+                            MaskPyramidIntegerBits, MaskPyramidFractionBits,
+                            SKIPSMMaskPixelType>(numLevels, wraparound,
+                                                 vigra_ext::apply(bandBB_uBB, srcImageRange(*mask)));
+
+        std::vector<ImagePyramidType*>* whiteLP =
+            laplacianPyramid<ImageType, AlphaType, ImagePyramidType,
+                             ImagePyramidIntegerBits, ImagePyramidFractionBits,
+                             SKIPSMImagePixelType, SKIPSMAlphaPixelType>
+            ("whiteGP",
+             numLevels, wraparound,
+             vigra_ext::apply(bandBB, srcImageRange(*(whitePair.first))),
+             vigra_ext::apply(bandBB, maskImage(*(whitePair.second))));
+
+        std::vector<ImagePyramidType*>* blackLP =
+            laplacianPyramid<ImageType, AlphaType, ImagePyramidType,
+                             ImagePyramidIntegerBits, ImagePyramidFractionBits,
+                             SKIPSMImagePixelType, SKIPSMAlphaPixelType>
+            ("blackGP",
+             numLevels, wraparound,
+             vigra_ext::apply(bandBB, srcImageRange(*(blackPair.first))),
+             vigra_ext::apply(bandBB, maskImage(*(blackPair.second))));
+
+        if (fuseBlendAndCollapse) {
+            blendAndCollapsePyramid<SKIPSMImagePixelType>(wraparound, maskGP, whiteLP, blackLP,
+                                                          whiteMask(vigra::NumericTraits<MaskPixelType>::max()));
+        } else {
+            blend(maskGP, whiteLP, blackLP, whiteMask(vigra::NumericTraits<MaskPixelType>::max()));
+        }
+
+        for (unsigned int i = 0; i < maskGP->size(); i++) {
+            delete (*maskGP)[i];
+        }
+        delete maskGP;
+
+        for (unsigned int i = 0; i < whiteLP->size(); i++) {
+            delete (*whiteLP)[i];
+        }
+        delete whiteLP;
+
+        if (!fuseBlendAndCollapse) {
+            collapsePyramid<SKIPSMImagePixelType>(wraparound, blackLP);
+        }
+
+        // Keep only the core rows of the collapsed band.
+        ImagePyramidType* core = new ImagePyramidType(roiBB.width(), coreEnd - y);
+        const ImagePyramidType* level0 = (*blackLP)[0];
+        vigra::copyImage(level0->upperLeft() + vigra::Diff2D(0, y - extendedBegin),
+                         level0->upperLeft() + vigra::Diff2D(roiBB.width(), coreEnd - extendedBegin),
+                         level0->accessor(),
+                         core->upperLeft(), core->accessor());
+        pending.push_back(std::make_pair(y, core));
+
+        for (unsigned int i = 0; i < blackLP->size(); i++) {
+            delete (*blackLP)[i];
+        }
+        delete blackLP;
+    }
+
+    flush(roiHeight);
+
+    // Copy pixels inside whiteBB and inside the white part of the mask
+    // but outside of the ROI into black image.
+    vigra::Rect2D roiBB_uBB(roiBB);
+    roiBB_uBB.moveBy(-uBB.upperLeft());
+    vigra::initImage(vigra_ext::apply(roiBB_uBB, destImageRange(*mask)),
+                     vigra::NumericTraits<MaskPixelType>::zero());
+    maskTiles->clear(roiBB_uBB);
+    copyImageIfTiled(vigra_ext::apply(uBB, srcImageRange(*(whitePair.first))),
+                     mask, *maskTiles,
+                     vigra_ext::apply(uBB, destImage(*(blackPair.first))));
+
+    // Make the black image alpha equal to the union of the white and
+    // black alpha channels outside of the ROI, too.
+    vigra::initImageIf(vigra_ext::apply(whiteBB, destImageRange(*(blackPair.second))),
+                       vigra_ext::apply(whiteBB, maskImage(*(whitePair.second))),
+                       vigra::NumericTraits<AlphaPixelType>::max());
+}
+
+} // namespace enblend
+
+#endif // BANDED_BLEND_H_INCLUDED_
+
+// Local Variables:
+// mode: c++
+// End:
@@ -31,6 +31,7 @@
 #include <vigra/numerictraits.hxx>
 
 #include "fixmath.h"
+#include "pyramid.h"
 
 
 namespace enblend {
@@ -120,6 +121,168 @@ blend(std::vector<MaskPyramidType*>* maskGP,
     }
 }
 
+
+/** Accessor that reads the blend of a mask, a white, and a black
+ *  pyramid level, but writes into the black level only.
+ *
+ *  The accessor is meant to be used with black-level iterators.  It
+ *  locates the corresponding mask and white pixels by the offset of
+ *  the iterator from the black level's upper-left corner.  All three
+ *  levels must have the same size.
+ */
+template <typename MaskIterator, typename MaskAccessor,
+          typename WhiteIterator, typename WhiteAccessor,
+          typename BlackIterator, typename BlackAccessor,
+          typename BlendFunctor>
+class BlendingAccessor
+{
+public:
+    typedef typename BlackAccessor::value_type value_type;
+
+    BlendingAccessor(MaskIterator mask_upperleft, MaskAccessor ma,
+                     WhiteIterator white_upperleft, WhiteAccessor wa,
+                     BlackIterator black_upperleft, BlackAccessor ba,
+                     BlendFunctor f) :
+        mask_upperleft_(mask_upperleft), ma_(ma),
+        white_upperleft_(white_upperleft), wa_(wa),
+        black_upperleft_(black_upperleft), ba_(ba),
+        f_(f)
+    {}
+
+    template <typename Iterator>
+    value_type operator()(const Iterator& i) const
+    {
+        const vigra::Diff2D offset(i - black_upperleft_);
+        return f_(ma_(mask_upperleft_ + offset), wa_(white_upperleft_ + offset), ba_(i));
+    }
+
+    template <typename Value, typename Iterator>
+    void set(const Value& v, const Iterator& i) const
+    {
+        ba_.set(v, i);
+    }
+
+private:
+    MaskIterator mask_upperleft_;
+    MaskAccessor ma_;
+    WhiteIterator white_upperleft_;
+    WhiteAccessor wa_;
+    BlackIterator black_upperleft_;
+    BlackAccessor ba_;
+    BlendFunctor f_;
+};
+
+
+/** Blend black and white pyramids using mask pyramid and collapse the
+ *  result in one pass per level.
+ *
+ *  Working from the coarsest to the finest level, the blend of level l
+ *  is computed on the fly while the collapsed level l + 1 is expanded
+ *  into it.  This saves one full read and one full write of each
+ *  black level compared with blend() followed by collapsePyramid(),
+ *  and it yields exactly the same result because expand() reads every
+ *  destination pixel once before it writes it.
+ *
+ *  The mask and white pyramids are released level by level; their
+ *  vectors are left holding null pointers.  On return, level 0 of
+ *  blackLP holds the collapsed result.
+ */
+template <typename SKIPSMImagePixelType, typename MaskPyramidType, typename ImagePyramidType>
+void
+blendAndCollapsePyramid(bool wraparound,
+                        std::vector<MaskPyramidType*>* maskGP,
+                        std::vector<ImagePyramidType*>* whiteLP,
+                        std::vector<ImagePyramidType*>* blackLP,
+                        typename MaskPyramidType::value_type maskPyramidWhiteValue)
+{
+    typedef CartesianBlendFunctor<typename MaskPyramidType::value_type> BlendFunctor;
+    typedef BlendingAccessor<typename MaskPyramidType::const_traverser, typename MaskPyramidType::ConstAccessor,
+                             typename ImagePyramidType::const_traverser, typename ImagePyramidType::ConstAccessor,
+                             typename ImagePyramidType::traverser, typename ImagePyramidType::Accessor,
+                             BlendFunctor> Accessor;
+
+    const int top = static_cast<int>(maskGP->size()) - 1;
+    const BlendFunctor blendFunctor(maskPyramidWhiteValue);
+
+    if (Verbose >= VERBOSE_BLEND_MESSAGES) {
+        std::cerr << command << ": info: blending and collapsing layers: l" << top;
+        std::cerr.flush();
+    }
+
+    // Nothing is expanded into the coarsest level.
+    vigra::omp::combineThreeImages(srcImageRange(*((*maskGP)[top])),
+                                   srcImage(*((*whiteLP)[top])),
+                                   srcImage(*((*blackLP)[top])),
+                                   destImage(*((*blackLP)[top])),
+                                   blendFunctor);
+    delete (*maskGP)[top];
+    (*maskGP)[top] = nullptr;
+    delete (*whiteLP)[top];
+    (*whiteLP)[top] = nullptr;
+
+    for (int l = top - 1; l >= 0; l--) {
+        if (Verbose >= VERBOSE_BLEND_MESSAGES) {
+            std::cerr << " l" << l;
+            std::cerr.flush();
+        }
+
+        const MaskPyramidType* mask = (*maskGP)[l];
+        const ImagePyramidType* white = (*whiteLP)[l];
+        ImagePyramidType* black = (*blackLP)[l];
+        const Accessor accessor(mask->upperLeft(), mask->accessor(),
+                                white->upperLeft(), white->accessor(),
+                                black->upperLeft(), black->accessor(),
+                                blendFunctor);
+
+        expand<SKIPSMImagePixelType>(true, wraparound,
+                                     srcImageRange(*((*blackLP)[l + 1])),
+                                     vigra::make_triple(black->upperLeft(), black->lowerRight(), accessor));
+
+        delete (*maskGP)[l];
+        (*maskGP)[l] = nullptr;
+        delete (*whiteLP)[l];
+        (*whiteLP)[l] = nullptr;
+    }
+
+    if (Verbose >= VERBOSE_BLEND_MESSAGES) {
+        std::cerr << std::endl;
+    }
+}
+
+
+/** Answer the number of bytes that blending and collapsing of
+ *  pyramids with the level sizes of aPyramid move between memory and
+ *  CPU, either with blendAndCollapsePyramid() (fused) or with blend()
+ *  followed by collapsePyramid().
+ */
+template <typename MaskPyramidType, typename ImagePyramidType>
+double
+blendAndCollapseTraffic(const std::vector<ImagePyramidType*>* aPyramid, bool fused)
+{
+    const double maskSize = sizeof(typename MaskPyramidType::value_type);
+    const double imageSize = sizeof(typename ImagePyramidType::value_type);
+    double bytes = 0.0;
+
+    for (unsigned int l = 0; l < aPyramid->size(); l++) {
+        const double area = static_cast<double>((*aPyramid)[l]->width()) * (*aPyramid)[l]->height();
+
+        // read mask, white, and black; write black
+        bytes += area * (maskSize + 3.0 * imageSize);
+        if (l + 1U < aPyramid->size()) {
+            const double coarserArea =
+                static_cast<double>((*aPyramid)[l + 1U]->width()) * (*aPyramid)[l + 1U]->height();
+            // read coarser level
+            bytes += coarserArea * imageSize;
+            if (!fused) {
+                // read and write level again
+                bytes += 2.0 * area * imageSize;
+            }
+        }
+    }
+
+    return bytes;
+}
+
 } // namespace enblend
 
 #endif /* __BLEND_H__ */
@@ -120,7 +120,7 @@ roiBounds(const vigra::Rect2D& inputUnion,
     // Verify the number of levels based on the size of the ROI.
     unsigned int roiShortDimension = std::min(roiBB.width(), roiBB.height());
     const unsigned int minimumPyramidLevels =
-        parameter::as_unsigned("minimum-pyramid-levels", 1U); //< minimum-pyramid-levels 1
+        parameter::minimum_pyramid_levels.value();
     unsigned int allowableLevels = minimumPyramidLevels;
     while (allowableLevels <= MAX_PYRAMID_LEVELS) {
         if (roiShortDimension <= 8U) {
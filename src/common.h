@@ -146,7 +146,11 @@ typedef enum
 #define TRANSFORMATION_FLAGS_FOR_BLENDING (cmsFLAGS_NOCACHE | cmsFLAGS_HIGHRESPRECALC)
 
 
-#define IMAGETYPE vigra::BasicImage
+// Image type of all large intermediate images.  It behaves exactly
+// like vigra::BasicImage unless the user asks for memory-mapped
+// storage; see mapped_storage.h, which every user of IMAGETYPE must
+// include.
+#define IMAGETYPE mapped_storage::image
 
 
 #ifdef WIN32
@@ -498,6 +502,63 @@ numberOfString(const std::string& a_string,        // string we want to convert
 }
 
 
+/** Convert a_string, which denotes an amount of memory, into a number
+ *  of bytes.
+ *
+ * The number may be followed by one of the binary suffixes "K", "M",
+ * "G", or "T" (case does not matter) optionally trailed by "B", as in
+ * "512M", "8G", or "2TB". */
+inline unsigned long long
+byteSizeOfString(const char* a_string)
+{
+    char* tail;
+
+    errno = 0;
+    const double value = strtod(a_string, &tail);
+    if (errno != 0)
+    {
+        std::cerr << command << ": "
+                  << "illegal numeric format of \""
+                  << a_string
+                  << "\": "
+                  << errorMessage(errno)
+                  << std::endl;
+        exit(1);
+    }
+    if (tail == a_string || value < 0.0)
+    {
+        std::cerr << command << ": "
+                  << "size \"" << a_string << "\" is not a non-negative number"
+                  << std::endl;
+        exit(1);
+    }
+
+    double multiplier = 1.0;
+    switch (std::toupper(*tail, std::locale()))
+    {
+    case 'K': multiplier = 1024.0; ++tail; break;
+    case 'M': multiplier = 1024.0 * 1024.0; ++tail; break;
+    case 'G': multiplier = 1024.0 * 1024.0 * 1024.0; ++tail; break;
+    case 'T': multiplier = 1024.0 * 1024.0 * 1024.0 * 1024.0; ++tail; break;
+    default: break;
+    }
+    if (std::toupper(*tail, std::locale()) == 'B')
+    {
+        ++tail;
+    }
+
+    if (*tail != 0)
+    {
+        std::cerr << command << ": "
+                  << "trailing garbage \"" << tail << "\" in size \"" << a_string << "\""
+                  << std::endl;
+        exit(1);
+    }
+
+    return static_cast<unsigned long long>(value * multiplier);
+}
+
+
 inline bool
 isFloatingPoint(const std::string& aPixelType)
 {
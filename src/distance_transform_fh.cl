@@ -36,10 +36,32 @@ manhattan_1d(global const float *restrict f, const int n, global float *restrict
 }
 
 
+// Same as manhattan_1d, but for samples on a ring.  Two laps in each
+// direction let every sample reach every other one across the seam.
+void
+manhattan_1d_periodic(global const float *restrict f, const int n, global float *restrict d)
+{
+    manhattan_1d(f, n, d);
+
+    d[0] = min(d[0], d[n - 1] + 1.0f);
+    for (int q = 1; q < n; ++q)
+    {
+        d[q] = min(d[q], d[q - 1] + 1.0f);
+    }
+
+    d[n - 1] = min(d[n - 1], d[0] + 1.0f);
+    for (int q = n - 2; q >= 0; --q)
+    {
+        d[q] = min(d[q], d[q + 1] + 1.0f);
+    }
+}
+
+
 kernel void
 manhattan_2d_columns(global float *restrict output,
                      const int width, const int height,
-                     global float *restrict f_base, global float *restrict d_base)
+                     global float *restrict f_base, global float *restrict d_base,
+                     const int wrap)
 {
     const int x = get_global_id(0);
 
@@ -57,7 +79,14 @@ manhattan_2d_columns(global float *restrict output,
         f[y] = output[x + y * width];
     }
 
-    manhattan_1d(f, height, d);
+    if (wrap)
+    {
+        manhattan_1d_periodic(f, height, d);
+    }
+    else
+    {
+        manhattan_1d(f, height, d);
+    }
 
     for (int y = 0; y < height; y++)
     {
@@ -69,7 +98,8 @@ manhattan_2d_columns(global float *restrict output,
 kernel void
 manhattan_2d_rows(global float *restrict output,
                   const int width, const int height,
-                  global float *restrict f_base, global float *restrict d_base)
+                  global float *restrict f_base, global float *restrict d_base,
+                  const int wrap)
 {
     const int y = get_global_id(0);
 
@@ -87,7 +117,14 @@ manhattan_2d_rows(global float *restrict output,
         f[x] = output[x + y * width];
     }
 
-    manhattan_1d(f, width, d);
+    if (wrap)
+    {
+        manhattan_1d_periodic(f, width, d);
+    }
+    else
+    {
+        manhattan_1d(f, width, d);
+    }
 
     for (int x = 0; x < width; x++)
     {
@@ -147,11 +184,56 @@ euclidean_1d(global const float *restrict f, const int n, global float *restrict
 }
 
 
+// Same as euclidean_1d, but for samples on a ring.  No sample is
+// farther than n/2 from q, so the parabolas rooted at -h..n+h-1 cover
+// all q in 0..n-1.  Arrays v and z need room for 2 * n + 3 elements,
+// whereas euclidean_1d gets along with n + 1.
+void
+euclidean_1d_periodic(global const float *restrict f, const int n, global float *restrict d,
+                      global int *restrict v, global float *restrict z)
+{
+    const int h = min(n, n / 2 + 1);
+
+    v[0] = -h;
+    z[0] = -FLT_MAX;
+    z[1] = +FLT_MAX;
+
+    int k = 0;
+    for (int q = 1 - h; q < n + h; q++)
+    {
+        const float a = f[(q + n) % n] + square(q);
+        float s = 0.5f * (a - (f[(v[k] + n) % n] + square(v[k]))) / (float) (q - v[k]);
+        while (s <= z[k])
+        {
+            k--;
+            s = 0.5f * (a - (f[(v[k] + n) % n] + square(v[k]))) / (float) (q - v[k]);
+        }
+        k++;
+
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = +FLT_MAX;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; q++)
+    {
+        while (z[k + 1] < (float) q)
+        {
+            k++;
+        }
+        d[q] = square(q - v[k]) + f[(v[k] + n) % n];
+    }
+}
+
+
 kernel void
 euclidean_2d_columns(global float *restrict output,
                      const int width, const int height,
                      global float *restrict f_base, global float *restrict d_base,
-                     global int *restrict v_base, global float *restrict z_base)
+                     global int *restrict v_base, global float *restrict z_base,
+                     const int envelope_stride,
+                     const int wrap)
 {
     const int x = get_global_id(0);
 
@@ -160,18 +242,26 @@ euclidean_2d_columns(global float *restrict output,
         return;
     }
 
-    const int offset = x * max(width, height);
+    const int length = max(width, height);
+    const int offset = x * length;
     global float *f = f_base + offset;
     global float *d = d_base + offset;
-    global int *v = v_base + offset;
-    global float *z = z_base + offset;
+    global int *v = v_base + x * envelope_stride;
+    global float *z = z_base + x * envelope_stride;
 
     for (int y = 0; y < height; y++)
     {
         f[y] = output[x + y * width];
     }
 
-    euclidean_1d(f, height, d, v, z);
+    if (wrap)
+    {
+        euclidean_1d_periodic(f, height, d, v, z);
+    }
+    else
+    {
+        euclidean_1d(f, height, d, v, z);
+    }
 
     for (int y = 0; y < height; y++)
     {
@@ -184,7 +274,9 @@ kernel void
 euclidean_2d_rows(global float *restrict output,
                   const int width, const int height,
                   global float *restrict f_base, global float *restrict d_base,
-                  global int *restrict v_base, global float *restrict z_base)
+                  global int *restrict v_base, global float *restrict z_base,
+                  const int envelope_stride,
+                  const int wrap)
 {
     const int y = get_global_id(0);
 
@@ -193,18 +285,26 @@ euclidean_2d_rows(global float *restrict output,
         return;
     }
 
-    const int offset = y * max(width, height);
+    const int length = max(width, height);
+    const int offset = y * length;
     global float *f = f_base + offset;
     global float *d = d_base + offset;
-    global int *v = v_base + offset;
-    global float *z = z_base + offset;
+    global int *v = v_base + y * envelope_stride;
+    global float *z = z_base + y * envelope_stride;
 
     for (int x = 0; x < width; x++)
     {
         f[x] = output[x + y * width];
     }
 
-    euclidean_1d(f, width, d, v, z);
+    if (wrap)
+    {
+        euclidean_1d_periodic(f, width, d, v, z);
+    }
+    else
+    {
+        euclidean_1d(f, width, d, v, z);
+    }
 
     for (int x = 0; x < width; x++)
     {
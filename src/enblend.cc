@@ -155,6 +155,7 @@ unsigned int DijkstraRadius = 25U; //< default-dijkstra-radius 25
 AlternativePercentage MaskVectorizeDistance(0.0, false);
 std::string OutputCompression;
 std::string OutputPixelType;
+unsigned long long MemoryLimit = 0ULL; // 0 means: no limit
 
 TiffResolution ImageResolution;
 bool OutputIsValid = true;
@@ -288,6 +289,7 @@ void dump_global_variables(const char* file, unsigned line,
         "+ }, arguments to option \"--mask-vectorize\"\n" <<
         "+ OutputCompression = <" << OutputCompression << ">, option \"--compression\"\n" <<
         "+ OutputPixelType = <" << OutputPixelType << ">, option \"--depth\"\n" <<
+        "+ MemoryLimit = " << MemoryLimit << ", option \"--memory-limit\"\n" <<
         "+ end of global variable dump\n";
 }
 
@@ -378,6 +380,9 @@ printUsage(const bool error = true)
         std::cout << "                         \"" << (*i)->name() << "\": " << (*i)->description() << "\n";
     }
     std::cout <<
+        "  --memory-limit=SIZE    build blending pyramids in horizontal bands such that\n" <<
+        "                         they fit into SIZE bytes, where SIZE takes the suffixes\n" <<
+        "                         \"K\", \"M\", \"G\", or \"T\"; \"0\" means no limit; default: none\n" <<
 #ifdef OPENCL
         "  --prefer-gpu=DEVICE    select DEVICE on auto-detected platform as GPU\n" <<
         "  --prefer-gpu=PLATFORM:DEVICE\n" <<
@@ -504,6 +509,7 @@ enum AllPossibleOptions {
     ImageDifferenceOption, AnnealOption, DijkstraRadiusOption, MaskVectorizeDistanceOption,
     OptimizerWeightsOption,
     LayerSelectorOption, NearestFeatureTransformOption, GraphCutOption,
+    MemoryLimitOption,
     ShowImageFormatsOption, ShowSignatureOption, ShowGlobbingAlgoInfoOption, ShowSoftwareComponentsInfoOption,
     ShowGPUInfoOption,
     // currently below the radar...
@@ -791,6 +797,7 @@ process_options(int argc, char** argv)
         BlendColorspaceId,
         FallbackProfileId,
         LayerSelectorId,
+        MemoryLimitId,
         MainAlgoId,
         ImageDifferenceId,
         ParameterId,
@@ -837,6 +844,7 @@ process_options(int argc, char** argv)
         {"blend-color-space", required_argument, 0, BlendColorspaceId}, // dash form: not documented, not deprecated
         {"fallback-profile", required_argument, 0, FallbackProfileId},
         {"layer-selector", required_argument, 0, LayerSelectorId},
+        {"memory-limit", required_argument, 0, MemoryLimitId},
         {"primary-seam-generator", required_argument, 0, MainAlgoId},
         {"image-difference", required_argument, 0, ImageDifferenceId},
         {"parameter", required_argument, 0, ParameterId},
@@ -1543,6 +1551,11 @@ process_options(int argc, char** argv)
             break;
         }
 
+        case MemoryLimitId:
+            MemoryLimit = enblend::byteSizeOfString(optarg);
+            optionSet.insert(MemoryLimitOption);
+            break;
+
         case ParameterId: {
             const std::regex delimiterRegex(NUMERIC_OPTION_DELIMITERS_REGEX);
             const std::string arg(optarg);
@@ -1658,6 +1671,13 @@ process_options(int argc, char** argv)
         failed = true;
     }
 
+    const std::vector<std::string> parameterMessages(parameter::resolve_all());
+    for (std::vector<std::string>::const_iterator m = parameterMessages.begin();
+         m != parameterMessages.end();
+         ++m) {
+        std::cerr << command << ": warning: " << *m << "; will use default" << std::endl;
+    }
+
     if (failed) {
         exit(1);
     }
@@ -1805,7 +1825,7 @@ int main(int argc, char** argv)
         exit(1);
     }
 
-    if (parameter::as_boolean("dump-global-variables", false)) {
+    if (parameter::dump_global_variables.value()) {
         DUMP_GLOBAL_VARIABLES();
     }
 
@@ -2092,7 +2112,7 @@ int main(int argc, char** argv)
 
     // Switch to fine mask, if the smallest coarse mask would be less
     // than 64 pixels wide or high.
-    if (minDim / CoarsenessFactor < parameter::as_unsigned("smallest-coarse-mask-size", 64) && CoarseMask) {
+    if (minDim / CoarsenessFactor < parameter::smallest_coarse_mask_size.value() && CoarseMask) {
         std::cerr << command
                   << ": warning: input images too small for coarse mask\n"
                   << command << ": note: switching to fine mask"
@@ -2117,8 +2137,7 @@ int main(int argc, char** argv)
     vigra::ImageExportInfo outputImageInfo(OutputFileName.c_str());
 
     if (!enblend::has_known_image_extension(OutputFileName)) {
-        std::string fallback_output_file_type {parameter::as_string("fallback-output-file-type",
-                                                                    DEFAULT_FALLBACK_OUTPUT_FILE_TYPE)};
+        std::string fallback_output_file_type {parameter::fallback_output_file_type.value()};
         if (OutputFileName == "-") {
             outputImageInfo.setFileName("/dev/stdout");
         } else {
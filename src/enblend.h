@@ -25,8 +25,16 @@
 #include <config.h>
 #endif
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <list>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>             // sysconf()
+#endif
 
 #include <vigra/impex.hxx>
 #include <vigra/initimage.hxx>
@@ -38,26 +46,46 @@
 #include "common.h"
 #include "opencl.h"
 #include "openmp_def.h"
+#include "openmp_lock.h"
 #include "openmp_vigra.h"
 #include "metadata.h"
 #include "numerictraits.h"
 #include "fixmath.h"
 #include "assemble.h"
+#include "banded_blend.h"
 #include "blend.h"
 #include "bounds.h"
 #include "mask.h"
 #include "pyramid.h"
+#include "timer.h"
 
 
 namespace enblend {
 
-/** Enblend's main blending loop. Templatized to handle different image types.
+/** Outcome of blending one image (white) into another (black). */
+enum BlendPairResult {
+    WhiteRedundant,             // white image completely covered; nothing changed
+    WhiteCopied,                // images do not overlap; white copied verbatim
+    WhiteBlended                // white blended into black
+};
+
+
+/** Blend whitePair into blackPair and release whitePair.  On return
+ *  blackBB is the bounding box of the combined image.
  */
 template <typename ImagePixelType>
-void enblendMain(const FileNameList& anInputFileNameList,
-                 const std::list<vigra::ImageImportInfo*>& anImageInfoList,
-                 vigra::ImageExportInfo& anOutputImageInfo,
-                 vigra::Rect2D& anInputUnion)
+BlendPairResult
+blendImagePair(std::pair<typename EnblendNumericTraits<ImagePixelType>::ImageType*,
+                         typename EnblendNumericTraits<ImagePixelType>::AlphaType*>& blackPair,
+               vigra::Rect2D& blackBB,
+               std::pair<typename EnblendNumericTraits<ImagePixelType>::ImageType*,
+                         typename EnblendNumericTraits<ImagePixelType>::AlphaType*> whitePair,
+               const vigra::Rect2D& whiteBB,
+               const vigra::Rect2D& anInputUnion,
+               unsigned numberOfImages,
+               FileNameList::const_iterator inputFileNameIterator,
+               unsigned m,
+               bool warnAboutNoOverlap)
 {
     typedef typename EnblendNumericTraits<ImagePixelType>::ImagePixelComponentType ImagePixelComponentType;
     typedef typename EnblendNumericTraits<ImagePixelType>::ImageType ImageType;
@@ -78,102 +106,47 @@ void enblendMain(const FileNameList& anInputFileNameList,
     typedef typename EnblendNumericTraits<ImagePixelType>::SKIPSMAlphaPixelType SKIPSMAlphaPixelType;
     typedef typename EnblendNumericTraits<ImagePixelType>::SKIPSMMaskPixelType SKIPSMMaskPixelType;
 
-    std::list<vigra::ImageImportInfo*> imageInfoList(anImageInfoList);
-
-    // Create the initial black image.
-    vigra::Rect2D blackBB;
-    std::pair<ImageType*, AlphaType*> blackPair =
-        assemble<ImageType, AlphaType>(imageInfoList, anInputUnion, blackBB);
+    // Union bounding box of whiteImage and blackImage.
+    vigra::Rect2D uBB = blackBB | whiteBB;
 
-    if (Checkpoint) {
-        checkpoint(blackPair, anOutputImageInfo);
+    if (Verbose >= VERBOSE_UBB_MESSAGES) {
+        std::cerr << command
+                  << ": info: image union bounding box: "
+                  << uBB
+                  << std::endl;
     }
 
-    // mem usage before = 0
-    // mem xsection = OneAtATime: anInputUnion*imageValueType + anInputUnion*AlphaValueType
-    //                !OneAtATime: 2*anInputUnion*imageValueType + 2*anInputUnion*AlphaValueType
-    // mem usage after = anInputUnion*ImageValueType + anInputUnion*AlphaValueType
-
-    const unsigned numberOfImages = imageInfoList.size();
+    // Intersection bounding box of whiteImage and blackImage.
+    vigra::Rect2D iBB = blackBB & whiteBB;
+    bool iBBValid = !iBB.isEmpty();
 
-    unsigned m = 0;
-    FileNameList::const_iterator inputFileNameIterator(anInputFileNameList.begin());
-
-#ifdef HAVE_EXIV2
-    typedef allocate::array<Exiv2::Image::AutoPtr> metadata_array;
-    metadata_array input_metadata(anInputFileNameList.size());
-    {
-        FileNameList::const_iterator filename(anInputFileNameList.begin());
-        metadata_array::pointer metadata {input_metadata.begin()};
-
-        while (filename != anInputFileNameList.end()) {
-            try {
-                new (metadata) metadata_array::value_type(metadata::read(*filename));
-                input_metadata.mark_as_initialized(metadata - input_metadata.begin());
-            }
-            catch (Exiv2::Error& e) {
-                std::cerr <<
-                    command << ": warning: could not read metadata of input image \"" <<
-                    *inputFileNameIterator << "\"\n" <<
-                    command << ": note: " << e.what() << "\n";
-            }
-            ++filename;
-            ++metadata;
+    if (Verbose >= VERBOSE_IBB_MESSAGES) {
+        std::cerr << command << ": info: image intersection bounding box: ";
+        if (iBBValid) {
+            std::cerr << iBB;
+        } else {
+            std::cerr << "(no intersection)";
         }
+        std::cerr << std::endl;
     }
-#endif
-
-    while (!imageInfoList.empty()) {
-        // Create the white image.
-        vigra::Rect2D whiteBB;
-        std::pair<ImageType*, AlphaType*> whitePair =
-            assemble<ImageType, AlphaType>(imageInfoList, anInputUnion, whiteBB);
-
-        // mem usage before = anInputUnion*ImageValueType + anInputUnion*AlphaValueType
-        // mem xsection = OneAtATime: anInputUnion*imageValueType + anInputUnion*AlphaValueType
-        //                !OneAtATime: 2*anInputUnion*imageValueType + 2*anInputUnion*AlphaValueType
-        // mem usage after = 2*anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
-
-        // Union bounding box of whiteImage and blackImage.
-        vigra::Rect2D uBB = blackBB | whiteBB;
-
-        if (Verbose >= VERBOSE_UBB_MESSAGES) {
-            std::cerr << command
-                      << ": info: image union bounding box: "
-                      << uBB
-                      << std::endl;
-        }
 
-        // Intersection bounding box of whiteImage and blackImage.
-        vigra::Rect2D iBB = blackBB & whiteBB;
-        bool iBBValid = !iBB.isEmpty();
+    // Determine what kind of overlap we have.
+    const Overlap overlap =
+        inspectOverlap(vigra_ext::apply(uBB, srcImageRange(*(blackPair.second))),
+                       vigra_ext::apply(uBB, srcImage(*(whitePair.second))));
 
-        if (Verbose >= VERBOSE_IBB_MESSAGES) {
-            std::cerr << command << ": info: image intersection bounding box: ";
-            if (iBBValid) {
-                std::cerr << iBB;
-            } else {
-                std::cerr << "(no intersection)";
-            }
-            std::cerr << std::endl;
-        }
-
-        // Determine what kind of overlap we have.
-        const Overlap overlap =
-            inspectOverlap(vigra_ext::apply(uBB, srcImageRange(*(blackPair.second))),
-                           vigra_ext::apply(uBB, srcImage(*(whitePair.second))));
-
-        // If white image is redundant, skip it and go to next images.
-        if (overlap == CompleteOverlap) {
-            // White image is redundant.
-            delete whitePair.first;
-            delete whitePair.second;
-            std::cerr << command << ": warning: some images are redundant and will not be blended\n"
-                      << command << ": note: usually this means that at least one of the images\n"
-                      << command << ": note: does not belong to the set" << std::endl;
-            continue;
-        } else if (overlap == NoOverlap && ExactLevels == 0) {
-            // Images do not actually overlap.
+    // If white image is redundant, skip it and go to next images.
+    if (overlap == CompleteOverlap) {
+        // White image is redundant.
+        delete whitePair.first;
+        delete whitePair.second;
+        std::cerr << command << ": warning: some images are redundant and will not be blended\n"
+                  << command << ": note: usually this means that at least one of the images\n"
+                  << command << ": note: does not belong to the set" << std::endl;
+        return WhiteRedundant;
+    } else if (overlap == NoOverlap && ExactLevels == 0) {
+        // Images do not actually overlap.
+        if (warnAboutNoOverlap) {
             std::cerr << command << ": warning: images do not overlap; they will be combined without blending\n"
                       << command << ": note: usually this means that at least one of these images does not\n"
                       << command << ": note: belong to the set or the order of the images given at the\n"
@@ -181,344 +154,739 @@ void enblendMain(const FileNameList& anInputFileNameList,
                       << command << ": note: \"--pre-assemble\" resolves the problem; in rare cases using\n"
                       << command << ": note: option \"--levels=NUMBER\" to force blending with a certain\n"
                       << command << ": note: NUMBER of levels can help, too" << std::endl;
+        }
 
-            // Copy white image into black image verbatim.
+        // Copy white image into black image verbatim.
 #ifdef OPENMP
-            omp::scoped_nested(true);
-            omp::scoped_dynamic(true);
+        omp::scoped_nested(true);
+        omp::scoped_dynamic(true);
 #pragma omp parallel
-            {
+        {
 #pragma omp single nowait
-                {
+            {
 #endif
-                    vigra::omp::copyImageIf(srcImageRange(*(whitePair.first)),
-                                            maskImage(*(whitePair.second)),
-                                            destImage(*(blackPair.first)));
-                    vigra::omp::copyImageIf(srcImageRange(*(whitePair.second)),
-                                            maskImage(*(whitePair.second)),
-                                            destImage(*(blackPair.second)));
+                vigra::omp::copyImageIf(srcImageRange(*(whitePair.first)),
+                                        maskImage(*(whitePair.second)),
+                                        destImage(*(blackPair.first)));
+                vigra::omp::copyImageIf(srcImageRange(*(whitePair.second)),
+                                        maskImage(*(whitePair.second)),
+                                        destImage(*(blackPair.second)));
 #ifdef OPENMP
-                } // omp single
-            } // omp parallel
+            } // omp single
+        } // omp parallel
 #endif
 
-            delete whitePair.first;
-            delete whitePair.second;
-
-            // Checkpoint results.
-            if (Checkpoint) {
-                if (Verbose >= VERBOSE_CHECKPOINTING_MESSAGES) {
-                    std::cerr << command << ": info: ";
-                    if (imageInfoList.empty()) {
-                        std::cerr << "writing final output" << std::endl;
-                    } else {
-                        std::cerr << "checkpointing" << std::endl;
-                    }
-                }
-                checkpoint(blackPair, anOutputImageInfo);
-            }
+        delete whitePair.first;
+        delete whitePair.second;
 
-            blackBB = uBB;
-            continue;
-        }
+        blackBB = uBB;
+        return WhiteCopied;
+    }
 
-        // Estimate memory requirements.
-        if (Verbose >= VERBOSE_MEMORY_ESTIMATION_MESSAGES) {
-            long long bytes = 0;
-
-            // Input images
-            bytes += 2 * uBB.area() * sizeof(ImagePixelType);
-
-            // Input alpha channels
-            bytes += 2 * uBB.area() * sizeof(AlphaPixelType);
-
-            // Mem used during mask generation:
-            long long nftBytes = 0;
-            if (LoadMasks) {
-                nftBytes = 0;
-            } else if (CoarseMask) {
-                nftBytes =
-                    2 * 1/8 * uBB.area() * sizeof(MaskPixelType)
-                    + 2 * 1/8 * uBB.area() * sizeof(vigra::UInt32);
-            } else {
-                nftBytes =
-                    2 * uBB.area() * sizeof(MaskPixelType)
-                    + 2 * uBB.area() * sizeof(vigra::UInt32);
-            }
+    // Estimate memory requirements.
+    if (Verbose >= VERBOSE_MEMORY_ESTIMATION_MESSAGES) {
+        long long bytes = 0;
 
-            long long optBytes = 0;
-            if (LoadMasks) {
-                optBytes = 0;
-            } else if (!OptimizeMask) {
-                optBytes = 0;
-            } else if (CoarseMask) {
-                optBytes = 1/2 * iBB.area() * sizeof(vigra::UInt8);
-            } else {
-                optBytes = iBB.area() * sizeof(vigra::UInt8);
-            }
-            if (VisualizeSeam) {
-                optBytes *= 2;
-            }
+        // Input images
+        bytes += 2 * uBB.area() * sizeof(ImagePixelType);
 
-            const long long bytesDuringMask = bytes + std::max(nftBytes, optBytes);
-            const long long bytesAfterMask = bytes + uBB.area() * sizeof(MaskPixelType);
+        // Input alpha channels
+        bytes += 2 * uBB.area() * sizeof(AlphaPixelType);
 
-            bytes = std::max(bytesDuringMask, bytesAfterMask);
+        // Mem used during mask generation:
+        long long nftBytes = 0;
+        if (LoadMasks) {
+            nftBytes = 0;
+        } else if (CoarseMask) {
+            nftBytes =
+                2 * 1/8 * uBB.area() * sizeof(MaskPixelType)
+                + 2 * 1/8 * uBB.area() * sizeof(vigra::UInt32);
+        } else {
+            nftBytes =
+                2 * uBB.area() * sizeof(MaskPixelType)
+                + 2 * uBB.area() * sizeof(vigra::UInt32);
+        }
 
-            std::cerr << command << ": info: estimated space required for mask generation: "
-                      << static_cast<int>(ceil(bytes / 1000000.0))
-                      << "MB" << std::endl;
+        long long optBytes = 0;
+        if (LoadMasks) {
+            optBytes = 0;
+        } else if (!OptimizeMask) {
+            optBytes = 0;
+        } else if (CoarseMask) {
+            optBytes = 1/2 * iBB.area() * sizeof(vigra::UInt8);
+        } else {
+            optBytes = iBB.area() * sizeof(vigra::UInt8);
+        }
+        if (VisualizeSeam) {
+            optBytes *= 2;
         }
 
-        // Create the blend mask.
-        const bool wraparoundForMask =
-            WrapAround != OpenBoundaries &&
-            uBB.width() == anInputUnion.width();
-
-        MaskType* mask =
-            createMask<ImageType, AlphaType, MaskType>(whitePair.first, blackPair.first,
-                                                       whitePair.second, blackPair.second,
-                                                       uBB, iBB, wraparoundForMask,
-                                                       numberOfImages,
-                                                       inputFileNameIterator, m);
-
-        // Calculate bounding box of seam line.
-        vigra::Rect2D mBB;
-        maskBounds(mask, uBB, mBB);
-
-        if (SaveMasks) {
-            const std::string maskFilename =
-                enblend::expandFilenameTemplate(SaveMaskTemplate,
-                                                numberOfImages,
-                                                *inputFileNameIterator,
-                                                OutputFileName,
-                                                m);
-            if (maskFilename == *inputFileNameIterator) {
-                std::cerr << command
-                          << ": will not overwrite input image \""
-                          << *inputFileNameIterator
-                          << "\" with mask file"
-                          << std::endl;
-                exit(1);
-            } else if (maskFilename == OutputFileName) {
+        const long long bytesDuringMask = bytes + std::max(nftBytes, optBytes);
+        const long long bytesAfterMask = bytes + uBB.area() * sizeof(MaskPixelType);
+
+        bytes = std::max(bytesDuringMask, bytesAfterMask);
+
+        std::cerr << command << ": info: estimated space required for mask generation: "
+                  << static_cast<int>(ceil(bytes / 1000000.0))
+                  << "MB" << std::endl;
+    }
+
+    // Create the blend mask.
+    const bool wraparoundForMask =
+        WrapAround != OpenBoundaries &&
+        uBB.width() == anInputUnion.width();
+
+    MaskType* mask =
+        createMask<ImageType, AlphaType, MaskType>(whitePair.first, blackPair.first,
+                                                   whitePair.second, blackPair.second,
+                                                   uBB, iBB, wraparoundForMask,
+                                                   numberOfImages,
+                                                   inputFileNameIterator, m);
+
+    // Summarize the mask tile by tile.  Most of it is uniform, so
+    // the passes below can skip or bulk-copy those parts.
+    MaskTiles<MaskType> maskTiles(mask, static_cast<int>(parameter::mask_tile_size.value()));
+
+    // Calculate bounding box of seam line.
+    vigra::Rect2D mBB;
+    maskBounds(mask, maskTiles, uBB, mBB);
+
+    if (SaveMasks) {
+        const std::string maskFilename =
+            enblend::expandFilenameTemplate(SaveMaskTemplate,
+                                            numberOfImages,
+                                            *inputFileNameIterator,
+                                            OutputFileName,
+                                            m);
+        if (maskFilename == *inputFileNameIterator) {
+            std::cerr << command
+                      << ": will not overwrite input image \""
+                      << *inputFileNameIterator
+                      << "\" with mask file"
+                      << std::endl;
+            exit(1);
+        } else if (maskFilename == OutputFileName) {
+            std::cerr << command
+                      << ": will not overwrite output image \""
+                      << OutputFileName
+                      << "\" with mask file"
+                      << std::endl;
+            exit(1);
+        } else {
+            if (Verbose >= VERBOSE_MASK_MESSAGES) {
                 std::cerr << command
-                          << ": will not overwrite output image \""
-                          << OutputFileName
-                          << "\" with mask file"
-                          << std::endl;
-                exit(1);
-            } else {
-                if (Verbose >= VERBOSE_MASK_MESSAGES) {
-                    std::cerr << command
-                              << ": info: saving mask \"" << maskFilename << "\"" << std::endl;
-                }
-                vigra::ImageExportInfo maskInfo(maskFilename.c_str());
-                maskInfo.setXResolution(ImageResolution.x);
-                maskInfo.setYResolution(ImageResolution.y);
-                maskInfo.setPosition(uBB.upperLeft());
-                maskInfo.setCompression(MASK_COMPRESSION);
-                exportImage(srcImageRange(*mask), maskInfo);
+                          << ": info: saving mask \"" << maskFilename << "\"" << std::endl;
             }
+            vigra::ImageExportInfo maskInfo(maskFilename.c_str());
+            maskInfo.setXResolution(ImageResolution.x);
+            maskInfo.setYResolution(ImageResolution.y);
+            maskInfo.setPosition(uBB.upperLeft());
+            maskInfo.setCompression(MASK_COMPRESSION);
+            exportImage(srcImageRange(*mask), maskInfo);
         }
+    }
 
-        // mem usage here = MaskType*ubb +
-        //                  2*anInputUnion*ImageValueType +
-        //                  2*anInputUnion*AlphaValueType
-
-        // Calculate ROI bounds and number of levels from mBB.
-        // ROI bounds must be at least mBB but not to extend uBB.
-        vigra::Rect2D roiBB;
-        const unsigned int numLevels =
-            roiBounds<ImagePixelComponentType>(anInputUnion,
-                                               iBB, mBB, uBB, roiBB,
-                                               wraparoundForMask);
-        const bool wraparoundForBlend =
-            WrapAround != OpenBoundaries &&
-            roiBB.width() == anInputUnion.width();
-
-        if (StopAfterMaskGeneration) {
-            vigra::copyImageIf(vigra_ext::apply(uBB, srcImageRange(*(whitePair.first))),
-                               maskImage(*mask),
-                               vigra_ext::apply(uBB, destImage(*(blackPair.first))));
-            vigra::initImageIf(vigra_ext::apply(whiteBB, destImageRange(*(blackPair.second))),
-                               vigra_ext::apply(whiteBB, maskImage(*(whitePair.second))),
-                               vigra::NumericTraits<AlphaPixelType>::max());
-
-            delete whitePair.first;
-            delete whitePair.second;
-
-            blackBB = uBB;
-            ++m;
-            ++inputFileNameIterator;
+    // mem usage here = MaskType*ubb +
+    //                  2*anInputUnion*ImageValueType +
+    //                  2*anInputUnion*AlphaValueType
+
+    // Calculate ROI bounds and number of levels from mBB.
+    // ROI bounds must be at least mBB but not to extend uBB.
+    vigra::Rect2D roiBB;
+    const unsigned int numLevels =
+        roiBounds<ImagePixelComponentType>(anInputUnion,
+                                           iBB, mBB, uBB, roiBB,
+                                           wraparoundForMask);
+    const bool wraparoundForBlend =
+        WrapAround != OpenBoundaries &&
+        roiBB.width() == anInputUnion.width();
+
+    if (StopAfterMaskGeneration) {
+        copyImageIfTiled(vigra_ext::apply(uBB, srcImageRange(*(whitePair.first))),
+                         mask, maskTiles,
+                         vigra_ext::apply(uBB, destImage(*(blackPair.first))));
+        vigra::initImageIf(vigra_ext::apply(whiteBB, destImageRange(*(blackPair.second))),
+                           vigra_ext::apply(whiteBB, maskImage(*(whitePair.second))),
+                           vigra::NumericTraits<AlphaPixelType>::max());
 
-            continue;
-        }
+        delete whitePair.first;
+        delete whitePair.second;
 
-        // Estimate memory requirements for this blend iteration
+        blackBB = uBB;
+        return WhiteBlended;
+    }
+
+    // Estimate memory requirements for this blend iteration
+    if (Verbose >= VERBOSE_MEMORY_ESTIMATION_MESSAGES) {
+        // Maximum utilization is when all three pyramids have been built
+        // mem xsection = 4 * roiBB.width() * SKIPSMImagePixelType
+        //                + 4 * roiBB.width() * SKIPSMAlphaPixelType
+        // mem usage after = anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
+        //      + (4/3)*roiBB*MaskPyramidType
+        //      + 2*(4/3)*roiBB*ImagePyramidType
+        long long bytes =
+            anInputUnion.area() * (sizeof(ImagePixelType) + 2 * sizeof(AlphaPixelType))
+            + (4/3) * roiBB.area() * (sizeof(MaskPyramidPixelType)
+                                      + 2 * sizeof(ImagePyramidPixelType))
+            + (4 * roiBB.width()) * (sizeof(SKIPSMImagePixelType)
+                                     + sizeof(SKIPSMAlphaPixelType));
+
+        std::cerr << command << ": info: estimated space required for this blend step: "
+                  << static_cast<int>(ceil(bytes / 1000000.0))
+                  << "MB" << std::endl;
+    }
+
+    // With a memory limit the pyramids may have to be built in
+    // horizontal bands rather than over the whole ROI at once.
+    const unsigned long long residentBytes =
+        anInputUnion.area() * 2ULL * (sizeof(ImagePixelType) + sizeof(AlphaPixelType))
+        + uBB.area() * static_cast<unsigned long long>(sizeof(MaskPixelType));
+    const int roiBandHeight =
+        bandHeight<ImagePixelType>(roiBB, numLevels, MemoryLimit, residentBytes);
+
+    if (roiBandHeight < roiBB.height()) {
         if (Verbose >= VERBOSE_MEMORY_ESTIMATION_MESSAGES) {
-            // Maximum utilization is when all three pyramids have been built
-            // mem xsection = 4 * roiBB.width() * SKIPSMImagePixelType
-            //                + 4 * roiBB.width() * SKIPSMAlphaPixelType
-            // mem usage after = anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
-            //      + (4/3)*roiBB*MaskPyramidType
-            //      + 2*(4/3)*roiBB*ImagePyramidType
-            long long bytes =
-                anInputUnion.area() * (sizeof(ImagePixelType) + 2 * sizeof(AlphaPixelType))
-                + (4/3) * roiBB.area() * (sizeof(MaskPyramidPixelType)
-                                          + 2 * sizeof(ImagePyramidPixelType))
-                + (4 * roiBB.width()) * (sizeof(SKIPSMImagePixelType)
-                                         + sizeof(SKIPSMAlphaPixelType));
-
-            std::cerr << command << ": info: estimated space required for this blend step: "
-                      << static_cast<int>(ceil(bytes / 1000000.0))
-                      << "MB" << std::endl;
+            std::cerr << command << ": info: memory limit requires blending in bands of "
+                      << roiBandHeight << " rows plus an apron of " << bandApron(numLevels)
+                      << " rows" << std::endl;
         }
 
-        // Create a version of roiBB relative to uBB upperleft corner.
-        // This is to access roi within images of size uBB.
-        // For example, the mask.
-        vigra::Rect2D roiBB_uBB = roiBB;
-        roiBB_uBB.moveBy(-uBB.upperLeft());
-
-        // Build Gaussian pyramid from mask.
-        std::vector<MaskPyramidType*> *maskGP =
-            gaussianPyramid<MaskType, MaskPyramidType,
-                            MaskPyramidIntegerBits, MaskPyramidFractionBits,
-                            SKIPSMMaskPixelType>(numLevels, wraparoundForBlend,
-                                                 vigra_ext::apply(roiBB_uBB, srcImageRange(*mask)));
-#ifdef DEBUG_EXPORT_PYRAMID
-        exportPyramid<SKIPSMMaskPixelType, MaskPyramidType>(maskGP, "mask");
-#endif
+        blendInBands<ImagePixelType>(whitePair, blackPair, mask, &maskTiles,
+                                     uBB, whiteBB, roiBB,
+                                     numLevels, wraparoundForBlend, roiBandHeight);
 
-        // mem usage before = MaskType*ubb + 2*anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
-        // mem usage xsection = 3 * roiBB.width * MaskPyramidType
-        // mem usage after = MaskType*ubb + 2*anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
-        //                   + (4/3)*roiBB*MaskPyramidType
-
-        // Now it is safe to make changes to mask image.
-        // Black out the ROI in the mask.
-        // Make an roiBounds relative to uBB origin.
-        vigra::initImage(vigra_ext::apply(roiBB_uBB, destImageRange(*mask)),
-                         vigra::NumericTraits<MaskPyramidPixelType>::zero());
-
-        // Copy pixels inside whiteBB and inside white part of mask into black image.
-        // These are pixels where the white image contributes outside of the ROI.
-        // We cannot modify black image inside the ROI yet because we haven't built the
-        // black pyramid.
-        vigra::copyImageIf(vigra_ext::apply(uBB, srcImageRange(*(whitePair.first))),
-                           maskImage(*mask),
-                           vigra_ext::apply(uBB, destImage(*(blackPair.first))));
-
-        // We no longer need the mask.
         delete mask;
-        // mem usage after = 2*anInputUnion*ImageValueType +
-        //                   2*anInputUnion*AlphaValueType +
-        //                   (4/3)*roiBB*MaskPyramidType
-
-        // Build Laplacian pyramid from white image.
-        std::vector<ImagePyramidType*>* whiteLP =
-            laplacianPyramid<ImageType, AlphaType, ImagePyramidType,
-                             ImagePyramidIntegerBits, ImagePyramidFractionBits,
-                             SKIPSMImagePixelType, SKIPSMAlphaPixelType>
-            ("whiteGP",
-             numLevels, wraparoundForBlend,
-             vigra_ext::apply(roiBB, srcImageRange(*(whitePair.first))),
-             vigra_ext::apply(roiBB, maskImage(*(whitePair.second))));
+        delete whitePair.first;
+        delete whitePair.second;
 
-        // mem usage after = 2*anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
-        //                   + (4/3)*roiBB*MaskPyramidType + (4/3)*roiBB*ImagePyramidType
-        // mem xsection = 4 * roiBB.width() * SKIPSMImagePixelType
-        //                + 4 * roiBB.width() * SKIPSMAlphaPixelType
+        blackBB = uBB;
+        return WhiteBlended;
+    }
 
-        // We no longer need the white rgb data.
-        delete whitePair.first;
-        // mem usage after = anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
-        //                   + (4/3)*roiBB*MaskPyramidType + (4/3)*roiBB*ImagePyramidType
-
-        // Build Laplacian pyramid from black image.
-        std::vector<ImagePyramidType*>* blackLP =
-            laplacianPyramid<ImageType, AlphaType, ImagePyramidType,
-                             ImagePyramidIntegerBits, ImagePyramidFractionBits,
-                             SKIPSMImagePixelType, SKIPSMAlphaPixelType>
-            ("blackGP",
-             numLevels, wraparoundForBlend,
-             vigra_ext::apply(roiBB, srcImageRange(*(blackPair.first))),
-             vigra_ext::apply(roiBB, maskImage(*(blackPair.second))));
+    // Create a version of roiBB relative to uBB upperleft corner.
+    // This is to access roi within images of size uBB.
+    // For example, the mask.
+    vigra::Rect2D roiBB_uBB = roiBB;
+    roiBB_uBB.moveBy(-uBB.upperLeft());
+
+    // Build Gaussian pyramid from mask.
+    std::vector<MaskPyramidType*> *maskGP =
+        gaussianPyramid<MaskType, MaskPyramidType,
+                        MaskPyramidIntegerBits, MaskPyramidFractionBits,
+                        SKIPSMMaskPixelType>(numLevels, wraparoundForBlend,
+                                             vigra_ext::apply(roiBB_uBB, srcImageRange(*mask)));
+#ifdef DEBUG_EXPORT_PYRAMID
+    exportPyramid<SKIPSMMaskPixelType, MaskPyramidType>(maskGP, "mask");
+#endif
+
+    // mem usage before = MaskType*ubb + 2*anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
+    // mem usage xsection = 3 * roiBB.width * MaskPyramidType
+    // mem usage after = MaskType*ubb + 2*anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
+    //                   + (4/3)*roiBB*MaskPyramidType
+
+    // Now it is safe to make changes to mask image.
+    // Black out the ROI in the mask.
+    // Make an roiBounds relative to uBB origin.
+    vigra::initImage(vigra_ext::apply(roiBB_uBB, destImageRange(*mask)),
+                     vigra::NumericTraits<MaskPyramidPixelType>::zero());
+    maskTiles.clear(roiBB_uBB);
+
+    // Copy pixels inside whiteBB and inside white part of mask into black image.
+    // These are pixels where the white image contributes outside of the ROI.
+    // We cannot modify black image inside the ROI yet because we haven't built the
+    // black pyramid.
+    copyImageIfTiled(vigra_ext::apply(uBB, srcImageRange(*(whitePair.first))),
+                     mask, maskTiles,
+                     vigra_ext::apply(uBB, destImage(*(blackPair.first))));
+
+    // We no longer need the mask.
+    delete mask;
+    // mem usage after = 2*anInputUnion*ImageValueType +
+    //                   2*anInputUnion*AlphaValueType +
+    //                   (4/3)*roiBB*MaskPyramidType
+
+    // Build Laplacian pyramid from white image.
+    std::vector<ImagePyramidType*>* whiteLP =
+        laplacianPyramid<ImageType, AlphaType, ImagePyramidType,
+                         ImagePyramidIntegerBits, ImagePyramidFractionBits,
+                         SKIPSMImagePixelType, SKIPSMAlphaPixelType>
+        ("whiteGP",
+         numLevels, wraparoundForBlend,
+         vigra_ext::apply(roiBB, srcImageRange(*(whitePair.first))),
+         vigra_ext::apply(roiBB, maskImage(*(whitePair.second))));
+
+    // mem usage after = 2*anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
+    //                   + (4/3)*roiBB*MaskPyramidType + (4/3)*roiBB*ImagePyramidType
+    // mem xsection = 4 * roiBB.width() * SKIPSMImagePixelType
+    //                + 4 * roiBB.width() * SKIPSMAlphaPixelType
+
+    // We no longer need the white rgb data.
+    delete whitePair.first;
+    // mem usage after = anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
+    //                   + (4/3)*roiBB*MaskPyramidType + (4/3)*roiBB*ImagePyramidType
+
+    // Build Laplacian pyramid from black image.
+    std::vector<ImagePyramidType*>* blackLP =
+        laplacianPyramid<ImageType, AlphaType, ImagePyramidType,
+                         ImagePyramidIntegerBits, ImagePyramidFractionBits,
+                         SKIPSMImagePixelType, SKIPSMAlphaPixelType>
+        ("blackGP",
+         numLevels, wraparoundForBlend,
+         vigra_ext::apply(roiBB, srcImageRange(*(blackPair.first))),
+         vigra_ext::apply(roiBB, maskImage(*(blackPair.second))));
 
 #ifdef DEBUG_EXPORT_PYRAMID
-        exportPyramid<SKIPSMImagePixelType, ImagePyramidType>(blackLP, "enblend_black_lp");
+    exportPyramid<SKIPSMImagePixelType, ImagePyramidType>(blackLP, "enblend_black_lp");
 #endif
 
-        // Peak memory xsection is here!
-        // mem xsection = 4 * roiBB.width() * SKIPSMImagePixelType
-        //                + 4 * roiBB.width() * SKIPSMAlphaPixelType
-        // mem usage after = anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
-        //      + (4/3)*roiBB*MaskPyramidType
-        //      + 2*(4/3)*roiBB*ImagePyramidType
+    // Peak memory xsection is here!
+    // mem xsection = 4 * roiBB.width() * SKIPSMImagePixelType
+    //                + 4 * roiBB.width() * SKIPSMAlphaPixelType
+    // mem usage after = anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
+    //      + (4/3)*roiBB*MaskPyramidType
+    //      + 2*(4/3)*roiBB*ImagePyramidType
 
-        // Make the black image alpha equal to the union of the
-        // white and black alpha channels.
-        vigra::initImageIf(vigra_ext::apply(whiteBB, destImageRange(*(blackPair.second))),
-                           vigra_ext::apply(whiteBB, maskImage(*(whitePair.second))),
-                           vigra::NumericTraits<AlphaPixelType>::max());
+    // Make the black image alpha equal to the union of the
+    // white and black alpha channels.
+    vigra::initImageIf(vigra_ext::apply(whiteBB, destImageRange(*(blackPair.second))),
+                       vigra_ext::apply(whiteBB, maskImage(*(whitePair.second))),
+                       vigra::NumericTraits<AlphaPixelType>::max());
 
-        // We no longer need the white alpha data.
-        delete whitePair.second;
+    // We no longer need the white alpha data.
+    delete whitePair.second;
 
-        // mem usage after = anInputUnion*ImageValueType + anInputUnion*AlphaValueType
-        //      + (4/3)*roiBB*MaskPyramidType + 2*(4/3)*roiBB*ImagePyramidType
+    // mem usage after = anInputUnion*ImageValueType + anInputUnion*AlphaValueType
+    //      + (4/3)*roiBB*MaskPyramidType + 2*(4/3)*roiBB*ImagePyramidType
 
-        // Blend pyramids
-        ConvertScalarToPyramidFunctor<MaskPixelType, MaskPyramidPixelType,
-                                      MaskPyramidIntegerBits, MaskPyramidFractionBits> whiteMask;
+    // Blend pyramids
+    ConvertScalarToPyramidFunctor<MaskPixelType, MaskPyramidPixelType,
+                                  MaskPyramidIntegerBits, MaskPyramidFractionBits> whiteMask;
+#ifdef DEBUG_EXPORT_PYRAMID
+    // The exports below need all levels of the mask and white pyramids.
+    const bool fuseBlendAndCollapse = false;
+#else
+    const bool fuseBlendAndCollapse = parameter::fuse_blend_collapse.value();
+#endif
+    timer::WallClock blend_collapse_clock;
+    if (fuseBlendAndCollapse) {
+        // Releases the mask and white pyramid levels as it goes.
+        blendAndCollapsePyramid<SKIPSMImagePixelType>(wraparoundForBlend, maskGP, whiteLP, blackLP,
+                                                      whiteMask(vigra::NumericTraits<MaskPixelType>::max()));
+    } else {
         blend(maskGP, whiteLP, blackLP, whiteMask(vigra::NumericTraits<MaskPixelType>::max()));
+    }
 
-        // delete mask pyramid
+    // delete mask pyramid
 #ifdef DEBUG_EXPORT_PYRAMID
-        exportPyramid<SKIPSMMaskPixelType, MaskPyramidType>(maskGP, "enblend_mask_gp");
+    exportPyramid<SKIPSMMaskPixelType, MaskPyramidType>(maskGP, "enblend_mask_gp");
 #endif
-        for (unsigned int i = 0; i < maskGP->size(); i++) {
-            delete (*maskGP)[i];
-        }
-        delete maskGP;
+    for (unsigned int i = 0; i < maskGP->size(); i++) {
+        delete (*maskGP)[i];
+    }
+    delete maskGP;
 
-        // mem usage after = anInputUnion*ImageValueType + anInputUnion*AlphaValueType + 2*(4/3)*roiBB*ImagePyramidType
+    // mem usage after = anInputUnion*ImageValueType + anInputUnion*AlphaValueType + 2*(4/3)*roiBB*ImagePyramidType
 
-        // delete white pyramid
+    // delete white pyramid
 #ifdef DEBUG_EXPORT_PYRAMID
-        exportPyramid<SKIPSMImagePixelType, ImagePyramidType>(whiteLP, "enblend_white_lp");
+    exportPyramid<SKIPSMImagePixelType, ImagePyramidType>(whiteLP, "enblend_white_lp");
 #endif
-        for (unsigned int i = 0; i < whiteLP->size(); i++) {
-            delete (*whiteLP)[i];
-        }
-        delete whiteLP;
+    for (unsigned int i = 0; i < whiteLP->size(); i++) {
+        delete (*whiteLP)[i];
+    }
+    delete whiteLP;
 
-        // mem usage after = anInputUnion*ImageValueType + anInputUnion*AlphaValueType + (4/3)*roiBB*ImagePyramidType
+    // mem usage after = anInputUnion*ImageValueType + anInputUnion*AlphaValueType + (4/3)*roiBB*ImagePyramidType
 
 #ifdef DEBUG_EXPORT_PYRAMID
-        exportPyramid<SKIPSMImagePixelType, ImagePyramidType>(blackLP, "enblend_blend_lp");
+    exportPyramid<SKIPSMImagePixelType, ImagePyramidType>(blackLP, "enblend_blend_lp");
 #endif
 
-        // collapse black pyramid
+    // collapse black pyramid
+    if (!fuseBlendAndCollapse) {
         collapsePyramid<SKIPSMImagePixelType>(wraparoundForBlend, blackLP);
+    }
+
+    blend_collapse_clock.stop();
+    if (parameter::time_blend_collapse.value()) {
+        const std::ios::fmtflags flags(std::cerr.flags());
+        const double traffic =
+            blendAndCollapseTraffic<MaskPyramidType>(blackLP, fuseBlendAndCollapse);
+        const double otherTraffic =
+            blendAndCollapseTraffic<MaskPyramidType>(blackLP, !fuseBlendAndCollapse);
+        std::cerr <<
+            command << ": timing: wall-clock runtime of `" <<
+            (fuseBlendAndCollapse ? "Fused Blend and Collapse" : "Blend, then Collapse") << "': " <<
+            std::setprecision(3) << 1000.0 * blend_collapse_clock.value() << " ms\n" <<
+            command << ": timing: estimated memory traffic: " <<
+            traffic / 1048576.0 << " MB (" <<
+            (fuseBlendAndCollapse ? "two-pass" : "fused") << ": " << otherTraffic / 1048576.0 << " MB)\n" <<
+            command << ": timing: effective bandwidth: " <<
+            traffic / (1048576.0 * blend_collapse_clock.value()) << " MB/s" <<
+            std::endl;
+        std::cerr.flags(flags);
+    }
+
+    // copy collapsed black pyramid into black image ROI, using black alpha mask.
+    copyFromPyramidImageIf<ImagePyramidType, MaskType, ImageType,
+                           ImagePyramidIntegerBits, ImagePyramidFractionBits>
+        (srcImageRange(*((*blackLP)[0])),
+         vigra_ext::apply(roiBB, maskImage(*(blackPair.second))),
+         vigra_ext::apply(roiBB, destImage(*(blackPair.first))));
+
+    // delete black pyramid
+    for (unsigned int i = 0; i < blackLP->size(); i++) {
+        delete (*blackLP)[i];
+    }
+    delete blackLP;
+
+    // mem usage after = anInputUnion*ImageValueType + anInputUnion*AlphaValueType
+
+    // Now set blackBB to uBB.
+    blackBB = uBB;
+
+    return WhiteBlended;
+}
+
+
+/** A leaf of the blending tree: one input image and its position in
+ *  the list of input images.
+ */
+struct BlendTreeLeaf
+{
+    vigra::ImageImportInfo* info;
+    unsigned index;
+};
+
+typedef std::vector<BlendTreeLeaf> BlendTreeLeafList;
+
+
+/** Reorder [first, last) so that the two halves of the range, their
+ *  halves, and so on each cover a compact part of the panorama.
+ *  blendSubtree() splits the range at the same points, so that the
+ *  siblings it blends are spatially adjacent.
+ */
+inline void
+spatialBlendOrder(BlendTreeLeafList::iterator first, BlendTreeLeafList::iterator last)
+{
+    if (last - first <= 2) {
+        return;
+    }
+
+    // Work with doubled centers to stay in integers.
+    auto center = [](const BlendTreeLeaf& leaf) {
+        return vigra::Diff2D(2 * leaf.info->getPosition().x + leaf.info->width(),
+                             2 * leaf.info->getPosition().y + leaf.info->height());
+    };
+
+    vigra::Diff2D lower(center(*first));
+    vigra::Diff2D upper(lower);
+    for (BlendTreeLeafList::iterator leaf = first; leaf != last; ++leaf) {
+        const vigra::Diff2D c(center(*leaf));
+        lower.x = std::min(lower.x, c.x);
+        lower.y = std::min(lower.y, c.y);
+        upper.x = std::max(upper.x, c.x);
+        upper.y = std::max(upper.y, c.y);
+    }
+
+    // Cut across the longer extent; keep the command-line order of
+    // images that line up.
+    if (upper.x - lower.x >= upper.y - lower.y) {
+        std::stable_sort(first, last,
+                         [&](const BlendTreeLeaf& a, const BlendTreeLeaf& b) {return center(a).x < center(b).x;});
+    } else {
+        std::stable_sort(first, last,
+                         [&](const BlendTreeLeaf& a, const BlendTreeLeaf& b) {return center(a).y < center(b).y;});
+    }
+
+    const BlendTreeLeafList::iterator middle = first + (last - first) / 2;
+    spatialBlendOrder(first, middle);
+    spatialBlendOrder(middle, last);
+}
+
+
+/** Blend the images in [first, last) as a balanced binary tree and
+ *  answer the result.  Up to aParallelDepth levels below this one
+ *  blend their two subtrees concurrently.
+ */
+template <typename ImagePixelType>
+std::pair<typename EnblendNumericTraits<ImagePixelType>::ImageType*,
+          typename EnblendNumericTraits<ImagePixelType>::AlphaType*>
+blendSubtree(const FileNameList& anInputFileNameList,
+             BlendTreeLeafList::const_iterator first, BlendTreeLeafList::const_iterator last,
+             const vigra::Rect2D& anInputUnion,
+             unsigned numberOfImages,
+             int aParallelDepth,
+             omp::lock& anImportLock,
+             vigra::Rect2D& aBoundingBox)
+{
+    typedef typename EnblendNumericTraits<ImagePixelType>::ImageType ImageType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::AlphaType AlphaType;
+    typedef std::pair<ImageType*, AlphaType*> ImagePair;
+
+    if (last - first == 1) {
+        // assemble() wants a mutable union and a list it can consume.
+        std::list<vigra::ImageImportInfo*> leaf(1, first->info);
+        vigra::Rect2D inputUnion(anInputUnion);
+        omp::scoped_lock<omp::lock> guard(anImportLock);
+        return assemble<ImageType, AlphaType>(leaf, inputUnion, aBoundingBox);
+    }
+
+    const BlendTreeLeafList::const_iterator middle = first + (last - first) / 2;
+    vigra::Rect2D blackBB;
+    vigra::Rect2D whiteBB;
+    ImagePair blackPair;
+    ImagePair whitePair;
+
+#ifdef OPENMP
+    if (aParallelDepth > 0) {
+        omp::scoped_nested nested(true);
+        omp::scoped_dynamic dynamic(true);
+
+#pragma omp parallel sections num_threads(2)
+        {
+#pragma omp section
+            blackPair = blendSubtree<ImagePixelType>(anInputFileNameList, first, middle, anInputUnion,
+                                                     numberOfImages, aParallelDepth - 1, anImportLock,
+                                                     blackBB);
+#pragma omp section
+            whitePair = blendSubtree<ImagePixelType>(anInputFileNameList, middle, last, anInputUnion,
+                                                     numberOfImages, aParallelDepth - 1, anImportLock,
+                                                     whiteBB);
+        }
+    } else
+#endif
+    {
+        blackPair = blendSubtree<ImagePixelType>(anInputFileNameList, first, middle, anInputUnion,
+                                                 numberOfImages, 0, anImportLock, blackBB);
+        whitePair = blendSubtree<ImagePixelType>(anInputFileNameList, middle, last, anInputUnion,
+                                                 numberOfImages, 0, anImportLock, whiteBB);
+    }
+
+    // Masks of a merge get named after the first image of the white
+    // subtree, which is unique among all merges.
+    const unsigned m = middle->index;
+    FileNameList::const_iterator inputFileNameIterator(anInputFileNameList.begin());
+    std::advance(inputFileNameIterator, m);
+
+    // Neighboring subtrees that do not touch are expected here.
+    blendImagePair<ImagePixelType>(blackPair, blackBB, whitePair, whiteBB, anInputUnion,
+                                   numberOfImages, inputFileNameIterator, m, false);
+
+    aBoundingBox = blackBB;
+    return blackPair;
+}
 
-        // copy collapsed black pyramid into black image ROI, using black alpha mask.
-        copyFromPyramidImageIf<ImagePyramidType, MaskType, ImageType,
-                               ImagePyramidIntegerBits, ImagePyramidFractionBits>
-            (srcImageRange(*((*blackLP)[0])),
-             vigra_ext::apply(roiBB, maskImage(*(blackPair.second))),
-             vigra_ext::apply(roiBB, destImage(*(blackPair.first))));
 
-        // delete black pyramid
-        for (unsigned int i = 0; i < blackLP->size(); i++) {
-            delete (*blackLP)[i];
+/** Answer how many bytes of memory enblend may use for concurrent
+ *  subtrees: the memory limit if one is given, otherwise the physical
+ *  memory.  Answer zero if we cannot tell.
+ */
+inline unsigned long long
+blendTreeMemoryBudget()
+{
+    if (MemoryLimit != 0ULL) {
+        return MemoryLimit;
+    }
+
+#if defined(_SC_PHYS_PAGES) && defined(_SC_PAGESIZE)
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long page_size = sysconf(_SC_PAGESIZE);
+    if (pages > 0L && page_size > 0L) {
+        return static_cast<unsigned long long>(pages) * static_cast<unsigned long long>(page_size);
+    }
+#endif
+
+    return 0ULL;
+}
+
+
+/** Answer how many levels of the blending tree may blend their
+ *  subtrees concurrently.
+ *
+ *  Every concurrent subtree holds its own black and white pair, each
+ *  an image plus alpha channel the size of anInputUnion.  A depth of
+ *  d therefore needs 2^(d+1) such pairs at the same time, before the
+ *  pyramids of blendImagePair() are counted.  The depth is reduced
+ *  until they fit into the memory limit, or the physical memory if
+ *  no limit is set; if not even two subtrees fit, blend sequentially.
+ */
+template <typename ImagePixelType>
+int
+blendTreeParallelDepth(const vigra::Rect2D& anInputUnion)
+{
+    typedef typename EnblendNumericTraits<ImagePixelType>::AlphaPixelType AlphaPixelType;
+
+#ifdef OPENCL
+    // The OpenCL kernels share a single context and queue.
+    if (UseGPU) {
+        return 0;
+    }
+#endif
+
+    // Loading or saving masks, seam visualizations, or NFT images
+    // imports and exports images and exits on bad file names.
+    // Neither is safe in concurrent subtrees.
+    if (LoadMasks || SaveMasks || VisualizeSeam || parameter::dump_nft_images.value()) {
+        return 0;
+    }
+
+    int depth = 0;
+    for (int threads = omp_get_max_threads(); threads >= 2; threads /= 2) {
+        ++depth;
+    }
+    depth = std::min(depth, static_cast<int>(parameter::blend_tree_parallel_depth.value_or(depth)));
+
+    const unsigned long long budget = blendTreeMemoryBudget();
+    if (depth > 0 && budget != 0ULL) {
+        const unsigned long long pairBytes =
+            static_cast<unsigned long long>(anInputUnion.area()) *
+            static_cast<unsigned long long>(sizeof(ImagePixelType) + sizeof(AlphaPixelType));
+        const int requestedDepth = depth;
+
+        // Leave the last pair to the merge of the top-level subtrees.
+        while (depth > 0 && (2ULL << depth) * pairBytes > budget) {
+            --depth;
         }
-        delete blackLP;
+
+        if (depth < requestedDepth && Verbose >= VERBOSE_MEMORY_ESTIMATION_MESSAGES) {
+            std::cerr << command << ": info: " << budget / (1024ULL * 1024ULL) <<
+                "MB of memory allow for a parallel blend-tree depth of " << depth <<
+                " instead of " << requestedDepth << std::endl;
+        }
+    }
+
+    return depth;
+}
+
+
+/** Enblend's main blending loop. Templatized to handle different image types.
+ */
+template <typename ImagePixelType>
+void enblendMain(const FileNameList& anInputFileNameList,
+                 const std::list<vigra::ImageImportInfo*>& anImageInfoList,
+                 vigra::ImageExportInfo& anOutputImageInfo,
+                 vigra::Rect2D& anInputUnion)
+{
+    typedef typename EnblendNumericTraits<ImagePixelType>::ImageType ImageType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::AlphaType AlphaType;
+
+    std::list<vigra::ImageImportInfo*> imageInfoList(anImageInfoList);
+
+    // Optionally blend in a balanced binary tree of spatially
+    // adjacent images instead of folding one image after the other
+    // into an ever-growing black image.
+    const std::string blendOrder(parameter::blend_order.value());
+    if (blendOrder != "sequential" && blendOrder != "tree") {
+        std::cerr << command << ": unknown blend order \"" << blendOrder << "\";\n"
+                  << command << ": note: valid blend orders are \"sequential\" and \"tree\"" << std::endl;
+        exit(1);
+    }
+    const bool blendAsTree = blendOrder == "tree" && imageInfoList.size() > 2;
+
+    AlphaFootprintIndex footprints;
+    vigra::Rect2D blackBB;
+    std::pair<ImageType*, AlphaType*> blackPair;
+
+    if (!blendAsTree) {
+        // Create the initial black image.
+        blackPair = assemble<ImageType, AlphaType>(imageInfoList, anInputUnion, blackBB, footprints);
+
+        if (Checkpoint) {
+            checkpoint(blackPair, anOutputImageInfo);
+        }
+    }
+
+    // mem usage before = 0
+    // mem xsection = OneAtATime: anInputUnion*imageValueType + anInputUnion*AlphaValueType
+    //                !OneAtATime: 2*anInputUnion*imageValueType + 2*anInputUnion*AlphaValueType
+    // mem usage after = anInputUnion*ImageValueType + anInputUnion*AlphaValueType
+
+    const unsigned numberOfImages = imageInfoList.size();
+
+    unsigned m = 0;
+    FileNameList::const_iterator inputFileNameIterator(anInputFileNameList.begin());
+
+#ifdef HAVE_EXIV2
+    typedef allocate::array<Exiv2::Image::AutoPtr> metadata_array;
+    metadata_array input_metadata(anInputFileNameList.size());
+    {
+        FileNameList::const_iterator filename(anInputFileNameList.begin());
+        metadata_array::pointer metadata {input_metadata.begin()};
+
+        while (filename != anInputFileNameList.end()) {
+            try {
+                new (metadata) metadata_array::value_type(metadata::read(*filename));
+                input_metadata.mark_as_initialized(metadata - input_metadata.begin());
+            }
+            catch (Exiv2::Error& e) {
+                std::cerr <<
+                    command << ": warning: could not read metadata of input image \"" <<
+                    *inputFileNameIterator << "\"\n" <<
+                    command << ": note: " << e.what() << "\n";
+            }
+            ++filename;
+            ++metadata;
+        }
+    }
+#endif
+
+    if (blendAsTree) {
+        BlendTreeLeafList leaves;
+        for (auto info : imageInfoList) {
+            leaves.push_back(BlendTreeLeaf {info, static_cast<unsigned>(leaves.size())});
+        }
+        spatialBlendOrder(leaves.begin(), leaves.end());
+        imageInfoList.clear();
+
+        const int parallelDepth = blendTreeParallelDepth<ImagePixelType>(anInputUnion);
+        if (Verbose >= VERBOSE_BLEND_MESSAGES) {
+            std::cerr << command << ": info: blending " << leaves.size() << " images as a tree";
+            if (parallelDepth > 0) {
+                std::cerr << " with up to " << (1 << parallelDepth) << " concurrent subtrees";
+            }
+            std::cerr << std::endl;
+        }
+
+        // vigra's import functions are not known to be reentrant.
+        omp::lock importLock;
+        blackPair = blendSubtree<ImagePixelType>(anInputFileNameList, leaves.begin(), leaves.end(),
+                                                 anInputUnion, numberOfImages, parallelDepth, importLock,
+                                                 blackBB);
+
+        if (Checkpoint && !StopAfterMaskGeneration) {
+            if (Verbose >= VERBOSE_CHECKPOINTING_MESSAGES) {
+                std::cerr << command << ": info: writing final output" << std::endl;
+            }
+            checkpoint(blackPair, anOutputImageInfo);
+        }
+    }
+
+    while (!imageInfoList.empty()) {
+        // Create the white image.
+        vigra::Rect2D whiteBB;
+        std::pair<ImageType*, AlphaType*> whitePair =
+            assemble<ImageType, AlphaType>(imageInfoList, anInputUnion, whiteBB, footprints);
+
+        // mem usage before = anInputUnion*ImageValueType + anInputUnion*AlphaValueType
+        // mem xsection = OneAtATime: anInputUnion*imageValueType + anInputUnion*AlphaValueType
+        //                !OneAtATime: 2*anInputUnion*imageValueType + 2*anInputUnion*AlphaValueType
+        // mem usage after = 2*anInputUnion*ImageValueType + 2*anInputUnion*AlphaValueType
+
+        const BlendPairResult result =
+            blendImagePair<ImagePixelType>(blackPair, blackBB, whitePair, whiteBB, anInputUnion,
+                                           numberOfImages, inputFileNameIterator, m, true);
 
         // mem usage after = anInputUnion*ImageValueType + anInputUnion*AlphaValueType
 
+        if (result == WhiteBlended) {
+            ++m;
+            ++inputFileNameIterator;
+        }
+
         // Checkpoint results.
-        if (Checkpoint) {
+        if (Checkpoint &&
+            (result == WhiteCopied || (result == WhiteBlended && !StopAfterMaskGeneration))) {
             if (Verbose >= VERBOSE_CHECKPOINTING_MESSAGES) {
                 std::cerr << command << ": info: ";
                 if (imageInfoList.empty()) {
@@ -529,12 +897,6 @@ void enblendMain(const FileNameList& anInputFileNameList,
             }
             checkpoint(blackPair, anOutputImageInfo);
         }
-
-        // Now set blackBB to uBB.
-        blackBB = uBB;
-
-        ++m;
-        ++inputFileNameIterator;
     } // end main blending loop
 
     if (!StopAfterMaskGeneration && !Checkpoint) {
@@ -548,9 +910,9 @@ void enblendMain(const FileNameList& anInputFileNameList,
     delete blackPair.second;
 
 #ifdef HAVE_EXIV2
-    if (OutputIsValid && parameter::as_boolean("metadata-pass-through", true)) {
+    if (OutputIsValid && parameter::metadata_pass_through.value()) {
         const size_t metadata_source_image_index =
-            std::min(static_cast<size_t>(parameter::as_unsigned("metadata-source-image-index", 0)),
+            std::min(static_cast<size_t>(parameter::metadata_source_image_index.value()),
                      input_metadata.size() - 1);
 
         metadata::named_meta_array valid_named_metadata;
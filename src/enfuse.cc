@@ -1851,6 +1851,13 @@ process_options(int argc, char** argv)
         failed = true;
     }
 
+    const std::vector<std::string> parameterMessages(parameter::resolve_all());
+    for (std::vector<std::string>::const_iterator m = parameterMessages.begin();
+         m != parameterMessages.end();
+         ++m) {
+        std::cerr << command << ": warning: " << *m << "; will use default" << std::endl;
+    }
+
     if (failed) {
         exit(1);
     }
@@ -1946,9 +1953,9 @@ process_options(int argc, char** argv)
         }
     }
 
-    if (parameter::as_boolean("dump-exposure-weight-function", false))
+    if (parameter::dump_exposure_weight_function.value())
     {
-        const int n = parameter::as_integer("exposure-weight-function-points", 21);
+        const int n = parameter::exposure_weight_function_points.value();
         exposure_weight::dump_weight_function(ExposureWeightFunction, std::min(std::max(n, 10), 10000));
         exit(0);
     }
@@ -2029,7 +2036,7 @@ int main(int argc, char** argv)
         exit(1);
     }
 
-    if (parameter::as_boolean("dump-global-variables", false)) {
+    if (parameter::dump_global_variables.value()) {
         DUMP_GLOBAL_VARIABLES();
     }
 
@@ -2317,8 +2324,7 @@ int main(int argc, char** argv)
     vigra::ImageExportInfo outputImageInfo(OutputFileName.c_str());
 
     if (!enblend::has_known_image_extension(OutputFileName)) {
-        std::string fallback_output_file_type {parameter::as_string("fallback-output-file-type",
-                                                                    DEFAULT_FALLBACK_OUTPUT_FILE_TYPE)};
+        std::string fallback_output_file_type {parameter::fallback_output_file_type.value()};
         if (OutputFileName == "-") {
             outputImageInfo.setFileName("/dev/stdout");
         } else {
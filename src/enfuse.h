@@ -25,10 +25,18 @@
 #include <config.h>
 #endif
 
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <list>
 #include <map>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
 #include <vigra/flatmorphology.hxx>
 #include <vigra/functorexpression.hxx>
@@ -42,6 +50,7 @@
 #include "allocate.h"
 #include "common.h"
 #include "filespec.h"
+#include "mapped_storage.h"
 #include "opencl.h"
 #include "openmp_def.h"
 #include "openmp_vigra.h"
@@ -52,7 +61,9 @@
 #include "blend.h"
 #include "bounds.h"
 #include "pyramid.h"
+#include "local_stddev.h"
 #include "mga.h"
+#include "timer.h"
 
 
 using vigra::functor::Arg1;
@@ -61,163 +72,6 @@ using vigra::functor::Param;
 
 
 namespace enblend {
-// Keep sum and sum-of-squares together for improved CPU-cache locality.
-template <typename T>
-struct ScratchPad {
-    ScratchPad() : sum(T()), sumSqr(T()), n(size_t()) {}
-
-    T sum;
-    T sumSqr;
-    size_t n;
-};
-
-
-template <class SrcIterator, class SrcAccessor,
-          class MaskIterator, class MaskAccessor,
-          class DestIterator, class DestAccessor>
-void localStdDevIf(SrcIterator src_ul, SrcIterator src_lr, SrcAccessor src_acc,
-                   MaskIterator mask_ul, MaskAccessor mask_acc,
-                   DestIterator dest_ul, DestAccessor dest_acc,
-                   vigra::Size2D size)
-{
-    typedef typename vigra::NumericTraits<typename SrcAccessor::value_type>::RealPromote SrcSumType;
-    typedef vigra::NumericTraits<typename DestAccessor::value_type> DestTraits;
-    typedef ScratchPad<SrcSumType> ScratchPadType;
-    typedef std::vector<ScratchPadType> ScratchPadArray;
-    typedef typename ScratchPadArray::iterator ScratchPadArrayIterator;
-
-    vigra_precondition(size.x > 1 && size.y > 1,
-                       "localStdDevIf(): window for local variance must be at least 2x2");
-    vigra_precondition(src_lr.x - src_ul.x >= size.x &&
-                       src_lr.y - src_ul.y >= size.y,
-                       "localStdDevIf(): window larger than image");
-
-    const typename SrcIterator::difference_type imageSize = src_lr - src_ul;
-    ScratchPadArray scratchPad(imageSize.x + 1);
-
-    const vigra::Diff2D border(size.x / 2, size.y / 2);
-    const vigra::Diff2D nextUpperRight(size.x / 2 + 1, -size.y / 2);
-
-    SrcIterator const srcEnd(src_lr - border);
-    SrcIterator const srcEndXm1(srcEnd - vigra::Diff2D(1, 0));
-
-    // For each row in the source image...
-#ifdef OPENMP
-#pragma omp parallel for firstprivate (scratchPad)
-#endif
-    for (int row = 0; row < imageSize.y - 2 * border.y; ++row)
-    {
-        SrcIterator srcRow(src_ul + border + vigra::Diff2D(0, row));
-        MaskIterator maskRow(mask_ul + border + vigra::Diff2D(0, row));
-        DestIterator destRow(dest_ul + border + vigra::Diff2D(0, row));
-
-        // Row's running values
-        SrcSumType sum = vigra::NumericTraits<SrcSumType>::zero();
-        SrcSumType sumSqr = vigra::NumericTraits<SrcSumType>::zero();
-        size_t n = 0;
-
-        SrcIterator const windowSrcUpperLeft(srcRow - border);
-        SrcIterator const windowSrcLowerRight(srcRow + border);
-        SrcIterator windowSrc;
-        MaskIterator const windowMaskUpperLeft(maskRow - border);
-        MaskIterator windowMask;
-        ScratchPadArrayIterator spCol;
-
-        // Initialize running-sums of this row
-        for (windowSrc = windowSrcUpperLeft, windowMask = windowMaskUpperLeft,
-                 spCol = scratchPad.begin();
-             windowSrc.x <= windowSrcLowerRight.x;
-             ++windowSrc.x, ++windowMask.x, ++spCol)
-        {
-            SrcSumType sumInit = vigra::NumericTraits<SrcSumType>::zero();
-            SrcSumType sumSqrInit = vigra::NumericTraits<SrcSumType>::zero();
-            size_t nInit = 0;
-
-            for (windowSrc.y = windowSrcUpperLeft.y, windowMask.y = windowMaskUpperLeft.y;
-                 windowSrc.y <= windowSrcLowerRight.y;
-                 ++windowSrc.y, ++windowMask.y)
-            {
-                if (mask_acc(windowMask))
-                {
-                    const SrcSumType value = src_acc(windowSrc);
-                    sumInit += value;
-                    sumSqrInit += square(value);
-                    ++nInit;
-                }
-            }
-
-            // Set scratch pad's column-wise values
-            spCol->sum = sumInit;
-            spCol->sumSqr = sumSqrInit;
-            spCol->n = nInit;
-
-            // Update totals
-            sum += sumInit;
-            sumSqr += sumSqrInit;
-            n += nInit;
-        }
-
-        // Write one row of results
-        SrcIterator srcCol(srcRow);
-        MaskIterator maskCol(maskRow);
-        DestIterator destCol(destRow);
-        ScratchPadArrayIterator old(scratchPad.begin());
-        ScratchPadArrayIterator next(scratchPad.begin() + size.x);
-
-        while (true)
-        {
-            // Compute standard deviation
-            if (mask_acc(maskCol))
-            {
-                const SrcSumType result =
-                    n <= 1 ?
-                    vigra::NumericTraits<SrcSumType>::zero() :
-                    sqrt((sumSqr - square(sum) / n) / (n - 1));
-                dest_acc.set(DestTraits::fromRealPromote(result), destCol);
-            }
-            if (srcCol.x == srcEndXm1.x)
-            {
-                break;
-            }
-
-            // Compute auxilliary values of next column
-            SrcSumType sumInit = vigra::NumericTraits<SrcSumType>::zero();
-            SrcSumType sumSqrInit = vigra::NumericTraits<SrcSumType>::zero();
-            size_t nInit = 0;
-
-            for (windowSrc = srcCol + nextUpperRight, windowMask = maskCol + nextUpperRight;
-                 windowSrc.y <= windowSrcLowerRight.y;
-                 ++windowSrc.y, ++windowMask.y)
-            {
-                if (mask_acc(windowMask))
-                {
-                    const SrcSumType value = src_acc(windowSrc);
-                    sumInit += value;
-                    sumSqrInit += square(value);
-                    ++nInit;
-                }
-            }
-
-            // Set sums of next column
-            next->sum = sumInit;
-            next->sumSqr = sumSqrInit;
-            next->n = nInit;
-
-            // Update totals
-            sum += sumInit - old->sum;
-            sumSqr += sumSqrInit - old->sumSqr;
-            n += nInit - old->n;
-
-            // Advance to next column
-            ++srcCol.x;
-            ++maskCol.x;
-            ++destCol.x;
-            ++old;
-            ++next;
-        }
-    }
-}
-
 
 template <typename InputPixelType, typename ResultPixelType>
 class Histogram
@@ -582,19 +436,519 @@ localEntropyIf(vigra::triple<SrcIterator, SrcIterator, SrcAccessor> src,
 }
 
 
+/** Map scalar values to the bins of a FlatHistogram.
+ *
+ *  Integral types cover their full range with the bins.  If the
+ *  number of bins equals the number of representable values -- the
+ *  default for 8-bit and 16-bit types -- each value gets a bin of
+ *  its own and we compute exactly the entropy of the map-based
+ *  Histogram.  Floating-point types cover [0, 1].
+ */
+template <typename ScalarType>
+class EntropyBinning
+{
+    typedef typename vigra::NumericTraits<ScalarType>::isIntegral isIntegral;
+
+public:
+    explicit EntropyBinning(unsigned bins) : bins_(bins) {}
+
+    // Answer the number of representable values of ScalarType or zero
+    // if we cannot represent all of them as bins.
+    static unsigned exactBins() {return exactBinsFun(isIntegral());}
+
+    unsigned bins() const {return bins_;}
+
+    unsigned operator()(ScalarType x) const {return binFun(x, isIntegral());}
+
+private:
+    static double range() {
+        return static_cast<double>(vigra::NumericTraits<ScalarType>::max()) -
+            static_cast<double>(vigra::NumericTraits<ScalarType>::min()) + 1.0;
+    }
+
+    static unsigned exactBinsFun(vigra::VigraTrueType) {
+        return sizeof(ScalarType) <= 2 ? static_cast<unsigned>(range()) : 0U;
+    }
+
+    static unsigned exactBinsFun(vigra::VigraFalseType) {return 0U;}
+
+    // Both the offset and the number of bins are below 2^32, so their
+    // product fits into 64 bits even for 32-bit pixels.  Never do it in
+    // ScalarType.
+    unsigned binFun(ScalarType x, vigra::VigraTrueType) const {
+        static_assert(sizeof(ScalarType) <= 4, "EntropyBinning: integral pixel types wider than 32 bits");
+        const vigra::UInt64 offset =
+            static_cast<vigra::UInt64>(static_cast<vigra::Int64>(x) -
+                                       static_cast<vigra::Int64>(vigra::NumericTraits<ScalarType>::min()));
+        return static_cast<unsigned>(offset * static_cast<vigra::UInt64>(bins_) /
+                                     static_cast<vigra::UInt64>(range()));
+    }
+
+    unsigned binFun(ScalarType x, vigra::VigraFalseType) const {
+        const double bin = std::floor(static_cast<double>(x) * bins_);
+        return bin <= 0.0 ? 0U : (bin >= bins_ - 1.0 ? bins_ - 1U : static_cast<unsigned>(bin));
+    }
+
+    unsigned bins_;
+};
+
+
+/** Histogram with a fixed number of bins in flat arrays, which keeps
+ *  its running entropy up to date with every insertion and erasure.
+ *
+ *  With counts c_i, total count n, and k occupied bins the normalized
+ *  entropy of a channel is
+ *      -(sum_i c_i * log(c_i) / n - log(n)) / log(k),
+ *  so we only track sum_i c_i * log(c_i), n, and k.  All counts are
+ *  bounded by the window area, for which we tabulate log().
+ */
+template <typename InputPixelType, typename ResultPixelType>
+class FlatHistogram
+{
+    enum {GRAY = 0, CHANNELS = 3};
+
+public:
+    typedef vigra::NumericTraits<InputPixelType> InputPixelTraits;
+    typedef typename InputPixelTraits::ValueType KeyType;
+    typedef typename InputPixelTraits::isScalar pixelIsScalar;
+    typedef vigra::NumericTraits<ResultPixelType> ResultPixelTraits;
+    typedef typename ResultPixelTraits::ValueType ResultType;
+
+    FlatHistogram(unsigned bins, unsigned maximumCount) :
+        binning(bins),
+        count(CHANNELS * static_cast<size_t>(bins)),
+        logarithm(maximumCount + 1U), countLogCount(maximumCount + 1U)
+    {
+        logarithm[0] = 0.0;     // just to have a reliable value
+        countLogCount[0] = 0.0;
+        for (unsigned i = 1U; i <= maximumCount; ++i)
+        {
+            logarithm[i] = std::log(static_cast<double>(i));
+            countLogCount[i] = i * logarithm[i];
+        }
+        clear();
+    }
+
+    void clear() {
+        std::fill(count.begin(), count.end(), 0U);
+        for (int channel = 0; channel < CHANNELS; ++channel)
+        {
+            sumCountLogCount[channel] = 0.0;
+            totalCount[channel] = 0U;
+            occupiedBins[channel] = 0U;
+        }
+    }
+
+    void insert(const InputPixelType& x) {insertFun(x, pixelIsScalar());}
+    void erase(const InputPixelType& x) {eraseFun(x, pixelIsScalar());}
+
+    ResultPixelType entropy() const {return entropyFun(pixelIsScalar());}
+
+protected:
+    void insertInChannel(int channel, KeyType x) {
+        unsigned& c = count[channel * binning.bins() + binning(x)];
+        sumCountLogCount[channel] += countLogCount[c + 1U] - countLogCount[c];
+        occupiedBins[channel] += c == 0U;
+        ++c;
+        ++totalCount[channel];
+    }
+
+    void eraseInChannel(int channel, KeyType x) {
+        unsigned& c = count[channel * binning.bins() + binning(x)];
+        assert(c != 0U);
+        sumCountLogCount[channel] += countLogCount[c - 1U] - countLogCount[c];
+        --c;
+        occupiedBins[channel] -= c == 0U;
+        --totalCount[channel];
+    }
+
+    double entropyOfChannel(int channel) const {
+        const unsigned total = totalCount[channel];
+        const unsigned occupied = occupiedBins[channel];
+        if (total == 0U || occupied <= 1U)
+        {
+            return 0.0;
+        }
+        else
+        {
+            return (logarithm[total] - sumCountLogCount[channel] / total) / logarithm[occupied];
+        }
+    }
+
+    // Grayscale
+    void insertFun(const InputPixelType& x, vigra::VigraTrueType) {insertInChannel(GRAY, x);}
+    void eraseFun(const InputPixelType& x, vigra::VigraTrueType) {eraseInChannel(GRAY, x);}
+
+    ResultPixelType entropyFun(vigra::VigraTrueType) const {
+        const double max = static_cast<double>(vigra::NumericTraits<KeyType>::max());
+        return ResultPixelType(ResultPixelTraits::fromRealPromote(entropyOfChannel(GRAY) * max));
+    }
+
+    // RGB
+    void insertFun(const InputPixelType& x, vigra::VigraFalseType) {
+        for (int channel = 0; channel < CHANNELS; ++channel) {
+            insertInChannel(channel, x[channel]);
+        }
+    }
+
+    void eraseFun(const InputPixelType& x, vigra::VigraFalseType) {
+        for (int channel = 0; channel < CHANNELS; ++channel) {
+            eraseInChannel(channel, x[channel]);
+        }
+    }
+
+    ResultPixelType entropyFun(vigra::VigraFalseType) const {
+        const double max = static_cast<double>(vigra::NumericTraits<KeyType>::max());
+        return ResultPixelType(vigra::NumericTraits<ResultType>::fromRealPromote(entropyOfChannel(0) * max),
+                               vigra::NumericTraits<ResultType>::fromRealPromote(entropyOfChannel(1) * max),
+                               vigra::NumericTraits<ResultType>::fromRealPromote(entropyOfChannel(2) * max));
+    }
+
+private:
+    EntropyBinning<KeyType> binning;
+    std::vector<unsigned> count;
+    std::vector<double> logarithm;
+    std::vector<double> countLogCount;
+    double sumCountLogCount[CHANNELS];
+    unsigned totalCount[CHANNELS];
+    unsigned occupiedBins[CHANNELS];
+};
+
+
+/** Compute the local entropy like localEntropyIf(), but with a
+ *  FlatHistogram of the given number of bins.  The window slides
+ *  along each row: we erase its leftmost column and insert the next
+ *  column to the right.  Rows are independent, which lets us
+ *  parallelize over them.
+ */
+template <class SrcIterator, class SrcAccessor,
+          class MaskIterator, class MaskAccessor,
+          class DestIterator, class DestAccessor>
+void localEntropyBinnedIf(SrcIterator src_ul, SrcIterator src_lr, SrcAccessor src_acc,
+                          MaskIterator mask_ul, MaskAccessor mask_acc,
+                          DestIterator dest_ul, DestAccessor dest_acc,
+                          vigra::Size2D size, unsigned bins)
+{
+    typedef typename SrcIterator::PixelType SrcPixelType;
+    typedef typename DestIterator::PixelType DestPixelType;
+    typedef FlatHistogram<SrcPixelType, DestPixelType> HistogramType;
+
+    vigra_precondition(src_lr.x - src_ul.x >= size.x &&
+                       src_lr.y - src_ul.y >= size.y,
+                       "localEntropyBinnedIf(): window larger than image");
+    vigra_precondition(bins >= 2U,
+                       "localEntropyBinnedIf(): need at least two bins");
+
+    const typename SrcIterator::difference_type imageSize = src_lr - src_ul;
+    const vigra::Diff2D border(size.x / 2, size.y / 2);
+    const vigra::Diff2D nextColumn(2 * border.x + 1, 0);
+
+    HistogramType hist(bins, (2 * border.x + 1) * (2 * border.y + 1));
+
+#ifdef OPENMP
+#pragma omp parallel for firstprivate (hist) schedule(guided)
+#endif
+    for (int row = border.y; row < imageSize.y - border.y; ++row)
+    {
+        // The window of the first column of results.
+        SrcIterator const windowSrcUpperLeft(src_ul + vigra::Diff2D(0, row - border.y));
+        MaskIterator const windowMaskUpperLeft(mask_ul + vigra::Diff2D(0, row - border.y));
+        SrcIterator windowSrc(windowSrcUpperLeft);
+        MaskIterator windowMask(windowMaskUpperLeft);
+
+        for (; windowSrc.y <= windowSrcUpperLeft.y + 2 * border.y; ++windowSrc.y, ++windowMask.y)
+        {
+            SrcIterator src(windowSrc);
+            MaskIterator mask(windowMask);
+            for (; src.x <= windowSrc.x + 2 * border.x; ++src.x, ++mask.x)
+            {
+                if (mask_acc(mask))
+                {
+                    hist.insert(src_acc(src));
+                }
+            }
+        }
+
+        // Write one row of results
+        SrcIterator columnSrc(windowSrcUpperLeft);     // leftmost column of the window
+        MaskIterator columnMask(windowMaskUpperLeft);
+        MaskIterator maskCol(mask_ul + vigra::Diff2D(border.x, row));
+        DestIterator destCol(dest_ul + vigra::Diff2D(border.x, row));
+
+        for (int column = border.x; ; ++column, ++columnSrc.x, ++columnMask.x, ++maskCol.x, ++destCol.x)
+        {
+            if (mask_acc(maskCol))
+            {
+                dest_acc.set(hist.entropy(), destCol);
+            }
+
+            const bool lastColumn = column + 1 >= imageSize.x - border.x;
+            SrcIterator src(columnSrc);
+            MaskIterator mask(columnMask);
+            for (int y = 0; y <= 2 * border.y; ++y, ++src.y, ++mask.y)
+            {
+                if (mask_acc(mask))
+                {
+                    hist.erase(src_acc(src)); // remove oldest column
+                }
+                if (!lastColumn && mask_acc(mask + nextColumn))
+                {
+                    hist.insert(src_acc(src + nextColumn)); // add next column
+                }
+            }
+
+            if (lastColumn)
+            {
+                // We have erased the last but 2 * border.x columns of
+                // the window.  Erasing the rest leaves hist empty for
+                // the next row, which is much cheaper than clear().
+                for (int x = 1; x <= 2 * border.x; ++x)
+                {
+                    src = columnSrc + vigra::Diff2D(x, 0);
+                    mask = columnMask + vigra::Diff2D(x, 0);
+                    for (int y = 0; y <= 2 * border.y; ++y, ++src.y, ++mask.y)
+                    {
+                        if (mask_acc(mask))
+                        {
+                            hist.erase(src_acc(src));
+                        }
+                    }
+                }
+                break;
+            }
+        }
+    }
+}
+
+
+/** Answer the number of bins of the flat-histogram entropy engine for
+ *  ScalarType or zero to select the map-based engine.
+ *
+ *  Parameter "entropy-bins" forces the flat histogram with the given
+ *  number of bins, at most 2^24 of them.  Otherwise we use it wherever
+ *  it is exact.
+ */
+template <typename ScalarType>
+unsigned
+entropyBins()
+{
+    // Every histogram keeps a count per bin and channel, and each
+    // thread has its own histogram.
+    const unsigned maximumBins = 1U << 24;
+    const unsigned exactBins = EntropyBinning<ScalarType>::exactBins();
+    const unsigned bins = parameter::entropy_bins.value();
+
+    if (bins == 0U)
+    {
+        return exactBins;
+    }
+    else if (bins < 2U)
+    {
+        std::cerr << command << ": warning: need at least two entropy bins; will use two" << std::endl;
+        return 2U;
+    }
+    else if (exactBins == 0U && bins > maximumBins)
+    {
+        std::cerr << command << ": warning: at most " << maximumBins << " entropy bins; will use " <<
+            maximumBins << std::endl;
+        return maximumBins;
+    }
+    else if (exactBins != 0U && bins > exactBins)
+    {
+        return exactBins;
+    }
+    else
+    {
+        return bins;
+    }
+}
+
+
+/** Compute the local entropy with the flat-histogram engine, wherever
+ *  entropyBins() allows, or the map-based engine.
+ *
+ *  With parameter "time-local-entropy" we report the runtime.  If we
+ *  have used the flat histogram, we then also run the map-based engine
+ *  on the same data and report its runtime and the largest deviation
+ *  of the results.
+ */
 template <typename SrcIterator, typename SrcAccessor,
           typename MaskIterator, typename MaskAccessor,
-          typename DestIterator, typename DestAccessor>
-inline void
-localStdDevIf(vigra::triple<SrcIterator, SrcIterator, SrcAccessor> src,
-              vigra::pair<MaskIterator, MaskAccessor> mask,
-              vigra::pair<DestIterator, DestAccessor> dest,
-              vigra::Size2D size)
+          typename DestImageType>
+void
+selectLocalEntropyIf(vigra::triple<SrcIterator, SrcIterator, SrcAccessor> src,
+                     vigra::pair<MaskIterator, MaskAccessor> mask,
+                     DestImageType& dest,
+                     vigra::Size2D size)
+{
+    typedef typename SrcIterator::PixelType SrcPixelType;
+    typedef typename vigra::NumericTraits<SrcPixelType>::ValueType ScalarType;
+    typedef typename DestImageType::PixelType DestPixelType;
+    typedef typename vigra::NumericTraits<DestPixelType>::RealPromote DestRealType;
+
+    const unsigned bins = entropyBins<ScalarType>();
+
+    timer::WallClock wall_clock;
+    if (bins == 0U)
+    {
+        localEntropyIf(src, mask, destImage(dest), size);
+    }
+    else
+    {
+        localEntropyBinnedIf(src.first, src.second, src.third,
+                             mask.first, mask.second,
+                             dest.upperLeft(), dest.accessor(),
+                             size, bins);
+    }
+    wall_clock.stop();
+
+    if (parameter::time_local_entropy.value())
+    {
+        const std::ios::fmtflags flags(std::cerr.flags());
+
+        std::cerr <<
+            command << ": timing: wall-clock runtime of local entropy (" <<
+            (bins == 0U ? std::string("map") : std::to_string(bins) + " bins") << "): " <<
+            std::setprecision(3) << 1000.0 * wall_clock.value() << " ms\n";
+
+        if (bins != 0U)
+        {
+            DestImageType reference(dest.size());
+            timer::WallClock reference_clock;
+            localEntropyIf(src, mask, destImage(reference), size);
+            reference_clock.stop();
+
+            double maximumDeviation = 0.0;
+            for (int y = 0; y < dest.height(); ++y)
+            {
+                for (int x = 0; x < dest.width(); ++x)
+                {
+                    const DestRealType deviation =
+                        vigra::NumericTraits<DestPixelType>::toRealPromote(dest(x, y)) -
+                        vigra::NumericTraits<DestPixelType>::toRealPromote(reference(x, y));
+                    maximumDeviation = std::max(maximumDeviation, static_cast<double>(vigra::norm(deviation)));
+                }
+            }
+
+            std::cerr <<
+                command << ": timing: wall-clock runtime of local entropy (map): " <<
+                1000.0 * reference_clock.value() << " ms\n" <<
+                command << ": timing: largest deviation of flat histogram from map: " <<
+                maximumDeviation << "\n";
+        }
+
+        std::cerr.flags(flags);
+    }
+}
+
+
+enum LocalStdDevAlgorithm {LOCAL_STDDEV_INTEGRAL, LOCAL_STDDEV_SLIDING_WINDOW};
+
+
+inline LocalStdDevAlgorithm
+selectLocalStdDevAlgorithm()
+{
+    const std::string algorithm(parameter::local_stddev_algorithm.value());
+
+    if (algorithm == "sliding-window")
+    {
+        return LOCAL_STDDEV_SLIDING_WINDOW;
+    }
+    else if (algorithm != "integral")
+    {
+        std::cerr << command
+                  << ": warning: unknown local standard deviation algorithm \"" << algorithm << "\";\n"
+                  << command
+                  << ": warning: will use \"integral\"" << std::endl;
+    }
+
+    return LOCAL_STDDEV_INTEGRAL;
+}
+
+
+inline LocalStdDevAlgorithm
+localStdDevAlgorithm()
 {
-    localStdDevIf(src.first, src.second, src.third,
-                  mask.first, mask.second,
-                  dest.first, dest.second,
-                  size);
+    static const LocalStdDevAlgorithm algorithm = selectLocalStdDevAlgorithm();
+    return algorithm;
+}
+
+
+/** Compute the local standard deviation with summed-area tables or,
+ *  if parameter "local-stddev-algorithm" is "sliding-window", with the
+ *  original column-sums algorithm.
+ *
+ *  With parameter "time-local-stddev" we report the runtime and
+ *  additionally run the other algorithm on the same data to report
+ *  its runtime and the largest deviation of the results.
+ */
+template <typename SrcIterator, typename SrcAccessor,
+          typename MaskIterator, typename MaskAccessor,
+          typename DestImageType>
+void
+selectLocalStdDevIf(SrcIterator src_ul, SrcIterator src_lr, SrcAccessor src_acc,
+                    MaskIterator mask_ul, MaskAccessor mask_acc,
+                    DestImageType& dest,
+                    vigra::Size2D size)
+{
+    const bool useIntegral = localStdDevAlgorithm() == LOCAL_STDDEV_INTEGRAL;
+    const int tileSize =
+        std::max(16, static_cast<int>(parameter::local_stddev_tile_size.value()));
+
+    timer::WallClock wall_clock;
+    if (useIntegral)
+    {
+        localStdDevIntegralIf(src_ul, src_lr, src_acc, mask_ul, mask_acc,
+                              dest.upperLeft(), dest.accessor(), size, tileSize);
+    }
+    else
+    {
+        localStdDevIf(src_ul, src_lr, src_acc, mask_ul, mask_acc,
+                      dest.upperLeft(), dest.accessor(), size);
+    }
+    wall_clock.stop();
+
+    if (parameter::time_local_stddev.value())
+    {
+        const std::ios::fmtflags flags(std::cerr.flags());
+        DestImageType reference(dest.size());
+
+        timer::WallClock reference_clock;
+        if (useIntegral)
+        {
+            localStdDevIf(src_ul, src_lr, src_acc, mask_ul, mask_acc,
+                          reference.upperLeft(), reference.accessor(), size);
+        }
+        else
+        {
+            localStdDevIntegralIf(src_ul, src_lr, src_acc, mask_ul, mask_acc,
+                                  reference.upperLeft(), reference.accessor(), size, tileSize);
+        }
+        reference_clock.stop();
+
+        double maximumDeviation = 0.0;
+        for (int y = 0; y < dest.height(); ++y)
+        {
+            for (int x = 0; x < dest.width(); ++x)
+            {
+                maximumDeviation =
+                    std::max(maximumDeviation,
+                             std::abs(static_cast<double>(dest(x, y)) - static_cast<double>(reference(x, y))));
+            }
+        }
+
+        std::cerr <<
+            command << ": timing: wall-clock runtime of local standard deviation (" <<
+            (useIntegral ? "integral" : "sliding-window") << "): " <<
+            std::setprecision(3) << 1000.0 * wall_clock.value() << " ms\n" <<
+            command << ": timing: wall-clock runtime of local standard deviation (" <<
+            (useIntegral ? "sliding-window" : "integral") << "): " <<
+            1000.0 * reference_clock.value() << " ms\n" <<
+            command << ": timing: largest deviation between the algorithms: " <<
+            maximumDeviation << "\n";
+
+        std::cerr.flags(flags);
+    }
 }
 
 
@@ -620,47 +974,113 @@ protected:
 };
 
 
+// Pixel types whose exposure weights we tabulate rather than
+// compute pixel by pixel.
+template <typename ScalarType>
+struct is_tabulated_exposure :
+    std::integral_constant<bool,
+                           std::is_integral<ScalarType>::value &&
+                           std::is_unsigned<ScalarType>::value &&
+                           sizeof(ScalarType) <= 2U>
+{};
+
+
+// Answer a table of the exposure weights of all values of
+// ScalarType.  An 8-bit or 16-bit image has at most 65536 different
+// luminances, but millions of pixels, each of which would otherwise
+// call the (virtual and possibly user-defined) weight function.  We
+// tabulate once per run and pixel type.
+template <typename ScalarType>
+inline static const double*
+exposureWeightTable(ExposureWeight* weight_function, std::true_type)
+{
+    static const std::vector<double> table([weight_function]() {
+            typedef vigra::NumericTraits<ScalarType> Traits;
+            const size_t n = static_cast<size_t>(Traits::max()) + 1U;
+            std::vector<double> ys(n);
+            std::vector<double> ws(n);
+
+            for (size_t i = 0U; i != n; ++i) {
+                ys[i] = Traits::toRealPromote(static_cast<ScalarType>(i)) / Traits::max();
+            }
+            weight_function->weight_batch(ys.data(), ws.data(), n);
+
+            return ws;
+        }());
+
+    return table.data();
+}
+
+
+template <typename ScalarType>
+inline static const double*
+exposureWeightTable(ExposureWeight*, std::false_type)
+{
+    return nullptr;
+}
+
+
 template <typename InputType, typename InputAccessor, typename ResultType>
 class ExposureFunctor : public std::unary_function<InputType, ResultType> {
+    typedef typename InputAccessor::value_type ScalarType;
+
 public:
     ExposureFunctor(double weight, ExposureWeight* weight_function, const InputAccessor& a) :
-        weight_(weight), weight_function_(weight_function), acc_(a) {}
+        weight_(weight), weight_function_(weight_function), acc_(a),
+        table_(exposureWeightTable<ScalarType>(weight_function, is_tabulated_exposure<ScalarType>())) {}
 
     ResultType operator()(const InputType& a) const {
-        typedef typename vigra::NumericTraits<InputType>::isScalar srcIsScalar;
-        return f(a, srcIsScalar());
+        double y;
+        exposure(a, acc_(a), y);
+        return scaled(weight(y));
     }
 
-protected:
-    // grayscale
-    template <typename T>
-    ResultType f(const T& a, vigra::VigraTrueType) const {
-        const double y = vigra::NumericTraits<T>::toRealPromote(a) / vigra::NumericTraits<T>::max();
-        return vigra::NumericTraits<ResultType>::fromRealPromote(weight_ * weight_function_->weight(y));
+    // Compute the luminance y of a from its gray value, i.e., its
+    // projection with the accessor.  Answer whether a gets an
+    // exposure weight at all.
+    bool exposure(const InputType&, ScalarType gray, double& y) const {
+        y = vigra::NumericTraits<ScalarType>::toRealPromote(gray) / vigra::NumericTraits<ScalarType>::max();
+        return true;
     }
 
-    // RGB
-    template <typename T>
-    ResultType f(const T& a, vigra::VigraFalseType) const {
-        return f(acc_.operator()(a), vigra::VigraTrueType());
+    double weight(double y) const {
+        return table_ ?
+            table_[std::lround(y * vigra::NumericTraits<ScalarType>::max())] :
+            weight_function_->weight(y);
+    }
+
+    ResultType scaled(double w) const {
+        return vigra::NumericTraits<ResultType>::fromRealPromote(weight_ * w);
     }
 
+    ExposureWeight* weight_function() const {return weight_function_;}
+
+protected:
     const double weight_;
     ExposureWeight* weight_function_;
     InputAccessor acc_;
+    const double* table_;
 };
 
 
-template <typename InputType, typename InputAccessor, typename ResultType>
+// Exposure weight that only counts pixels between a lower and an
+// upper cutoff.  The cutoffs apply to the projections of the pixel
+// with lca and uca.  A null cutoff accessor stands for one that
+// projects like a, so the pixel's gray value is reused.
+template <typename InputType, typename InputAccessor, typename ResultType,
+          typename CutoffAccessor = InputAccessor>
 class CutoffExposureFunctor : public std::unary_function<InputType, ResultType> {
+    typedef typename InputAccessor::value_type ScalarType;
+
 public:
     CutoffExposureFunctor(double weight, ExposureWeight* weight_function, InputAccessor a,
                           const AlternativePercentage& lc, const AlternativePercentage& uc,
-                          InputAccessor lca, InputAccessor uca) :
+                          const CutoffAccessor* lca, const CutoffAccessor* uca) :
         weight_(weight), weight_function_(weight_function), acc_(a),
         lower_cutoff_(lc.instantiate<typename InputAccessor::value_type>()),
         upper_cutoff_(uc.instantiate<typename InputAccessor::value_type>()),
-        lower_acc_(lca), upper_acc_(uca)
+        lower_acc_(lca), upper_acc_(uca),
+        table_(exposureWeightTable<ScalarType>(weight_function, is_tabulated_exposure<ScalarType>()))
     {
         typedef typename InputAccessor::value_type value_type;
 
@@ -686,47 +1106,49 @@ public:
     }
 
     ResultType operator()(const InputType& a) const {
-        typedef typename vigra::NumericTraits<InputType>::isScalar srcIsScalar;
-        return f(a, srcIsScalar());
+        double y;
+        return exposure(a, acc_(a), y) ? scaled(weight(y)) : ResultType();
     }
 
-protected:
-    // grayscale
-    template <typename T>
-    ResultType f(const T& a, vigra::VigraTrueType) const {
-        typedef typename vigra::NumericTraits<T>::RealPromote RealType;
-        const RealType ra = vigra::NumericTraits<T>::toRealPromote(a);
-        if (ra >= lower_cutoff_ && ra <= upper_cutoff_) {
-            const double y = ra / vigra::NumericTraits<T>::max();
-            return vigra::NumericTraits<ResultType>::fromRealPromote(weight_ * weight_function_->weight(y));
+    // Compute the luminance y of a from its gray value, i.e., its
+    // projection with the accessor.  Answer whether a gets an
+    // exposure weight at all, i.e., whether it passes the cutoffs.
+    bool exposure(const InputType& a, ScalarType gray, double& y) const {
+        typedef typename vigra::NumericTraits<ScalarType>::RealPromote RealType;
+        const RealType ra = vigra::NumericTraits<ScalarType>::toRealPromote(gray);
+        const RealType lower_ra =
+            lower_acc_ ? vigra::NumericTraits<ScalarType>::toRealPromote((*lower_acc_)(a)) : ra;
+        const RealType upper_ra =
+            upper_acc_ ? vigra::NumericTraits<ScalarType>::toRealPromote((*upper_acc_)(a)) : ra;
+        if (lower_ra >= lower_cutoff_ && upper_ra <= upper_cutoff_) {
+            y = ra / vigra::NumericTraits<ScalarType>::max();
+            return true;
         } else {
-            return ResultType();
+            return false;
         }
     }
 
-    // RGB
-    template <typename T>
-    ResultType f(const T& a, vigra::VigraFalseType) const {
-        typedef typename T::value_type ValueType;
-        typedef typename vigra::NumericTraits<ValueType>::RealPromote RealType;
-        const RealType ra = vigra::NumericTraits<ValueType>::toRealPromote(acc_.operator()(a));
-        const RealType lower_ra = vigra::NumericTraits<ValueType>::toRealPromote(lower_acc_.operator()(a));
-        const RealType upper_ra = vigra::NumericTraits<ValueType>::toRealPromote(upper_acc_.operator()(a));
-        if (lower_ra >= lower_cutoff_ && upper_ra <= upper_cutoff_) {
-            const double y = ra / vigra::NumericTraits<ValueType>::max();
-            return vigra::NumericTraits<ResultType>::fromRealPromote(weight_ * weight_function_->weight(y));
-        } else {
-            return ResultType();
-        }
+    double weight(double y) const {
+        return table_ ?
+            table_[std::lround(y * vigra::NumericTraits<ScalarType>::max())] :
+            weight_function_->weight(y);
+    }
+
+    ResultType scaled(double w) const {
+        return vigra::NumericTraits<ResultType>::fromRealPromote(weight_ * w);
     }
 
+    ExposureWeight* weight_function() const {return weight_function_;}
+
+protected:
     const double weight_;
     ExposureWeight* weight_function_;
     InputAccessor acc_;
     const double lower_cutoff_;
     const double upper_cutoff_;
-    InputAccessor lower_acc_;
-    InputAccessor upper_acc_;
+    const CutoffAccessor* lower_acc_;
+    const CutoffAccessor* upper_acc_;
+    const double* table_;
 };
 
 
@@ -959,6 +1381,156 @@ private:
 };
 
 
+// Compute the weights that depend on nothing but the pixel itself --
+// exposure and saturation -- in one sweep over the source image.
+// The same sweep projects the source to the grayscale plane that the
+// contrast weight works on, so the source is read only once.
+// MultiGrayscaleAccessor::withProjector() instantiates the sweep for
+// the projector selected at run time.
+//
+// Every pixel is projected once.  The projection goes into the
+// grayscale plane and serves as the luminance of the exposure weight,
+// with or without cutoffs.  Cutoff accessors that project like the
+// selected projector are passed as null pointers; other ones still
+// switch on their kind for every pixel.
+//
+// For pixel types whose exposure weights are not tabulated, the
+// sweep collects the luminances of a row and evaluates the weight
+// function for all of them in a single weight_batch() call.
+template <class SrcImageIterator, class SrcAccessor,
+          class MaskImageIterator, class MaskAccessor,
+          class DestImageIterator, class DestAccessor,
+          class GrayImageType, class CutoffAccessor, class SaturationFunctor>
+class LocalWeights
+{
+    typedef typename SrcAccessor::value_type InputType;
+    typedef typename vigra::NumericTraits<InputType>::ValueType ScalarType;
+    typedef typename DestAccessor::value_type ResultType;
+    typedef typename GrayImageType::value_type GrayType;
+
+public:
+    LocalWeights(SrcImageIterator src_upperleft, SrcImageIterator src_lowerright, SrcAccessor sa,
+                 MaskImageIterator mask_upperleft, MaskAccessor ma,
+                 DestImageIterator dest_upperleft, DestAccessor da,
+                 GrayImageType* gray,
+                 double exposureWeight, ExposureWeight* weightFunction,
+                 const AlternativePercentage* lowerCutoff, const AlternativePercentage* upperCutoff,
+                 const CutoffAccessor* lowerCutoffAccessor, const CutoffAccessor* upperCutoffAccessor,
+                 const SaturationFunctor* saturation) :
+        src_upperleft_(src_upperleft), src_lowerright_(src_lowerright), sa_(sa),
+        mask_upperleft_(mask_upperleft), ma_(ma),
+        dest_upperleft_(dest_upperleft), da_(da),
+        gray_(gray),
+        exposureWeight_(exposureWeight), weightFunction_(weightFunction),
+        lowerCutoff_(lowerCutoff), upperCutoff_(upperCutoff),
+        lowerCutoffAccessor_(lowerCutoffAccessor), upperCutoffAccessor_(upperCutoffAccessor),
+        saturation_(saturation) {}
+
+    template <class Projector>
+    void operator()(const Projector& projector) const {
+        typedef ExposureFunctor<InputType, Projector, ResultType> PlainExposureFunctor;
+        typedef CutoffExposureFunctor<InputType, Projector, ResultType, CutoffAccessor> CutoffFunctor;
+
+        if (exposureWeight_ > 0.0 && lowerCutoff_ && upperCutoff_) {
+            const CutoffFunctor ef(exposureWeight_, weightFunction_, projector,
+                                   *lowerCutoff_, *upperCutoff_,
+                                   lowerCutoffAccessor_, upperCutoffAccessor_);
+            sweep(projector, &ef);
+        } else if (exposureWeight_ > 0.0) {
+            const PlainExposureFunctor ef(exposureWeight_, weightFunction_, projector);
+            sweep(projector, &ef);
+        } else {
+            sweep(projector, static_cast<const PlainExposureFunctor*>(nullptr));
+        }
+    }
+
+private:
+    template <class Projector, class Exposure>
+    void sweep(const Projector& projector, const Exposure* exposure) const {
+        typedef typename Projector::value_type ProjectedType;
+
+        const vigra::Size2D size(src_lowerright_ - src_upperleft_);
+        const bool batched = exposure != nullptr && !is_tabulated_exposure<ScalarType>::value;
+
+#ifdef OPENMP
+#pragma omp parallel
+#endif
+        {
+            std::vector<int> column(batched ? size.x : 0);
+            std::vector<double> ys(batched ? size.x : 0);
+            std::vector<double> ws(batched ? size.x : 0);
+
+#ifdef OPENMP
+#pragma omp for schedule(guided) nowait
+#endif
+            for (int y = 0; y < size.y; ++y) {
+                const vigra::Diff2D begin(0, y);
+                typename SrcImageIterator::row_iterator s((src_upperleft_ + begin).rowIterator());
+                typename MaskImageIterator::row_iterator m((mask_upperleft_ + begin).rowIterator());
+                const typename DestImageIterator::row_iterator d((dest_upperleft_ + begin).rowIterator());
+                GrayType* const g = gray_ ? (*gray_)[y] : nullptr;
+                size_t n = 0U;
+
+                for (int x = 0; x < size.x; ++x, ++s, ++m) {
+                    const InputType pixel(sa_(s));
+                    const bool inside = ma_(m);
+                    const ProjectedType projected =
+                        g || (exposure && inside) ? projector(pixel) : ProjectedType();
+
+                    if (g) {
+                        g[x] = static_cast<GrayType>(projected);
+                    }
+
+                    if (inside) {
+                        ResultType w = exposure ? ResultType() : da_(d, x);
+
+                        double luminance;
+                        if (exposure && exposure->exposure(pixel, projected, luminance)) {
+                            if (batched) {
+                                column[n] = x;
+                                ys[n] = luminance;
+                                ++n;
+                            } else {
+                                w = exposure->scaled(exposure->weight(luminance));
+                            }
+                        }
+
+                        if (saturation_) {
+                            w = (*saturation_)(pixel) + w;
+                        }
+
+                        da_.set(w, d, x);
+                    }
+                }
+
+                if (n != 0U) {
+                    exposure->weight_function()->weight_batch(ys.data(), ws.data(), n);
+                    for (size_t i = 0U; i != n; ++i) {
+                        da_.set(da_(d, column[i]) + exposure->scaled(ws[i]), d, column[i]);
+                    }
+                }
+            }
+        } // omp parallel
+    }
+
+    SrcImageIterator src_upperleft_;
+    SrcImageIterator src_lowerright_;
+    SrcAccessor sa_;
+    MaskImageIterator mask_upperleft_;
+    MaskAccessor ma_;
+    DestImageIterator dest_upperleft_;
+    DestAccessor da_;
+    GrayImageType* gray_;
+    const double exposureWeight_;
+    ExposureWeight* weightFunction_;
+    const AlternativePercentage* lowerCutoff_;
+    const AlternativePercentage* upperCutoff_;
+    const CutoffAccessor* lowerCutoffAccessor_;
+    const CutoffAccessor* upperCutoffAccessor_;
+    const SaturationFunctor* saturation_;
+};
+
+
 template <typename ImageType, typename AlphaType, typename MaskType>
 void enfuseMask(vigra::triple<typename ImageType::const_traverser, typename ImageType::const_traverser, typename ImageType::ConstAccessor> src,
                 vigra::pair<typename AlphaType::const_traverser, typename AlphaType::ConstAccessor> mask,
@@ -970,22 +1542,29 @@ void enfuseMask(vigra::triple<typename ImageType::const_traverser, typename Imag
 
     const typename ImageType::difference_type imageSize = src.second - src.first;
 
-    // Exposure
-    if (WExposure > 0.0) {
-        typedef MultiGrayscaleAccessor<ImageValueType, ScalarType> MultiGrayAcc;
-        MultiGrayAcc ga(GrayscaleProjector);
-
-        if (ExposureLowerCutoff.is_effective<ScalarType>() ||
-            ExposureUpperCutoff.is_effective<ScalarType>()) {
-            MultiGrayAcc lca(ExposureLowerCutoffGrayscaleProjector.empty() ?
-                             GrayscaleProjector :
-                             ExposureLowerCutoffGrayscaleProjector);
-            MultiGrayAcc uca(ExposureUpperCutoffGrayscaleProjector.empty() ?
-                             ExposureLowerCutoffGrayscaleProjector :
-                             ExposureUpperCutoffGrayscaleProjector);
-            CutoffExposureFunctor<ImageValueType, MultiGrayAcc, MaskValueType>
-                cef(WExposure, ExposureWeightFunction, ga,
-                    ExposureLowerCutoff, ExposureUpperCutoff, lca, uca);
+    typedef MultiGrayscaleAccessor<ImageValueType, ScalarType> MultiGrayAcc;
+    typedef typename vigra::NumericTraits<ScalarType>::Promote LongScalarType;
+    typedef IMAGETYPE<LongScalarType> GradImage;
+    typedef SaturationFunctor<ImageValueType, MaskValueType> SatFunctor;
+
+    // Exposure, saturation, and the grayscale plane for contrast
+    std::unique_ptr<GradImage> gray;
+    if (WExposure > 0.0 || WSaturation > 0.0 || WContrast > 0.0) {
+        const MultiGrayAcc ga(GrayscaleProjector);
+        std::unique_ptr<MultiGrayAcc> lca;
+        std::unique_ptr<MultiGrayAcc> uca;
+        const bool cutoff =
+            WExposure > 0.0 &&
+            (ExposureLowerCutoff.is_effective<ScalarType>() ||
+             ExposureUpperCutoff.is_effective<ScalarType>());
+
+        if (cutoff) {
+            lca.reset(new MultiGrayAcc(ExposureLowerCutoffGrayscaleProjector.empty() ?
+                                       GrayscaleProjector :
+                                       ExposureLowerCutoffGrayscaleProjector));
+            uca.reset(new MultiGrayAcc(ExposureUpperCutoffGrayscaleProjector.empty() ?
+                                       ExposureLowerCutoffGrayscaleProjector :
+                                       ExposureUpperCutoffGrayscaleProjector));
 #ifdef DEBUG_EXPOSURE
             std::cout << "+ enfuseMask: cutoff - GrayscaleProjector = <" <<
                 GrayscaleProjector << ">\n" <<
@@ -997,25 +1576,39 @@ void enfuseMask(vigra::triple<typename ImageType::const_traverser, typename Imag
                 ", actual cutoff = " << static_cast<double>(ExposureUpperCutoff.instantiate<ScalarType>()) <<
                 "\n";
 #endif
-            vigra::omp::transformImageIf(src, mask, result, cef);
-        } else {
-            ExposureFunctor<ImageValueType, MultiGrayAcc, MaskValueType>
-                ef(WExposure, ExposureWeightFunction, ga);
+        }
 #ifdef DEBUG_EXPOSURE
+        else if (WExposure > 0.0) {
             std::cout << "+ enfuseMask: plain - GrayscaleProjector = <" <<
                 GrayscaleProjector << ">\n";
+        }
 #endif
-            vigra::omp::transformImageIf(src, mask, result, ef);
+
+        if (WContrast > 0.0) {
+            gray.reset(new GradImage(imageSize));
         }
+
+        const SatFunctor sf(WSaturation);
+        LocalWeights<typename ImageType::const_traverser, typename ImageType::ConstAccessor,
+                     typename AlphaType::const_traverser, typename AlphaType::ConstAccessor,
+                     typename MaskType::traverser, typename MaskType::Accessor,
+                     GradImage, MultiGrayAcc, SatFunctor>
+            localWeights(src.first, src.second, src.third,
+                         mask.first, mask.second,
+                         result.first, result.second,
+                         gray.get(),
+                         WExposure, ExposureWeightFunction,
+                         cutoff ? &ExposureLowerCutoff : nullptr,
+                         cutoff ? &ExposureUpperCutoff : nullptr,
+                         lca && !ga.projectsLike(*lca) ? lca.get() : nullptr,
+                         uca && !ga.projectsLike(*uca) ? uca.get() : nullptr,
+                         WSaturation > 0.0 ? &sf : nullptr);
+        ga.withProjector(localWeights);
     }
 
     // Contrast
     if (WContrast > 0.0) {
-        typedef typename vigra::NumericTraits<ScalarType>::Promote LongScalarType;
-        typedef IMAGETYPE<LongScalarType> GradImage;
-
         GradImage grad(imageSize);
-        MultiGrayscaleAccessor<PixelType, LongScalarType> ga(GrayscaleProjector);
 
         if (FilterConfig.edgeScale > 0.0)
         {
@@ -1033,7 +1626,7 @@ void enfuseMask(vigra::triple<typename ImageType::const_traverser, typename Imag
                           << (100.0 * FilterConfig.lceFactor) << "%" << std::endl;
 #endif
                 GradImage lce(imageSize);
-                vigra::gaussianSharpening(src.first, src.second, ga,
+                vigra::gaussianSharpening(gray->upperLeft(), gray->lowerRight(), gray->accessor(),
                                           lce.upperLeft(), lce.accessor(),
                                           FilterConfig.lceFactor, FilterConfig.lceScale);
                 vigra::laplacianOfGaussian(lce.upperLeft(), lce.lowerRight(), lce.accessor(),
@@ -1042,7 +1635,7 @@ void enfuseMask(vigra::triple<typename ImageType::const_traverser, typename Imag
             }
             else
             {
-                vigra::laplacianOfGaussian(src.first, src.second, ga,
+                vigra::laplacianOfGaussian(gray->upperLeft(), gray->lowerRight(), gray->accessor(),
                                            laplacian.upperLeft(), MagnitudeAccessor<LongScalarType>(),
                                            FilterConfig.edgeScale);
             }
@@ -1076,10 +1669,10 @@ void enfuseMask(vigra::triple<typename ImageType::const_traverser, typename Imag
 #endif
                 GradImage localContrast(imageSize);
                 // TODO: use localStdDev
-                localStdDevIf(src.first, src.second, ga,
-                              mask.first, mask.second,
-                              localContrast.upperLeft(), localContrast.accessor(),
-                              vigra::Size2D(ContrastWindowSize, ContrastWindowSize));
+                selectLocalStdDevIf(gray->upperLeft(), gray->lowerRight(), gray->accessor(),
+                                    mask.first, mask.second,
+                                    localContrast,
+                                    vigra::Size2D(ContrastWindowSize, ContrastWindowSize));
 
                 vigra::omp::combineTwoImagesIf(laplacian.upperLeft(), laplacian.lowerRight(), laplacian.accessor(),
                                                localContrast.upperLeft(), localContrast.accessor(),
@@ -1096,10 +1689,10 @@ void enfuseMask(vigra::triple<typename ImageType::const_traverser, typename Imag
 #ifdef DEBUG_LOG
             std::cout << "+ Variance of Local Contrast" << std::endl;
 #endif
-            localStdDevIf(src.first, src.second, ga,
-                          mask.first, mask.second,
-                          grad.upperLeft(), grad.accessor(),
-                          vigra::Size2D(ContrastWindowSize, ContrastWindowSize));
+            selectLocalStdDevIf(gray->upperLeft(), gray->lowerRight(), gray->accessor(),
+                                mask.first, mask.second,
+                                grad,
+                                vigra::Size2D(ContrastWindowSize, ContrastWindowSize));
         }
 
 #ifdef DEBUG_LOG
@@ -1121,20 +1714,6 @@ void enfuseMask(vigra::triple<typename ImageType::const_traverser, typename Imag
 #endif
     }
 
-    // Saturation
-    if (WSaturation > 0.0) {
-        SaturationFunctor<ImageValueType, MaskValueType> sf(WSaturation);
-#if defined(__clang__)
-        vigra::omp::combineTwoImagesIf(src, result, mask, result,
-                                       std::bind(std::plus<MaskValueType>(),
-                                                 std::bind(sf, std::placeholders::_1),
-                                                 std::placeholders::_2));
-#else
-        vigra::omp::combineTwoImagesIf(src, result, mask, result,
-                                       [&sf](ImageValueType x, const MaskValueType& y) {return sf(x) + y;});
-#endif
-    }
-
     // Entropy
     if (WEntropy > 0.0) {
         typedef typename ImageType::PixelType PixelType;
@@ -1185,17 +1764,13 @@ void enfuseMask(vigra::triple<typename ImageType::const_traverser, typename Imag
             vigra::omp::transformImage(src.first, src.second, src.third,
                                        trunc.upperLeft(), trunc.accessor(),
                                        cf);
-            localEntropyIf(trunc.upperLeft(), trunc.lowerRight(), trunc.accessor(),
-                           mask.first, mask.second,
-                           entropy.upperLeft(), entropy.accessor(),
-                           vigra::Size2D(EntropyWindowSize, EntropyWindowSize));
+            selectLocalEntropyIf(srcImageRange(trunc), mask, entropy,
+                                 vigra::Size2D(EntropyWindowSize, EntropyWindowSize));
         }
         else
         {
-            localEntropyIf(src.first, src.second, src.third,
-                           mask.first, mask.second,
-                           entropy.upperLeft(), entropy.accessor(),
-                           vigra::Size2D(EntropyWindowSize, EntropyWindowSize));
+            selectLocalEntropyIf(src, mask, entropy,
+                                 vigra::Size2D(EntropyWindowSize, EntropyWindowSize));
         }
 
         EntropyFunctor<PixelType, MaskValueType> ef(WEntropy);
@@ -1212,7 +1787,418 @@ void enfuseMask(vigra::triple<typename ImageType::const_traverser, typename Imag
 };
 
 
+/** Keep a sequence of equally sized images in an anonymous temporary
+ *  file.  Images go in with push_back() and come back in the same
+ *  order with pop_front().  All push_back()s must precede the first
+ *  pop_front().
+ */
+template <typename ImageType>
+class ImageSpill
+{
+public:
+    ImageSpill() : file_(std::tmpfile()), reading_(false)
+    {
+        if (file_ == nullptr) {
+            std::cerr << command
+                      << ": cannot create temporary file to spill weight masks: "
+                      << std::strerror(errno) << std::endl;
+            exit(1);
+        }
+    }
+
+    ~ImageSpill() {std::fclose(file_);}
+
+    void push_back(const ImageType& image)
+    {
+        assert(!reading_);
+        const size_t size = static_cast<size_t>(image.width()) * static_cast<size_t>(image.height());
+        if (std::fwrite(image.data(), sizeof(typename ImageType::value_type), size, file_) != size) {
+            std::cerr << command
+                      << ": cannot spill weight mask to temporary file: "
+                      << std::strerror(errno) << std::endl;
+            exit(1);
+        }
+    }
+
+    void pop_front(ImageType& image)
+    {
+        if (!reading_) {
+            std::rewind(file_);
+            reading_ = true;
+        }
+        const size_t size = static_cast<size_t>(image.width()) * static_cast<size_t>(image.height());
+        if (std::fread(image.data(), sizeof(typename ImageType::value_type), size, file_) != size) {
+            std::cerr << command
+                      << ": cannot read back weight mask from temporary file"
+                      << std::endl;
+            exit(1);
+        }
+    }
+
+private:
+    ImageSpill(const ImageSpill&) = delete;
+    ImageSpill& operator=(const ImageSpill&) = delete;
+
+    std::FILE* file_;
+    bool reading_;
+};
+
+
+/** Assemble the images in imageInfoList one after the other and pass
+ *  each of them to process(), which takes ownership.
+ *
+ *  With OpenMP we assemble -- that is, read and decode -- the next
+ *  image while process() works on the current one.  Both the
+ *  assembly and the processing must see the images in order, so a
+ *  single image of look-ahead is all we can use; it also bounds the
+ *  number of images in flight to two.  Nested parallelism keeps the
+ *  image-processing functions inside process() parallel.  Parameter
+ *  "assemble-ahead" turns the overlap off; so do "--load-masks" and
+ *  "--save-masks".
+ */
+template <typename ImageType, typename AlphaType, typename Processor>
+void
+assembleAndProcess(std::list<vigra::ImageImportInfo*>& imageInfoList,
+                   vigra::Rect2D& anInputUnion,
+                   Processor process)
+{
+    AlphaFootprintIndex footprints;
+    vigra::Rect2D imageBB;
+    std::pair<ImageType*, AlphaType*> imagePair =
+        assemble<ImageType, AlphaType>(imageInfoList, anInputUnion, imageBB, footprints);
+
+#ifdef OPENMP
+    // Loading or saving masks makes process() import and export
+    // images, too.  The vigra codecs are not reentrant, so we must not
+    // run them concurrently with assemble().
+    const bool assemble_ahead =
+        parameter::assemble_ahead.value() && omp_get_max_threads() >= 2 &&
+        !(LoadMasks || SaveMasks);
+#endif
+
+    while (imagePair.first != nullptr) {
+        std::pair<ImageType*, AlphaType*> nextImagePair;
+
+#ifdef OPENMP
+        if (assemble_ahead) {
+            omp::scoped_nested nested(true);
+            omp::scoped_dynamic dynamic(true);
+#pragma omp parallel sections num_threads(2)
+            {
+#pragma omp section
+                nextImagePair = assemble<ImageType, AlphaType>(imageInfoList, anInputUnion, imageBB, footprints);
+#pragma omp section
+                process(imagePair);
+            } // omp parallel sections
+        } else
+#endif
+        {
+            process(imagePair);
+            nextImagePair = assemble<ImageType, AlphaType>(imageInfoList, anInputUnion, imageBB, footprints);
+        }
+
+        imagePair = nextImagePair;
+    }
+}
+
+
+/** Load the weight mask of the assembled image number m from a file
+ *  or compute it from imagePair.
+ */
+template <typename ImageType, typename AlphaType, typename MaskType>
+void
+loadOrComputeMask(const std::pair<ImageType*, AlphaType*>& imagePair, MaskType* mask,
+                  unsigned numberOfImages, const std::string& inputFileName, unsigned m,
+                  const vigra::Rect2D& anInputUnion)
+{
+    if (LoadMasks) {
+        // IMPLEMENTATION NOTE: For simplicity of the code, here
+        // we also load in hard masks.  Computing the set of hard
+        // masks from a set of soft masks is done by maximum
+        // selection, which is an idempotent function.
+        const std::string maskFilename =
+            enblend::expandFilenameTemplate(UseHardMask ? HardMaskTemplate : SoftMaskTemplate,
+                                            numberOfImages,
+                                            inputFileName,
+                                            OutputFileName,
+                                            m);
+        if (can_open_file(maskFilename)) {
+            vigra::ImageImportInfo maskInfo(maskFilename.c_str());
+            if (Verbose >= VERBOSE_MASK_MESSAGES) {
+                std::cerr << command
+                          << ": info: loading " << (UseHardMask ? "hard" : "soft")
+                          << "mask \"" << maskFilename << "\"" << std::endl;
+            }
+            if (!maskInfo.isGrayscale()) {
+                std::cerr << command
+                          << ": mask image \"" << maskFilename << "\" is not grayscale" << std::endl;
+                exit(1);
+            }
+            if (maskInfo.numExtraBands() != 0) {
+                std::cerr << command
+                          << ": mask image \"" << maskFilename << "\" must not have an alpha channel" << std::endl;
+                exit(1);
+            }
+            if (maskInfo.width() != anInputUnion.width() || maskInfo.height() != anInputUnion.height()) {
+                std::cerr << command
+                          << ": warning: mask in \"" << maskFilename << "\" has size "
+                          << "(" << maskInfo.width() << "x" << maskInfo.height() << "),\n"
+                          << command
+                          << ": warning: but image union has size " << anInputUnion.size() << ";\n"
+                          << command
+                          << ": note: make sure this is the right mask for the given images"
+                          << std::endl;
+            }
+            importImage(maskInfo, destImage(*mask));
+        } else {
+            // Cannot read mask file.  We already issued an error
+            // message through can_open_file().
+            exit(1);
+        }
+    } else {
+        enfuseMask<ImageType, AlphaType, MaskType>(srcImageRange(*(imagePair.first)),
+                                                   srcImage(*(imagePair.second)),
+                                                   destImage(*mask));
+    }
+}
+
+
+/** Save the soft or hard weight mask of the assembled image number m.
+ */
+template <typename MaskType>
+void
+saveMask(const MaskType& mask, bool isHardMask,
+         unsigned numberOfImages, const std::string& inputFileName, unsigned m)
+{
+    const std::string mask_pixel_type =
+        to_upper_copy(parameter::mask_save_pixel_type.value());
+    const std::string maskFilename =
+        enblend::expandFilenameTemplate(isHardMask ? HardMaskTemplate : SoftMaskTemplate,
+                                        numberOfImages,
+                                        inputFileName,
+                                        OutputFileName,
+                                        m);
+
+    if (maskFilename == inputFileName) {
+        std::cerr << command
+                  << ": will not overwrite input image \""
+                  << inputFileName
+                  << (isHardMask ? "\" with hard mask" : "\" with soft mask file")
+                  << std::endl;
+        exit(1);
+    } else if (maskFilename == OutputFileName) {
+        std::cerr << command
+                  << ": will not overwrite output image \""
+                  << OutputFileName
+                  << (isHardMask ? "\" with hard mask" : "\" with soft mask file")
+                  << std::endl;
+        exit(1);
+    } else {
+        if (Verbose >= VERBOSE_MASK_MESSAGES) {
+            std::cerr << command
+                      << ": info: saving " << (isHardMask ? "hard" : "soft")
+                      << " mask \"" << maskFilename << "\"" << std::endl;
+        }
+        vigra::ImageExportInfo maskInfo(maskFilename.c_str());
+        maskInfo.setXResolution(ImageResolution.x);
+        maskInfo.setYResolution(ImageResolution.y);
+        maskInfo.setCompression(MASK_COMPRESSION);
+        maskInfo.setPixelType(mask_pixel_type.c_str());
+        exportImage(srcImageRange(mask), maskInfo);
+    }
+}
+
+
+/** Fold a weight mask into the running maximum of all weights and the
+ *  index of the image that attains it.  This is the incremental form
+ *  of the hard-mask selection in enfuseMain(): strict comparison
+ *  makes the first of several equal weights win.
+ */
+template <typename MaskType, typename IndexImageType>
+void
+foldHardMask(const MaskType& mask, unsigned m, MaskType& maxWeight, IndexImageType& winner)
+{
+    const vigra::Size2D sz = mask.size();
+
+#ifdef OPENMP
+#pragma omp parallel for
+#endif
+    for (int y = 0; y < sz.y; ++y) {
+        for (int x = 0; x < sz.x; ++x) {
+            const float w = static_cast<float>(mask(x, y));
+            if (w > static_cast<float>(maxWeight(x, y))) {
+                maxWeight(x, y) = w;
+                winner(x, y) = m;
+            }
+        }
+    }
+}
+
+
+/** Functor that reconstructs the hard mask of image number m from
+ *  the per-pixel index of the winning image.
+ */
+template <typename IndexType, typename MaskPixelType>
+class HardMaskFromWinnerFunctor
+{
+public:
+    HardMaskFromWinnerFunctor(IndexType index, IndexType noWinner,
+                              MaskPixelType maxValue, MaskPixelType evenShare) :
+        index_(index), noWinner_(noWinner), maxValue_(maxValue), evenShare_(evenShare) {}
+
+    MaskPixelType operator()(IndexType winner) const
+    {
+        if (winner == noWinner_) {
+            return evenShare_;
+        } else if (winner == index_) {
+            return maxValue_;
+        } else {
+            return MaskPixelType();
+        }
+    }
+
+private:
+    const IndexType index_;
+    const IndexType noWinner_;
+    const MaskPixelType maxValue_;
+    const MaskPixelType evenShare_;
+};
+
+
+/** Build the Laplacian pyramid of one assembled image, weight it with
+ *  the Gaussian pyramid of its mask, and add the result to resultLP.
+ *  Takes ownership of image, alpha, and mask.
+ */
+template <typename ImagePixelType>
+void
+accumulateWeightedPyramid(unsigned m, unsigned numLevels,
+                          typename EnblendNumericTraits<ImagePixelType>::ImageType* image,
+                          typename EnblendNumericTraits<ImagePixelType>::AlphaType* alpha,
+                          IMAGETYPE<float>* mask,
+                          const IMAGETYPE<float>& normImage,
+                          const typename EnblendNumericTraits<ImagePixelType>::AlphaType& unionAlpha,
+                          int totalImages,
+                          std::vector<typename EnblendNumericTraits<ImagePixelType>::ImagePyramidType*>*& resultLP)
+{
+    typedef typename EnblendNumericTraits<ImagePixelType>::ImageType ImageType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::AlphaType AlphaType;
+    typedef IMAGETYPE<float> MaskType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::ImagePyramidType ImagePyramidType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::MaskPyramidPixelType MaskPyramidPixelType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::MaskPyramidType MaskPyramidType;
+
+    enum {ImagePyramidIntegerBits = EnblendNumericTraits<ImagePixelType>::ImagePyramidIntegerBits};
+    enum {ImagePyramidFractionBits = EnblendNumericTraits<ImagePixelType>::ImagePyramidFractionBits};
+    enum {MaskPyramidIntegerBits = EnblendNumericTraits<ImagePixelType>::MaskPyramidIntegerBits};
+    enum {MaskPyramidFractionBits = EnblendNumericTraits<ImagePixelType>::MaskPyramidFractionBits};
+    typedef typename EnblendNumericTraits<ImagePixelType>::SKIPSMImagePixelType SKIPSMImagePixelType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::SKIPSMAlphaPixelType SKIPSMAlphaPixelType;
+    typedef typename EnblendNumericTraits<ImagePixelType>::SKIPSMMaskPixelType SKIPSMMaskPixelType;
+
+    typename EnblendNumericTraits<ImagePixelType>::MaskPixelType maxMaskPixelType =
+        vigra::NumericTraits<typename EnblendNumericTraits<ImagePixelType>::MaskPixelType>::max();
+
+    std::ostringstream oss0;
+    oss0 << "imageGP" << m << "_";
+
+    // imageLP is constructed using the image's own alpha channel
+    // as the boundary for extrapolation.
+    std::vector<ImagePyramidType*> *imageLP =
+        laplacianPyramid<ImageType, AlphaType, ImagePyramidType,
+                         ImagePyramidIntegerBits, ImagePyramidFractionBits,
+                         SKIPSMImagePixelType, SKIPSMAlphaPixelType>(
+                                                                     oss0.str().c_str(),
+                                                                     numLevels, WrapAround != OpenBoundaries,
+                                                                     srcImageRange(*image),
+                                                                     maskImage(*alpha));
+
+    delete image;
+    delete alpha;
+
+    //std::ostringstream oss1;
+    //oss1 << "imageLP" << m << "_";
+    //exportPyramid<ImagePyramidType>(imageLP, oss1.str().c_str());
+
+    if (!UseHardMask) {
+        // Normalize the mask coefficients.
+        // Scale to the range expected by the MaskPyramidPixelType.
+        vigra::omp::combineTwoImages(srcImageRange(*mask),
+                                     srcImage(normImage),
+                                     destImage(*mask),
+                                     ifThenElse(Arg2() > Param(0.0),
+                                                Param(maxMaskPixelType) * Arg1() / Arg2(),
+                                                Param(maxMaskPixelType / totalImages)));
+    }
+
+    // maskGP is constructed using the union of the input alpha channels
+    // as the boundary for extrapolation.
+    std::vector<MaskPyramidType*> *maskGP =
+        gaussianPyramid<MaskType, AlphaType, MaskPyramidType,
+        MaskPyramidIntegerBits, MaskPyramidFractionBits,
+        SKIPSMMaskPixelType, SKIPSMAlphaPixelType>
+        (numLevels,
+         WrapAround != OpenBoundaries,
+         srcImageRange(*mask),
+         maskImage(unionAlpha));
+
+    delete mask;
+
+    //std::ostringstream oss2;
+    //oss2 << "maskGP" << m << "_";
+    //exportPyramid<MaskPyramidType>(maskGP, oss2.str().c_str());
+
+    ConvertScalarToPyramidFunctor<typename EnblendNumericTraits<ImagePixelType>::MaskPixelType,
+        MaskPyramidPixelType,
+        MaskPyramidIntegerBits,
+        MaskPyramidFractionBits> maskConvertFunctor;
+    MaskPyramidPixelType maxMaskPyramidPixelValue = maskConvertFunctor(maxMaskPixelType);
+
+    for (unsigned int i = 0; i < maskGP->size(); ++i) {
+        // Multiply image lp with the mask gp.
+        vigra::omp::combineTwoImages(srcImageRange(*((*imageLP)[i])),
+                                     srcImage(*((*maskGP)[i])),
+                                     destImage(*((*imageLP)[i])),
+                                     ImageMaskMultiplyFunctor<MaskPyramidPixelType>(maxMaskPyramidPixelValue));
+
+        // Done with maskGP.
+        delete (*maskGP)[i];
+    }
+    delete maskGP;
+
+    //std::ostringstream oss3;
+    //oss3 << "multLP" << m << "_";
+    //exportPyramid<ImagePyramidType>(imageLP, oss3.str().c_str());
+
+    if (resultLP != nullptr) {
+        // Add imageLP to resultLP.
+        for (unsigned int i = 0; i < imageLP->size(); ++i) {
+            vigra::omp::combineTwoImages(srcImageRange(*((*imageLP)[i])),
+                                         srcImage(*((*resultLP)[i])),
+                                         destImage(*((*resultLP)[i])),
+                                         Arg1() + Arg2());
+            delete (*imageLP)[i];
+        }
+        delete imageLP;
+    } else {
+        resultLP = imageLP;
+    }
+
+    //std::ostringstream oss4;
+    //oss4 << "resultLP" << m << "_";
+    //exportPyramid<ImagePyramidType>(resultLP, oss4.str().c_str());
+}
+
+
 /** Enfuse's main blending loop. Templatized to handle different image types.
+ *
+ *  By default all assembled input images and their weight masks stay
+ *  in memory until the pyramids are built.  With the parameter
+ *  "streaming-fusion" we work in two passes instead.  The first pass
+ *  computes each weight mask, folds it into the normalization (or
+ *  into the hard-mask selection), and spills it to a temporary file.
+ *  The second pass re-assembles the images one by one and adds their
+ *  weighted Laplacian pyramids to the result right away.  Then the
+ *  memory footprint no longer grows with the number of input images.
  */
 template <typename ImagePixelType>
 void enfuseMain(const FileNameList& anInputFileNameList,
@@ -1226,25 +2212,38 @@ void enfuseMain(const FileNameList& anInputFileNameList,
     typedef IMAGETYPE<float> MaskType;
     typedef typename MaskType::value_type MaskPixelType;
     typedef typename EnblendNumericTraits<ImagePixelType>::ImagePyramidType ImagePyramidType;
-    typedef typename EnblendNumericTraits<ImagePixelType>::MaskPyramidPixelType MaskPyramidPixelType;
-    typedef typename EnblendNumericTraits<ImagePixelType>::MaskPyramidType MaskPyramidType;
 
     enum {ImagePyramidIntegerBits = EnblendNumericTraits<ImagePixelType>::ImagePyramidIntegerBits};
     enum {ImagePyramidFractionBits = EnblendNumericTraits<ImagePixelType>::ImagePyramidFractionBits};
-    enum {MaskPyramidIntegerBits = EnblendNumericTraits<ImagePixelType>::MaskPyramidIntegerBits};
-    enum {MaskPyramidFractionBits = EnblendNumericTraits<ImagePixelType>::MaskPyramidFractionBits};
     typedef typename EnblendNumericTraits<ImagePixelType>::SKIPSMImagePixelType SKIPSMImagePixelType;
-    typedef typename EnblendNumericTraits<ImagePixelType>::SKIPSMAlphaPixelType SKIPSMAlphaPixelType;
-    typedef typename EnblendNumericTraits<ImagePixelType>::SKIPSMMaskPixelType SKIPSMMaskPixelType;
+
+    // Index of the image that wins the hard-mask selection at each pixel
+    typedef IMAGETYPE<vigra::UInt32> WinnerImageType;
+    const vigra::UInt32 noWinner = vigra::NumericTraits<vigra::UInt32>::max();
 
     // List of input image / input alpha / mask triples
     typedef std::list< vigra::triple<ImageType*, AlphaType*, MaskType*> > imageListType;
     typedef typename imageListType::iterator imageListIteratorType;
     imageListType imageList;
 
-    // Sum of all masks
+    const bool streaming = parameter::streaming_fusion.value();
+
+    // Sum of all masks; in streaming mode with hard masks the maximum
+    // of all masks.
     MaskType *normImage = new MaskType(anInputUnion.size());
 
+    // Streaming mode only: spilled soft masks or the winners of the
+    // hard-mask selection.
+    std::unique_ptr<ImageSpill<MaskType> > maskSpill;
+    std::unique_ptr<WinnerImageType> winnerImage;
+    if (streaming) {
+        if (UseHardMask) {
+            winnerImage.reset(new WinnerImageType(anInputUnion.size(), noWinner));
+        } else {
+            maskSpill.reset(new ImageSpill<MaskType>);
+        }
+    }
+
     // Result image. Alpha will be union of all input alphas.
     std::pair<ImageType*, AlphaType*> outputPair(static_cast<ImageType*>(nullptr),
                                                  new AlphaType(anInputUnion.size()));
@@ -1278,99 +2277,16 @@ void enfuseMain(const FileNameList& anInputFileNameList,
     }
 #endif
 
-    while (!imageInfoList.empty()) {
-        vigra::Rect2D imageBB;
-        std::pair<ImageType*, AlphaType*> imagePair =
-            assemble<ImageType, AlphaType>(imageInfoList, anInputUnion, imageBB);
-
+    assembleAndProcess<ImageType, AlphaType>(imageInfoList, anInputUnion,
+                                             [&](std::pair<ImageType*, AlphaType*> imagePair) {
         MaskType* mask = new MaskType(anInputUnion.size());
 
-        if (LoadMasks) {
-            // IMPLEMENTATION NOTE: For simplicity of the code, here
-            // we also load in hard masks.  Computing the set of hard
-            // masks from a set of soft masks is done by maximum
-            // selection, which is an idempotent function.
-            const std::string maskFilename =
-                enblend::expandFilenameTemplate(UseHardMask ? HardMaskTemplate : SoftMaskTemplate,
-                                                numberOfImages,
-                                                *inputFileNameIterator,
-                                                OutputFileName,
-                                                m);
-            if (can_open_file(maskFilename)) {
-                vigra::ImageImportInfo maskInfo(maskFilename.c_str());
-                if (Verbose >= VERBOSE_MASK_MESSAGES) {
-                    std::cerr << command
-                              << ": info: loading " << (UseHardMask ? "hard" : "soft")
-                              << "mask \"" << maskFilename << "\"" << std::endl;
-                }
-                if (!maskInfo.isGrayscale()) {
-                    std::cerr << command
-                              << ": mask image \"" << maskFilename << "\" is not grayscale" << std::endl;
-                    exit(1);
-                }
-                if (maskInfo.numExtraBands() != 0) {
-                    std::cerr << command
-                              << ": mask image \"" << maskFilename << "\" must not have an alpha channel" << std::endl;
-                    exit(1);
-                }
-                if (maskInfo.width() != anInputUnion.width() || maskInfo.height() != anInputUnion.height()) {
-                    std::cerr << command
-                              << ": warning: mask in \"" << maskFilename << "\" has size "
-                              << "(" << maskInfo.width() << "x" << maskInfo.height() << "),\n"
-                              << command
-                              << ": warning: but image union has size " << anInputUnion.size() << ";\n"
-                              << command
-                              << ": note: make sure this is the right mask for the given images"
-                              << std::endl;
-                }
-                importImage(maskInfo, destImage(*mask));
-            } else {
-                // Cannot read mask file.  We already issued an error
-                // message through can_open_file().
-                exit(1);
-            }
-        } else {
-            enfuseMask<ImageType, AlphaType, MaskType>(srcImageRange(*(imagePair.first)),
-                                                       srcImage(*(imagePair.second)),
-                                                       destImage(*mask));
-        }
+        loadOrComputeMask<ImageType, AlphaType, MaskType>(imagePair, mask,
+                                                          numberOfImages, *inputFileNameIterator, m,
+                                                          anInputUnion);
 
         if (SaveMasks) {
-            const std::string mask_pixel_type =
-                to_upper_copy(parameter::as_string("mask-save-pixel-type", "float"));
-            const std::string maskFilename =
-                enblend::expandFilenameTemplate(SoftMaskTemplate,
-                                                numberOfImages,
-                                                *inputFileNameIterator,
-                                                OutputFileName,
-                                                m);
-
-            if (maskFilename == *inputFileNameIterator) {
-                std::cerr << command
-                          << ": will not overwrite input image \""
-                          << *inputFileNameIterator
-                          << "\" with soft mask file"
-                          << std::endl;
-                exit(1);
-            } else if (maskFilename == OutputFileName) {
-                std::cerr << command
-                          << ": will not overwrite output image \""
-                          << OutputFileName
-                          << "\" with soft mask file"
-                          << std::endl;
-                exit(1);
-            } else {
-                if (Verbose >= VERBOSE_MASK_MESSAGES) {
-                    std::cerr << command
-                              << ": info: saving soft mask \"" << maskFilename << "\"" << std::endl;
-                }
-                vigra::ImageExportInfo maskInfo(maskFilename.c_str());
-                maskInfo.setXResolution(ImageResolution.x);
-                maskInfo.setYResolution(ImageResolution.y);
-                maskInfo.setCompression(MASK_COMPRESSION);
-                maskInfo.setPixelType(mask_pixel_type.c_str());
-                exportImage(srcImageRange(*mask), maskInfo);
-            }
+            saveMask(*mask, false, numberOfImages, *inputFileNameIterator, m);
         }
 
         // Make output alpha the union of all input alphas.
@@ -1378,28 +2294,65 @@ void enfuseMain(const FileNameList& anInputFileNameList,
                                 maskImage(*(imagePair.second)),
                                 destImage(*(outputPair.second)));
 
-        // Add the mask to the norm image.
-        vigra::omp::combineTwoImages(srcImageRange(*mask),
-                                     srcImage(*normImage),
-                                     destImage(*normImage),
-                                     Arg1() + Arg2());
+        if (streaming) {
+            if (UseHardMask) {
+                foldHardMask(*mask, m, *normImage, *winnerImage);
+            } else {
+                vigra::omp::combineTwoImages(srcImageRange(*mask),
+                                             srcImage(*normImage),
+                                             destImage(*normImage),
+                                             Arg1() + Arg2());
+                maskSpill->push_back(*mask);
+            }
+
+            // We shall re-assemble the image in the second pass.
+            delete imagePair.first;
+            delete imagePair.second;
+            delete mask;
+        } else {
+            // Add the mask to the norm image.
+            vigra::omp::combineTwoImages(srcImageRange(*mask),
+                                         srcImage(*normImage),
+                                         destImage(*normImage),
+                                         Arg1() + Arg2());
 
-        imageList.push_back(vigra::make_triple(imagePair.first, imagePair.second, mask));
+            imageList.push_back(vigra::make_triple(imagePair.first, imagePair.second, mask));
+        }
 
         ++m;
         ++inputFileNameIterator;
-    }
+    });
 
     if (StopAfterMaskGeneration && !UseHardMask) {
         exit(0);
     }
 
-    const int totalImages = imageList.size();
+    const int totalImages = streaming ? static_cast<int>(m) : static_cast<int>(imageList.size());
 
     typename EnblendNumericTraits<ImagePixelType>::MaskPixelType maxMaskPixelType =
         vigra::NumericTraits<typename EnblendNumericTraits<ImagePixelType>::MaskPixelType>::max();
 
-    if (UseHardMask) {
+    if (UseHardMask && streaming) {
+        // We already know the winners; we only have to write out the
+        // hard masks if the user wants them.
+        if (SaveMasks) {
+            if (Verbose >= VERBOSE_MASK_MESSAGES) {
+                std::cerr << command
+                          << ": info: creating hard blend mask" << std::endl;
+            }
+            MaskType mask(anInputUnion.size());
+            inputFileNameIterator = anInputFileNameList.begin();
+            for (int i = 0; i < totalImages; ++i, ++inputFileNameIterator) {
+                vigra::omp::transformImage(srcImageRange(*winnerImage),
+                                           destImage(mask),
+                                           HardMaskFromWinnerFunctor<vigra::UInt32, MaskPixelType>
+                                           (i, noWinner,
+                                            maxMaskPixelType,
+                                            static_cast<MaskPixelType>(maxMaskPixelType) / totalImages));
+                saveMask(mask, true, totalImages, *inputFileNameIterator, i);
+            }
+        }
+    } else if (UseHardMask) {
         if (Verbose >= VERBOSE_MASK_MESSAGES) {
             std::cerr << command
                       << ": info: creating hard blend mask" << std::endl;
@@ -1442,44 +2395,10 @@ void enfuseMain(const FileNameList& anInputFileNameList,
         }
         unsigned i = 0;
         if (SaveMasks) {
-            const std::string mask_pixel_type =
-                to_upper_copy(parameter::as_string("mask-save-pixel-type", "float"));
-
             for (imageIter = imageList.begin(), inputFileNameIterator = anInputFileNameList.begin();
                  imageIter != imageList.end();
                  ++imageIter, ++inputFileNameIterator) {
-                const std::string maskFilename =
-                    enblend::expandFilenameTemplate(HardMaskTemplate,
-                                                    imageList.size(),
-                                                    *inputFileNameIterator,
-                                                    OutputFileName,
-                                                    i);
-                if (maskFilename == *inputFileNameIterator) {
-                    std::cerr << command
-                              << ": will not overwrite input image \""
-                              << *inputFileNameIterator
-                              << "\" with hard mask"
-                              << std::endl;
-                    exit(1);
-                } else if (maskFilename == OutputFileName) {
-                    std::cerr << command
-                              << ": will not overwrite output image \""
-                              << OutputFileName
-                              << "\" with hard mask"
-                              << std::endl;
-                    exit(1);
-                } else {
-                    if (Verbose >= VERBOSE_MASK_MESSAGES) {
-                        std::cerr << command
-                                  << ": info: saving hard mask \"" << maskFilename << "\"" << std::endl;
-                    }
-                    vigra::ImageExportInfo maskInfo(maskFilename.c_str());
-                    maskInfo.setXResolution(ImageResolution.x);
-                    maskInfo.setYResolution(ImageResolution.y);
-                    maskInfo.setCompression(MASK_COMPRESSION);
-                    maskInfo.setPixelType(mask_pixel_type.c_str());
-                    exportImage(srcImageRange(*(imageIter->third)), maskInfo);
-                }
+                saveMask(*(imageIter->third), true, imageList.size(), *inputFileNameIterator, i);
                 i++;
             }
         }
@@ -1497,101 +2416,46 @@ void enfuseMain(const FileNameList& anInputFileNameList,
 
     std::vector<ImagePyramidType*> *resultLP = nullptr;
 
-    m = 0;
-    while (!imageList.empty()) {
-        vigra::triple<ImageType*, AlphaType*, MaskType*> imageTriple = imageList.front();
-        imageList.erase(imageList.begin());
-
-        std::ostringstream oss0;
-        oss0 << "imageGP" << m << "_";
-
-        // imageLP is constructed using the image's own alpha channel
-        // as the boundary for extrapolation.
-        std::vector<ImagePyramidType*> *imageLP =
-            laplacianPyramid<ImageType, AlphaType, ImagePyramidType,
-                             ImagePyramidIntegerBits, ImagePyramidFractionBits,
-                             SKIPSMImagePixelType, SKIPSMAlphaPixelType>(
-                                                                         oss0.str().c_str(),
-                                                                         numLevels, WrapAround != OpenBoundaries,
-                                                                         srcImageRange(*(imageTriple.first)),
-                                                                         maskImage(*(imageTriple.second)));
-
-        delete imageTriple.first;
-        delete imageTriple.second;
-
-        //std::ostringstream oss1;
-        //oss1 << "imageLP" << m << "_";
-        //exportPyramid<ImagePyramidType>(imageLP, oss1.str().c_str());
-
-        if (!UseHardMask) {
-            // Normalize the mask coefficients.
-            // Scale to the range expected by the MaskPyramidPixelType.
-            vigra::omp::combineTwoImages(srcImageRange(*(imageTriple.third)),
-                                         srcImage(*normImage),
-                                         destImage(*(imageTriple.third)),
-                                         ifThenElse(Arg2() > Param(0.0),
-                                                    Param(maxMaskPixelType) * Arg1() / Arg2(),
-                                                    Param(maxMaskPixelType / totalImages)));
-        }
-
-        // maskGP is constructed using the union of the input alpha channels
-        // as the boundary for extrapolation.
-        std::vector<MaskPyramidType*> *maskGP =
-            gaussianPyramid<MaskType, AlphaType, MaskPyramidType,
-            MaskPyramidIntegerBits, MaskPyramidFractionBits,
-            SKIPSMMaskPixelType, SKIPSMAlphaPixelType>
-            (numLevels,
-             WrapAround != OpenBoundaries,
-             srcImageRange(*(imageTriple.third)),
-             maskImage(*(outputPair.second)));
-
-        delete imageTriple.third;
-
-        //std::ostringstream oss2;
-        //oss2 << "maskGP" << m << "_";
-        //exportPyramid<MaskPyramidType>(maskGP, oss2.str().c_str());
-
-        ConvertScalarToPyramidFunctor<typename EnblendNumericTraits<ImagePixelType>::MaskPixelType,
-            MaskPyramidPixelType,
-            MaskPyramidIntegerBits,
-            MaskPyramidFractionBits> maskConvertFunctor;
-        MaskPyramidPixelType maxMaskPyramidPixelValue = maskConvertFunctor(maxMaskPixelType);
-
-        for (unsigned int i = 0; i < maskGP->size(); ++i) {
-            // Multiply image lp with the mask gp.
-            vigra::omp::combineTwoImages(srcImageRange(*((*imageLP)[i])),
-                                         srcImage(*((*maskGP)[i])),
-                                         destImage(*((*imageLP)[i])),
-                                         ImageMaskMultiplyFunctor<MaskPyramidPixelType>(maxMaskPyramidPixelValue));
-
-            // Done with maskGP.
-            delete (*maskGP)[i];
-        }
-        delete maskGP;
-
-        //std::ostringstream oss3;
-        //oss3 << "multLP" << m << "_";
-        //exportPyramid<ImagePyramidType>(imageLP, oss3.str().c_str());
-
-        if (resultLP != nullptr) {
-            // Add imageLP to resultLP.
-            for (unsigned int i = 0; i < imageLP->size(); ++i) {
-                vigra::omp::combineTwoImages(srcImageRange(*((*imageLP)[i])),
-                                             srcImage(*((*resultLP)[i])),
-                                             destImage(*((*resultLP)[i])),
-                                             Arg1() + Arg2());
-                delete (*imageLP)[i];
+    if (streaming) {
+        // Second pass: re-assemble the images in the same order as
+        // before and fuse each one as soon as we have got it.
+        imageInfoList = anImageInfoList;
+
+        m = 0;
+        assembleAndProcess<ImageType, AlphaType>(imageInfoList, anInputUnion,
+                                                 [&](std::pair<ImageType*, AlphaType*> imagePair) {
+            MaskType* mask = new MaskType(anInputUnion.size());
+            if (UseHardMask) {
+                vigra::omp::transformImage(srcImageRange(*winnerImage),
+                                           destImage(*mask),
+                                           HardMaskFromWinnerFunctor<vigra::UInt32, MaskPixelType>
+                                           (m, noWinner,
+                                            maxMaskPixelType,
+                                            static_cast<MaskPixelType>(maxMaskPixelType) / totalImages));
+            } else {
+                maskSpill->pop_front(*mask);
             }
-            delete imageLP;
-        } else {
-            resultLP = imageLP;
-        }
-
-        //std::ostringstream oss4;
-        //oss4 << "resultLP" << m << "_";
-        //exportPyramid<ImagePyramidType>(resultLP, oss4.str().c_str());
 
-        ++m;
+            accumulateWeightedPyramid<ImagePixelType>(m, numLevels,
+                                                      imagePair.first, imagePair.second, mask,
+                                                      *normImage, *(outputPair.second),
+                                                      totalImages, resultLP);
+
+            ++m;
+        });
+    } else {
+        m = 0;
+        while (!imageList.empty()) {
+            vigra::triple<ImageType*, AlphaType*, MaskType*> imageTriple = imageList.front();
+            imageList.erase(imageList.begin());
+
+            accumulateWeightedPyramid<ImagePixelType>(m, numLevels,
+                                                      imageTriple.first, imageTriple.second, imageTriple.third,
+                                                      *normImage, *(outputPair.second),
+                                                      totalImages, resultLP);
+
+            ++m;
+        }
     }
 
     delete normImage;
@@ -1620,9 +2484,9 @@ void enfuseMain(const FileNameList& anInputFileNameList,
     delete outputPair.second;
 
 #ifdef HAVE_EXIV2
-    if (OutputIsValid && parameter::as_boolean("metadata-pass-through", true)) {
+    if (OutputIsValid && parameter::metadata_pass_through.value()) {
         const size_t metadata_source_image_index =
-            std::min(static_cast<size_t>(parameter::as_unsigned("metadata-source-image-index", 0)),
+            std::min(static_cast<size_t>(parameter::metadata_source_image_index.value()),
                      input_metadata.size() - 1);
 
         metadata::named_meta_array valid_named_metadata;
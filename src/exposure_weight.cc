@@ -81,6 +81,11 @@ namespace exposure_weight
 
         double weight(double y) override {return function_->weight(y);}
 
+        void weight_batch(const double* ys, double* ws, size_t n) override
+        {
+            function_->weight_batch(ys, ws, n);
+        }
+
     private:
         std::string library_;
         std::string symbol_;
@@ -7,6 +7,7 @@
 #define EXPOSURE_WEIGHT_BASE_INCLUDED
 
 
+#include <cstddef>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -14,7 +15,7 @@
 
 
 // Version number of the interface-to-user-weight functions.
-#define EXPOSURE_WEIGHT_INTERFACE_VERSION 2
+#define EXPOSURE_WEIGHT_INTERFACE_VERSION 3
 
 
 // The full width at half of the maximum of the Gauss-curve we use for
@@ -61,6 +62,17 @@ public:
 
     virtual double weight(double) = 0;
 
+    // Evaluate the weight function for n luminances at once.
+    // Override this if the weight function can do better than
+    // calling weight() for every single luminance.
+    virtual void weight_batch(const double* ys, double* ws, size_t n)
+    {
+        for (size_t i = 0U; i != n; ++i)
+        {
+            ws[i] = weight(ys[i]);
+        }
+    }
+
     virtual ~ExposureWeight() {}
 
     struct error : public std::runtime_error
@@ -465,6 +465,158 @@ namespace vigra_ext
             }
         }
     }
+
+
+    // Band-parallel variant of fill_polygon_active().
+    //
+    // Cut the rows of the polygon's extent into bands of band_height
+    // rows and fill the bands in parallel.  Every band maintains its
+    // own active-edge table: an edge enters when the scanline reaches
+    // its upper end point and leaves after the scanline has passed
+    // its lower one.  Each edge is bucketed into all bands it spans
+    // beforehand, so a band never looks at edges outside of it.  The
+    // intersections are computed exactly as in fill_polygon_active(),
+    // which makes both fill the same pixels.
+    template <class ImageIterator, class ImageAccessor, class ValueType, class PolygonVertexIterator>
+    void
+    fill_polygon_banded(const ImageIterator& upper_left, const ImageIterator& lower_right, const ImageAccessor& accessor,
+                        const PolygonVertexIterator& vertex_begin, const PolygonVertexIterator& vertex_end,
+                        const ValueType& fill_value, int band_height = 64)
+    {
+        typedef std::pair<int, detail::intersection_t> intersection_data;
+        typedef std::vector<intersection_data> intersection_list;
+        typedef typename ImageIterator::row_iterator row_iterator;
+
+        if (vertex_begin == vertex_end)
+        {
+            return;
+        }
+
+        const vigra::Size2D image_size(lower_right - upper_left);
+        const vigra::Rect2D extent(detail::get_polygon_extent(vertex_begin, vertex_end));
+        const int first_row = std::max(0, extent.top());
+        const int end_row = std::min(image_size.height(), extent.bottom());
+
+        if (first_row >= end_row)
+        {
+            return;
+        }
+
+        typedef std::pair<vigra::Point2D, vigra::Point2D> segment;
+        typedef std::vector<segment> segments;
+        typedef std::vector<typename segments::size_type> segment_index_list;
+
+        // Create the line segments that make up the polygon with the
+        // upper end point first and sort them by their upper end points.
+        segments polygon_segments;
+        PolygonVertexIterator u(vertex_begin);
+        PolygonVertexIterator v(vertex_begin);
+
+        ++v;
+        while (v != vertex_end)
+        {
+            if (*u != END_OF_SEGMENT_MARKER && *v != END_OF_SEGMENT_MARKER)
+            {
+                polygon_segments.push_back(u->py() < v->py() ? std::make_pair(*u, *v) : std::make_pair(*v, *u));
+            }
+            ++u;
+            ++v;
+        }
+
+        std::sort(polygon_segments.begin(), polygon_segments.end(), detail::LessThanSegment<segment>());
+
+        band_height = std::max(band_height, 1);
+        const int number_of_bands = (end_row - first_row + band_height - 1) / band_height;
+
+        // As polygon_segments is sorted, so is every bucket.
+        std::vector<segment_index_list> band_segments(number_of_bands);
+        for (typename segments::size_type i = 0U; i != polygon_segments.size(); ++i)
+        {
+            const int top = std::max(first_row, polygon_segments[i].first.py());
+            const int bottom = std::min(end_row - 1, polygon_segments[i].second.py());
+
+            for (int b = (top - first_row) / band_height; top <= bottom && b <= (bottom - first_row) / band_height; ++b)
+            {
+                band_segments[b].push_back(i);
+            }
+        }
+
+        // Exceptions must not escape a parallel region; remember
+        // which bands failed and throw afterwards.
+        std::vector<unsigned char> malformed(number_of_bands, 0U);
+
+#ifdef OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int b = 0; b < number_of_bands; ++b)
+        {
+            const int band_begin = first_row + b * band_height;
+            const int band_end = std::min(end_row, band_begin + band_height);
+            const segment_index_list& candidates(band_segments[b]);
+            typename segment_index_list::const_iterator next(candidates.begin());
+            std::vector<const segment*> active_segments;
+            intersection_list intersections;
+            std::vector<int> paired_intersections;
+
+            try
+            {
+                for (int y = band_begin; y < band_end; ++y)
+                {
+                    while (next != candidates.end() && polygon_segments[*next].first.py() <= y)
+                    {
+                        active_segments.push_back(&polygon_segments[*next]);
+                        ++next;
+                    }
+                    active_segments.erase(std::remove_if(active_segments.begin(), active_segments.end(),
+                                                         [y](const segment* s) {return s->second.py() < y;}),
+                                          active_segments.end());
+
+                    intersections.clear();
+                    for (typename std::vector<const segment*>::const_iterator a = active_segments.begin();
+                         a != active_segments.end();
+                         ++a)
+                    {
+                        const segment& s(**a);
+                        const int delta_y = s.second.py() - s.first.py();
+                        if (delta_y != 0)
+                        {
+                            const double m = static_cast<double>(y - s.first.py()) / static_cast<double>(delta_y);
+                            const int x = lrint(static_cast<double>(s.first.px()) +
+                                                m * static_cast<double>(s.second.px() - s.first.px()));
+                            intersections.push_back(std::make_pair(x, detail::intersection_of_bool(detail::is_touching_point(s.first, s.second, y))));
+                        }
+                        else if (y == s.first.py()) // horizontal segment in _current_ scanline
+                        {
+                            intersections.push_back(std::make_pair(std::min(s.first.px(), s.second.px()), detail::HORIZONTAL_LEFT));
+                            intersections.push_back(std::make_pair(std::max(s.first.px(), s.second.px()), detail::HORIZONTAL_RIGHT));
+                        }
+                    }
+
+                    if (!intersections.empty()) // OPTIMIZATION: skip empty scanlines
+                    {
+                        std::sort(intersections.begin(), intersections.end());
+
+                        paired_intersections.clear();
+                        detail::group_to_pairs(intersections.begin(), intersections.end(), std::back_inserter(paired_intersections));
+
+                        const row_iterator row((upper_left + vigra::Diff2D(0, y)).rowIterator());
+                        detail::fill_row_segments(paired_intersections,
+                                                  row, image_size.width(), accessor,
+                                                  fill_value);
+                    }
+                }
+            }
+            catch (detail::malformed_polygon&)
+            {
+                malformed[b] = 1U;
+            }
+        }
+
+        if (std::find(malformed.begin(), malformed.end(), 1U) != malformed.end())
+        {
+            throw detail::malformed_polygon("vigra_ext::fill_row_segments: open polygon");
+        }
+    }
 } // end namespace vigra_ext
 
 
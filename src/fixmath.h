@@ -26,7 +26,14 @@
 #include <config.h>
 #endif
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include <time.h>
 
@@ -466,7 +473,7 @@ class PyramidScale
 
 public:
     PyramidScale() :
-        color_limit(parameter::as_double("lab-color-limit", 200.0)),
+        color_limit(parameter::lab_color_limit.value()),
         pyramid_scale(double(1U << (PyramidIntegerBits - PYRAMID_HEADROOM_BITS)))
     {
         static_assert(PyramidIntegerBits >= PYRAMID_HEADROOM_BITS,
@@ -663,16 +670,23 @@ public:
     }
 #endif // LOG_COLORSPACE_CONVERSION
 
-    PyramidVectorType operator()(const SrcVectorType& v) const
+    typedef std::array<double, 3> profile_input_type;
+    typedef cmsCIELab profile_output_type;
+
+    void prepare(const SrcVectorType& v, profile_input_type& rgb) const
     {
-        const double rgb[] = {
-            rgb_source_scale * SrcTraits::toRealPromote(v.red()),
-            rgb_source_scale * SrcTraits::toRealPromote(v.green()),
-            rgb_source_scale * SrcTraits::toRealPromote(v.blue())
-        };
-        cmsCIELab lab;
+        rgb[0] = rgb_source_scale * SrcTraits::toRealPromote(v.red());
+        rgb[1] = rgb_source_scale * SrcTraits::toRealPromote(v.green());
+        rgb[2] = rgb_source_scale * SrcTraits::toRealPromote(v.blue());
+    }
+
+    void transform(const profile_input_type* rgb, profile_output_type* lab, unsigned n) const
+    {
+        cmsDoTransform(InputToLabTransform, rgb, lab, n);
+    }
 
-        cmsDoTransform(InputToLabTransform, rgb, &lab, 1U);
+    PyramidVectorType finish(const profile_input_type&, const profile_output_type& lab) const
+    {
 #ifdef LOG_COLORSPACE_CONVERSION
         range.update(lab.L, lab.a, lab.b);
 #endif // LOG_COLORSPACE_CONVERSION
@@ -682,6 +696,17 @@ public:
                                  converter(Scale::scale_color_difference_for_pyramid(lab.b)));
     }
 
+    PyramidVectorType operator()(const SrcVectorType& v) const
+    {
+        profile_input_type rgb;
+        profile_output_type lab;
+
+        prepare(v, rgb);
+        transform(&rgb, &lab, 1U);
+
+        return finish(rgb, lab);
+    }
+
 protected:
     ConvertFunctorType converter;
     const double rgb_source_scale;
@@ -829,6 +854,74 @@ namespace lab_detail
 
         return delta_e_cost(&lab, parameter);
     }
+
+
+    // Key of the polishing cache: the bit patterns of L, a, and b.
+    // Comparing bits rather than values keeps -0.0 and 0.0 apart,
+    // which matters because they yield different hue angles.
+    typedef std::array<std::uint64_t, 3> polish_key;
+
+    inline static polish_key
+    make_polish_key(const cmsCIELab& lab)
+    {
+        static_assert(sizeof(double) == sizeof(std::uint64_t), "unexpected size of double");
+
+        polish_key key;
+        std::memcpy(&key[0], &lab.L, sizeof(double));
+        std::memcpy(&key[1], &lab.a, sizeof(double));
+        std::memcpy(&key[2], &lab.b, sizeof(double));
+
+        return key;
+    }
+
+
+    struct polish_key_hash
+    {
+        size_t operator()(const polish_key& key) const
+        {
+            const std::hash<std::uint64_t> hash;
+            size_t seed = hash(key[0]);
+
+            seed ^= hash(key[1]) + 0x9e3779b9U + (seed << 6) + (seed >> 2);
+            seed ^= hash(key[2]) + 0x9e3779b9U + (seed << 6) + (seed >> 2);
+
+            return seed;
+        }
+    };
+
+
+    struct polish_result
+    {
+        double rgb[3];
+        double delta_e;
+    };
+
+
+    // Tallies of polish_rgb().  Every copy of a converter counts on
+    // its own and adds its tallies to the totals it shares with all
+    // other copies when it goes away.
+    struct polish_statistics
+    {
+        polish_statistics() :
+            calls(0ULL), false_positives(0ULL), cache_hits(0ULL),
+            total_delta_e(0.0), total_iterations(0ULL)
+        {}
+
+        void add(const polish_statistics& other)
+        {
+            calls += other.calls;
+            false_positives += other.false_positives;
+            cache_hits += other.cache_hits;
+            total_delta_e += other.total_delta_e;
+            total_iterations += other.total_iterations;
+        }
+
+        unsigned long long calls;
+        unsigned long long false_positives;
+        unsigned long long cache_hits;
+        double total_delta_e;
+        unsigned long long total_iterations;
+    };
 } // namespace lab_detail
 
 
@@ -836,45 +929,74 @@ class OptimizableLuminanceSpace
 {
 public:
     OptimizableLuminanceSpace() :
-        shadow_rgb_threshold(parameter::as_double("lum-shadow-rgb-threshold", 0.0)),
-        maximum_bracket_tries(parameter::as_unsigned("lum-bracket-maximum-tries", 500U)),
-        suspicious_delta_e(parameter::as_double("lum-suspicious-delta-e", 1.0)),
-        optimizer_error(parameter::as_double("lum-optimizer-error", 0.5 / 256.0)),
-        optimizer_goal(parameter::as_double("lum-optimizer-deltae-goal", 0.5)),
-        maximum_iterations(parameter::as_unsigned("lum-maximum-iterations", 50U)),
-        max_chroma_factor(parameter::as_double("lum-max-chroma-factor", 20.0))
-#ifdef LOG_COLORSPACE_OPTIMIZATION
-        , polish_tally(0U), polish_false_positive_tally(0U),
-        total_delta_e(0.0), total_iterations(0U)
-#endif // LOG_COLORSPACE_OPTIMIZATION
+        shadow_rgb_threshold(parameter::lum_shadow_rgb_threshold.value()),
+        maximum_bracket_tries(parameter::lum_bracket_maximum_tries.value()),
+        suspicious_delta_e(parameter::lum_suspicious_delta_e.value()),
+        optimizer_error(parameter::lum_optimizer_error.value()),
+        optimizer_goal(parameter::lum_optimizer_deltae_goal.value()),
+        maximum_iterations(parameter::lum_maximum_iterations.value()),
+        max_chroma_factor(parameter::lum_max_chroma_factor.value()),
+        polish_cache_size(parameter::lum_polish_cache_size.value()),
+        total_statistics(std::make_shared<lab_detail::polish_statistics>())
+    {}
+
+    // A copy starts with empty tallies, but shares the totals.
+    OptimizableLuminanceSpace(const OptimizableLuminanceSpace& other) :
+        shadow_rgb_threshold(other.shadow_rgb_threshold),
+        maximum_bracket_tries(other.maximum_bracket_tries),
+        suspicious_delta_e(other.suspicious_delta_e),
+        optimizer_error(other.optimizer_error),
+        optimizer_goal(other.optimizer_goal),
+        maximum_iterations(other.maximum_iterations),
+        max_chroma_factor(other.max_chroma_factor),
+        polish_cache_size(other.polish_cache_size),
+        polish_cache(other.polish_cache),
+        total_statistics(other.total_statistics)
     {}
 
     virtual ~OptimizableLuminanceSpace()
     {
-#ifdef LOG_COLORSPACE_OPTIMIZATION
-        if (polish_tally)
-        {
 #ifdef OPENMP
-#pragma omp critical
+#pragma omp critical (polish_statistics)
 #endif
-            std::cout <<
-                "+ OptimizableLuminanceSpace: polish_rgb() called " << polish_tally << " times with " <<
-                100.0 * static_cast<double>(polish_false_positive_tally) / static_cast<double>(polish_tally) <<
-                "% false positives\n" <<
-                "+ OptimizableLuminanceSpace: polish_rgb() total residual deltaE " << total_delta_e << " (" <<
-                (polish_tally == polish_false_positive_tally ?
-                 total_delta_e :
-                 total_delta_e / static_cast<double>(polish_tally - polish_false_positive_tally)) <<
-                " average) after " << total_iterations << " iterations\n" << std::endl;
-        }
-        else
-        {
+        total_statistics->add(statistics);
+    }
+
+    // Report the tallies of all copies of this converter.  Call this
+    // after the conversion pass, when the copies that worked on the
+    // image are gone.
+    void log_polish_statistics() const
+    {
+        lab_detail::polish_statistics total(statistics);
 #ifdef OPENMP
-#pragma omp critical
+#pragma omp critical (polish_statistics)
 #endif
-            std::cout << "+ OptimizableLuminanceSpace: polish_rgb() not called\n" << std::endl;
+        total.add(*total_statistics);
+
+        if (total.calls == 0ULL)
+        {
+            std::cerr << command << ": info: no dark pixels needed luminance polishing" << std::endl;
+            return;
         }
-#endif // LOG_COLORSPACE_OPTIMIZATION
+
+        const unsigned long long optimizations = total.calls - total.false_positives;
+
+        std::cerr <<
+            command << ": info: luminance polishing checked " << total.calls << " dark pixels, " <<
+            100.0 * static_cast<double>(total.false_positives) / static_cast<double>(total.calls) <<
+            "% false positives\n" <<
+            command << ": info: luminance polishing answered " << total.cache_hits <<
+            " optimizations from cache (" <<
+            (optimizations == 0ULL ?
+             0.0 :
+             100.0 * static_cast<double>(total.cache_hits) / static_cast<double>(optimizations)) <<
+            "% hit rate)\n" <<
+            command << ": info: luminance polishing left total residual deltaE " << total.total_delta_e <<
+            " (" <<
+            (optimizations == 0ULL ?
+             total.total_delta_e :
+             total.total_delta_e / static_cast<double>(optimizations)) <<
+            " average) after " << total.total_iterations << " iterations" << std::endl;
     }
 
     bool is_below_threshold(const double* rgb) const
@@ -886,16 +1008,11 @@ public:
 
     void polish_rgb(const cmsCIELab* lab, double* rgb) const
     {
-#ifdef LOG_COLORSPACE_OPTIMIZATION
-#ifdef OPENMP
-#pragma omp atomic
-#endif
-        ++polish_tally;
-#endif // LOG_COLORSPACE_OPTIMIZATION
+        ++statistics.calls;
 
         if (EXPECT_RESULT(std::isnan(lab->a) || std::isnan(lab->b), false))
         {
-            if (parameter::as_boolean("mark-freaky-color-conversions", false))
+            if (parameter::mark_freaky_color_conversions.value())
             {
                 // magenta
                 rgb[0] = 1.0;
@@ -917,12 +1034,7 @@ public:
 
             if (EXPECT_RESULT(delta_e < suspicious_delta_e, true))
             {
-#ifdef LOG_COLORSPACE_OPTIMIZATION
-#ifdef OPENMP
-#pragma omp atomic
-#endif
-                ++polish_false_positive_tally;
-#endif // LOG_COLORSPACE_OPTIMIZATION
+                ++statistics.false_positives;
                 return;
             }
 
@@ -934,7 +1046,26 @@ public:
 #endif // LOG_COLORSPACE_OPTIMIZATION
         }
 
+        // The optimization depends on nothing but the Lab value, and
+        // Lab values coming out of the fixed-point pyramid repeat a
+        // lot in saturated areas.  Each thread works on its own copy
+        // of the converter, so neither the cache nor the tallies need
+        // locking.
+        const lab_detail::polish_key key(lab_detail::make_polish_key(*lab));
+        if (polish_cache_size != 0U)
+        {
+            const auto hit = polish_cache.find(key);
+            if (hit != polish_cache.end())
+            {
+                std::copy(hit->second.rgb, hit->second.rgb + 3, rgb);
+                ++statistics.cache_hits;
+                statistics.total_delta_e += hit->second.delta_e;
+                return;
+            }
+        }
+
         const double initial_chroma {chroma_of_cartesian_lab(*lab)};
+        double residual_delta_e {0.0};
 
         lab_detail::extra_minimizer_parameter extra(*lab);
         gsl_function cost = {lab_detail::delta_e_min_cost, &extra};
@@ -962,16 +1093,9 @@ public:
                 set_goal(optimizer_goal)->
                 set_maximum_number_of_iterations(maximum_iterations);
             optimizer.run();
-#ifdef LOG_COLORSPACE_OPTIMIZATION
-#ifdef OPENMP
-#pragma omp atomic
-#endif
-            total_delta_e += optimizer.f_minimum();
-#ifdef OPENMP
-#pragma omp atomic
-#endif
-            total_iterations += optimizer.number_of_iterations();
-#endif // LOG_COLORSPACE_OPTIMIZATION
+            residual_delta_e = optimizer.f_minimum();
+            statistics.total_delta_e += residual_delta_e;
+            statistics.total_iterations += optimizer.number_of_iterations();
 
             const double initial_hue {hue_of_cartesian_lab(*lab)};
             final_lab.L = lab->L;
@@ -1017,7 +1141,7 @@ public:
                 ", final deltaE = " << calculate_delta_e(lab, &final_lab) << "\n" << std::endl;
 #endif // LOG_COLORSPACE_OPTIMIZATION
 
-            if (parameter::as_boolean("mark-freaky-color-conversions", false))
+            if (parameter::mark_freaky_color_conversions.value())
             {
                 // yellow
                 rgb[0] = 1.0;
@@ -1025,6 +1149,15 @@ public:
                 rgb[2] = 0.0;
             }
         }
+
+        if (polish_cache_size != 0U)
+        {
+            if (polish_cache.size() >= polish_cache_size)
+            {
+                polish_cache.clear();
+            }
+            polish_cache.emplace(key, lab_detail::polish_result {{rgb[0], rgb[1], rgb[2]}, residual_delta_e});
+        }
     }
 
 private:
@@ -1035,13 +1168,12 @@ private:
     const double optimizer_goal;
     const unsigned maximum_iterations;
     const double max_chroma_factor;
+    const size_t polish_cache_size;
+    mutable std::unordered_map<lab_detail::polish_key, lab_detail::polish_result,
+                               lab_detail::polish_key_hash> polish_cache;
 
-#ifdef LOG_COLORSPACE_OPTIMIZATION
-    mutable unsigned polish_tally;
-    mutable unsigned polish_false_positive_tally;
-    mutable double total_delta_e;
-    mutable unsigned total_iterations;
-#endif // LOG_COLORSPACE_OPTIMIZATION
+    mutable lab_detail::polish_statistics statistics;
+    const std::shared_ptr<lab_detail::polish_statistics> total_statistics;
 };  // class OptimizableLuminanceSpace
 
 
@@ -1058,6 +1190,8 @@ class ConvertLabPyramidToVectorFunctor :
                                           PyramidIntegerBits, PyramidFractionBits> ConvertFunctorType;
 
 public:
+    using OptimizableLuminanceSpace::log_polish_statistics;
+
     ConvertLabPyramidToVectorFunctor() :
         converter(),
         rgb_dest_scale(DestTraits::toRealPromote(DestTraits::max()))
@@ -1091,25 +1225,32 @@ public:
     }
 #endif // LOG_COLORSPACE_CONVERSION
 
-    DestVectorType operator()(const PyramidVectorType& v) const
+    typedef cmsCIELab profile_input_type;
+    typedef std::array<double, 3> profile_output_type;
+
+    void prepare(const PyramidVectorType& v, profile_input_type& lab) const
     {
-        const cmsCIELab lab = {
-            Scale::scale_lightness_of_pyramid(converter(v.red())),
-            Scale::scale_color_difference_of_pyramid(converter(v.green())),
-            Scale::scale_color_difference_of_pyramid(converter(v.blue()))
-        };
-        double rgb[3];
+        lab.L = Scale::scale_lightness_of_pyramid(converter(v.red()));
+        lab.a = Scale::scale_color_difference_of_pyramid(converter(v.green()));
+        lab.b = Scale::scale_color_difference_of_pyramid(converter(v.blue()));
 
 #ifdef LOG_COLORSPACE_CONVERSION
         range.update(lab.L, lab.a, lab.b);
 #endif // LOG_COLORSPACE_CONVERSION
 
         assert(lab.L >= 0.0);
-        cmsDoTransform(LabToInputTransform, &lab, rgb, 1U);
+    }
+
+    void transform(const profile_input_type* lab, profile_output_type* rgb, unsigned n) const
+    {
+        cmsDoTransform(LabToInputTransform, lab, rgb, n);
+    }
 
-        if (EXPECT_RESULT(is_below_threshold(rgb), false))
+    DestVectorType finish(const profile_input_type& lab, profile_output_type rgb) const
+    {
+        if (EXPECT_RESULT(is_below_threshold(rgb.data()), false))
         {
-            polish_rgb(&lab, rgb);
+            polish_rgb(&lab, rgb.data());
         }
 
         return DestVectorType(DestTraits::fromRealPromote(rgb_dest_scale * rgb[0]),
@@ -1117,6 +1258,17 @@ public:
                               DestTraits::fromRealPromote(rgb_dest_scale * rgb[2]));
     }
 
+    DestVectorType operator()(const PyramidVectorType& v) const
+    {
+        profile_input_type lab;
+        profile_output_type rgb;
+
+        prepare(v, lab);
+        transform(&lab, &rgb, 1U);
+
+        return finish(lab, rgb);
+    }
+
 protected:
     ConvertFunctorType converter;
     const double rgb_dest_scale;
@@ -1176,16 +1328,34 @@ public:
     }
 #endif // LOG_COLORSPACE_CONVERSION
 
+    typedef std::array<double, 3> profile_input_type;
+    typedef XYZ2LuvFunctor::argument_type profile_output_type;
+
+    void prepare(const SrcVectorType& v, profile_input_type& rgb) const
+    {
+        rgb[0] = rgb_source_scale * SrcTraits::toRealPromote(v.red());
+        rgb[1] = rgb_source_scale * SrcTraits::toRealPromote(v.green());
+        rgb[2] = rgb_source_scale * SrcTraits::toRealPromote(v.blue());
+    }
+
+    void transform(const profile_input_type* rgb, profile_output_type* xyz, unsigned n) const
+    {
+        cmsDoTransform(InputToXYZTransform, rgb, xyz, n);
+    }
+
     PyramidVectorType operator()(const SrcVectorType& v) const
     {
-        const double rgb[] = {
-            rgb_source_scale * SrcTraits::toRealPromote(v.red()),
-            rgb_source_scale * SrcTraits::toRealPromote(v.green()),
-            rgb_source_scale * SrcTraits::toRealPromote(v.blue())
-        };
-        XYZ2LuvFunctor::argument_type xyz;
+        profile_input_type rgb;
+        profile_output_type xyz;
+
+        prepare(v, rgb);
+        transform(&rgb, &xyz, 1U);
+
+        return finish(rgb, xyz);
+    }
 
-        cmsDoTransform(InputToXYZTransform, rgb, &xyz[0], 1U);
+    PyramidVectorType finish(const profile_input_type&, const profile_output_type& xyz) const
+    {
         const XYZ2LuvFunctor::result_type luv {xyz2luv(xyz)};
 #ifdef LOG_COLORSPACE_CONVERSION
         range.update(luv[0], luv[1], luv[2]);
@@ -1225,6 +1395,8 @@ class ConvertLuvPyramidToVectorFunctor :
     typedef vigra::XYZ2LabFunctor<double> XYZ2LabFunctor;
 
 public:
+    using OptimizableLuminanceSpace::log_polish_statistics;
+
     ConvertLuvPyramidToVectorFunctor() :
         converter(),
         rgb_dest_scale(DestTraits::toRealPromote(DestTraits::max()))
@@ -1258,7 +1430,10 @@ public:
     }
 #endif // LOG_COLORSPACE_CONVERSION
 
-    DestVectorType operator()(const PyramidVectorType& v) const
+    typedef Luv2XYZFunctor::result_type profile_input_type;
+    typedef std::array<double, 3> profile_output_type;
+
+    void prepare(const PyramidVectorType& v, profile_input_type& xyz) const
     {
         const Luv2XYZFunctor::value_type luv {
             Scale::scale_lightness_of_pyramid(converter(v.red())),
@@ -1270,12 +1445,28 @@ public:
 #endif // LOG_COLORSPACE_CONVERSION
 
         assert(!std::isnan(luv[0]) && luv[0] >= 0.0);
-        Luv2XYZFunctor::result_type xyz {luv2xyz(luv)};
-        double rgb[3];
+        xyz = luv2xyz(luv);
+    }
 
-        cmsDoTransform(XYZToInputTransform, &xyz[0], rgb, 1U);
+    void transform(const profile_input_type* xyz, profile_output_type* rgb, unsigned n) const
+    {
+        cmsDoTransform(XYZToInputTransform, xyz, rgb, n);
+    }
+
+    DestVectorType operator()(const PyramidVectorType& v) const
+    {
+        profile_input_type xyz;
+        profile_output_type rgb;
+
+        prepare(v, xyz);
+        transform(&xyz, &rgb, 1U);
+
+        return finish(xyz, rgb);
+    }
 
-        if (EXPECT_RESULT(is_below_threshold(rgb), false))
+    DestVectorType finish(profile_input_type xyz, profile_output_type rgb) const
+    {
+        if (EXPECT_RESULT(is_below_threshold(rgb.data()), false))
         {
             XYZ2LabFunctor::result_type lab_vector {xyz2lab(xyz)};
             cmsCIELab lab {lab_vector[0], lab_vector[1], lab_vector[2]};
@@ -1295,7 +1486,7 @@ public:
                 xyz[1] = std::max(xyz[1], 0.0);
                 xyz[2] = std::max(xyz[2], 0.0);
 
-                cmsDoTransform(XYZToInputTransform, &xyz[0], rgb, 1U);
+                cmsDoTransform(XYZToInputTransform, &xyz[0], rgb.data(), 1U);
                 lab_vector = xyz2lab(xyz);
 
                 lab.L = lab_vector[0];
@@ -1313,7 +1504,7 @@ public:
 #endif // LOG_COLORSPACE_CONVERSION
             }
 
-            polish_rgb(&lab, rgb);
+            polish_rgb(&lab, rgb.data());
         }
 
         return DestVectorType(DestTraits::fromRealPromote(rgb_dest_scale * rgb[0]),
@@ -1419,17 +1610,38 @@ public:
         rgb_source_scale(1.0 / SrcTraits::toRealPromote(SrcTraits::max()))
     {}
 
-    PyramidVectorType operator()(const SrcVectorType& v) const
+    typedef std::array<double, 3> profile_input_type;
+    typedef std::array<double, 3> profile_output_type;
+
+    void prepare(const SrcVectorType& v, profile_input_type& rgb) const
     {
         // rgb values must be in range [0, 1]
-        const double rgb[] = {
-            rgb_source_scale * SrcTraits::toRealPromote(v.red()),
-            rgb_source_scale * SrcTraits::toRealPromote(v.green()),
-            rgb_source_scale * SrcTraits::toRealPromote(v.blue())
-        };
+        rgb[0] = rgb_source_scale * SrcTraits::toRealPromote(v.red());
+        rgb[1] = rgb_source_scale * SrcTraits::toRealPromote(v.green());
+        rgb[2] = rgb_source_scale * SrcTraits::toRealPromote(v.blue());
+    }
+
+    void transform(const profile_input_type* rgb, profile_output_type* xyz, unsigned n) const
+    {
+        cmsDoTransform(InputToXYZTransform, rgb, xyz, n);
+    }
+
+    PyramidVectorType operator()(const SrcVectorType& v) const
+    {
+        profile_input_type rgb;
+        profile_output_type xyz;
+
+        prepare(v, rgb);
+        transform(&rgb, &xyz, 1U);
+
+        return finish(rgb, xyz);
+    }
+
+    PyramidVectorType finish(const profile_input_type&, const profile_output_type& xyz) const
+    {
         cmsJCh jch;
 
-        rgb_to_jch(rgb, &jch);
+        xyz_to_jch(xyz.data(), &jch);
 
         const double theta = radian_of_degree(jch.h);
 
@@ -1444,11 +1656,8 @@ protected:
         return x * (M_PI / 180.0);
     }
 
-    void rgb_to_jch(const double* rgb, cmsJCh* jch) const
+    void xyz_to_jch(const double* xyz, cmsJCh* jch) const
     {
-        double xyz[3];
-        cmsDoTransform(InputToXYZTransform, rgb, xyz, 1U);
-
         const cmsCIEXYZ scaled_xyz = {XYZ_SCALE * xyz[0], XYZ_SCALE * xyz[1], XYZ_SCALE * xyz[2]};
         cmsJCh jch_unlimited;
         cmsCIECAM02Forward(CIECAMTransform, &scaled_xyz, &jch_unlimited);
@@ -1579,47 +1788,47 @@ public:
         rgb_dest_scale(DestTraits::toRealPromote(DestTraits::max())),
 
         // Parameters for highlight optimizer only
-        highlight_lightness_guess_1d_factor(limit(parameter::as_double("ciecam-highlight-recovery-lightness-guess-factor", 0.975),
+        highlight_lightness_guess_1d_factor(limit(parameter::ciecam_highlight_recovery_lightness_guess_factor.value(),
                                                   0.25, 4.0)),
-        highlight_lightness_guess_1d_offset(parameter::as_double("ciecam-highlight-recovery-lightness-guess-offset", 0.0)),
+        highlight_lightness_guess_1d_offset(parameter::ciecam_highlight_recovery_lightness_guess_offset.value()),
 
-        maximum_highlight_iterations(limit(parameter::as_unsigned("ciecam-highlight-recovery-maximum-iterations", 100U),
+        maximum_highlight_iterations(limit(parameter::ciecam_highlight_recovery_maximum_iterations.value(),
                                            10U, 1000U)),
-        maximum_highlight_bracket_tries(limit(parameter::as_unsigned("ciecam-highlight-recovery-bracket-maximum-tries", 1000U),
+        maximum_highlight_bracket_tries(limit(parameter::ciecam_highlight_recovery_bracket_maximum_tries.value(),
                                               10U, 1000000U)),
-        highlight_simplex_lightness_step_length(limit(parameter::as_double("ciecam-highlight-recovery-lightness-step-length", 12.5),
+        highlight_simplex_lightness_step_length(limit(parameter::ciecam_highlight_recovery_lightness_step_length.value(),
                                                       1.0 / 65536.0, 100.0)),
-        highlight_simplex_chroma_step_length(limit(parameter::as_double("ciecam-highlight-recovery-chroma-step-length", 6.25),
+        highlight_simplex_chroma_step_length(limit(parameter::ciecam_highlight_recovery_chroma_step_length.value(),
                                                    1.0 / 65536.0, 120.0)),
-        highlight_iterations_per_leg(limit(parameter::as_unsigned("ciecam-highlight-recovery-iterations-per-leg", 50U),
+        highlight_iterations_per_leg(limit(parameter::ciecam_highlight_recovery_iterations_per_leg.value(),
                                            5U, 500U)),
-        maximum_highlight_leg(limit(parameter::as_unsigned("ciecam-highlight-recovery-maximum-legs", 10U), 1U, 100U)),
-        shadow_disguised_as_highlight_j(limit(parameter::as_double("ciecam-shadow-disguised-as-highlight-lightness", 1.0),
+        maximum_highlight_leg(limit(parameter::ciecam_highlight_recovery_maximum_legs.value(), 1U, 100U)),
+        shadow_disguised_as_highlight_j(limit(parameter::ciecam_shadow_disguised_as_highlight_lightness.value(),
                                               0.0001, 10.0)),
 
         // Parameters for shadow optimizer only
-        shadow_lightness_lightness_guess_factor(parameter::as_double("ciecam-shadow-recovery-lightness-lightness-guess-factor", 1.24)),
-        shadow_lightness_chroma_guess_factor(parameter::as_double("ciecam-shadow-recovery-lightness-chroma-guess-factor", -0.136)),
-        shadow_lightness_guess_offset(parameter::as_double("ciecam-shadow-recovery-lightness-guess-offset", 0.0)),
-        shadow_chroma_lightness_guess_factor(parameter::as_double("ciecam-shadow-recovery-chroma-lightness-guess-factor", -0.604)),
-        shadow_chroma_chroma_guess_factor(parameter::as_double("ciecam-shadow-recovery-chroma-chroma-guess-factor", 1.33)),
-        shadow_chroma_guess_offset(parameter::as_double("ciecam-shadow-recovery-chroma-guess-offset", 0.0)),
-
-        shadow_simplex_lightness_step_length(limit(parameter::as_double("ciecam-shadow-recovery-lightness-step-length", 0.625),
+        shadow_lightness_lightness_guess_factor(parameter::ciecam_shadow_recovery_lightness_lightness_guess_factor.value()),
+        shadow_lightness_chroma_guess_factor(parameter::ciecam_shadow_recovery_lightness_chroma_guess_factor.value()),
+        shadow_lightness_guess_offset(parameter::ciecam_shadow_recovery_lightness_guess_offset.value()),
+        shadow_chroma_lightness_guess_factor(parameter::ciecam_shadow_recovery_chroma_lightness_guess_factor.value()),
+        shadow_chroma_chroma_guess_factor(parameter::ciecam_shadow_recovery_chroma_chroma_guess_factor.value()),
+        shadow_chroma_guess_offset(parameter::ciecam_shadow_recovery_chroma_guess_offset.value()),
+
+        shadow_simplex_lightness_step_length(limit(parameter::ciecam_shadow_recovery_lightness_step_length.value(),
                                                    1.0 / 65536.0, 100.0)),
-        shadow_simplex_chroma_step_length(limit(parameter::as_double("ciecam-shadow-recovery-chroma-step-length", 1.25),
+        shadow_simplex_chroma_step_length(limit(parameter::ciecam_shadow_recovery_chroma_step_length.value(),
                                                 1.0 / 65536.0, 120.0)),
-        shadow_iterations_per_leg(limit(parameter::as_unsigned("ciecam-shadow-recovery-iterations-per-leg", 40U),
+        shadow_iterations_per_leg(limit(parameter::ciecam_shadow_recovery_iterations_per_leg.value(),
                                         4U, 400U)),
-        maximum_shadow_leg(limit(parameter::as_unsigned("ciecam-shadow-recovery-maximum-legs", 5U), 1U, 50U)),
-        maximum_multistart_tries(limit(parameter::as_unsigned("ciecam-shadow-recovery-maximum-tries", 20U), 1U, 500U)),
+        maximum_shadow_leg(limit(parameter::ciecam_shadow_recovery_maximum_legs.value(), 1U, 50U)),
+        maximum_multistart_tries(limit(parameter::ciecam_shadow_recovery_maximum_tries.value(), 1U, 500U)),
 
         // Parameters for both optimizers
         // Desired error limits: LoFi: 0.5/2^8, HiFi: 0.5/2^16, Super-HiFi: 0.5/2^24
-        optimizer_error(limit(parameter::as_double("ciecam-optimizer-error", 0.5 / 65536.0),
+        optimizer_error(limit(parameter::ciecam_optimizer_error.value(),
                               0.5 / 16777216.0, 1.0)),
         // Delta-E goals: LoFi: 1.0, HiFi: 0.5, Super-HiFi: 0.0
-        optimizer_goal(limit(parameter::as_double("ciecam-optimizer-deltae-goal", 0.5), 0.0, 10.0))
+        optimizer_goal(limit(parameter::ciecam_optimizer_deltae_goal.value(), 0.0, 10.0))
     {}
 
     double highlight_lightness_guess_1d(const cmsJCh& jch) const
@@ -1866,7 +2075,7 @@ public:
         {
             // Lasciate ogne speranza, voi ch'intrate.
             return
-                parameter::as_boolean("mark-freaky-color-conversions", false) ?
+                parameter::mark_freaky_color_conversions.value() ?
                 DestVectorType(DestTraits::max(), DestTraits::max(), 0) : // yellow
                 DestVectorType(0, 0, 0);
         }
@@ -1941,7 +2150,7 @@ public:
                 std::cout << "\n";
                 ciecam_detail::show_jch_rgb("+ stubborn highlight:", &jch);
             }
-            if (parameter::as_boolean("mark-freaky-color-conversions", false))
+            if (parameter::mark_freaky_color_conversions.value())
             {
                 // navy blue
                 rgb[0] = 0.0;
@@ -1959,7 +2168,7 @@ public:
                 std::cout << "\n";
                 ciecam_detail::show_jch_rgb("+ stubborn shadow:", &jch);
             }
-            if (parameter::as_boolean("mark-freaky-color-conversions", false))
+            if (parameter::mark_freaky_color_conversions.value())
             {
                 // yellow
                 rgb[0] = 1.0;
@@ -2008,6 +2217,127 @@ protected:
 };
 
 
+// Apply a color-space converter to an image row by row.  Converters
+// that go through an ICC profile split the conversion of a pixel
+// into prepare(), the profile transform(), and finish().  Every call
+// of cmsDoTransform() pays a fixed overhead for dispatching to the
+// pixel formatters and the transform pipeline, so we prepare a whole
+// row, run it through the profile in a single call, and then finish
+// the row.  The results are the same as calling the converter pixel
+// by pixel.
+template <class SrcImageIterator, class SrcAccessor,
+          class DestImageIterator, class DestAccessor,
+          class Converter>
+void
+transformImageInRows(SrcImageIterator src_upperleft, SrcImageIterator src_lowerright, SrcAccessor sa,
+                     DestImageIterator dest_upperleft, DestAccessor da,
+                     const Converter& converter)
+{
+    const vigra::Size2D size(src_lowerright - src_upperleft);
+
+    if (size.x <= 0)
+    {
+        return;
+    }
+
+#ifdef OPENMP
+#pragma omp parallel
+#endif
+    {
+        Converter f(converter);
+        std::vector<typename Converter::profile_input_type> input(size.x);
+        std::vector<typename Converter::profile_output_type> output(size.x);
+
+#ifdef OPENMP
+#pragma omp for schedule(guided) nowait
+#endif
+        for (int y = 0; y < size.y; ++y)
+        {
+            const vigra::Diff2D begin(0, y);
+
+            typename SrcImageIterator::row_iterator s((src_upperleft + begin).rowIterator());
+            for (int x = 0; x < size.x; ++x, ++s)
+            {
+                f.prepare(sa(s), input[x]);
+            }
+
+            f.transform(input.data(), output.data(), static_cast<unsigned>(size.x));
+
+            typename DestImageIterator::row_iterator d((dest_upperleft + begin).rowIterator());
+            for (int x = 0; x < size.x; ++x, ++d)
+            {
+                da.set(f.finish(input[x], output[x]), d);
+            }
+        }
+    } // omp parallel
+}
+
+
+// Masked version of transformImageInRows().  Only the pixels under
+// the mask enter the profile transform.
+template <class SrcImageIterator, class SrcAccessor,
+          class MaskImageIterator, class MaskAccessor,
+          class DestImageIterator, class DestAccessor,
+          class Converter>
+void
+transformImageIfInRows(SrcImageIterator src_upperleft, SrcImageIterator src_lowerright, SrcAccessor sa,
+                       MaskImageIterator mask_upperleft, MaskAccessor ma,
+                       DestImageIterator dest_upperleft, DestAccessor da,
+                       const Converter& converter)
+{
+    const vigra::Size2D size(src_lowerright - src_upperleft);
+
+    if (size.x <= 0)
+    {
+        return;
+    }
+
+#ifdef OPENMP
+#pragma omp parallel
+#endif
+    {
+        Converter f(converter);
+        std::vector<int> column(size.x);
+        std::vector<typename Converter::profile_input_type> input(size.x);
+        std::vector<typename Converter::profile_output_type> output(size.x);
+
+#ifdef OPENMP
+#pragma omp for schedule(guided) nowait
+#endif
+        for (int y = 0; y < size.y; ++y)
+        {
+            const vigra::Diff2D begin(0, y);
+            const typename SrcImageIterator::row_iterator s((src_upperleft + begin).rowIterator());
+            typename MaskImageIterator::row_iterator m((mask_upperleft + begin).rowIterator());
+            int n = 0;
+
+            for (int x = 0; x < size.x; ++x, ++m)
+            {
+                if (ma(m))
+                {
+                    column[n] = x;
+                    f.prepare(sa(s, x), input[n]);
+                    ++n;
+                }
+            }
+
+            if (n == 0)
+            {
+                continue;
+            }
+
+            f.transform(input.data(), output.data(), static_cast<unsigned>(n));
+
+            const typename DestImageIterator::row_iterator d((dest_upperleft + begin).rowIterator());
+            for (int i = 0; i < n; ++i)
+            {
+                da.set(f.finish(input[i], output[i]), d, column[i]);
+            }
+        }
+    } // omp parallel
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Copy TO pyramid
@@ -2076,9 +2406,9 @@ copyToPyramidImage(typename SrcImageType::const_traverser src_upperleft,
             }
             std::cerr << "\n";
         }
-        vigra::omp::transformImage(src_upperleft, src_lowerright, sa,
-                                   dest_upperleft, da,
-                                   ConverterLab());
+        transformImageInRows(src_upperleft, src_lowerright, sa,
+                             dest_upperleft, da,
+                             ConverterLab());
         break;
 
     case CIELUV:
@@ -2091,9 +2421,9 @@ copyToPyramidImage(typename SrcImageType::const_traverser src_upperleft,
             }
             std::cerr << "\n";
         }
-        vigra::omp::transformImage(src_upperleft, src_lowerright, sa,
-                                   dest_upperleft, da,
-                                   ConverterLuv());
+        transformImageInRows(src_upperleft, src_lowerright, sa,
+                             dest_upperleft, da,
+                             ConverterLuv());
         break;
 
     case CIECAM:
@@ -2106,9 +2436,9 @@ copyToPyramidImage(typename SrcImageType::const_traverser src_upperleft,
             }
             std::cerr << "\n";
         }
-        vigra::omp::transformImage(src_upperleft, src_lowerright, sa,
-                                   dest_upperleft, da,
-                                   ConverterJCH());
+        transformImageInRows(src_upperleft, src_lowerright, sa,
+                             dest_upperleft, da,
+                             ConverterJCH());
         break;
 
     default:
@@ -2221,10 +2551,17 @@ copyFromPyramidImageIf(typename PyramidImageType::const_traverser src_upperleft,
         {
             std::cerr << command << ": info: CIELAB color conversion" << std::endl;
         }
-        vigra::omp::transformImageIf(src_upperleft, src_lowerright, sa,
-                                     mask_upperleft, ma,
-                                     dest_upperleft, da,
-                                     ConverterLab());
+        {
+            const ConverterLab converter;
+            transformImageIfInRows(src_upperleft, src_lowerright, sa,
+                                   mask_upperleft, ma,
+                                   dest_upperleft, da,
+                                   converter);
+            if (Verbose >= VERBOSE_COLOR_CONVERSION_MESSAGES)
+            {
+                converter.log_polish_statistics();
+            }
+        }
         break;
 
     case CIELUV:
@@ -2232,10 +2569,17 @@ copyFromPyramidImageIf(typename PyramidImageType::const_traverser src_upperleft,
         {
             std::cerr << command << ": info: CIELUV color conversion" << std::endl;
         }
-        vigra::omp::transformImageIf(src_upperleft, src_lowerright, sa,
-                                     mask_upperleft, ma,
-                                     dest_upperleft, da,
-                                     ConverterLuv());
+        {
+            const ConverterLuv converter;
+            transformImageIfInRows(src_upperleft, src_lowerright, sa,
+                                   mask_upperleft, ma,
+                                   dest_upperleft, da,
+                                   converter);
+            if (Verbose >= VERBOSE_COLOR_CONVERSION_MESSAGES)
+            {
+                converter.log_polish_statistics();
+            }
+        }
         break;
 
     case CIECAM:
@@ -30,9 +30,9 @@
 #endif
 
 #include <stdlib.h>
+#include <algorithm>
 #include <utility>
-#include <queue>
-#include <unordered_set>
+#include <vector>
 
 #include <vigra/functorexpression.hxx>
 #include <vigra/inspectimage.hxx>
@@ -51,9 +51,13 @@
 #include "stride.hxx"
 
 #include "common.h"
+#include "mapped_storage.h"
 #include "maskcommon.h"
 #include "masktypedefs.h"
 #include "nearest.h"
+#include "overlap.h"
+#include "parameter.h"
+#include "timer.h"
 
 
 using namespace vigra::functor;
@@ -74,36 +78,68 @@ using namespace vigra::functor;
 
 namespace enblend
 {
-    template <class T>
-    inline void hash_combine(std::size_t & seed, const T & value)
-    {
-        std::hash<T> hasher;
-        seed ^= hasher(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-    }
-
-    struct pointHash
+    // Set of points confined to a fixed rectangle and stored as one
+    // bit per point.  Points outside of the rectangle are silently
+    // dropped on insertion and never reported as members.
+    class DensePointSet
     {
-        std::size_t operator()(const vigra::Point2D& p) const
+    public:
+        explicit DensePointSet(const vigra::Rect2D& a_rectangle) :
+            rectangle(a_rectangle),
+            bits(static_cast<std::size_t>(a_rectangle.area()), false)
+        {}
+
+        bool contains(const vigra::Point2D& p) const
+        {
+            return rectangle.contains(p) && bits[index(p)];
+        }
+
+        void insert(const vigra::Point2D& p)
         {
-            std::size_t seed = 0;
+            if (rectangle.contains(p)) {
+                bits[index(p)] = true;
+            }
+        }
 
-            hash_combine(seed, p.x);
-            hash_combine(seed, p.y);
+        template <class InputIterator>
+        void insert(InputIterator first, InputIterator last)
+        {
+            for (; first != last; ++first) {
+                insert(*first);
+            }
+        }
 
-            return seed;
+    private:
+        std::size_t index(const vigra::Point2D& p) const
+        {
+            return
+                static_cast<std::size_t>(p.y - rectangle.top()) * static_cast<std::size_t>(rectangle.width()) +
+                static_cast<std::size_t>(p.x - rectangle.left());
         }
+
+        vigra::Rect2D rectangle;
+        std::vector<bool> bits;
     };
 
 
+    // Start and end points of one sub-cut.  There are only ever a
+    // handful of them, so a linear search beats any hashing.
     class CheckpointPixels
     {
     public:
+        typedef std::vector<vigra::Point2D> point_list;
+
         CheckpointPixels() {}
-        std::unordered_set<vigra::Point2D, pointHash> top, bottom;
+        point_list top, bottom;
+
+        bool isTop(const vigra::Point2D& p) const
+        {
+            return std::find(top.begin(), top.end(), p) != top.end();
+        }
 
-        ~CheckpointPixels()
+        bool isBottom(const vigra::Point2D& p) const
         {
-            this->clear();
+            return std::find(bottom.begin(), bottom.end(), p) != bottom.end();
         }
 
         void clear()
@@ -127,7 +163,7 @@ namespace enblend
                            MaskAccessor ma1, MaskImageIterator mask2_upperleft, MaskAccessor ma2,
                            DestImageIterator dest_upperleft, DestAccessor da,
                            nearest_neighbor_metric_t& norm, boundary_t& boundary,
-                           const vigra::Rect2D& iBB)
+                           const vigra::Rect2D& iBB, const IMAGETYPE<OverlapPixelType>& overlapFlags)
     {
         typedef vigra::NumericTraits<MaskPixelType> MaskPixelTraits;
         typedef typename IMAGETYPE<MaskPixelType>::traverser IteratorType;
@@ -135,7 +171,6 @@ namespace enblend
         typedef vigra::triple<IteratorType, IteratorType, unsigned int> EntryPointContainer;
         IMAGETYPE<MaskPixelType> nftTempImg(mask1_lowerright - mask1_upperleft + vigra::Diff2D(2, 2));
         IMAGETYPE<MaskPixelType> nft(iBB.lowerRight() - iBB.upperLeft() + vigra::Diff2D(2, 2));
-        IMAGETYPE<MaskPixelType> overlap(iBB.lowerRight() - iBB.upperLeft() + vigra::Diff2D(2, 2));
         IteratorType nftIter = nft.upperLeft();
         IteratorType previous;
         Circulator* circ;
@@ -165,17 +200,19 @@ namespace enblend
                                                                    nftTempImg.lowerRight() - vigra::Diff2D(1, 1))),
                          vigra::destIter(nft.upperLeft() + vigra::Diff2D(1, 1)));
 
-        vigra::omp::combineTwoImages(vigra_ext::apply(iBB, vigra::srcIterRange(mask1_upperleft, mask1_lowerright, ma1)),
-                                     vigra_ext::apply(iBB, vigra::srcIter(mask2_upperleft, ma2)),
-                                     vigra::destIter(overlap.upperLeft() + vigra::Diff2D(1, 1)),
-                                     ifThenElse(Arg1() && Arg2(),
-                                                Param(MaskPixelTraits::max()),
-                                                Param(MaskPixelTraits::zero())));
+        // The circulator walks nft, which has a one-pixel border
+        // around the overlap flags.
+        auto overlap = [&overlapFlags](const vigra::Point2D& p) -> bool
+        {
+            const vigra::Point2D q(p - vigra::Diff2D(1, 1));
+            return q.x >= 0 && q.y >= 0 && q.x < overlapFlags.width() && q.y < overlapFlags.height() &&
+                overlapFlags[q] == OVERLAP_BOTH;
+        };
 
 #ifdef DEBUG_GRAPHCUT
         exportImage(srcImageRange(nftTempImg), ImageExportInfo("./debug/nft-orig.tif").setPixelType("UINT8"));
         exportImage(srcImageRange(nft), ImageExportInfo("./debug/nfttotal.tif").setPixelType("UINT8"));
-        exportImage(srcImageRange(overlap), ImageExportInfo("./debug/overlap.tif").setPixelType("UINT8"));
+        exportImage(srcImageRange(overlapFlags), ImageExportInfo("./debug/overlap.tif").setPixelType("UINT8"));
 #endif
 
         circ = new Circulator(nftIter + vigra::Diff2D(1, 0), vigra::FourNeighborCode::South);
@@ -259,7 +296,7 @@ namespace enblend
             }
 
             if (offTheBorder) {
-                if (!inOverlap && overlap[intermediatePoint] == MaskPixelTraits::max()) {
+                if (!inOverlap && overlap(intermediatePoint)) {
                     inOverlap = true;
                     const vigra::Point2D dualGraphPoint = vigra::Point2D(intermediatePoint * 2 - vigra::Diff2D(1, 1));
                     if (!interPointList->empty() &&
@@ -275,7 +312,7 @@ namespace enblend
                 }
 
                 if (inOverlap &&
-                    overlap[intermediatePoint] == MaskPixelTraits::zero() &&
+                    !overlap(intermediatePoint) &&
                     nft.accessor()(circ->outerPixel()) != MaskPixelTraits::max() / 2) {
                     inOverlap = false;
                     const vigra::Point2D dualGraphPoint = vigra::Point2D(intermediatePoint * 2 - vigra::Diff2D(1, 1));
@@ -316,7 +353,7 @@ namespace enblend
     class CostComparer
     {
     public:
-        CostComparer(const ImageType* image) : img(image) {}
+        CostComparer(const ImageType* image) : img(image), totalScore(0L) {}
 
         bool operator()(const vigra::Point2D& a, const vigra::Point2D& b) const
         {
@@ -344,8 +381,7 @@ namespace enblend
     struct OutputLabelingFunctor
     {
     public:
-        OutputLabelingFunctor(std::unordered_set<vigra::Point2D, pointHash>* a_,
-                              std::unordered_set<vigra::Point2D, pointHash>* b_,
+        OutputLabelingFunctor(const DensePointSet* a_, const DensePointSet* b_,
                               vigra::Point2D offset_) :
             left(a_), right(b_), offset(offset_) {}
 
@@ -355,17 +391,17 @@ namespace enblend
             // add border to detect seams close to border
             point -= vigra::Point2D(1,1);
 
-            if(left->find(point) != left->end())
+            if (left->contains(point))
                 return LABEL_LEFT;
-            else if (right->find(point) != right->end())
+            else if (right->contains(point))
                 return LABEL_RIGHT;
             else
                 return LABEL_NONE;
         }
 
     protected:
-        std::unordered_set<vigra::Point2D, pointHash>* left;
-        std::unordered_set<vigra::Point2D, pointHash>* right;
+        const DensePointSet* left;
+        const DensePointSet* right;
         vigra::Point2D offset;
     };
 
@@ -373,25 +409,24 @@ namespace enblend
     struct CutPixelsFunctor
     {
     public:
-        CutPixelsFunctor(std::unordered_set<vigra::Point2D, pointHash>* a_,
-                         std::unordered_set<vigra::Point2D, pointHash>* b_) :
+        CutPixelsFunctor(const DensePointSet* a_, const DensePointSet* b_) :
             left(a_), right(b_){}
 
         MaskPixelType operator()(const vigra::Diff2D& pos2, const MaskPixelType& a2) const
         {
             vigra::Point2D pos(pos2);
-            if(left->find(pos) != left->end() && right->find(pos) != right->end())
+            if (left->contains(pos) && right->contains(pos))
                 return 164;
-            else if (left->find(*pos) != left->end())
+            else if (left->contains(pos))
                 return 64;
-            else if (right->find(*pos) != right->end())
+            else if (right->contains(pos))
                 return 255;
             else return 0;
         }
 
     protected:
-        std::unordered_set<vigra::Point2D, pointHash>* left;
-        std::unordered_set<vigra::Point2D, pointHash>* right;
+        const DensePointSet* left;
+        const DensePointSet* right;
     };
 
     template<class MaskPixelType>
@@ -415,6 +450,19 @@ namespace enblend
         long* count;
     };
 
+    template<class SrcPixelType, class BasePixelType, class ResultType>
+    struct MappedSumFunctor
+    {
+    public:
+        ResultType operator()(const SrcPixelType& a, const SrcPixelType& b) const
+        {
+            return ResultType(map(a)) + ResultType(map(b));
+        }
+
+    protected:
+        MapFunctor<SrcPixelType, BasePixelType> map;
+    };
+
 
     template <class SrcImageIterator, class SrcAccessor, class DestImageIterator,
               class DestAccessor, class MaskImageIterator, class MaskAccessor>
@@ -436,7 +484,7 @@ namespace enblend
 
 
     void getNeighbourList(vigra::Point2D src, vigra::Point2D* list,
-                          vigra::Diff2D bounds, CheckpointPixels* srcDestPoints)
+                          vigra::Diff2D bounds, const CheckpointPixels* srcDestPoints)
     {
         // return neighbour points from top to left in clockwise order
         bool check = false;
@@ -468,7 +516,7 @@ namespace enblend
             list[3] = src(-2, 0);
         }
 
-        if (srcDestPoints->bottom.find(src) != srcDestPoints->bottom.end()) {
+        if (srcDestPoints->isBottom(src)) {
             list[0] = vigra::Point2D(-20, -20);
             list[1] = vigra::Point2D(-20, -20);
             list[2] = vigra::Point2D(-20, -20);
@@ -476,10 +524,10 @@ namespace enblend
         }
 
         if (check) {
-            if (srcDestPoints->bottom.find(src) != srcDestPoints->bottom.end() ||
-                srcDestPoints->bottom.find(src(1, 0)) != srcDestPoints->bottom.end() ||
-                srcDestPoints->bottom.find(src(1, 1)) != srcDestPoints->bottom.end() ||
-                srcDestPoints->bottom.find(src(0, 1)) != srcDestPoints->bottom.end()) {
+            if (srcDestPoints->isBottom(src) ||
+                srcDestPoints->isBottom(src(1, 0)) ||
+                srcDestPoints->isBottom(src(1, 1)) ||
+                srcDestPoints->isBottom(src(0, 1))) {
                 if (list[1] == vigra::Point2D(-1, -1)) {
                     list[1] = vigra::Point2D(-20, -20);
                 } else if (list[2] == vigra::Point2D(-1, -1)) {
@@ -493,9 +541,9 @@ namespace enblend
 
 
     void
-    getNeighbourList(CheckpointPixels* srcDestPoints,
-                     std::unordered_set<vigra::Point2D, pointHash>::iterator* auxList1,
-                     std::unordered_set<vigra::Point2D, pointHash>::iterator* auxList2)
+    getNeighbourList(const CheckpointPixels* srcDestPoints,
+                     CheckpointPixels::point_list::const_iterator* auxList1,
+                     CheckpointPixels::point_list::const_iterator* auxList2)
     {
         *auxList1 = srcDestPoints->top.begin();
         *auxList2 = srcDestPoints->top.end();
@@ -503,7 +551,7 @@ namespace enblend
 
 
     template <class ImageType>
-    std::vector<vigra::Point2D>* tracePath(vigra::Point2D pt, ImageType* img, CheckpointPixels* srcDestPoints)
+    std::vector<vigra::Point2D>* tracePath(vigra::Point2D pt, ImageType* img, const CheckpointPixels* srcDestPoints)
     {
         std::vector<vigra::Point2D>* vec = new std::vector<vigra::Point2D>;
         vigra::Point2D current = pt;
@@ -529,7 +577,7 @@ namespace enblend
                 break;
             }
             current = vec->back();
-        } while (srcDestPoints->top.find(current) == srcDestPoints->top.end());
+        } while (!srcDestPoints->isTop(current));
 
         return vec;
     }
@@ -569,16 +617,73 @@ namespace enblend
     }
 
 
+    // Open set of the A* search.  The heap storage survives from one
+    // sub-cut to the next together with the list of all nodes the
+    // search has opened, which lets the caller undo exactly the changes
+    // to the graph image instead of copying all of it.
+    class OpenSet
+    {
+    public:
+        OpenSet() {}
+
+        bool empty() const {return heap.empty();}
+
+        // Answer the number of nodes opened since the last clear().
+        std::size_t size() const {return opened.size();}
+
+        void clear()
+        {
+            heap.clear();
+            opened.clear();
+        }
+
+        template <class Compare>
+        void push(const vigra::Point2D& p, const Compare& compare)
+        {
+            heap.push_back(p);
+            std::push_heap(heap.begin(), heap.end(), compare);
+            opened.push_back(p);
+        }
+
+        template <class Compare>
+        vigra::Point2D pop(const Compare& compare)
+        {
+            std::pop_heap(heap.begin(), heap.end(), compare);
+            const vigra::Point2D top(heap.back());
+            heap.pop_back();
+            return top;
+        }
+
+        // Reset all nodes opened since the last clear() to their
+        // values in pristine.
+        template <class ImageType>
+        void restore(const ImageType& pristine, ImageType* img) const
+        {
+            const vigra::Rect2D graph(0, 0, pristine.width() - 1, pristine.height() - 1);
+
+            for (auto p = opened.begin(); p != opened.end(); ++p) {
+                if (graph.contains(*p)) {
+                    (*img)[*p] = pristine[*p];
+                    (*img)[(*p)(1, 1)] = pristine[(*p)(1, 1)];
+                }
+            }
+        }
+
+    private:
+        std::vector<vigra::Point2D> heap;
+        std::vector<vigra::Point2D> opened;
+    };
+
+
     template <class ImageType, class GradientImageType, class MaskPixelType>
     std::vector<vigra::Point2D>*
     A_star(vigra::Point2D srcpt, vigra::Point2D destpt, ImageType* img,
            GradientImageType* gradientX, GradientImageType* gradientY,
-           vigra::Diff2D bounds, CheckpointPixels* srcDestPoints, std::unordered_set<vigra::Point2D, pointHash>* visited)
+           vigra::Diff2D bounds, const CheckpointPixels* srcDestPoints, const DensePointSet* visited,
+           OpenSet* openset)
     {
         MaskPixelType zeroVal = vigra::NumericTraits<MaskPixelType>::zero();
-        typedef std::priority_queue<vigra::Point2D, std::vector<vigra::Point2D>, CostComparer<ImageType> > Queue;
         CostComparer<ImageType> costcomp(img);
-        Queue* openset = new Queue(costcomp);
         long score = 0;
         long totalScore = 0;
         long iterCount = 0;
@@ -591,19 +696,18 @@ namespace enblend
         vigra::Point2D current;
         vigra::Point2D neighbour;
         vigra::Point2D destNeighbour;
-        std::unordered_set<vigra::Point2D, pointHash>::iterator auxListBegin;
-        std::unordered_set<vigra::Point2D, pointHash>::iterator auxListEnd;
-        openset->push(srcpt);
+        CheckpointPixels::point_list::const_iterator auxListBegin;
+        CheckpointPixels::point_list::const_iterator auxListEnd;
+        openset->clear();
+        openset->push(srcpt, costcomp);
 
         while (!openset->empty()) {
-            current = openset->top();
-            openset->pop();
+            current = openset->pop(costcomp);
             iterCount++;
             if (current == destpt) {
 #ifdef DEBUG_GRAPHCUT
                 std::cout << "Graphcut completed after visiting " << iterCount << " nodes" << std::endl;
 #endif
-                delete openset;
                 return tracePath<ImageType>(destNeighbour, img, srcDestPoints);
             }
 
@@ -622,7 +726,7 @@ namespace enblend
 
                     //visited during an earlier sub-cut, ignore
 
-                    if(visited->find(neighbour) != visited->end()) {
+                    if (visited->contains(neighbour)) {
                         continue;
                     }
 
@@ -677,13 +781,13 @@ namespace enblend
                             }
 
                             if (pushToList) {
-                                openset->push(neighbour);
+                                openset->push(neighbour, costcomp);
                             }
                         }
                     }
                 }
             } else {
-                for (std::unordered_set<vigra::Point2D, pointHash>::iterator x = auxListBegin; x != auxListEnd; ++x) {
+                for (CheckpointPixels::point_list::const_iterator x = auxListBegin; x != auxListEnd; ++x) {
                     score = 0;
                     scoreIsBetter = false;
                     pushToList = false;
@@ -702,7 +806,7 @@ namespace enblend
                             (*img)[neighbour(1, 1)] &= BIT_MASK_OPEN;
                             (*img)[neighbour] = score;
                             if (pushToList) {
-                                openset->push(neighbour);
+                                openset->push(neighbour, costcomp);
                             }
                         }
                     }
@@ -712,7 +816,6 @@ namespace enblend
 #ifdef DEBUG_GRAPHCUT
         std::cout << "Graphcut failed after visiting " << iterCount << " nodes" << std::endl;
 #endif
-        delete openset;
         return new std::vector<vigra::Point2D>();
     }
 
@@ -725,8 +828,8 @@ namespace enblend
 
 
     void dividePath(std::vector<vigra::Point2D>* cut,
-                    std::unordered_set<vigra::Point2D, pointHash>* left,
-                    std::unordered_set<vigra::Point2D, pointHash>* right,
+                    DensePointSet* left,
+                    DensePointSet* right,
                     const vigra::Rect2D& iBB)
     {
         vigra::Point2D previous;
@@ -1211,7 +1314,8 @@ namespace enblend
     processCutResults(MaskImageIterator mask1_upperleft, MaskImageIterator mask1_lowerright, MaskAccessor ma1,
                       MaskImageIterator mask2_upperleft, MaskAccessor ma2,
                       DestImageIterator dest_upperleft, DestAccessor da,
-                      std::vector<vigra::Point2D>& totalDualPath, const vigra::Rect2D& iBB)
+                      std::vector<vigra::Point2D>& totalDualPath, const vigra::Rect2D& iBB,
+                      const IMAGETYPE<OverlapPixelType>& overlapFlags)
     {
         const vigra::Diff2D size(iBB.lowerRight().x - iBB.upperLeft().x,
                                  iBB.lowerRight().y - iBB.upperLeft().y);
@@ -1223,8 +1327,10 @@ namespace enblend
         typedef vigra::NumericTraits<BasePixelType> BasePixelTraits;
         typedef vigra::NumericTraits<MaskPixelType> MaskPixelTraits;
 
-        std::unordered_set<vigra::Point2D, pointHash> pixelsLeftOfCut;
-        std::unordered_set<vigra::Point2D, pointHash> pixelsRightOfCut;
+        // Only points inside of this rectangle are ever queried.
+        const vigra::Rect2D labelBB(vigra::Point2D(-1, -1), vigra::Point2D(size));
+        DensePointSet pixelsLeftOfCut(labelBB);
+        DensePointSet pixelsRightOfCut(labelBB);
 
         dividePath(&totalDualPath, &pixelsLeftOfCut, &pixelsRightOfCut, iBB);
 
@@ -1280,11 +1386,10 @@ namespace enblend
         exportImage(finalmaskSrcRange, ImageExportInfo("./debug/process_cut_4_final_precopy.tif").setPixelType("UINT8"));
 #endif
 
-        vigra::omp::combineTwoImages(vigra_ext::apply(iBB, vigra::srcIterRange(mask1_upperleft, mask1_lowerright, ma1)),
-                                     vigra_ext::apply(iBB, vigra::srcIter(mask2_upperleft, ma2)), destImage(tempImg),
-                                     ifThenElse(Arg1() && Arg2(),
-                                                Param(MaskPixelTraits::max()),
-                                                Param(MaskPixelTraits::zero())));
+        vigra::omp::transformImage(srcImageRange(overlapFlags), destImage(tempImg),
+                                   ifThenElse(Arg1() == Param(OverlapPixelType(OVERLAP_BOTH)),
+                                              Param(MaskPixelTraits::max()),
+                                              Param(MaskPixelTraits::zero())));
 
         vigra::copyImageIf(finalmaskSrcRange, srcImage(tempImg),
                            vigra::destIter(dest_upperleft + iBB.upperLeft(), da));
@@ -1334,6 +1439,7 @@ namespace enblend
 #endif
 
         IMAGETYPE<BasePixelType> intermediateImg(size);
+        IMAGETYPE<OverlapPixelType> overlapFlags(size);
         IMAGETYPE<BasePromotePixelType> intermediateGraphImg(size + size + vigra::Diff2D(1, 1));
         IMAGETYPE<BasePromotePixelType> gradientPreConvolve(size);
         IMAGETYPE<GradientPixelType> gradientX(size);
@@ -1360,16 +1466,10 @@ namespace enblend
         gradientKernel.initSymmetricGradient();
 
         // gradient images calculation
-        transformImage(src1_upperleft, src1_lowerright, sa1,
-                       gradientPreConvolve.upperLeft(), gradientPreConvolve.accessor(),
-                       MapFunctor<SrcPixelType, BasePixelType>());
-        transformImage(src2_upperleft, src2_upperleft + size, sa2,
-                       intermediateImg.upperLeft(), intermediateImg.accessor(),
-                       MapFunctor<SrcPixelType, BasePixelType>());
-        vigra::omp::combineTwoImages(srcImageRange(gradientPreConvolve),
-                                     srcImage(intermediateImg),
-                                     destImage(gradientPreConvolve),
-                                     Arg1() + Arg2());
+        vigra::omp::combineTwoImages(src1_upperleft, src1_lowerright, sa1,
+                                     src2_upperleft, sa2,
+                                     gradientPreConvolve.upperLeft(), gradientPreConvolve.accessor(),
+                                     MappedSumFunctor<SrcPixelType, BasePixelType, BasePromotePixelType>());
 
         // computing image gradient for a better cost function
         vigra::separableConvolveX(srcImageRange(gradientPreConvolve),
@@ -1379,40 +1479,40 @@ namespace enblend
                                   destImage(gradientY),
                                   vigra::kernel1d(gradientKernel));
 
-        // difference image calculation
+        // difference image calculation, where the overlap region
+        // borders get maximum cost
         switch (PixelDifferenceFunctor)
         {
         case HueLuminanceMaxDifference:
-            vigra::omp::combineTwoImages(src1_upperleft, src1_lowerright, sa1,
-                                         src2_upperleft, sa2,
-                                         intermediateImg.upperLeft(), intermediateImg.accessor(),
-                                         MaxHueLuminanceDifferenceFunctor<SrcPixelType, BasePixelType>
-                                         (LuminanceDifferenceWeight, ChrominanceDifferenceWeight));
+            analyzeOverlap(src1_upperleft, src1_lowerright, sa1,
+                           src2_upperleft, sa2,
+                           vigra_ext::apply(iBB, vigra::srcIter(mask1_upperleft, ma1)),
+                           vigra_ext::apply(iBB, vigra::srcIter(mask2_upperleft, ma2)),
+                           vigra::destImage(intermediateImg),
+                           vigra::destImage(overlapFlags),
+                           MaxHueLuminanceDifferenceFunctor<SrcPixelType, BasePixelType>
+                           (LuminanceDifferenceWeight, ChrominanceDifferenceWeight));
             break;
         case DeltaEDifference:
-            vigra::omp::combineTwoImages(src1_upperleft, src1_lowerright, sa1,
-                                         src2_upperleft, sa2,
-                                         intermediateImg.upperLeft(), intermediateImg.accessor(),
-                                         DeltaEPixelDifferenceFunctor<SrcPixelType, BasePixelType>
-                                         (LuminanceDifferenceWeight, ChrominanceDifferenceWeight));
+            analyzeOverlap(src1_upperleft, src1_lowerright, sa1,
+                           src2_upperleft, sa2,
+                           vigra_ext::apply(iBB, vigra::srcIter(mask1_upperleft, ma1)),
+                           vigra_ext::apply(iBB, vigra::srcIter(mask2_upperleft, ma2)),
+                           vigra::destImage(intermediateImg),
+                           vigra::destImage(overlapFlags),
+                           DeltaEPixelDifferenceFunctor<SrcPixelType, BasePixelType>
+                           (LuminanceDifferenceWeight, ChrominanceDifferenceWeight));
             break;
         default:
             NEVER_REACHED("switch control expression \"PixelDifferenceFunctor\" out of range");
         }
 
-        // masking overlap region borders
-        vigra::omp::combineThreeImages(vigra_ext::apply(iBB, vigra::srcIterRange(mask1_upperleft, mask1_lowerright, ma1)),
-                                       vigra_ext::apply(iBB, vigra::srcIter(mask2_upperleft, ma2)),
-                                       vigra::srcIter(intermediateImg.upperLeft(), intermediateImg.accessor()),
-                                       vigra::destIter(intermediateImg.upperLeft(), intermediateImg.accessor()),
-                                       ifThenElse(!(Arg1() & Arg2()), Param(BasePixelTraits::max()), Arg3()));
-
         // look for possible start and end points
         std::vector<vigra::Point2D>* intermediatePointList =
             findIntermediatePoints<MaskImageIterator, MaskAccessor, BasePixelType>
             (mask1_upperleft, mask1_lowerright, ma1,
              mask2_upperleft, ma2, dest_upperleft, da,
-             norm, boundary, iBB);
+             norm, boundary, iBB, overlapFlags);
 
         // in case something goes wrong with start/end point finding, returns regular nft image
         if (intermediatePointList->empty()) {
@@ -1440,10 +1540,18 @@ namespace enblend
         exportImage(srcImageRange(graphImg), ImageExportInfo("./debug/graph.tif").setPixelType("UINT8"));
 #endif
 
-        // a set of points to keep visited points for subsequent graph-cut runs
-        std::unordered_set<vigra::Point2D, pointHash> visited;
+        timer::WallClock wall_clock;
+        wall_clock.start();
 
-        // find optimal cuts in dual graph
+        // a set of points to keep visited points for subsequent graph-cut runs
+        DensePointSet visited(vigra::Rect2D(vigra::Point2D(0, 0), vigra::Size2D(graphsize)));
+        OpenSet openset;
+        unsigned subCuts = 0U;
+        std::size_t openedNodes = 0U;
+
+        // find optimal cuts in dual graph; each sub-cut must steer clear
+        // of the paths of all its predecessors, which forces them to run
+        // one after the other
         for (std::vector<vigra::Point2D>::iterator i = intermediatePointList->begin();
              i != intermediatePointList->end();
              ++i) {
@@ -1453,8 +1561,8 @@ namespace enblend
             }
 
             srcDestPoints.clear();
-            srcDestPoints.top.insert(intermediatePoint);
-            srcDestPoints.bottom.insert(*i);
+            srcDestPoints.top.push_back(intermediatePoint);
+            srcDestPoints.bottom.push_back(*i);
 
 #ifdef DEBUG_GRAPHCUT
             std::cout << "Running graph-cut: " << intermediatePoint << ":" << *i << std::endl;
@@ -1462,8 +1570,10 @@ namespace enblend
 
             dualPath = A_star<IMAGETYPE<GraphPixelType>, IMAGETYPE<GradientPixelType>, BasePixelType>
                 (vigra::Point2D(-10, -10), vigra::Point2D(-20, -20), &intermediateGraphImg, &gradientX,
-                 &gradientY, graphsize - vigra::Diff2D(1, 1), &srcDestPoints, &visited);
+                 &gradientY, graphsize - vigra::Diff2D(1, 1), &srcDestPoints, &visited, &openset);
 
+            ++subCuts;
+            openedNodes += openset.size();
             visited.insert(dualPath->begin(), dualPath->end());
 
             for (std::vector<vigra::Point2D>::reverse_iterator j = dualPath->rbegin(); j < dualPath->rend(); j++) {
@@ -1472,16 +1582,27 @@ namespace enblend
                 }
             }
 
-            vigra::copyImage(srcImageRange(graphImg), destImage(intermediateGraphImg));
+            delete dualPath;
+            openset.restore(graphImg, &intermediateGraphImg);
             intermediatePoint = *i;
         }
 
         processCutResults<DestImageIterator, DestAccessor, MaskImageIterator, MaskAccessor, MaskPixelType>
             (mask1_upperleft, mask1_lowerright, ma1, mask2_upperleft, ma2,
-             dest_upperleft, da, totalDualPath, iBB);
+             dest_upperleft, da, totalDualPath, iBB, overlapFlags);
+
+        wall_clock.stop();
+        if (parameter::time_graph_cut.value()) {
+            const std::ios::fmtflags flags(std::cerr.flags());
+            std::cerr <<
+                command << ": timing: wall-clock runtime of `Graph-Cut': " <<
+                std::setprecision(3) << 1000.0 * wall_clock.value() << " ms\n" <<
+                command << ": timing: " << subCuts << " sub-cuts opened " << openedNodes <<
+                 " nodes in a graph of size " << graphsize << std::endl;
+            std::cerr.flags(flags);
+        }
 
         delete intermediatePointList;
-        delete dualPath;
     }
 } /* namespace enblend */
 
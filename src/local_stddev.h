@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2004-2009 Andrew Mihal
+ * Copyright (C) 2009-2017 Christoph Spiel
+ *
+ * This file is part of Enblend.
+ *
+ * Enblend is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Enblend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Enblend; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef LOCAL_STDDEV_H_INCLUDED
+#define LOCAL_STDDEV_H_INCLUDED
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <vigra/numerictraits.hxx>
+#include <vigra/utilities.hxx>
+
+
+
+namespace enblend {
+// Keep sum and sum-of-squares together for improved CPU-cache locality.
+template <typename T>
+struct ScratchPad {
+    ScratchPad() : sum(T()), sumSqr(T()), n(size_t()) {}
+
+    T sum;
+    T sumSqr;
+    size_t n;
+};
+
+
+template <class SrcIterator, class SrcAccessor,
+          class MaskIterator, class MaskAccessor,
+          class DestIterator, class DestAccessor>
+void localStdDevIf(SrcIterator src_ul, SrcIterator src_lr, SrcAccessor src_acc,
+                   MaskIterator mask_ul, MaskAccessor mask_acc,
+                   DestIterator dest_ul, DestAccessor dest_acc,
+                   vigra::Size2D size)
+{
+    typedef typename vigra::NumericTraits<typename SrcAccessor::value_type>::RealPromote SrcSumType;
+    typedef vigra::NumericTraits<typename DestAccessor::value_type> DestTraits;
+    typedef ScratchPad<SrcSumType> ScratchPadType;
+    typedef std::vector<ScratchPadType> ScratchPadArray;
+    typedef typename ScratchPadArray::iterator ScratchPadArrayIterator;
+
+    vigra_precondition(size.x > 1 && size.y > 1,
+                       "localStdDevIf(): window for local variance must be at least 2x2");
+    vigra_precondition(src_lr.x - src_ul.x >= size.x &&
+                       src_lr.y - src_ul.y >= size.y,
+                       "localStdDevIf(): window larger than image");
+
+    const typename SrcIterator::difference_type imageSize = src_lr - src_ul;
+    ScratchPadArray scratchPad(imageSize.x + 1);
+
+    const vigra::Diff2D border(size.x / 2, size.y / 2);
+    const vigra::Diff2D nextUpperRight(size.x / 2 + 1, -size.y / 2);
+
+    SrcIterator const srcEnd(src_lr - border);
+    SrcIterator const srcEndXm1(srcEnd - vigra::Diff2D(1, 0));
+
+    // For each row in the source image...
+#ifdef OPENMP
+#pragma omp parallel for firstprivate (scratchPad)
+#endif
+    for (int row = 0; row < imageSize.y - 2 * border.y; ++row)
+    {
+        SrcIterator srcRow(src_ul + border + vigra::Diff2D(0, row));
+        MaskIterator maskRow(mask_ul + border + vigra::Diff2D(0, row));
+        DestIterator destRow(dest_ul + border + vigra::Diff2D(0, row));
+
+        // Row's running values
+        SrcSumType sum = vigra::NumericTraits<SrcSumType>::zero();
+        SrcSumType sumSqr = vigra::NumericTraits<SrcSumType>::zero();
+        size_t n = 0;
+
+        SrcIterator const windowSrcUpperLeft(srcRow - border);
+        SrcIterator const windowSrcLowerRight(srcRow + border);
+        SrcIterator windowSrc;
+        MaskIterator const windowMaskUpperLeft(maskRow - border);
+        MaskIterator windowMask;
+        ScratchPadArrayIterator spCol;
+
+        // Initialize running-sums of this row
+        for (windowSrc = windowSrcUpperLeft, windowMask = windowMaskUpperLeft,
+                 spCol = scratchPad.begin();
+             windowSrc.x <= windowSrcLowerRight.x;
+             ++windowSrc.x, ++windowMask.x, ++spCol)
+        {
+            SrcSumType sumInit = vigra::NumericTraits<SrcSumType>::zero();
+            SrcSumType sumSqrInit = vigra::NumericTraits<SrcSumType>::zero();
+            size_t nInit = 0;
+
+            for (windowSrc.y = windowSrcUpperLeft.y, windowMask.y = windowMaskUpperLeft.y;
+                 windowSrc.y <= windowSrcLowerRight.y;
+                 ++windowSrc.y, ++windowMask.y)
+            {
+                if (mask_acc(windowMask))
+                {
+                    const SrcSumType value = src_acc(windowSrc);
+                    sumInit += value;
+                    sumSqrInit += value * value;
+                    ++nInit;
+                }
+            }
+
+            // Set scratch pad's column-wise values
+            spCol->sum = sumInit;
+            spCol->sumSqr = sumSqrInit;
+            spCol->n = nInit;
+
+            // Update totals
+            sum += sumInit;
+            sumSqr += sumSqrInit;
+            n += nInit;
+        }
+
+        // Write one row of results
+        SrcIterator srcCol(srcRow);
+        MaskIterator maskCol(maskRow);
+        DestIterator destCol(destRow);
+        ScratchPadArrayIterator old(scratchPad.begin());
+        ScratchPadArrayIterator next(scratchPad.begin() + size.x);
+
+        while (true)
+        {
+            // Compute standard deviation
+            if (mask_acc(maskCol))
+            {
+                const SrcSumType result =
+                    n <= 1 ?
+                    vigra::NumericTraits<SrcSumType>::zero() :
+                    sqrt((sumSqr - sum * sum / n) / (n - 1));
+                dest_acc.set(DestTraits::fromRealPromote(result), destCol);
+            }
+            if (srcCol.x == srcEndXm1.x)
+            {
+                break;
+            }
+
+            // Compute auxilliary values of next column
+            SrcSumType sumInit = vigra::NumericTraits<SrcSumType>::zero();
+            SrcSumType sumSqrInit = vigra::NumericTraits<SrcSumType>::zero();
+            size_t nInit = 0;
+
+            for (windowSrc = srcCol + nextUpperRight, windowMask = maskCol + nextUpperRight;
+                 windowSrc.y <= windowSrcLowerRight.y;
+                 ++windowSrc.y, ++windowMask.y)
+            {
+                if (mask_acc(windowMask))
+                {
+                    const SrcSumType value = src_acc(windowSrc);
+                    sumInit += value;
+                    sumSqrInit += value * value;
+                    ++nInit;
+                }
+            }
+
+            // Set sums of next column
+            next->sum = sumInit;
+            next->sumSqr = sumSqrInit;
+            next->n = nInit;
+
+            // Update totals
+            sum += sumInit - old->sum;
+            sumSqr += sumSqrInit - old->sumSqr;
+            n += nInit - old->n;
+
+            // Advance to next column
+            ++srcCol.x;
+            ++maskCol.x;
+            ++destCol.x;
+            ++old;
+            ++next;
+        }
+    }
+}
+
+
+/** Compute the same local standard deviation as localStdDevIf() with
+ *  summed-area tables, which makes the cost per pixel independent of
+ *  the window size.
+ *
+ *  The variance comes out of E[x^2] - E[x]^2, which cancels badly if
+ *  the sums lose precision.  Therefore the tables always accumulate
+ *  in double, even for float images.  For non-integral input every
+ *  tile subtracts one of its own pixel values from all its samples,
+ *  which leaves the variance unchanged but keeps the sums small.
+ *
+ *  One table of the whole image would need sums with magnitudes far
+ *  beyond the precision of double.  So we cut the result into tiles
+ *  of at most tileSize x tileSize pixels and build one table per tile
+ *  plus its window border.  For integral input up to 16 bits all sums
+ *  are exact and so is the result.  Tiles are independent, which lets
+ *  us parallelize over them.
+ */
+template <class SrcIterator, class SrcAccessor,
+          class MaskIterator, class MaskAccessor,
+          class DestIterator, class DestAccessor>
+void localStdDevIntegralIf(SrcIterator src_ul, SrcIterator src_lr, SrcAccessor src_acc,
+                           MaskIterator mask_ul, MaskAccessor mask_acc,
+                           DestIterator dest_ul, DestAccessor dest_acc,
+                           vigra::Size2D size,
+                           int tileSize = 256)
+{
+    typedef typename SrcAccessor::value_type SrcPixelType;
+    typedef vigra::NumericTraits<typename DestAccessor::value_type> DestTraits;
+    typedef ScratchPad<double> ScratchPadType;
+    typedef std::vector<ScratchPadType> ScratchPadArray;
+
+    vigra_precondition(size.x > 1 && size.y > 1,
+                       "localStdDevIntegralIf(): window for local variance must be at least 2x2");
+    vigra_precondition(src_lr.x - src_ul.x >= size.x &&
+                       src_lr.y - src_ul.y >= size.y,
+                       "localStdDevIntegralIf(): window larger than image");
+    vigra_precondition(tileSize > 0,
+                       "localStdDevIntegralIf(): tile size must be positive");
+
+    const typename SrcIterator::difference_type imageSize = src_lr - src_ul;
+    const vigra::Diff2D border(size.x / 2, size.y / 2);
+    const vigra::Diff2D window(2 * border.x + 1, 2 * border.y + 1);
+
+    // Interior of the image, where the window fits
+    const vigra::Diff2D interior(imageSize.x - 2 * border.x, imageSize.y - 2 * border.y);
+    const int tilesX = (interior.x + tileSize - 1) / tileSize;
+    const int tilesY = (interior.y + tileSize - 1) / tileSize;
+
+    // The table has a leading row and column of zeros.
+    const int tableWidth = std::min(tileSize, interior.x) + window.x;
+    ScratchPadArray table(static_cast<size_t>(tableWidth) *
+                          static_cast<size_t>(std::min(tileSize, interior.y) + window.y));
+
+#ifdef OPENMP
+#pragma omp parallel for firstprivate (table) schedule(dynamic)
+#endif
+    for (int tile = 0; tile < tilesX * tilesY; ++tile)
+    {
+        // Upper left corner of the tile in image coordinates
+        const vigra::Diff2D tileOrigin(border.x + (tile % tilesX) * tileSize,
+                                       border.y + (tile / tilesX) * tileSize);
+        const vigra::Diff2D tileSize2D(std::min(tileSize, border.x + interior.x - tileOrigin.x),
+                                       std::min(tileSize, border.y + interior.y - tileOrigin.y));
+        const vigra::Diff2D tableSize(tileSize2D + window);
+
+        // Build the summed-area table of the tile and its border.
+        const double shift =
+            vigra::NumericTraits<SrcPixelType>::isIntegral::asBool ? 0.0 : src_acc(src_ul + tileOrigin);
+        std::fill(table.begin(), table.begin() + tableSize.x, ScratchPadType());
+        SrcIterator srcRow(src_ul + tileOrigin - border);
+        MaskIterator maskRow(mask_ul + tileOrigin - border);
+        for (int y = 1; y < tableSize.y; ++y, ++srcRow.y, ++maskRow.y)
+        {
+            ScratchPadType* const above = &table[(y - 1) * tableWidth];
+            ScratchPadType* const current = &table[y * tableWidth];
+            ScratchPadType rowSum;
+
+            current[0] = ScratchPadType();
+            SrcIterator srcCol(srcRow);
+            MaskIterator maskCol(maskRow);
+            for (int x = 1; x < tableSize.x; ++x, ++srcCol.x, ++maskCol.x)
+            {
+                if (mask_acc(maskCol))
+                {
+                    const double value = static_cast<double>(src_acc(srcCol)) - shift;
+                    rowSum.sum += value;
+                    rowSum.sumSqr += value * value;
+                    ++rowSum.n;
+                }
+                current[x].sum = above[x].sum + rowSum.sum;
+                current[x].sumSqr = above[x].sumSqr + rowSum.sumSqr;
+                current[x].n = above[x].n + rowSum.n;
+            }
+        }
+
+        // Write the results of the tile
+        MaskIterator maskY(mask_ul + tileOrigin);
+        DestIterator destY(dest_ul + tileOrigin);
+        for (int y = 0; y < tileSize2D.y; ++y, ++maskY.y, ++destY.y)
+        {
+            const ScratchPadType* const top = &table[y * tableWidth];
+            const ScratchPadType* const bottom = &table[(y + window.y) * tableWidth];
+
+            MaskIterator maskX(maskY);
+            DestIterator destX(destY);
+            for (int x = 0; x < tileSize2D.x; ++x, ++maskX.x, ++destX.x)
+            {
+                if (mask_acc(maskX))
+                {
+                    const int right = x + window.x;
+                    const size_t n = bottom[right].n - bottom[x].n - top[right].n + top[x].n;
+                    double result = 0.0;
+                    if (n > 1)
+                    {
+                        const double sum = bottom[right].sum - bottom[x].sum - top[right].sum + top[x].sum;
+                        const double sumSqr =
+                            bottom[right].sumSqr - bottom[x].sumSqr - top[right].sumSqr + top[x].sumSqr;
+                        const double variance = (sumSqr - sum * sum / n) / (n - 1);
+                        // Only rounding errors can make the variance negative.
+                        if (variance > 0.0)
+                        {
+                            result = sqrt(variance);
+                        }
+                    }
+                    dest_acc.set(DestTraits::fromRealPromote(result), destX);
+                }
+            }
+        }
+    }
+}
+
+
+template <typename SrcIterator, typename SrcAccessor,
+          typename MaskIterator, typename MaskAccessor,
+          typename DestIterator, typename DestAccessor>
+inline void
+localStdDevIf(vigra::triple<SrcIterator, SrcIterator, SrcAccessor> src,
+              vigra::pair<MaskIterator, MaskAccessor> mask,
+              vigra::pair<DestIterator, DestAccessor> dest,
+              vigra::Size2D size)
+{
+    localStdDevIf(src.first, src.second, src.third,
+                  mask.first, mask.second,
+                  dest.first, dest.second,
+                  size);
+}
+} // namespace enblend
+
+
+#endif /* LOCAL_STDDEV_H_INCLUDED */
+
+
+// Local Variables:
+// mode: c++
+// End:
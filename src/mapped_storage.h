@@ -0,0 +1,525 @@
+/*
+ * Copyright (C) 2009-2017 Christoph Spiel
+ *
+ * This file is part of Enblend.
+ *
+ * Enblend is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Enblend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Enblend; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MAPPED_STORAGE_H_INCLUDED_
+#define MAPPED_STORAGE_H_INCLUDED_
+
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <new>
+#include <string>
+
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MKSTEMP) && defined(HAVE_UNISTD_H)
+#include <fcntl.h>      // posix_fallocate()
+#include <sys/mman.h>   // mmap(), munmap(), madvise()
+#include <unistd.h>     // close(), ftruncate(), sysconf(), unlink()
+#define MAPPED_STORAGE_AVAILABLE 1
+#endif
+
+#include <vigra/basicimage.hxx>
+
+#include "common.h"
+#include "openmp_lock.h"
+#include "parameter.h"
+
+
+extern const std::string command;
+
+
+// Out-of-core storage for large images.
+//
+// Canvas-sized images and the lower levels of the blending pyramids
+// dominate the memory footprint of both Enblend and Enfuse.  When the
+// user sets parameter "mapped-storage-directory", every allocation of
+// at least "mapped-storage-threshold" bytes that would push the total
+// of such large heap allocations beyond "mapped-storage-budget" gets
+// backed by an unlinked scratch file in that directory, which we map
+// into memory.  The operating system then pages the image in and out
+// on demand instead of the whole process hitting the swap file.
+//
+// vigra::BasicImage needs its pixels in one contiguous, row-major
+// block, so we cannot rearrange them in square tiles.  Instead, the
+// unit of paging is a band of "mapped-storage-tile-rows" full image
+// rows.  The pyramid code, which scans images strictly top to bottom,
+// calls a row_prefetcher once per row; at every band boundary we ask the
+// kernel to read ahead the next band and to deprioritize the band
+// just left behind.
+//
+// Without "mapped-storage-directory" the allocator degenerates to
+// std::allocator and row_prefetcher to a single relaxed atomic load
+// per scan.
+
+
+namespace mapped_storage
+{
+    struct configuration
+    {
+        std::string directory;
+        std::size_t budget;
+        std::size_t threshold;
+        std::size_t tile_rows;
+
+        bool enabled() const {return !directory.empty();}
+    }; // struct configuration
+
+
+    inline const configuration&
+    get_configuration()
+    {
+        static const configuration config {
+            parameter::mapped_storage_directory.value(),
+            static_cast<std::size_t>(enblend::byteSizeOfString(parameter::mapped_storage_budget.value().c_str())),
+            static_cast<std::size_t>(enblend::byteSizeOfString(parameter::mapped_storage_threshold.value().c_str())),
+            std::max(1U, parameter::mapped_storage_tile_rows.value())
+        };
+
+#ifndef MAPPED_STORAGE_AVAILABLE
+        static bool warned = false;
+        if (config.enabled() && !warned)
+        {
+            warned = true;
+            std::cerr << command << ": warning: memory-mapped image storage is not available on this platform;\n"
+                      << command << ": warning:     ignoring parameter \"mapped-storage-directory\"" << std::endl;
+        }
+#endif
+
+        return config;
+    }
+
+
+    namespace detail
+    {
+        struct mapping
+        {
+            std::size_t size;
+            int descriptor;
+        }; // struct mapping
+
+
+        class registry
+        {
+        public:
+            typedef std::map<const char*, mapping> map_type;
+
+            registry() : heap_bytes_(0U), mapping_count_(0U) {}
+
+            registry(const registry&) = delete;
+            registry& operator=(const registry&) = delete;
+
+            omp::lock& lock() {return lock_;}
+            std::size_t& heap_bytes() {return heap_bytes_;}
+
+            // Cheap check for row_prefetcher, which must not take the
+            // lock when nothing is mapped at all.
+            bool has_mappings() const {return mapping_count_.load(std::memory_order_relaxed) != 0U;}
+
+            void insert(const char* a_base, const mapping& a_mapping)
+            {
+                mappings_.insert(map_type::value_type(a_base, a_mapping));
+                mapping_count_.fetch_add(1U, std::memory_order_relaxed);
+            }
+
+            bool erase(const char* a_base, mapping& a_mapping)
+            {
+                map_type::iterator m = mappings_.find(a_base);
+                if (m == mappings_.end())
+                {
+                    return false;
+                }
+                a_mapping = m->second;
+                mappings_.erase(m);
+                mapping_count_.fetch_sub(1U, std::memory_order_relaxed);
+                return true;
+            }
+
+            // Answer the mapping that contains a_pointer or nullptr.
+            const map_type::value_type* find(const char* a_pointer) const
+            {
+                map_type::const_iterator m = mappings_.upper_bound(a_pointer);
+                if (m == mappings_.begin())
+                {
+                    return nullptr;
+                }
+                --m;
+                return a_pointer < m->first + m->second.size ? &*m : nullptr;
+            }
+
+        private:
+            omp::lock lock_;
+            map_type mappings_;
+            std::size_t heap_bytes_;   // bytes of large allocations currently on the heap
+            std::atomic<std::size_t> mapping_count_;
+        }; // class registry
+
+
+        inline registry&
+        get_registry()
+        {
+            static registry the_registry;
+            return the_registry;
+        }
+
+
+#ifdef MAPPED_STORAGE_AVAILABLE
+        inline std::size_t
+        page_size()
+        {
+            static const std::size_t size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            return size;
+        }
+
+
+        // Create an anonymous scratch file of a_size bytes and map it.
+        // Answer nullptr if anything goes wrong; the caller then falls
+        // back to the heap.
+        inline char*
+        map_scratch_file(const std::string& a_directory, std::size_t a_size, int& a_descriptor)
+        {
+            std::string name(a_directory + "/enblend-mapped-XXXXXX");
+            const int descriptor = mkstemp(&name[0]);
+            if (descriptor == -1)
+            {
+                std::cerr << command << ": warning: cannot create scratch file in \"" << a_directory << "\": "
+                          << enblend::errorMessage(errno) << std::endl;
+                return nullptr;
+            }
+            unlink(name.c_str());
+
+#ifdef HAVE_POSIX_FALLOCATE
+            // Reserve the blocks now: a sparse file could run out of
+            // disk space while we write the image, which would kill us
+            // with SIGBUS instead of a proper error.
+            const int status = posix_fallocate(descriptor, 0, static_cast<off_t>(a_size));
+#else
+            const int status = ftruncate(descriptor, static_cast<off_t>(a_size)) == 0 ? 0 : errno;
+#endif
+            if (status != 0)
+            {
+                std::cerr << command << ": warning: cannot extend scratch file to " << a_size << " bytes: "
+                          << enblend::errorMessage(status) << std::endl;
+                close(descriptor);
+                return nullptr;
+            }
+
+            void* base = mmap(nullptr, a_size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+            if (base == MAP_FAILED)
+            {
+                std::cerr << command << ": warning: cannot map scratch file: "
+                          << enblend::errorMessage(errno) << std::endl;
+                close(descriptor);
+                return nullptr;
+            }
+
+            madvise(base, a_size, MADV_SEQUENTIAL);
+            a_descriptor = descriptor;
+
+            return static_cast<char*>(base);
+        }
+#endif // MAPPED_STORAGE_AVAILABLE
+
+
+        inline void*
+        allocate(std::size_t a_size)
+        {
+            const configuration& config = get_configuration();
+
+            if (!config.enabled() || a_size < config.threshold)
+            {
+                return ::operator new(a_size);
+            }
+
+            registry& the_registry = get_registry();
+            bool within_budget;
+            {
+                omp::scoped_lock<omp::lock> guard(the_registry.lock());
+                within_budget = the_registry.heap_bytes() + a_size <= config.budget;
+                if (within_budget)
+                {
+                    the_registry.heap_bytes() += a_size;
+                }
+            }
+
+            if (within_budget)
+            {
+                try
+                {
+                    return ::operator new(a_size);
+                }
+                catch (std::bad_alloc&)
+                {
+                    omp::scoped_lock<omp::lock> guard(the_registry.lock());
+                    the_registry.heap_bytes() -= a_size;
+                    throw;
+                }
+            }
+
+#ifdef MAPPED_STORAGE_AVAILABLE
+            int descriptor;
+            char* base = map_scratch_file(config.directory, a_size, descriptor);
+            if (base != nullptr)
+            {
+                omp::scoped_lock<omp::lock> guard(the_registry.lock());
+                the_registry.insert(base, mapping {a_size, descriptor});
+                return base;
+            }
+#endif
+
+            // Over budget, but mapping is unavailable or failed: the
+            // heap is our last resort.
+            omp::scoped_lock<omp::lock> guard(the_registry.lock());
+            the_registry.heap_bytes() += a_size;
+            return ::operator new(a_size);
+        }
+
+
+        inline void
+        deallocate(void* a_pointer, std::size_t a_size)
+        {
+            const configuration& config = get_configuration();
+
+            if (!config.enabled() || a_size < config.threshold)
+            {
+                ::operator delete(a_pointer);
+                return;
+            }
+
+            registry& the_registry = get_registry();
+            mapping a_mapping;
+            bool is_mapped;
+            {
+                omp::scoped_lock<omp::lock> guard(the_registry.lock());
+                is_mapped = the_registry.erase(static_cast<const char*>(a_pointer), a_mapping);
+                if (!is_mapped)
+                {
+                    the_registry.heap_bytes() -= a_size;
+                }
+            }
+
+            if (!is_mapped)
+            {
+                ::operator delete(a_pointer);
+                return;
+            }
+
+#ifdef MAPPED_STORAGE_AVAILABLE
+            munmap(a_pointer, a_mapping.size);
+            close(a_mapping.descriptor);
+#endif
+        }
+
+
+        // The part of a scan that needs no lock: advise the kernel
+        // about the band around a_row of the mapping at a_base.
+        inline void
+        advise_row(const char* a_base, std::size_t a_size, std::size_t a_pitch, std::size_t a_band_size,
+                   const char* a_row)
+        {
+#ifdef MAPPED_STORAGE_AVAILABLE
+            // Act only on the first row of each band.
+            const std::size_t offset = static_cast<std::size_t>(a_row - a_base);
+            if (offset >= a_pitch && offset / a_band_size == (offset - a_pitch) / a_band_size)
+            {
+                return;
+            }
+
+            const std::size_t page_mask = ~(page_size() - 1U);
+            const std::size_t band_begin = offset - offset % a_band_size;
+            const std::size_t next_begin = band_begin + a_band_size;
+            if (next_begin < a_size)
+            {
+                const std::size_t begin = next_begin & page_mask;
+                const std::size_t end = std::min(a_size, next_begin + a_band_size);
+                madvise(const_cast<char*>(a_base) + begin, end - begin, MADV_WILLNEED);
+            }
+#ifdef MADV_COLD
+            if (band_begin >= a_band_size)
+            {
+                // Only whole pages that lie completely in the previous band.
+                const std::size_t begin = ((band_begin - a_band_size) + page_size() - 1U) & page_mask;
+                const std::size_t end = band_begin & page_mask;
+                if (begin < end)
+                {
+                    madvise(const_cast<char*>(a_base) + begin, end - begin, MADV_COLD);
+                }
+            }
+#endif
+#else
+            (void) a_base;
+            (void) a_size;
+            (void) a_pitch;
+            (void) a_band_size;
+            (void) a_row;
+#endif // MAPPED_STORAGE_AVAILABLE
+        }
+
+
+        // Answer the address of the pixel an_iterator points to, or
+        // nullptr for iterators not backed by a vigra::BasicImage,
+        // which carry no information we could exploit.
+        template <class iterator>
+        inline const char*
+        pixel_address(const iterator&)
+        {
+            return nullptr;
+        }
+
+        template <typename t>
+        inline const char*
+        pixel_address(const vigra::BasicImageIterator<t, t**>& an_iterator)
+        {
+            return reinterpret_cast<const char*>(&*an_iterator);
+        }
+
+        template <typename t>
+        inline const char*
+        pixel_address(const vigra::ConstBasicImageIterator<t, t**>& an_iterator)
+        {
+            return reinterpret_cast<const char*>(&*an_iterator);
+        }
+    } // namespace detail
+
+
+    // A standard allocator that places large blocks in memory-mapped
+    // scratch files according to the configuration above.
+    template <typename t>
+    class allocator
+    {
+    public:
+        typedef t value_type;
+        typedef t* pointer;
+        typedef const t* const_pointer;
+        typedef t& reference;
+        typedef const t& const_reference;
+        typedef std::size_t size_type;
+        typedef std::ptrdiff_t difference_type;
+
+        template <typename u>
+        struct rebind
+        {
+            typedef allocator<u> other;
+        };
+
+        allocator() noexcept {}
+        allocator(const allocator&) noexcept {}
+        template <typename u> allocator(const allocator<u>&) noexcept {}
+
+        pointer address(reference x) const noexcept {return &x;}
+        const_pointer address(const_reference x) const noexcept {return &x;}
+
+        size_type max_size() const noexcept {return std::numeric_limits<size_type>::max() / sizeof(t);}
+
+        pointer allocate(size_type n, const void* = nullptr)
+        {
+            if (n > max_size())
+            {
+                throw std::bad_alloc();
+            }
+            return static_cast<pointer>(detail::allocate(n * sizeof(t)));
+        }
+
+        void deallocate(pointer p, size_type n) {detail::deallocate(p, n * sizeof(t));}
+
+        void construct(pointer p, const t& x) {::new (static_cast<void*>(p)) t(x);}
+        void destroy(pointer p) {p->~t();}
+    }; // class allocator
+
+
+    template <typename t, typename u>
+    inline bool operator==(const allocator<t>&, const allocator<u>&) {return true;}
+
+    template <typename t, typename u>
+    inline bool operator!=(const allocator<t>&, const allocator<u>&) {return false;}
+
+
+    template <typename t>
+    using image = vigra::BasicImage<t, allocator<t> >;
+
+
+    // Hints for a top-to-bottom scan of an image.  We look up the
+    // mapping that holds the image and its row pitch once, when the
+    // scan starts, so that prefetching the rows of the scan neither
+    // takes the registry lock nor depends on the width of the region
+    // scanned.
+    class row_prefetcher
+    {
+    public:
+        template <class iterator>
+        row_prefetcher(const iterator& an_upper_left, int a_height) :
+            base_(nullptr), size_(0U), pitch_(0U), band_size_(0U)
+        {
+            const char* const first_row = detail::pixel_address(an_upper_left);
+            if (first_row == nullptr || a_height < 2 || !detail::get_registry().has_mappings())
+            {
+                return;
+            }
+
+            const char* const second_row = detail::pixel_address(an_upper_left + vigra::Diff2D(0, 1));
+            if (second_row <= first_row)
+            {
+                return;
+            }
+
+            detail::registry& the_registry = detail::get_registry();
+            omp::scoped_lock<omp::lock> guard(the_registry.lock());
+            const detail::registry::map_type::value_type* m = the_registry.find(first_row);
+            if (m != nullptr)
+            {
+                base_ = m->first;
+                size_ = m->second.size;
+                pitch_ = static_cast<std::size_t>(second_row - first_row);
+                band_size_ = get_configuration().tile_rows * pitch_;
+            }
+        }
+
+        // Hint that the scan has reached the row that an_iterator
+        // points into.
+        template <class iterator>
+        void operator()(const iterator& an_iterator) const
+        {
+            if (base_ != nullptr)
+            {
+                detail::advise_row(base_, size_, pitch_, band_size_, detail::pixel_address(an_iterator));
+            }
+        }
+
+    private:
+        const char* base_;
+        std::size_t size_;
+        std::size_t pitch_;
+        std::size_t band_size_;
+    }; // class row_prefetcher
+} // namespace mapped_storage
+
+
+#endif // MAPPED_STORAGE_H_INCLUDED_
+
+// Local Variables:
+// mode: c++
+// End:
@@ -25,9 +25,11 @@
 #include <config.h>
 #endif
 
+#include <algorithm>
 #include <iostream>
 #include <functional>
 #include <numeric>
+#include <vector>
 
 #include <vigra/contourcirculator.hxx>
 #include <vigra/error.hxx>
@@ -47,11 +49,13 @@
 #include "anneal.h"
 #include "muopt.h"
 #include "nearest.h"
+#include "overlap.h"
 #include "parameter.h"
 #include "path.h"
 #include "postoptimizer.h"
 #include "graphcut.h"
 #include "maskcommon.h"
+#include "masktiles.h"
 #include "masktypedefs.h"
 
 
@@ -493,11 +497,31 @@ fillContourScanLineActive(MaskType* mask, const Contour& contour, const vigra::D
 }
 
 
+template <typename MaskType>
+void
+fillContourScanLineBanded(MaskType* mask, const Contour& contour, const vigra::Diff2D& offset)
+{
+    typedef typename MaskType::PixelType MaskPixelType;
+    typedef typename MaskType::Accessor MaskAccessor;
+
+    const vigra::Size2D mask_size(mask->lowerRight() - mask->upperLeft());
+    std::vector<vigra::Point2D> polygon;
+
+    closedPolygonsOfContourSegments(mask_size, contour, std::back_inserter(polygon));
+
+    vigra_ext::fill_polygon_banded(mask->upperLeft() + offset, mask->lowerRight() + offset,
+                                   XorAccessor<MaskPixelType, MaskAccessor>(mask->accessor()),
+                                   polygon.begin(), polygon.end(),
+                                   ~MaskPixelType(),
+                                   static_cast<int>(parameter::polygon_filler_band_height.value()));
+}
+
+
 template <typename MaskType>
 void
 fillContour(MaskType* mask, const Contour& contour, const vigra::Diff2D& offset)
 {
-    const std::string routine_name(parameter::as_string("polygon-filler", "new-active"));
+    const std::string routine_name(parameter::polygon_filler.value());
 
 #ifdef DEBUG_POLYGON_FILL
     std::cout << "+ fillContour: mask offset = " << offset << "\n";
@@ -508,6 +532,11 @@ fillContour(MaskType* mask, const Contour& contour, const vigra::Diff2D& offset)
         std::cout << "+ fillContour: use fillContourScanLine polygon filler\n";
 #endif
         fillContourScanLine(mask, contour, offset);
+    } else if (routine_name == "banded") {
+#ifdef DEBUG_POLYGON_FILL
+        std::cout << "+ fillContour: use fillContourScanLineBanded polygon filler\n";
+#endif
+        fillContourScanLineBanded(mask, contour, offset);
     } else {
 #ifdef DEBUG_POLYGON_FILL
         std::cout << "+ fillContour: use fillContourScanLineActive polygon filler\n";
@@ -519,43 +548,38 @@ fillContour(MaskType* mask, const Contour& contour, const vigra::Diff2D& offset)
 
 template <typename MaskType>
 void
-maskBounds(MaskType* mask, const vigra::Rect2D& uBB, vigra::Rect2D& mBB)
+maskBounds(const MaskType* mask, const MaskTiles<MaskType>& tiles, const vigra::Rect2D& uBB, vigra::Rect2D& mBB)
 {
     typedef typename MaskType::PixelType MaskPixelType;
-    typedef typename MaskType::traverser MaskIteratorType;
 
     // Find the bounding box of the mask transition line and put it in mBB.
     // mBB starts out as empty rectangle.
     mBB = vigra::Rect2D(vigra::Point2D(mask->size()), vigra::Point2D(0, 0));
 
-    MaskIteratorType myPrev = mask->upperLeft();
-    MaskIteratorType my = mask->upperLeft() + vigra::Diff2D(0, 1);
-    MaskIteratorType mend = mask->lowerRight();
-    MaskIteratorType mxLeft = myPrev;
-    MaskIteratorType mx = myPrev + vigra::Diff2D(1, 0);
-
-    for (int x = 1; mx.x < mend.x; ++x, ++mx.x, ++mxLeft.x) {
-        if (*mxLeft != *mx) {
-            mBB |= vigra::Rect2D(x - 1, 0, x + 1, 1);
-        }
-    }
-    for (int y = 1; my.y < mend.y; ++y, ++my.y, ++myPrev.y) {
-        mxLeft = my;
-        mx = my + vigra::Diff2D(1, 0);
-        MaskIteratorType mxUpLeft = myPrev;
-        MaskIteratorType mxUp = myPrev + vigra::Diff2D(1, 0);
-
-        if (*mxUpLeft != *mxLeft) {
-            // Transition line is between mxUpLeft and mxLeft.
-            mBB |= vigra::Rect2D(0, y - 1, 1, y + 1);
-        }
-
-        for (int x = 1; mx.x < mend.x; ++x, ++mx.x, ++mxLeft.x, ++mxUp.x) {
-            if (*mxLeft != *mx) {
-                mBB |= vigra::Rect2D(x - 1, y, x + 1, y + 1);
+    // A transition between two pixels can only exist inside a
+    // non-uniform tile or across the edge of two tiles that do not
+    // agree.  Visit only those tiles.  Each pixel gets compared with
+    // its left and upper neighbor, which might lie in the adjacent
+    // tile.
+    for (int ty = 0; ty < tiles.tiles().y; ++ty) {
+        for (int tx = 0; tx < tiles.tiles().x; ++tx) {
+            if (tiles.isUniform(tx, ty) &&
+                (tx == 0 || tiles.agrees(tx, ty, vigra::Diff2D(-1, 0))) &&
+                (ty == 0 || tiles.agrees(tx, ty, vigra::Diff2D(0, -1)))) {
+                continue;
             }
-            if (*mxUp != *mx) {
-                mBB |= vigra::Rect2D(x, y - 1, x + 1, y + 1);
+
+            const vigra::Rect2D r(tiles.rect(tx, ty));
+            for (int y = r.top(); y < r.bottom(); ++y) {
+                for (int x = r.left(); x < r.right(); ++x) {
+                    const MaskPixelType m = (*mask)(x, y);
+                    if (x > 0 && (*mask)(x - 1, y) != m) {
+                        mBB |= vigra::Rect2D(x - 1, y, x + 1, y + 1);
+                    }
+                    if (y > 0 && (*mask)(x, y - 1) != m) {
+                        mBB |= vigra::Rect2D(x, y - 1, x + 1, y + 1);
+                    }
+                }
             }
         }
     }
@@ -656,15 +680,44 @@ vectorizeSeamLine(Contour& rawSegments,
     const MaskPixelType zero(vigra::NumericTraits<MaskPixelType>::zero());
     const MaskPixelType one(vigra::NumericTraits<MaskPixelType>::one());
 
-    const vigra::Rect2D border(1, 1, nftOutputImage->width() - 1, nftOutputImage->height() - 1);
-    MaskIteratorType my = nftOutputImage->upperLeft() + vigra::Diff2D(1, 1);
-    MaskIteratorType mend = nftOutputImage->lowerRight() + vigra::Diff2D(-1, -1);
+    const MaskPixelType white(vigra::NumericTraits<MaskPixelType>::max());
 
-    for (int y = 1; my.y < mend.y; ++y, ++my.y) {
-        MaskIteratorType mx = my;
+    const int width = nftOutputImage->width();
+    const int height = nftOutputImage->height();
+    const vigra::Rect2D border(1, 1, width - 1, height - 1);
+
+    // Look for the corners of white regions, that is white pixels
+    // with a black left neighbor, in parallel.  Walking around a
+    // region below only paints pixels with `one', which never creates
+    // a new corner, so it suffices to recheck these candidates in
+    // raster order.  Only this prescan runs in parallel: the contour
+    // tracer itself stays sequential, because it paints the regions it
+    // has visited into nftOutputImage and numbers the snakes in
+    // raster order.
+    std::vector<std::vector<int> > corners(std::max(height - 2, 0));
+
+#ifdef OPENMP
+#pragma omp parallel for schedule(guided)
+#endif
+    for (int y = 1; y < height - 1; ++y) {
         MaskPixelType lastColor = zero;
-        for (int x = 1; mx.x < mend.x; ++x, ++mx.x) {
-            if (*mx == vigra::NumericTraits<MaskPixelType>::max() && lastColor == zero) {
+        for (int x = 1; x < width - 1; ++x) {
+            const MaskPixelType color = (*nftOutputImage)(x, y);
+            if (color == white && lastColor == zero) {
+                corners[y - 1].push_back(x);
+            }
+            lastColor = color;
+        }
+    }
+
+    for (int y = 1; y < height - 1; ++y) {
+        for (std::vector<int>::const_iterator corner = corners[y - 1].begin();
+             corner != corners[y - 1].end();
+             ++corner) {
+            const int x = *corner;
+            const MaskIteratorType mx(nftOutputImage->upperLeft() + vigra::Diff2D(x, y));
+
+            if (*mx == white && (x == 1 || (*nftOutputImage)(x - 1, y) == zero)) {
                 // Found the corner of a previously unvisited white region.
                 // Create a Segment to hold the border of this region.
                 Segment* snake = new Segment();
@@ -738,8 +791,6 @@ vectorizeSeamLine(Contour& rawSegments,
                     delete snake;
                 }
             }
-
-            lastColor = *mx;
         }
     }
 }
@@ -925,6 +976,163 @@ round_to_nearest_div(int a_numerator, int a_denominator)
 }
 
 
+inline static int
+floor_div(int a_numerator, int a_denominator)
+{
+    const std::div_t result(std::div(a_numerator, a_denominator));
+
+    return result.rem < 0 ? result.quot - 1 : result.quot;
+}
+
+
+inline static bool
+lexicographic_less(const vigra::Point2D& a, const vigra::Point2D& b)
+{
+    return a.y < b.y || (a.y == b.y && a.x < b.x);
+}
+
+
+/** Re-route the optimized stretches of all seam lines in contours on
+ *  a grid of the given stride, which must be half the stride of the
+ *  grid the vertices currently sit on.  The search for each stretch
+ *  only looks at the pixels at most corridor grid steps off the
+ *  current seam, which is why its cost grows with the length of the
+ *  seam instead of the area of the overlap.
+ *
+ *  All vertices are uBB-relative, gridOrigin is root-relative.  A
+ *  stretch runs from one anchor to the next, where the anchors are
+ *  the moveable vertices and the frozen ones in sortedFrozenVertices.
+ *  The optimizers only routed stretches with a moveable end and only
+ *  those get refined.
+ */
+template <typename CostPixelType, typename ImageType, typename AlphaType, typename DifferenceFunctorType>
+void
+refineSeamLines(ContourVector& contours,
+                const std::vector<vigra::Point2D>& sortedFrozenVertices,
+                const ImageType* const white,
+                const ImageType* const black,
+                const AlphaType* const whiteAlpha,
+                const AlphaType* const blackAlpha,
+                const vigra::Rect2D& uBB,
+                const vigra::Point2D& gridOrigin,
+                int stride,
+                int corridor,
+                const DifferenceFunctorType& difference)
+{
+    // Grid points that map into uBB.
+    const vigra::Rect2D grid(vigra::Point2D(-floor_div(gridOrigin.x - uBB.left(), stride),
+                                            -floor_div(gridOrigin.y - uBB.top(), stride)),
+                             vigra::Point2D(floor_div(uBB.right() - 1 - gridOrigin.x, stride) + 1,
+                                            floor_div(uBB.bottom() - 1 - gridOrigin.y, stride) + 1));
+
+    auto to_grid = [&](const vigra::Point2D& p)
+    {
+        return vigra::Point2D(floor_div(p.x + uBB.left() - gridOrigin.x, stride),
+                              floor_div(p.y + uBB.top() - gridOrigin.y, stride));
+    };
+    auto to_root = [&](const vigra::Point2D& q) {return gridOrigin + q * stride;};
+
+    for (ContourVector::iterator contour = contours.begin(); contour != contours.end(); ++contour) {
+        for (Contour::iterator segment = (*contour)->begin(); segment != (*contour)->end(); ++segment) {
+            Segment* const snake = *segment;
+
+            std::vector<Segment::iterator> anchors;
+            for (Segment::iterator vertex = snake->begin(); vertex != snake->end(); ++vertex) {
+                if (vertex->first ||
+                    std::binary_search(sortedFrozenVertices.begin(), sortedFrozenVertices.end(),
+                                       vertex->second, lexicographic_less)) {
+                    anchors.push_back(vertex);
+                }
+            }
+            if (anchors.size() < 2U) {
+                continue;
+            }
+
+            for (size_t i = 0U; i != anchors.size(); ++i) {
+                const Segment::iterator from = anchors[i];
+                const Segment::iterator to = anchors[(i + 1U) % anchors.size()];
+
+                if (!(from->first || to->first)) {
+                    continue;
+                }
+
+                // Current route between both anchors in grid coordinates.
+                std::vector<Segment::iterator> inner;
+                std::vector<vigra::Point2D> route(1U, to_grid(from->second));
+                vigra::Rect2D roi(route.front(), vigra::Size2D(1, 1));
+                Segment::iterator vertex = std::next(from);
+                while (true) {
+                    if (vertex == snake->end()) {
+                        vertex = snake->begin();
+                    }
+                    if (vertex == to) {
+                        break;
+                    }
+                    inner.push_back(vertex);
+                    route.push_back(to_grid(vertex->second));
+                    roi |= vigra::Rect2D(route.back(), vigra::Size2D(1, 1));
+                    ++vertex;
+                }
+                route.push_back(to_grid(to->second));
+                roi |= vigra::Rect2D(route.back(), vigra::Size2D(1, 1));
+                roi.addBorder(corridor);
+                roi &= grid;
+
+                if (!roi.contains(route.front()) || !roi.contains(route.back())) {
+                    continue;
+                }
+
+                // Outside of the corridor and outside of the overlap
+                // everything has maximum cost.
+                vigra::BasicImage<CostPixelType> cost(roi.size(), vigra::NumericTraits<CostPixelType>::max());
+                vigra::BasicImage<vigra::UInt8> evaluated(roi.size(), vigra::UInt8(0));
+
+                for (std::vector<vigra::Point2D>::const_iterator a = route.begin(); std::next(a) != route.end(); ++a) {
+                    const vigra::Diff2D delta(*std::next(a) - *a);
+                    const int steps = std::max(std::abs(delta.x), std::abs(delta.y));
+
+                    for (int k = 0; k <= steps; ++k) {
+                        const vigra::Point2D center(steps == 0 ? *a : *a + delta * k / steps);
+                        vigra::Rect2D box(center, vigra::Size2D(1, 1));
+                        box.addBorder(corridor);
+                        box &= roi;
+
+                        for (int y = box.top(); y < box.bottom(); ++y) {
+                            for (int x = box.left(); x < box.right(); ++x) {
+                                const vigra::Point2D q(x, y);
+                                const vigra::Diff2D local(q - roi.upperLeft());
+                                if (evaluated[local]) {
+                                    continue;
+                                }
+                                evaluated[local] = 1;
+
+                                const vigra::Point2D root(to_root(q));
+                                if ((*whiteAlpha)[root] && (*blackAlpha)[root]) {
+                                    cost[local] = difference((*white)[root], (*black)[root]);
+                                }
+                            }
+                        }
+                    }
+                }
+
+                std::vector<vigra::Point2D>* shortPath =
+                    minCostPath(srcImageRange(cost),
+                                vigra::Point2D(route.back() - roi.upperLeft()),
+                                vigra::Point2D(route.front() - roi.upperLeft()));
+
+                std::for_each(inner.begin(), inner.end(), [snake](Segment::iterator x) {snake->erase(x);});
+                for (std::vector<vigra::Point2D>::const_iterator p = shortPath->begin(); p != shortPath->end(); ++p) {
+                    snake->insert(std::next(from),
+                                  std::make_pair(false, vigra::Point2D(to_root(*p + roi.upperLeft()) - uBB.upperLeft())));
+                }
+
+                delete shortPath;
+            }
+        }
+    }
+}
+
+
 template <typename AlphaType>
 void
 search_for_isolated_points(const AlphaType* const alpha)
@@ -967,7 +1175,7 @@ search_for_isolated_points(const AlphaType* const alpha)
     }
 
     if (number_of_isolated_points >=
-        std::max(1U, parameter::as_unsigned("black-alpha-mask-check-isolated-points-threshold", 2U))) {
+        std::max(1U, parameter::black_alpha_mask_check_isolated_points_threshold.value())) {
         std::cerr <<
             command << ": encountered degenerate image/mask geometry; too high risk of defective seam line" <<
             std::endl;
@@ -1115,7 +1323,7 @@ createMask(const ImageType* const white,
 
     const unsigned default_norm_value =
         std::min(static_cast<unsigned>(EuclideanDistance),
-                 parameter::as_unsigned("distance-transform-norm", static_cast<unsigned>(EuclideanDistance)));
+                 parameter::distance_transform_norm.value());
     const nearest_neighbor_metric_t norm = static_cast<nearest_neighbor_metric_t>(default_norm_value);
 
     if (MainAlgorithm == GraphCut) {
@@ -1139,7 +1347,7 @@ createMask(const ImageType* const white,
 
     search_for_isolated_points(blackAlpha);
 
-    if (parameter::as_boolean("dump-nft-images", false)) {
+    if (parameter::dump_nft_images.value()) {
         typedef std::pair<const char*, const MaskType*> image_pair_t;
 
         const std::array<image_pair_t, 3> nft {
@@ -1193,7 +1401,7 @@ createMask(const ImageType* const white,
     }
     delete mainOutputImage;
 
-    if (parameter::as_boolean("debug-seam-line", false)) {
+    if (parameter::debug_seam_line.value()) {
         std::cout << "+ createMask: rawSegments\n";
         dump_contour(rawSegments, "+ createMask: ");
     }
@@ -1213,7 +1421,7 @@ createMask(const ImageType* const white,
     reorderSnakesToMovableRuns(contours, rawSegments);
     rawSegments.clear();
 
-    if (parameter::as_boolean("debug-seam-line", false)) {
+    if (parameter::debug_seam_line.value()) {
         std::cout << "+ createMask: contours\n";
         dump_contourvector(contours, "+ createMask: ");
     }
@@ -1259,19 +1467,28 @@ createMask(const ImageType* const white,
     int mismatchImageStride;
     vigra::Diff2D uvBBStrideOffset;
 
-    if (CoarseMask) {
-        // Prepare to stride by two over uvBB to create cost image.
-        // Push ul corner of vBB so that there is an even number of
-        // pixels between vBB and uvBB.
-        if (uvBBOffset.x % 2) {
-            vBB.setUpperLeft(vBB.upperLeft() + vigra::Diff2D(-1, 0));
+    // Each refinement level halves the stride of the grid the seam
+    // lines live on.  The optimizers run on the coarsest grid, but
+    // never on a grid coarser than the one of the main algorithm.
+    unsigned refinementLevels = 0U;
+    if (CoarseMask && OptimizeMask) {
+        refinementLevels = std::min(parameter::seam_refinement_levels.value(), 16U);
+        while (refinementLevels > 1U && (1U << refinementLevels) > CoarsenessFactor) {
+            --refinementLevels;
         }
-        if (uvBBOffset.y % 2) {
-            vBB.setUpperLeft(vBB.upperLeft() + vigra::Diff2D(0, -1));
-        }
-        uvBBStrideOffset = (uvBB.upperLeft() - vBB.upperLeft()) / 2;
-        mismatchImageStride = 2;
-        mismatchImageSize = (vBB.size() + vigra::Diff2D(1, 1)) / 2;
+    }
+
+    if (CoarseMask) {
+        // Prepare to stride by two (or more with refinement) over
+        // uvBB to create cost image.  Push ul corner of vBB so that
+        // there is a multiple of the stride of pixels between vBB and
+        // uvBB.
+        mismatchImageStride = std::max(2, 1 << refinementLevels);
+        vBB.setUpperLeft(vBB.upperLeft() -
+                         vigra::Diff2D((mismatchImageStride - uvBBOffset.x % mismatchImageStride) % mismatchImageStride,
+                                       (mismatchImageStride - uvBBOffset.y % mismatchImageStride) % mismatchImageStride));
+        uvBBStrideOffset = (uvBB.upperLeft() - vBB.upperLeft()) / mismatchImageStride;
+        mismatchImageSize = (vBB.size() + vigra::Diff2D(mismatchImageStride - 1, mismatchImageStride - 1)) / mismatchImageStride;
     } else {
         uvBBStrideOffset = uvBBOffset;
         mismatchImageStride = 1;
@@ -1294,22 +1511,34 @@ createMask(const ImageType* const white,
     //                  !Visualize && CoarseMask: 1/2 * iBB * UInt8
     //                  !Visualize && !CoarseMask: iBB * UInt8
 
-    // Calculate mismatch image
+    // Calculate mismatch image and record where the images overlap
+    // in one go.  The flags cover the strided uvBB only; the rest of
+    // vBB lies outside of both images anyhow.
+    typedef vigra::BasicImage<OverlapPixelType> OverlapImageType;
+    OverlapImageType overlapImage(vigra::Size2D((uvBB.size() + vigra::Diff2D(mismatchImageStride - 1, mismatchImageStride - 1)) /
+                                                mismatchImageStride));
+
     switch (PixelDifferenceFunctor)
     {
     case HueLuminanceMaxDifference:
-        vigra::omp::combineTwoImages(vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImageRange(*white))),
-                                     vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImage(*black))),
-                                     vigra::destIter(mismatchImage.upperLeft() + uvBBStrideOffset),
-                                     MaxHueLuminanceDifferenceFunctor<ImagePixelType, MismatchImagePixelType>
-                                     (LuminanceDifferenceWeight, ChrominanceDifferenceWeight));
+        analyzeOverlap(vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImageRange(*white))),
+                       vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImage(*black))),
+                       vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImage(*whiteAlpha))),
+                       vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImage(*blackAlpha))),
+                       vigra::destIter(mismatchImage.upperLeft() + uvBBStrideOffset),
+                       vigra::destImage(overlapImage),
+                       MaxHueLuminanceDifferenceFunctor<ImagePixelType, MismatchImagePixelType>
+                       (LuminanceDifferenceWeight, ChrominanceDifferenceWeight));
         break;
     case DeltaEDifference:
-        vigra::omp::combineTwoImages(vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImageRange(*white))),
-                                     vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImage(*black))),
-                                     vigra::destIter(mismatchImage.upperLeft() + uvBBStrideOffset),
-                                     DeltaEPixelDifferenceFunctor<ImagePixelType, MismatchImagePixelType>
-                                     (LuminanceDifferenceWeight, ChrominanceDifferenceWeight));
+        analyzeOverlap(vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImageRange(*white))),
+                       vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImage(*black))),
+                       vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImage(*whiteAlpha))),
+                       vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImage(*blackAlpha))),
+                       vigra::destIter(mismatchImage.upperLeft() + uvBBStrideOffset),
+                       vigra::destImage(overlapImage),
+                       DeltaEPixelDifferenceFunctor<ImagePixelType, MismatchImagePixelType>
+                       (LuminanceDifferenceWeight, ChrominanceDifferenceWeight));
         break;
     default:
         NEVER_REACHED("switch control expression \"PixelDifferenceFunctor\" out of range");
@@ -1341,13 +1570,12 @@ createMask(const ImageType* const white,
 
         // Color the parts of the visualize image where the two images
         // to be blended do not overlap.
-        vigra::omp::combineThreeImages(vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImageRange(*whiteAlpha))),
-                                       vigra_ext::stride(mismatchImageStride, mismatchImageStride, vigra_ext::apply(uvBB, srcImage(*blackAlpha))),
-                                       vigra::srcIter(visualizeImage->upperLeft() + uvBBStrideOffset),
-                                       vigra::destIter(visualizeImage->upperLeft() + uvBBStrideOffset),
-                                       ifThenElse(Arg1() & Arg2(),
-                                                  Arg3(),
-                                                  Param(VISUALIZE_NO_OVERLAP_VALUE)));
+        vigra::omp::combineTwoImages(srcImageRange(overlapImage),
+                                     vigra::srcIter(visualizeImage->upperLeft() + uvBBStrideOffset),
+                                     vigra::destIter(visualizeImage->upperLeft() + uvBBStrideOffset),
+                                     ifThenElse(Arg1() == Param(OverlapPixelType(OVERLAP_BOTH)),
+                                                Arg2(),
+                                                Param(VISUALIZE_NO_OVERLAP_VALUE)));
 
         const vigra::Diff2D offset = vigra::Diff2D(vBB.upperLeft()) - vigra::Diff2D(uBB.upperLeft());
         // Draw the initial seam line as a reference.
@@ -1373,9 +1601,9 @@ createMask(const ImageType* const white,
         }
     }
 
-    if (OptimizeMask && !parameter::as_boolean("skip-optimizer", false)) {
+    if (OptimizeMask && !parameter::skip_optimizer.value()) {
         // Move snake points to mismatchImage-relative coordinates
-        if (parameter::as_boolean("adya-snake-points", false)) {
+        if (parameter::adya_snake_points.value()) {
             for_each_vertex(contours.begin(), contours.end(),
                             [&](Segment::iterator vertex)
                             {
@@ -1394,15 +1622,30 @@ createMask(const ImageType* const white,
                             });
         }
 
+        // Refinement must not move the vertices that pin the seam
+        // lines to the borders of the overlap region.
+        std::vector<vigra::Point2D> frozenVertices;
+        if (refinementLevels != 0U) {
+            for_each_vertex(contours.begin(), contours.end(),
+                            [&](Segment::iterator vertex)
+                            {
+                                if (!vertex->first) {
+                                    frozenVertices.push_back(vigra::Point2D(vertex->second * mismatchImageStride +
+                                                                            vBB.upperLeft() - uBB.upperLeft()));
+                                }
+                            });
+            std::sort(frozenVertices.begin(), frozenVertices.end(), lexicographic_less);
+        }
+
         std::unique_ptr<std::vector<double> > params(new std::vector<double>);
         std::unique_ptr<OptimizerChain<MismatchImagePixelType, MismatchImageType,
-                                       VisualizeImageType, AlphaType> >
+                                       VisualizeImageType, OverlapImageType> >
             defaultOptimizerChain(new OptimizerChain<MismatchImagePixelType, MismatchImageType,
-                                                     VisualizeImageType, AlphaType>
+                                                     VisualizeImageType, OverlapImageType>
                                   (&mismatchImage, visualizeImage,
                                    &mismatchImageSize, &mismatchImageStride,
                                    &uvBBStrideOffset, &contours, &uBB, &vBB, params.get(),
-                                   whiteAlpha, blackAlpha, &uvBB));
+                                   &overlapImage));
 
         // Add Strategy 1: Use GDA to optimize placement of snake vertices
         defaultOptimizerChain->addOptimizer("anneal");
@@ -1411,7 +1654,7 @@ createMask(const ImageType* const white,
         defaultOptimizerChain->addOptimizer("dijkstra");
 
         // Fire optimizer chain (runs every optimizer on the list in sequence)
-        if (!parameter::as_boolean("skip-optimizer-chain", false)) {
+        if (!parameter::skip_optimizer_chain.value()) {
             defaultOptimizerChain->runOptimizerChain();
         }
 
@@ -1421,6 +1664,39 @@ createMask(const ImageType* const white,
                         [&](Segment::iterator vertex)
                         {vertex->second =
                                 vertex->second * mismatchImageStride + vBB.upperLeft() - uBB.upperLeft();});
+
+        // Refine the seam lines level by level down to full
+        // resolution, each time only within a narrow corridor around
+        // the seam line of the previous level.
+        if (refinementLevels != 0U && !parameter::skip_optimizer_chain.value()) {
+            const int corridor = static_cast<int>(std::max(1U, parameter::seam_refinement_corridor.value()));
+
+            for (int stride = mismatchImageStride / 2; stride >= 1; stride /= 2) {
+                if (Verbose >= VERBOSE_MASK_MESSAGES) {
+                    std::cerr << command << ": info: refining seam lines at 1/" << stride << " scale" << std::endl;
+                }
+
+                switch (PixelDifferenceFunctor)
+                {
+                case HueLuminanceMaxDifference:
+                    refineSeamLines<MismatchImagePixelType>
+                        (contours, frozenVertices, white, black, whiteAlpha, blackAlpha,
+                         uBB, vBB.upperLeft(), stride, corridor,
+                         MaxHueLuminanceDifferenceFunctor<ImagePixelType, MismatchImagePixelType>
+                         (LuminanceDifferenceWeight, ChrominanceDifferenceWeight));
+                    break;
+                case DeltaEDifference:
+                    refineSeamLines<MismatchImagePixelType>
+                        (contours, frozenVertices, white, black, whiteAlpha, blackAlpha,
+                         uBB, vBB.upperLeft(), stride, corridor,
+                         DeltaEPixelDifferenceFunctor<ImagePixelType, MismatchImagePixelType>
+                         (LuminanceDifferenceWeight, ChrominanceDifferenceWeight));
+                    break;
+                default:
+                    NEVER_REACHED("switch control expression \"PixelDifferenceFunctor\" out of range");
+                }
+            }
+        }
     }
 
     if (visualizeImage) {
@@ -1458,7 +1734,7 @@ createMask(const ImageType* const white,
         delete visualizeImage;
     }
 
-    if (parameter::as_boolean("debug-seam-line", false)) {
+    if (parameter::debug_seam_line.value()) {
         std::cout << "+ createMask: contours of final optimized mask\n";
         dump_contourvector(contours, "+ createMask: ");
     }
@@ -0,0 +1,199 @@
+/*
+ * Copyright (C) 2017 Christoph Spiel
+ *
+ * This file is part of Enblend.
+ *
+ * Enblend is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Enblend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Enblend; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef MASKTILES_H_INCLUDED
+#define MASKTILES_H_INCLUDED
+
+#include <algorithm>
+#include <vector>
+
+#include <vigra/copyimage.hxx>
+#include <vigra/numerictraits.hxx>
+
+#include "rect2d.hxx"
+
+
+namespace enblend
+{
+    // Tile-level summary of a blend mask.
+    //
+    // A seam mask is constant almost everywhere: the transition
+    // between the white and the black image lives in a thin band
+    // around the seam line.  MaskTiles cuts the mask into square
+    // tiles and remembers which of them hold a single value, so that
+    // passes over the mask can skip uniform tiles or treat them
+    // wholesale.
+    template <typename MaskType>
+    class MaskTiles
+    {
+    public:
+        typedef typename MaskType::PixelType MaskPixelType;
+
+        MaskTiles() = delete;
+
+        MaskTiles(const MaskType* aMask, int aTileSize) :
+            size_(aMask->size()),
+            tileSize_(std::max(aTileSize, 1)),
+            tiles_((size_.x + tileSize_ - 1) / tileSize_, (size_.y + tileSize_ - 1) / tileSize_),
+            uniform_(tiles_.area()),
+            value_(tiles_.area())
+        {
+            const int n = tiles_.area();
+
+#ifdef OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+            for (int i = 0; i < n; ++i) {
+                const vigra::Rect2D r(rect(i % tiles_.x, i / tiles_.x));
+                const typename MaskType::const_traverser ul(aMask->upperLeft() + r.upperLeft());
+                const MaskPixelType first = *ul;
+                bool constant = true;
+
+                for (int y = 0; constant && y < r.height(); ++y) {
+                    typename MaskType::const_traverser::row_iterator x((ul + vigra::Diff2D(0, y)).rowIterator());
+                    const typename MaskType::const_traverser::row_iterator end(x + r.width());
+                    constant = std::find_if(x, end,
+                                            [first](const MaskPixelType& p) {return p != first;}) == end;
+                }
+
+                uniform_[i] = constant;
+                value_[i] = first;
+            }
+        }
+
+        int tileSize() const {return tileSize_;}
+        const vigra::Size2D& tiles() const {return tiles_;}
+
+        // Answer the part of the mask covered by tile (tx, ty).
+        vigra::Rect2D rect(int tx, int ty) const
+        {
+            return vigra::Rect2D(tx * tileSize_, ty * tileSize_,
+                                 std::min((tx + 1) * tileSize_, size_.x),
+                                 std::min((ty + 1) * tileSize_, size_.y));
+        }
+
+        bool isUniform(int tx, int ty) const {return uniform_[index(tx, ty)];}
+
+        // Answer the value of a uniform tile.
+        MaskPixelType value(int tx, int ty) const {return value_[index(tx, ty)];}
+
+        bool isZero(int tx, int ty) const
+        {
+            return isUniform(tx, ty) && value(tx, ty) == vigra::NumericTraits<MaskPixelType>::zero();
+        }
+
+        // Tell whether tile (tx, ty) and its neighbor at offset d
+        // certainly agree on every pixel.
+        bool agrees(int tx, int ty, const vigra::Diff2D& d) const
+        {
+            return isUniform(tx, ty) && isUniform(tx + d.x, ty + d.y) && value(tx, ty) == value(tx + d.x, ty + d.y);
+        }
+
+        // Record that aRectangle of the mask was zeroed.
+        void clear(const vigra::Rect2D& aRectangle)
+        {
+            const vigra::Rect2D r(aRectangle & vigra::Rect2D(size_));
+
+            if (r.isEmpty()) {
+                return;
+            }
+
+            for (int ty = r.top() / tileSize_; ty <= (r.bottom() - 1) / tileSize_; ++ty) {
+                for (int tx = r.left() / tileSize_; tx <= (r.right() - 1) / tileSize_; ++tx) {
+                    const vigra::Rect2D t(rect(tx, ty));
+                    const int i = index(tx, ty);
+
+                    if ((t & r) == t) {
+                        uniform_[i] = true;
+                        value_[i] = vigra::NumericTraits<MaskPixelType>::zero();
+                    } else if (!isZero(tx, ty)) {
+                        uniform_[i] = false;
+                    }
+                }
+            }
+        }
+
+    private:
+        int index(int tx, int ty) const {return ty * tiles_.x + tx;}
+
+        const vigra::Size2D size_;
+        const int tileSize_;
+        const vigra::Size2D tiles_;
+        std::vector<unsigned char> uniform_;
+        std::vector<MaskPixelType> value_;
+    };
+
+
+    // Like vigra::copyImageIf(src, maskImage(*mask), dest) with src and
+    // dest spanning the whole mask, but skip the zero tiles of the mask
+    // and copy its non-zero uniform tiles without looking at the mask.
+    template <typename MaskType, class SrcImageIterator, class SrcAccessor,
+              class DestImageIterator, class DestAccessor>
+    void
+    copyImageIfTiled(SrcImageIterator src_upperleft, SrcImageIterator src_lowerright, SrcAccessor sa,
+                     const MaskType* mask, const MaskTiles<MaskType>& tiles,
+                     DestImageIterator dest_upperleft, DestAccessor da)
+    {
+        vigra_precondition(vigra::Size2D(src_lowerright - src_upperleft) == mask->size(),
+                           "copyImageIfTiled: source and mask differ in size");
+
+        const int n = tiles.tiles().area();
+
+#ifdef OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int i = 0; i < n; ++i) {
+            const int tx = i % tiles.tiles().x;
+            const int ty = i / tiles.tiles().x;
+
+            if (tiles.isZero(tx, ty)) {
+                continue;
+            }
+
+            const vigra::Rect2D r(tiles.rect(tx, ty));
+            if (tiles.isUniform(tx, ty)) {
+                vigra::copyImage(src_upperleft + r.upperLeft(), src_upperleft + r.lowerRight(), sa,
+                                 dest_upperleft + r.upperLeft(), da);
+            } else {
+                vigra::copyImageIf(src_upperleft + r.upperLeft(), src_upperleft + r.lowerRight(), sa,
+                                   mask->upperLeft() + r.upperLeft(), mask->accessor(),
+                                   dest_upperleft + r.upperLeft(), da);
+            }
+        }
+    }
+
+
+    template <typename MaskType, class SrcImageIterator, class SrcAccessor,
+              class DestImageIterator, class DestAccessor>
+    inline void
+    copyImageIfTiled(vigra::triple<SrcImageIterator, SrcImageIterator, SrcAccessor> src,
+                     const MaskType* mask, const MaskTiles<MaskType>& tiles,
+                     vigra::pair<DestImageIterator, DestAccessor> dest)
+    {
+        copyImageIfTiled(src.first, src.second, src.third, mask, tiles, dest.first, dest.second);
+    }
+} // namespace enblend
+
+
+#endif /* MASKTILES_H_INCLUDED */
+
+
+// Local Variables:
+// mode: c++
+// End:
@@ -128,7 +128,7 @@ namespace metadata
 
         // Dynamic part.
         const std::regex delimiter {R"(\s*[,;:]\s*)"};
-        const std::string dynamic_keys {parameter::as_string("blacklist-exif-keys", "")};
+        const std::string dynamic_keys {parameter::blacklist_exif_keys.value()};
         std::sregex_token_iterator
             dynamic_key_iterator(dynamic_keys.begin(), dynamic_keys.end(), delimiter, -1);
         while (dynamic_key_iterator != std::sregex_token_iterator())
@@ -26,6 +26,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <type_traits>
 
 #include <vigra/colorconversions.hxx>
 
@@ -63,6 +64,18 @@ public:
         return f(i, d, srcIsScalar());
     }
 
+    // Answer whether anAccessor projects every pixel to the same
+    // gray value as this accessor does.
+    bool projectsLike(const MultiGrayscaleAccessor& anAccessor) const {
+        typedef typename vigra::NumericTraits<InputType>::isScalar srcIsScalar;
+        return srcIsScalar::asBool ||
+            (kind == anAccessor.kind &&
+             (kind != MIXER ||
+              (redWeight == anAccessor.redWeight &&
+               greenWeight == anAccessor.greenWeight &&
+               blueWeight == anAccessor.blueWeight)));
+    }
+
     static const std::string defaultGrayscaleAccessorName() {
         return "average";       //< default-grayscale-accessor average
     }
@@ -71,6 +84,66 @@ private:
     typedef enum AccessorKind {
         AVERAGE, LSTAR, PRIMED_LSTAR, LIGHTNESS, VALUE, ANTI_VALUE, LUMINANCE, MIXER
     } AccKindType;
+
+    template <AccKindType K>
+    struct Kind : public std::integral_constant<AccKindType, K> {};
+
+public:
+    // Projector with its kind fixed at compile time.  It projects
+    // exactly like the accessor it refers to, but it does not switch
+    // on the kind for every pixel.
+    template <AccKindType K>
+    class Projector
+    {
+    public:
+        typedef ResultType value_type;
+
+        explicit Projector(const MultiGrayscaleAccessor* anAccessor) : accessor(anAccessor) {}
+
+        ResultType operator()(const InputType& x) const {return accessor->project(x, Kind<K>());}
+
+    private:
+        const MultiGrayscaleAccessor* accessor;
+    };
+
+    // Grayscale images need no projection at all.
+    class IdentityProjector
+    {
+    public:
+        typedef ResultType value_type;
+
+        ResultType operator()(const InputType& x) const {return x;}
+    };
+
+    // Call aFunction with the projector of this accessor's kind.
+    // Functions that loop over whole images get the kind compiled
+    // into their inner loops this way.
+    template <class Function>
+    void withProjector(Function& aFunction) const {
+        typedef typename vigra::NumericTraits<InputType>::isScalar srcIsScalar;
+        withProjector(aFunction, srcIsScalar());
+    }
+
+private:
+    template <class Function>
+    void withProjector(Function& aFunction, vigra::VigraTrueType) const {
+        aFunction(IdentityProjector());
+    }
+
+    template <class Function>
+    void withProjector(Function& aFunction, vigra::VigraFalseType) const {
+        switch (kind)
+        {
+        case AVERAGE: aFunction(Projector<AVERAGE>(this)); break;
+        case LSTAR: aFunction(Projector<LSTAR>(this)); break;
+        case PRIMED_LSTAR: aFunction(Projector<PRIMED_LSTAR>(this)); break;
+        case LIGHTNESS: aFunction(Projector<LIGHTNESS>(this)); break;
+        case VALUE: aFunction(Projector<VALUE>(this)); break;
+        case ANTI_VALUE: aFunction(Projector<ANTI_VALUE>(this)); break;
+        case LUMINANCE: aFunction(Projector<LUMINANCE>(this)); break;
+        case MIXER: aFunction(Projector<MIXER>(this)); break;
+        }
+    }
     typedef std::map<std::string, AccKindType> NameMapType;
     typedef typename NameMapType::const_iterator NameMapConstIterType;
 
@@ -181,44 +254,67 @@ private:
         rgb_prime_to_lab_fun = vigra::RGBPrime2LabFunctor<double>(vigra::NumericTraits<ValueType>::max());
     }
 
-    ResultType project(const InputType& x) const {
+    ResultType project(const InputType& x, Kind<AVERAGE>) const {
         typedef typename InputType::value_type ValueType;
+        return vigra::NumericTraits<ResultType>::fromRealPromote
+            ((vigra::NumericTraits<ValueType>::toRealPromote(x.red()) +
+              vigra::NumericTraits<ValueType>::toRealPromote(x.green()) +
+              vigra::NumericTraits<ValueType>::toRealPromote(x.blue())) /
+             3.0);
+    }
+
+    ResultType project(const InputType& x, Kind<LSTAR>) const {
+        typedef typename InputType::value_type ValueType;
+        typedef typename vigra::RGB2LabFunctor<double>::result_type LABResultType;
+        const LABResultType y = rgb_to_lab_fun.operator()(x) / 100.0;
+        return vigra::NumericTraits<ResultType>::fromRealPromote(vigra::NumericTraits<ValueType>::max() * y[0]);
+    }
+
+    ResultType project(const InputType& x, Kind<PRIMED_LSTAR>) const {
+        typedef typename InputType::value_type ValueType;
+        typedef typename vigra::RGBPrime2LabFunctor<double>::result_type LABResultType;
+        const LABResultType y = rgb_prime_to_lab_fun.operator()(x) / 100.0;
+        return vigra::NumericTraits<ResultType>::fromRealPromote(vigra::NumericTraits<ValueType>::max() * y[0]);
+    }
+
+    ResultType project(const InputType& x, Kind<LIGHTNESS>) const {
+        return vigra::NumericTraits<ResultType>::fromRealPromote
+            ((std::min(x.red(), std::min(x.green(), x.blue())) +
+              std::max(x.red(), std::max(x.green(), x.blue()))) /
+             2.0);
+    }
+
+    ResultType project(const InputType& x, Kind<VALUE>) const {
+        return std::max(x.red(), std::max(x.green(), x.blue()));
+    }
+
+    ResultType project(const InputType& x, Kind<ANTI_VALUE>) const {
+        return std::min(x.red(), std::min(x.green(), x.blue()));
+    }
+
+    ResultType project(const InputType& x, Kind<LUMINANCE>) const {
+        return vigra::NumericTraits<ResultType>::fromRealPromote(x.luminance());
+    }
+
+    ResultType project(const InputType& x, Kind<MIXER>) const {
+        typedef typename InputType::value_type ValueType;
+        return vigra::NumericTraits<ResultType>::fromRealPromote
+            (redWeight * vigra::NumericTraits<ValueType>::toRealPromote(x.red()) +
+             greenWeight * vigra::NumericTraits<ValueType>::toRealPromote(x.green()) +
+             blueWeight * vigra::NumericTraits<ValueType>::toRealPromote(x.blue()));
+    }
+
+    ResultType project(const InputType& x) const {
         switch (kind)
         {
-        case AVERAGE:
-            return vigra::NumericTraits<ResultType>::fromRealPromote
-                ((vigra::NumericTraits<ValueType>::toRealPromote(x.red()) +
-                  vigra::NumericTraits<ValueType>::toRealPromote(x.green()) +
-                  vigra::NumericTraits<ValueType>::toRealPromote(x.blue())) /
-                 3.0);
-        case LSTAR:
-        {
-            typedef typename vigra::RGB2LabFunctor<double>::result_type LABResultType;
-            const LABResultType y = rgb_to_lab_fun.operator()(x) / 100.0;
-            return vigra::NumericTraits<ResultType>::fromRealPromote(vigra::NumericTraits<ValueType>::max() * y[0]);
-        }
-        case PRIMED_LSTAR:
-        {
-            typedef typename vigra::RGBPrime2LabFunctor<double>::result_type LABResultType;
-            const LABResultType y = rgb_prime_to_lab_fun.operator()(x) / 100.0;
-            return vigra::NumericTraits<ResultType>::fromRealPromote(vigra::NumericTraits<ValueType>::max() * y[0]);
-        }
-        case LIGHTNESS:
-            return vigra::NumericTraits<ResultType>::fromRealPromote
-                ((std::min(x.red(), std::min(x.green(), x.blue())) +
-                  std::max(x.red(), std::max(x.green(), x.blue()))) /
-                 2.0);
-        case VALUE:
-            return std::max(x.red(), std::max(x.green(), x.blue()));
-        case ANTI_VALUE:
-            return std::min(x.red(), std::min(x.green(), x.blue()));
-        case LUMINANCE:
-            return vigra::NumericTraits<ResultType>::fromRealPromote(x.luminance());
-        case MIXER:
-            return vigra::NumericTraits<ResultType>::fromRealPromote
-                (redWeight * vigra::NumericTraits<ValueType>::toRealPromote(x.red()) +
-                 greenWeight * vigra::NumericTraits<ValueType>::toRealPromote(x.green()) +
-                 blueWeight * vigra::NumericTraits<ValueType>::toRealPromote(x.blue()));
+        case AVERAGE: return project(x, Kind<AVERAGE>());
+        case LSTAR: return project(x, Kind<LSTAR>());
+        case PRIMED_LSTAR: return project(x, Kind<PRIMED_LSTAR>());
+        case LIGHTNESS: return project(x, Kind<LIGHTNESS>());
+        case VALUE: return project(x, Kind<VALUE>());
+        case ANTI_VALUE: return project(x, Kind<ANTI_VALUE>());
+        case LUMINANCE: return project(x, Kind<LUMINANCE>());
+        case MIXER: return project(x, Kind<MIXER>());
         }
 
         // never reached
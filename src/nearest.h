@@ -37,6 +37,7 @@
 #include <vigra/inspectimage.hxx>
 #include <vigra/numerictraits.hxx>
 
+#include "mapped_storage.h"
 #include "timer.h"
 #include "opencl_vigra.h"
 
@@ -53,20 +54,46 @@ namespace vigra
 {
     namespace ocl
     {
+        template <class SrcImageIterator, class SrcAccessor,
+                  class DestImageIterator, class DestAccessor,
+                  class ValueType>
+        inline static void
+        cpuDistanceTransform(SrcImageIterator src_upperleft, SrcImageIterator src_lowerright, SrcAccessor src_acc,
+                             DestImageIterator dest_upperleft, DestAccessor dest_acc,
+                             ValueType background, int norm,
+                             bool wrap_x, bool wrap_y)
+        {
+            if (wrap_x || wrap_y)
+            {
+                vigra::omp::periodicDistanceTransform(src_upperleft, src_lowerright, src_acc,
+                                                      dest_upperleft, dest_acc,
+                                                      background, norm,
+                                                      wrap_x, wrap_y);
+            }
+            else
+            {
+                vigra::omp::distanceTransform(src_upperleft, src_lowerright, src_acc,
+                                              dest_upperleft, dest_acc,
+                                              background, norm);
+            }
+        }
+
+
         template <class SrcImageIterator, class SrcAccessor,
                   class DestImageIterator, class DestAccessor,
                   class ValueType>
         inline void
         distanceTransform(SrcImageIterator src_upperleft, SrcImageIterator src_lowerright, SrcAccessor src_acc,
                           DestImageIterator dest_upperleft, DestAccessor dest_acc,
-                          ValueType background, int norm)
+                          ValueType background, int norm,
+                          bool wrap_x = false, bool wrap_y = false)
         {
             timer::WallClock wall_clock;
 
             wall_clock.start();
 
 #ifdef OPENCL
-            const bool enable_kernel = parameter::as_boolean("gpu-kernel-dt", true);
+            const bool enable_kernel = parameter::gpu_kernel_dt.value();
 
             if (GPUContext && GPU::DistanceTransform && enable_kernel)
             {
@@ -77,7 +104,8 @@ namespace vigra
 
                 GPU::DistanceTransform->run(src_upperleft, src_lowerright, src_acc,
                                             dest_upperleft, dest_acc,
-                                            background, norm);
+                                            background, norm,
+                                            wrap_x, wrap_y);
             }
             else
             {
@@ -88,18 +116,20 @@ namespace vigra
                         command << ": warning: falling back to CPU path" << std::endl;
                 }
 
-                vigra::omp::distanceTransform(src_upperleft, src_lowerright, src_acc,
-                                              dest_upperleft, dest_acc,
-                                              background, norm);
+                cpuDistanceTransform(src_upperleft, src_lowerright, src_acc,
+                                     dest_upperleft, dest_acc,
+                                     background, norm,
+                                     wrap_x, wrap_y);
             }
 #else
-            vigra::omp::distanceTransform(src_upperleft, src_lowerright, src_acc,
-                                          dest_upperleft, dest_acc,
-                                          background, norm);
+            cpuDistanceTransform(src_upperleft, src_lowerright, src_acc,
+                                 dest_upperleft, dest_acc,
+                                 background, norm,
+                                 wrap_x, wrap_y);
 #endif // OPENCL
 
             wall_clock.stop();
-            if (parameter::as_boolean("time-distance-transform", false))
+            if (parameter::time_distance_transform.value())
             {
                 const std::ios::fmtflags flags(std::cerr.flags());
                 vigra::Size2D size(src_lowerright - src_upperleft);
@@ -121,11 +151,13 @@ namespace vigra
         inline static void
         distanceTransform(vigra::triple<SrcImageIterator, SrcImageIterator, SrcAccessor> src,
                           vigra::pair<DestImageIterator, DestAccessor> dest,
-                          ValueType background, int norm)
+                          ValueType background, int norm,
+                          bool wrap_x = false, bool wrap_y = false)
         {
             vigra::ocl::distanceTransform(src.first, src.second, src.third,
                                           dest.first, dest.second,
-                                          background, norm);
+                                          background, norm,
+                                          wrap_x, wrap_y);
         }
     } // namespace ocl
 } // namespace vigra
@@ -301,6 +333,23 @@ periodicDistanceTransform(SrcImageIterator src_upperleft, SrcImageIterator src_l
     typedef typename SrcImageIterator::value_type SrcValueType;
     typedef typename DestImageIterator::value_type DestValueType;
 
+    if (norm != 0)
+    {
+        // The Felzenszwalb-Huttenlocher passes handle the periodic
+        // axes natively, one ring per row or column, so there is no
+        // need to enlarge the image.
+        const bool wrap_x = boundary == HorizontalStrip || boundary == DoubleStrip;
+        const bool wrap_y = boundary == VerticalStrip || boundary == DoubleStrip;
+
+        vigra::ocl::distanceTransform(src_upperleft, src_lowerright, sa,
+                                      dest_upperleft, da,
+                                      background, norm,
+                                      wrap_x, wrap_y);
+        return;
+    }
+
+    // The chessboard metric is not separable into FH passes; fall
+    // back to transforming a doubled copy of the image.
     const vigra::Diff2D size(src_lowerright.x - src_upperleft.x,
                              src_lowerright.y - src_upperleft.y);
     int size_x;
@@ -403,6 +452,288 @@ quick_tally(vigra::triple<SrcImageIterator, SrcImageIterator, SrcAccessor> src,
 }
 
 
+namespace detail
+{
+    // Classic nearest-feature algorithm: two distance transforms of
+    // the difference images, compared pixel by pixel.
+    template <class SrcImageIterator, class SrcAccessor,
+              class DestImageIterator, class DestAccessor>
+    unsigned
+    differenceNearestFeatureTransform(SrcImageIterator src1_upperleft, SrcImageIterator src1_lowerright,
+                                      SrcAccessor sa1,
+                                      SrcImageIterator src2_upperleft, SrcAccessor sa2,
+                                      DestImageIterator dest_upperleft, DestAccessor da,
+                                      nearest_neighbor_metric_t norm, boundary_t boundary,
+                                      unsigned overlap_threshold)
+    {
+        typedef typename SrcAccessor::value_type SrcPixelType;
+        typedef vigra::NumericTraits<SrcPixelType> SrcPixelTraits;
+
+        typedef typename DestAccessor::value_type DestPixelType;
+        typedef vigra::NumericTraits<DestPixelType> DestPixelTraits;
+
+        const SrcPixelType background = SrcPixelTraits::zero();
+        const vigra::Size2D size(src1_lowerright.x - src1_upperleft.x, src1_lowerright.y - src1_upperleft.y);
+
+        IMAGETYPE<float> dist12(size);
+        IMAGETYPE<float> dist21(size);
+        if (Verbose >= VERBOSE_NFT_MESSAGES)
+        {
+            std::cerr << " 1/3";
+            std::cerr.flush();
+        }
+
+        IMAGETYPE<SrcPixelType> diff12(size);
+        vigra::omp::combineTwoImages(src1_upperleft, src1_lowerright, sa1,
+                                     src2_upperleft, sa2,
+                                     diff12.upperLeft(), diff12.accessor(),
+                                     saturating_subtract<SrcPixelType>());
+
+        const unsigned tally12 = quick_tally(diff12.begin(), diff12.end(), diff12.accessor(), overlap_threshold);
+
+        switch (boundary)
+        {
+        case OpenBoundaries:
+            vigra::ocl::distanceTransform(srcImageRange(diff12), destImage(dist12), background, norm);
+            break;
+
+        case HorizontalStrip: // FALLTHROUGH
+        case VerticalStrip:   // FALLTHROUGH
+        case DoubleStrip:
+            periodicDistanceTransform(srcImageRange(diff12), destImage(dist12),
+                                      background, norm, boundary);
+            break;
+
+        default:
+            NEVER_REACHED("switch control expression \"boundary\" out of range");
+        }
+
+        if (Verbose >= VERBOSE_NFT_MESSAGES)
+        {
+            std::cerr << " 2/3";
+            std::cerr.flush();
+        }
+        IMAGETYPE<SrcPixelType> diff21(size);
+        vigra::omp::combineTwoImages(src2_upperleft, src2_upperleft + size, sa2,
+                                     src1_upperleft, sa1,
+                                     diff21.upperLeft(), diff21.accessor(),
+                                     saturating_subtract<SrcPixelType>());
+
+        const unsigned tally21 = quick_tally(diff21.begin(), diff21.end(), diff21.accessor(), overlap_threshold);
+
+        switch (boundary)
+        {
+        case OpenBoundaries:
+            vigra::ocl::distanceTransform(srcImageRange(diff21), destImage(dist21), background, norm);
+            break;
+
+        case HorizontalStrip: // FALLTHROUGH
+        case VerticalStrip:   // FALLTHROUGH
+        case DoubleStrip:
+            periodicDistanceTransform(srcImageRange(diff21), destImage(dist21),
+                                      background, norm, boundary);
+            break;
+
+        default:
+            NEVER_REACHED("switch control expression \"boundary\" out of range");
+        }
+
+        if (Verbose >= VERBOSE_NFT_MESSAGES)
+        {
+            std::cerr << " 3/3";
+            std::cerr.flush();
+        }
+
+        vigra::omp::combineTwoImages(dist12.upperLeft(), dist12.lowerRight(), dist12.accessor(),
+                                     dist21.upperLeft(), dist21.accessor(),
+                                     dest_upperleft, da,
+                                     ifThenElse(vigra::functor::Arg1() < vigra::functor::Arg2(),
+                                                vigra::functor::Param(DestPixelTraits::max()),
+                                                vigra::functor::Param(DestPixelTraits::zero())));
+
+        return std::max(tally12, tally21);
+    }
+
+
+    // Fused nearest-feature engine.  The features are the pixels
+    // where one mask exceeds the other.  A single labeled distance
+    // transform over both kinds of features finds the nearest one and
+    // its label goes straight into dest, which doubles as the label
+    // image between the column and the row pass.  Only one distance
+    // image is needed, the difference images and the second distance
+    // image of the classic algorithm go away.
+    //
+    // Features of src1 start at a distance of one half.  All true
+    // (squared) distances are integral, so src1 wins a pixel exactly
+    // if it is strictly closer, which is what the comparison of two
+    // separate distance images yields.  The half must survive the
+    // addition of squared distances of up to twice the square of the
+    // greatest image extent, which overruns the 24-bit mantissa of a
+    // float; therefore the distances are doubles.
+    template <class SrcImageIterator, class SrcAccessor,
+              class DestImageIterator, class DestAccessor,
+              class ColumnTransform1dFunctor, class RowTransform1dFunctor>
+    unsigned
+    fusedNearestFeatureTransform(SrcImageIterator src1_upperleft, SrcImageIterator src1_lowerright,
+                                 SrcAccessor sa1,
+                                 SrcImageIterator src2_upperleft, SrcAccessor sa2,
+                                 DestImageIterator dest_upperleft, DestAccessor da,
+                                 ColumnTransform1dFunctor column_transform, RowTransform1dFunctor row_transform)
+    {
+        typedef typename ColumnTransform1dFunctor::value_type DistanceType;
+        typedef typename ColumnTransform1dFunctor::label_type LabelType;
+        typedef vigra::NumericTraits<DistanceType> DistanceTraits;
+        typedef typename SrcAccessor::value_type SrcPixelType;
+        typedef typename DestAccessor::value_type DestPixelType;
+        typedef vigra::NumericTraits<DestPixelType> DestPixelTraits;
+
+        const vigra::Size2D size(src1_lowerright - src1_upperleft);
+        const int greatest_length = std::max(size.x, size.y);
+        const DistanceType bias = static_cast<DistanceType>(0.5);
+        IMAGETYPE<DistanceType> intermediate(size, vigra::SkipInitialization);
+        unsigned tally12 = 0U;
+        unsigned tally21 = 0U;
+
+        if (Verbose >= VERBOSE_NFT_MESSAGES)
+        {
+            std::cerr << " 1/2";
+            std::cerr.flush();
+        }
+
+#ifdef OPENMP
+#pragma omp parallel
+#endif
+        {
+            DistanceType* const f = new DistanceType[greatest_length];
+            DistanceType* const d = new DistanceType[greatest_length];
+            LabelType* const fl = new LabelType[greatest_length];
+            LabelType* const dl = new LabelType[greatest_length];
+
+#ifdef OPENMP
+#pragma omp for schedule(guided) reduction(+:tally12, tally21)
+#endif
+            for (int x = 0; x < size.x; ++x)
+            {
+                SrcImageIterator s1(src1_upperleft + vigra::Diff2D(x, 0));
+                SrcImageIterator s2(src2_upperleft + vigra::Diff2D(x, 0));
+                for (int y = 0; y < size.y; ++y, ++s1.y, ++s2.y)
+                {
+                    const SrcPixelType v1 = sa1(s1);
+                    const SrcPixelType v2 = sa2(s2);
+
+                    if (v2 < v1)
+                    {
+                        f[y] = bias;
+                        fl[y] = LabelType(1);
+                        ++tally12;
+                    }
+                    else if (v1 < v2)
+                    {
+                        f[y] = DistanceTraits::zero();
+                        fl[y] = LabelType(0);
+                        ++tally21;
+                    }
+                    else
+                    {
+                        f[y] = DistanceTraits::max();
+                        fl[y] = LabelType(0);
+                    }
+                }
+
+                column_transform(d, dl, f, fl, size.y);
+
+                typename IMAGETYPE<DistanceType>::column_iterator ci(intermediate.columnBegin(x));
+                DestImageIterator di(dest_upperleft + vigra::Diff2D(x, 0));
+                for (int y = 0; y < size.y; ++y, ++ci, ++di.y)
+                {
+                    *ci = d[y];
+                    da.set(dl[y] ? DestPixelTraits::max() : DestPixelTraits::zero(), di);
+                }
+            }
+
+#ifdef OPENMP
+#pragma omp single
+#endif
+            if (Verbose >= VERBOSE_NFT_MESSAGES)
+            {
+                std::cerr << " 2/2";
+                std::cerr.flush();
+            }
+
+#ifdef OPENMP
+#pragma omp for nowait schedule(guided)
+#endif
+            for (int y = 0; y < size.y; ++y)
+            {
+                DestImageIterator di(dest_upperleft + vigra::Diff2D(0, y));
+                for (int x = 0; x < size.x; ++x, ++di.x)
+                {
+                    fl[x] = da(di) != DestPixelTraits::zero() ? LabelType(1) : LabelType(0);
+                }
+
+                row_transform(d, dl, &intermediate(0, y), fl, size.x);
+
+                di = dest_upperleft + vigra::Diff2D(0, y);
+                for (int x = 0; x < size.x; ++x, ++di.x)
+                {
+                    da.set(dl[x] ? DestPixelTraits::max() : DestPixelTraits::zero(), di);
+                }
+            }
+
+            delete [] dl;
+            delete [] fl;
+            delete [] d;
+            delete [] f;
+        } // omp parallel
+
+        return std::max(tally12, tally21);
+    }
+
+
+    template <template <class, class> class Transform1dFunctor,
+              template <class, class> class PeriodicTransform1dFunctor,
+              class SrcImageIterator, class SrcAccessor,
+              class DestImageIterator, class DestAccessor>
+    inline unsigned
+    fusedNearestFeatureTransform(SrcImageIterator src1_upperleft, SrcImageIterator src1_lowerright,
+                                 SrcAccessor sa1,
+                                 SrcImageIterator src2_upperleft, SrcAccessor sa2,
+                                 DestImageIterator dest_upperleft, DestAccessor da,
+                                 bool wrap_x, bool wrap_y)
+    {
+        typedef Transform1dFunctor<double, unsigned char> open_t;
+        typedef PeriodicTransform1dFunctor<double, unsigned char> periodic_t;
+
+        if (wrap_y)
+        {
+            if (wrap_x)
+            {
+                return fusedNearestFeatureTransform(src1_upperleft, src1_lowerright, sa1, src2_upperleft, sa2,
+                                                    dest_upperleft, da, periodic_t(), periodic_t());
+            }
+            else
+            {
+                return fusedNearestFeatureTransform(src1_upperleft, src1_lowerright, sa1, src2_upperleft, sa2,
+                                                    dest_upperleft, da, periodic_t(), open_t());
+            }
+        }
+        else
+        {
+            if (wrap_x)
+            {
+                return fusedNearestFeatureTransform(src1_upperleft, src1_lowerright, sa1, src2_upperleft, sa2,
+                                                    dest_upperleft, da, open_t(), periodic_t());
+            }
+            else
+            {
+                return fusedNearestFeatureTransform(src1_upperleft, src1_lowerright, sa1, src2_upperleft, sa2,
+                                                    dest_upperleft, da, open_t(), open_t());
+            }
+        }
+    }
+} // namespace detail
+
+
 // Compute a mask (dest) that defines the seam line given the
 // blackmask (src1) and the whitemask (src2) of the overlapping
 // images.
@@ -429,17 +760,8 @@ nearestFeatureTransform(SrcImageIterator src1_upperleft, SrcImageIterator src1_l
                         DestImageIterator dest_upperleft, DestAccessor da,
                         nearest_neighbor_metric_t norm, boundary_t boundary)
 {
-    typedef typename SrcAccessor::value_type SrcPixelType;
-    typedef vigra::NumericTraits<SrcPixelType> SrcPixelTraits;
-
-    typedef typename DestAccessor::value_type DestPixelType;
-    typedef vigra::NumericTraits<DestPixelType> DestPixelTraits;
-
-    const SrcPixelType background = SrcPixelTraits::zero();
     const vigra::Size2D size(src1_lowerright.x - src1_upperleft.x, src1_lowerright.y - src1_upperleft.y);
 
-    IMAGETYPE<float> dist12(size);
-    IMAGETYPE<float> dist21(size);
     if (Verbose >= VERBOSE_NFT_MESSAGES)
     {
         std::cerr << command << ": info: creating ";
@@ -448,7 +770,7 @@ nearestFeatureTransform(SrcImageIterator src1_upperleft, SrcImageIterator src1_l
         } else {
             std::cerr << "fine";
         }
-        std::cerr << " blend mask: 1/3";
+        std::cerr << " blend mask:";
         std::cerr.flush();
     }
 
@@ -459,70 +781,48 @@ nearestFeatureTransform(SrcImageIterator src1_upperleft, SrcImageIterator src1_l
         //
         // The current parameter default is two times the
         // circumference of the overlap rectangle.
-        parameter::as_unsigned("overlap-check-threshold", 2U) * //< overlap-check-threshold 2
+        parameter::overlap_check_threshold.value() *
         2U * (static_cast<unsigned>(size.height()) + static_cast<unsigned>(size.width()));
-    IMAGETYPE<SrcPixelType> diff12(size);
-    vigra::omp::combineTwoImages(src1_upperleft, src1_lowerright, sa1,
-                                 src2_upperleft, sa2,
-                                 diff12.upperLeft(), diff12.accessor(),
-                                 saturating_subtract<SrcPixelType>());
-
-    const unsigned tally12 = quick_tally(diff12.begin(), diff12.end(), diff12.accessor(), overlap_threshold);
 
-    switch (boundary)
-    {
-    case OpenBoundaries:
-        vigra::ocl::distanceTransform(srcImageRange(diff12), destImage(dist12), background, norm);
-        break;
-
-    case HorizontalStrip: // FALLTHROUGH
-    case VerticalStrip:   // FALLTHROUGH
-    case DoubleStrip:
-        periodicDistanceTransform(srcImageRange(diff12), destImage(dist12),
-                                  background, norm, boundary);
-        break;
-
-    default:
-        NEVER_REACHED("switch control expression \"boundary\" out of range");
-    }
-
-    if (Verbose >= VERBOSE_NFT_MESSAGES)
-    {
-        std::cerr << " 2/3";
-        std::cerr.flush();
-    }
-    IMAGETYPE<SrcPixelType> diff21(size);
-    vigra::omp::combineTwoImages(src2_upperleft, src2_upperleft + size, sa2,
-                                 src1_upperleft, sa1,
-                                 diff21.upperLeft(), diff21.accessor(),
-                                 saturating_subtract<SrcPixelType>());
-
-    const unsigned tally21 = quick_tally(diff21.begin(), diff21.end(), diff21.accessor(), overlap_threshold);
+    // The fused engine relies on the Felzenszwalb-Huttenlocher
+    // passes, which know nothing about the chessboard metric.  An
+    // active OpenCL distance transform keeps the classic algorithm,
+    // too, so that the GPU does the heavy lifting.
+    bool fuse = norm != ChessboardDistance;
+#ifdef OPENCL
+    fuse = fuse && !(GPUContext && GPU::DistanceTransform && parameter::gpu_kernel_dt.value());
+#endif
 
-    switch (boundary)
+    unsigned overlap_tally;
+    if (fuse)
     {
-    case OpenBoundaries:
-        vigra::ocl::distanceTransform(srcImageRange(diff21), destImage(dist21), background, norm);
-        break;
+        const bool wrap_x = boundary == HorizontalStrip || boundary == DoubleStrip;
+        const bool wrap_y = boundary == VerticalStrip || boundary == DoubleStrip;
 
-    case HorizontalStrip: // FALLTHROUGH
-    case VerticalStrip:   // FALLTHROUGH
-    case DoubleStrip:
-        periodicDistanceTransform(srcImageRange(diff21), destImage(dist21),
-                                  background, norm, boundary);
-        break;
-
-    default:
-        NEVER_REACHED("switch control expression \"boundary\" out of range");
+        if (norm == ManhattanDistance)
+        {
+            overlap_tally =
+                detail::fusedNearestFeatureTransform<vigra::omp::fh::detail::LabeledManhattanTransform1D,
+                                                     vigra::omp::fh::detail::LabeledPeriodicManhattanTransform1D>
+                (src1_upperleft, src1_lowerright, sa1, src2_upperleft, sa2, dest_upperleft, da, wrap_x, wrap_y);
+        }
+        else
+        {
+            overlap_tally =
+                detail::fusedNearestFeatureTransform<vigra::omp::fh::detail::LabeledEuclideanTransform1D,
+                                                     vigra::omp::fh::detail::LabeledPeriodicEuclideanTransform1D>
+                (src1_upperleft, src1_lowerright, sa1, src2_upperleft, sa2, dest_upperleft, da, wrap_x, wrap_y);
+        }
     }
-
-    if (Verbose >= VERBOSE_NFT_MESSAGES)
+    else
     {
-        std::cerr << " 3/3";
-        std::cerr.flush();
+        overlap_tally =
+            detail::differenceNearestFeatureTransform(src1_upperleft, src1_lowerright, sa1,
+                                                      src2_upperleft, sa2,
+                                                      dest_upperleft, da,
+                                                      norm, boundary, overlap_threshold);
     }
 
-    const unsigned overlap_tally = std::max(tally12, tally21);
     if (overlap_tally < overlap_threshold)
     {
         std::cerr << "\n" <<
@@ -537,13 +837,6 @@ nearestFeatureTransform(SrcImageIterator src1_upperleft, SrcImageIterator src1_l
         exit(1);
     }
 
-    vigra::omp::combineTwoImages(dist12.upperLeft(), dist12.lowerRight(), dist12.accessor(),
-                                 dist21.upperLeft(), dist21.accessor(),
-                                 dest_upperleft, da,
-                                 ifThenElse(vigra::functor::Arg1() < vigra::functor::Arg2(),
-                                            vigra::functor::Param(DestPixelTraits::max()),
-                                            vigra::functor::Param(DestPixelTraits::zero())));
-
     if (Verbose >= VERBOSE_NFT_MESSAGES)
     {
         std::cerr << std::endl;
@@ -31,6 +31,7 @@
 #include <vigra/utilities.hxx>
 
 #include "common.h"
+#include "mapped_storage.h"
 
 
 namespace enblend
@@ -103,7 +103,7 @@ namespace ocl
         {
             query_device_extensions(f_.device(), std::back_inserter(extensions_));
             has_extension_fp64_ =
-                !parameter::as_boolean("force-opencl-anneal-float", false) &&
+                !parameter::force_opencl_anneal_float.value() &&
                 std::find(extensions_.begin(), extensions_.end(), "cl_khr_fp64") != extensions_.end();
 
             if (has_extension_fp64_)
@@ -337,7 +337,7 @@ namespace ocl
 
             cl::Event::waitForEvents(unmap_buffer_prereq_);
 
-            if (parameter::as_boolean("profile-state-probabilities", false))
+            if (parameter::profile_state_probabilities.value())
             {
                 show_profile_data(state_probabilities->size(), local_k);
             }
@@ -283,8 +283,6 @@ namespace opencl_exposure_weight
 
     class OpenCLUserExposureWeight : public ExposureWeight
     {
-        enum {OPENCL_USER_WEIGHT_SAMPLES = 32U};
-
     public:
         OpenCLUserExposureWeight() = delete;
 
@@ -294,7 +292,7 @@ namespace opencl_exposure_weight
             source_file_name_(source_file_name),
             weight_function_name_(weight_function_name),
             user_weight_function_(ocl::create_function<UserWeightFunction>(GPUContext)),
-            number_of_samples_(parameter::as_unsigned("opencl-user-weight-samples", OPENCL_USER_WEIGHT_SAMPLES))
+            number_of_samples_(parameter::opencl_user_weight_samples.value())
         {}
 
         OpenCLUserExposureWeight(const std::string& source_file_name,
@@ -304,7 +302,7 @@ namespace opencl_exposure_weight
             source_file_name_(source_file_name),
             weight_function_name_(weight_function_name),
             user_weight_function_(ocl::create_function<UserWeightFunction>(GPUContext)),
-            number_of_samples_(parameter::as_unsigned("opencl-user-weight-samples", OPENCL_USER_WEIGHT_SAMPLES))
+            number_of_samples_(parameter::opencl_user_weight_samples.value())
         {}
 
         void initialize(double y_optimum, double width_parameter,
@@ -336,7 +334,7 @@ namespace opencl_exposure_weight
 
             {
                 std::ostringstream user_code;
-                if (parameter::as_boolean("consult-opencl-user-exposure-weight-file", true))
+                if (parameter::consult_opencl_user_exposure_weight_file.value())
                 {
                     user_code <<
                         "#line 1 \"" << source_file_name_ << "\"\n" <<
@@ -420,6 +418,19 @@ namespace opencl_exposure_weight
             return weight_samples_[std::lround(y * static_cast<double>(number_of_samples_ - 1))];
         }
 
+        void weight_batch(const double* ys, double* ws, size_t n) override
+        {
+            const double scale = static_cast<double>(number_of_samples_ - 1);
+
+            for (size_t i = 0U; i != n; ++i)
+            {
+                assert(ys[i] >= 0.0);
+                assert(ys[i] <= 1.0);
+
+                ws[i] = weight_samples_[std::lround(ys[i] * scale)];
+            }
+        }
+
     private:
         std::string source_file_name_;
         std::string weight_function_name_;
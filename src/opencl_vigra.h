@@ -126,14 +126,16 @@ namespace vigra
                      source_accessor a_source_accessor,
                      destination_iterator a_destination_upperleft, destination_accessor a_destination_accessor,
                      value_type a_background_value,
-                     int a_distance_norm)
+                     int a_distance_norm,
+                     bool a_wrap_x = false, bool a_wrap_y = false)
             {
                 try
                 {
                     run0(a_source_upperleft, a_source_lowerright, a_source_accessor,
                          a_destination_upperleft, a_destination_accessor,
                          a_background_value,
-                         a_distance_norm);
+                         a_distance_norm,
+                         a_wrap_x, a_wrap_y);
                     return;
                 }
                 catch (cl::Error& a_cl_error)
@@ -156,10 +158,22 @@ namespace vigra
                         std::endl;
                 }
 
-                vigra::omp::distanceTransform(a_source_upperleft, a_source_lowerright, a_source_accessor,
-                                              a_destination_upperleft, a_destination_accessor,
-                                              a_background_value,
-                                              a_distance_norm);
+                if (a_wrap_x || a_wrap_y)
+                {
+                    vigra::omp::periodicDistanceTransform(a_source_upperleft, a_source_lowerright,
+                                                          a_source_accessor,
+                                                          a_destination_upperleft, a_destination_accessor,
+                                                          a_background_value,
+                                                          a_distance_norm,
+                                                          a_wrap_x, a_wrap_y);
+                }
+                else
+                {
+                    vigra::omp::distanceTransform(a_source_upperleft, a_source_lowerright, a_source_accessor,
+                                                  a_destination_upperleft, a_destination_accessor,
+                                                  a_background_value,
+                                                  a_distance_norm);
+                }
             }
 
             template <class source_iterator, class source_accessor,
@@ -168,12 +182,14 @@ namespace vigra
             void run(vigra::triple<source_iterator, source_iterator, source_accessor> a_source,
                      vigra::pair<destination_iterator, destination_accessor> a_destination,
                      value_type a_background,
-                     int a_distance_norm)
+                     int a_distance_norm,
+                     bool a_wrap_x = false, bool a_wrap_y = false)
             {
                 run(a_source.first, a_source.second, a_source.third,
                     a_destination.first, a_destination.second,
                     a_background,
-                    a_distance_norm);
+                    a_distance_norm,
+                    a_wrap_x, a_wrap_y);
             }
 
         private:
@@ -184,7 +200,8 @@ namespace vigra
                       source_accessor a_source_accessor,
                       destination_iterator a_destination_upperleft, destination_accessor a_destination_accessor,
                       value_type a_background_value,
-                      int a_distance_norm)
+                      int a_distance_norm,
+                      bool a_wrap_x, bool a_wrap_y)
             {
                 wait();         // Ensure that all kernels were built.
 
@@ -210,7 +227,7 @@ namespace vigra
                 const cl::NDRange row_global_size(work_group_size(size.height()));
                 const cl::NDRange local_size(16U);
 
-                setup(a_distance_norm, size);
+                setup(a_distance_norm, size, a_wrap_x, a_wrap_y);
 
                 f_.queue().enqueueWriteBuffer(output_buffer_, CL_FALSE, 0U, buffer_size,
                                               buffer_begin,
@@ -237,7 +254,7 @@ namespace vigra
 
                 f_.queue().enqueueUnmapMemObject(output_buffer_, buffer_begin, &unmap_buffer_prereq_, &done_);
 
-                if (parameter::as_boolean("time-distance-transform", false))
+                if (parameter::time_distance_transform.value())
                 {
                     show_profile_data(size);
                 }
@@ -318,11 +335,18 @@ namespace vigra
                 work_group_size_ = std::min(device_max_group_size, kernel_group_size);
             }
 
-            void setup(int a_distance_norm, const vigra::Size2D& a_size)
+            void setup(int a_distance_norm, const vigra::Size2D& a_size, bool a_wrap_x, bool a_wrap_y)
             {
                 const size_t max_length = static_cast<size_t>(std::max(a_size.width(), a_size.height()));
                 const size_t float_size = max_length * max_length * sizeof(cl_float);
-                const size_t int_size = max_length * max_length * sizeof(cl_int);
+                // The Euclidean transform needs n + 1 elements of v and z,
+                // its periodic variant 2 * n + 3.
+                const size_t row_envelope_stride = a_wrap_x ? 2U * max_length + 3U : max_length + 1U;
+                const size_t column_envelope_stride = a_wrap_y ? 2U * max_length + 3U : max_length + 1U;
+                const size_t envelope_length =
+                    max_length * std::max(row_envelope_stride, column_envelope_stride);
+                const size_t envelope_int_size = envelope_length * sizeof(cl_int);
+                const size_t envelope_float_size = envelope_length * sizeof(cl_float);
 
                 f_scratch_buffer_ = new cl::Buffer(f_.context(), CL_MEM_READ_WRITE, float_size);
                 d_scratch_buffer_ = new cl::Buffer(f_.context(), CL_MEM_READ_WRITE, float_size);
@@ -352,17 +376,27 @@ namespace vigra
                 column_kernel.setArg(3U, *f_scratch_buffer_);
                 column_kernel.setArg(4U, *d_scratch_buffer_);
 
+                cl_uint wrap_argument = 5U;
                 if (a_distance_norm >= 2)
                 {
-                    v_scratch_buffer_ = new cl::Buffer(f_.context(), CL_MEM_READ_WRITE, int_size);
-                    z_scratch_buffer_ = new cl::Buffer(f_.context(), CL_MEM_READ_WRITE, float_size);
+                    v_scratch_buffer_ = new cl::Buffer(f_.context(), CL_MEM_READ_WRITE, envelope_int_size);
+                    z_scratch_buffer_ = new cl::Buffer(f_.context(), CL_MEM_READ_WRITE, envelope_float_size);
 
                     row_kernel.setArg(5U, *v_scratch_buffer_);
                     row_kernel.setArg(6U, *z_scratch_buffer_);
 
                     column_kernel.setArg(5U, *v_scratch_buffer_);
                     column_kernel.setArg(6U, *z_scratch_buffer_);
+
+                    row_kernel.setArg(7U, static_cast<cl_int>(row_envelope_stride));
+                    column_kernel.setArg(7U, static_cast<cl_int>(column_envelope_stride));
+
+                    wrap_argument = 8U;
                 }
+
+                // Rows run along x, columns along y.
+                row_kernel.setArg(wrap_argument, static_cast<cl_int>(a_wrap_x));
+                column_kernel.setArg(wrap_argument, static_cast<cl_int>(a_wrap_y));
             }
 
             void teardown(int a_distance_norm __attribute__((unused)))
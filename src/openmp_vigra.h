@@ -32,6 +32,7 @@
 #include <vigra/convolution.hxx>
 #include <vigra/distancetransform.hxx>
 
+#include "muopt.h"
 #include "openmp_def.h"
 
 
@@ -39,6 +40,579 @@ namespace vigra
 {
     namespace omp
     {
+        namespace fh
+        {
+            namespace detail
+            {
+                template <class ValueType>
+                inline static ValueType
+                square(ValueType x)
+                {
+                    return x * x;
+                }
+
+
+                // Pedro F. Felzenszwalb, Daniel P. Huttenlocher
+                // "Distance Transforms of Sampled Functions"
+
+
+                template <class ValueType>
+                struct ChessboardTransform1D
+                {
+                    typedef ValueType value_type;
+
+                    int id() const {return 0;}
+
+                    void operator()(ValueType* /* RESTRICT d */, const ValueType* /* RESTRICT f */, int /* n */) const
+                    {
+                        vigra_fail("fh::detail::ChessboardTransform1D: not implemented");
+                    }
+                };
+
+
+                template <class ValueType>
+                struct ManhattanTransform1D
+                {
+                    typedef ValueType value_type;
+
+                    int id() const {return 1;}
+
+                    void operator()(ValueType* RESTRICT d, const ValueType* RESTRICT f, int n) const
+                    {
+                        const ValueType one = static_cast<ValueType>(1);
+
+                        d[0] = f[0];
+                        for (int q = 1; q < n; ++q)
+                        {
+                            d[q] = std::min<ValueType>(f[q], d[q - 1] + one);
+                        }
+                        for (int q = n - 2; q >= 0; --q)
+                        {
+                            d[q] = std::min<ValueType>(d[q], d[q + 1] + one);
+                        }
+                    }
+                };
+
+
+                template <class ValueType>
+                struct EuclideanTransform1D
+                {
+                    typedef ValueType value_type;
+
+                    int id() const {return 2;}
+
+                    void operator()(ValueType* RESTRICT d, const ValueType* RESTRICT f, int n) const
+                    {
+                        typedef float math_t;
+
+                        const math_t infinity = std::numeric_limits<math_t>::infinity();
+
+                        int* v = static_cast<int*>(::omp::malloc(n * sizeof(int)));
+                        math_t* z = static_cast<math_t*>(::omp::malloc((n + 1) * sizeof(math_t)));
+                        int k = 0;
+
+                        v[0] = 0;
+                        z[0] = -infinity;
+                        z[1] = infinity;
+
+                        for (int q = 1; q < n; ++q)
+                        {
+                            const math_t sum_q = static_cast<math_t>(f[q]) + square(static_cast<math_t>(q));
+                            math_t s = (sum_q - (f[v[k]] + square(v[k]))) / (2 * (q - v[k]));
+
+                            while (s <= z[k])
+                            {
+                                --k;
+                                // IMPLEMENTATION NOTE
+                                //     Prefetching improves performance because we must iterate from high to
+                                //     low addresses, i.e. against the cache's look-ahead algorithm.
+                                HINTED_PREFETCH(z + k - 2U, PREPARE_FOR_READ, HIGH_TEMPORAL_LOCALITY);
+                                s = (sum_q - (f[v[k]] + square(v[k]))) / (2 * (q - v[k]));
+                            }
+                            ++k;
+
+                            v[k] = q;
+                            z[k] = s;
+                            z[k + 1] = infinity;
+                        }
+
+                        k = 0;
+                        for (int q = 0; q < n; ++q)
+                        {
+                            while (z[k + 1] < static_cast<math_t>(q))
+                            {
+                                ++k;
+                            }
+                            d[q] = square(q - v[k]) + f[v[k]];
+                        }
+
+                        ::omp::free(z);
+                        ::omp::free(v);
+                    }
+                };
+
+
+                // The periodic variants treat their 1-D domain as a
+                // ring of n samples, i.e. the distance between q and j
+                // is min(|q - j|, n - |q - j|).  They compute exactly
+                // what their non-periodic counterparts would compute in
+                // the middle of three copies of f, but in O(n) time and
+                // without any copies.
+
+                template <class ValueType>
+                struct PeriodicManhattanTransform1D
+                {
+                    typedef ValueType value_type;
+
+                    int id() const {return 1;}
+
+                    void operator()(ValueType* RESTRICT d, const ValueType* RESTRICT f, int n) const
+                    {
+                        const ValueType one = static_cast<ValueType>(1);
+
+                        // Two laps in each direction let every sample
+                        // reach every other one across the seam.
+                        d[0] = f[0];
+                        for (int q = 1; q < n; ++q)
+                        {
+                            d[q] = std::min<ValueType>(f[q], d[q - 1] + one);
+                        }
+                        d[0] = std::min<ValueType>(d[0], d[n - 1] + one);
+                        for (int q = 1; q < n; ++q)
+                        {
+                            d[q] = std::min<ValueType>(d[q], d[q - 1] + one);
+                        }
+
+                        for (int lap = 0; lap != 2; ++lap)
+                        {
+                            d[n - 1] = std::min<ValueType>(d[n - 1], d[0] + one);
+                            for (int q = n - 2; q >= 0; --q)
+                            {
+                                d[q] = std::min<ValueType>(d[q], d[q + 1] + one);
+                            }
+                        }
+                    }
+                };
+
+
+                template <class ValueType>
+                struct PeriodicEuclideanTransform1D
+                {
+                    typedef ValueType value_type;
+
+                    int id() const {return 2;}
+
+                    void operator()(ValueType* RESTRICT d, const ValueType* RESTRICT f, int n) const
+                    {
+                        typedef float math_t;
+
+                        const math_t infinity = std::numeric_limits<math_t>::infinity();
+
+                        // No sample is farther than n/2 from q on the
+                        // ring, so the parabolas rooted at -h..n+h-1
+                        // cover all q in 0..n-1.
+                        const int h = std::min(n, n / 2 + 1);
+                        const int m = n + 2 * h;
+                        auto f_at = [=](int j) {return static_cast<math_t>(f[(j + n) % n]);};
+
+                        int* v = static_cast<int*>(::omp::malloc(m * sizeof(int)));
+                        math_t* z = static_cast<math_t*>(::omp::malloc((m + 1) * sizeof(math_t)));
+                        int k = 0;
+
+                        v[0] = -h;
+                        z[0] = -infinity;
+                        z[1] = infinity;
+
+                        for (int q = 1 - h; q < n + h; ++q)
+                        {
+                            const math_t sum_q = f_at(q) + square(static_cast<math_t>(q));
+                            math_t s = (sum_q - (f_at(v[k]) + square(static_cast<math_t>(v[k])))) / (2 * (q - v[k]));
+
+                            while (s <= z[k])
+                            {
+                                --k;
+                                s = (sum_q - (f_at(v[k]) + square(static_cast<math_t>(v[k])))) / (2 * (q - v[k]));
+                            }
+                            ++k;
+
+                            v[k] = q;
+                            z[k] = s;
+                            z[k + 1] = infinity;
+                        }
+
+                        k = 0;
+                        for (int q = 0; q < n; ++q)
+                        {
+                            while (z[k + 1] < static_cast<math_t>(q))
+                            {
+                                ++k;
+                            }
+                            d[q] = square(q - v[k]) + f_at(v[k]);
+                        }
+
+                        ::omp::free(z);
+                        ::omp::free(v);
+                    }
+                };
+
+
+                // The labeled variants additionally report for each q the
+                // label fl[j] of the sample j that realizes the minimum,
+                // i.e. they compute a nearest-feature transform.  Ties
+                // keep the label found first.  The Euclidean variants
+                // compute in ValueType, so that fractional offsets of
+                // large distances survive in double precision.
+
+                template <class ValueType, class LabelType>
+                struct LabeledManhattanTransform1D
+                {
+                    typedef ValueType value_type;
+                    typedef LabelType label_type;
+
+                    void operator()(ValueType* RESTRICT d, LabelType* RESTRICT dl,
+                                    const ValueType* RESTRICT f, const LabelType* RESTRICT fl,
+                                    int n) const
+                    {
+                        const ValueType one = static_cast<ValueType>(1);
+
+                        d[0] = f[0];
+                        dl[0] = fl[0];
+                        for (int q = 1; q < n; ++q)
+                        {
+                            if (d[q - 1] + one < f[q])
+                            {
+                                d[q] = d[q - 1] + one;
+                                dl[q] = dl[q - 1];
+                            }
+                            else
+                            {
+                                d[q] = f[q];
+                                dl[q] = fl[q];
+                            }
+                        }
+                        for (int q = n - 2; q >= 0; --q)
+                        {
+                            if (d[q + 1] + one < d[q])
+                            {
+                                d[q] = d[q + 1] + one;
+                                dl[q] = dl[q + 1];
+                            }
+                        }
+                    }
+                };
+
+
+                template <class ValueType, class LabelType>
+                struct LabeledPeriodicManhattanTransform1D
+                {
+                    typedef ValueType value_type;
+                    typedef LabelType label_type;
+
+                    void operator()(ValueType* RESTRICT d, LabelType* RESTRICT dl,
+                                    const ValueType* RESTRICT f, const LabelType* RESTRICT fl,
+                                    int n) const
+                    {
+                        const ValueType one = static_cast<ValueType>(1);
+
+                        LabeledManhattanTransform1D<ValueType, LabelType>()(d, dl, f, fl, n);
+
+                        // After the open sweeps one wrapped lap in each
+                        // direction carries every sample across the seam.
+                        if (d[n - 1] + one < d[0])
+                        {
+                            d[0] = d[n - 1] + one;
+                            dl[0] = dl[n - 1];
+                        }
+                        for (int q = 1; q < n; ++q)
+                        {
+                            if (d[q - 1] + one < d[q])
+                            {
+                                d[q] = d[q - 1] + one;
+                                dl[q] = dl[q - 1];
+                            }
+                        }
+
+                        if (d[0] + one < d[n - 1])
+                        {
+                            d[n - 1] = d[0] + one;
+                            dl[n - 1] = dl[0];
+                        }
+                        for (int q = n - 2; q >= 0; --q)
+                        {
+                            if (d[q + 1] + one < d[q])
+                            {
+                                d[q] = d[q + 1] + one;
+                                dl[q] = dl[q + 1];
+                            }
+                        }
+                    }
+                };
+
+
+                template <class ValueType, class LabelType>
+                struct LabeledEuclideanTransform1D
+                {
+                    typedef ValueType value_type;
+                    typedef LabelType label_type;
+
+                    void operator()(ValueType* RESTRICT d, LabelType* RESTRICT dl,
+                                    const ValueType* RESTRICT f, const LabelType* RESTRICT fl,
+                                    int n) const
+                    {
+                        typedef ValueType math_t;
+
+                        const math_t infinity = std::numeric_limits<math_t>::infinity();
+
+                        int* v = static_cast<int*>(::omp::malloc(n * sizeof(int)));
+                        math_t* z = static_cast<math_t*>(::omp::malloc((n + 1) * sizeof(math_t)));
+                        int k = 0;
+
+                        v[0] = 0;
+                        z[0] = -infinity;
+                        z[1] = infinity;
+
+                        for (int q = 1; q < n; ++q)
+                        {
+                            const math_t sum_q = static_cast<math_t>(f[q]) + square(static_cast<math_t>(q));
+                            math_t s = (sum_q - (f[v[k]] + square(v[k]))) / (2 * (q - v[k]));
+
+                            while (s <= z[k])
+                            {
+                                --k;
+                                s = (sum_q - (f[v[k]] + square(v[k]))) / (2 * (q - v[k]));
+                            }
+                            ++k;
+
+                            v[k] = q;
+                            z[k] = s;
+                            z[k + 1] = infinity;
+                        }
+
+                        k = 0;
+                        for (int q = 0; q < n; ++q)
+                        {
+                            while (z[k + 1] < static_cast<math_t>(q))
+                            {
+                                ++k;
+                            }
+                            d[q] = square(q - v[k]) + f[v[k]];
+                            dl[q] = fl[v[k]];
+                        }
+
+                        ::omp::free(z);
+                        ::omp::free(v);
+                    }
+                };
+
+
+                template <class ValueType, class LabelType>
+                struct LabeledPeriodicEuclideanTransform1D
+                {
+                    typedef ValueType value_type;
+                    typedef LabelType label_type;
+
+                    void operator()(ValueType* RESTRICT d, LabelType* RESTRICT dl,
+                                    const ValueType* RESTRICT f, const LabelType* RESTRICT fl,
+                                    int n) const
+                    {
+                        typedef ValueType math_t;
+
+                        const math_t infinity = std::numeric_limits<math_t>::infinity();
+
+                        const int h = std::min(n, n / 2 + 1);
+                        const int m = n + 2 * h;
+                        auto f_at = [=](int j) {return static_cast<math_t>(f[(j + n) % n]);};
+
+                        int* v = static_cast<int*>(::omp::malloc(m * sizeof(int)));
+                        math_t* z = static_cast<math_t*>(::omp::malloc((m + 1) * sizeof(math_t)));
+                        int k = 0;
+
+                        v[0] = -h;
+                        z[0] = -infinity;
+                        z[1] = infinity;
+
+                        for (int q = 1 - h; q < n + h; ++q)
+                        {
+                            const math_t sum_q = f_at(q) + square(static_cast<math_t>(q));
+                            math_t s = (sum_q - (f_at(v[k]) + square(static_cast<math_t>(v[k])))) / (2 * (q - v[k]));
+
+                            while (s <= z[k])
+                            {
+                                --k;
+                                s = (sum_q - (f_at(v[k]) + square(static_cast<math_t>(v[k])))) / (2 * (q - v[k]));
+                            }
+                            ++k;
+
+                            v[k] = q;
+                            z[k] = s;
+                            z[k + 1] = infinity;
+                        }
+
+                        k = 0;
+                        for (int q = 0; q < n; ++q)
+                        {
+                            while (z[k + 1] < static_cast<math_t>(q))
+                            {
+                                ++k;
+                            }
+                            d[q] = square(q - v[k]) + f_at(v[k]);
+                            dl[q] = fl[(v[k] + n) % n];
+                        }
+
+                        ::omp::free(z);
+                        ::omp::free(v);
+                    }
+                };
+
+
+                // Transform along the columns with column_transform, then
+                // along the rows with row_transform.
+                template <class SrcImageIterator, class SrcAccessor,
+                          class DestImageIterator, class DestAccessor,
+                          class ValueType, class ColumnTransform1dFunctor, class RowTransform1dFunctor>
+                void
+                fhDistanceTransform(SrcImageIterator src_upperleft, SrcImageIterator src_lowerright, SrcAccessor sa,
+                                    DestImageIterator dest_upperleft, DestAccessor da,
+                                    ValueType background,
+                                    ColumnTransform1dFunctor column_transform, RowTransform1dFunctor row_transform)
+                {
+                    typedef typename ColumnTransform1dFunctor::value_type DistanceType;
+                    typedef typename vigra::NumericTraits<DistanceType> DistanceTraits;
+                    typedef vigra::BasicImage<DistanceType> DistanceImageType;
+
+                    const vigra::Size2D size(src_lowerright - src_upperleft);
+                    const int greatest_length = std::max(size.x, size.y);
+                    DistanceImageType intermediate(size, vigra::SkipInitialization);
+
+#ifdef OPENMP
+#pragma omp parallel
+#endif
+                    {
+                        DistanceType* const f = new DistanceType[greatest_length];
+                        DistanceType* const d = new DistanceType[greatest_length];
+
+                        DistanceType* const pf_end = f + size.y;
+                        const DistanceType* const pd_end = d + size.y;
+
+                        // IMPLEMENTATION NOTE
+                        //     We need "guided" schedule to reduce the waiting time at the
+                        //     (implicit) barriers.  This holds true for the next OpenMP
+                        //     parallelized "for" loop, too.
+#ifdef OPENMP
+#pragma omp for schedule(guided)
+#endif
+                        for (int x = 0; x < size.x; ++x)
+                        {
+                            SrcImageIterator si(src_upperleft + vigra::Diff2D(x, 0));
+                            for (DistanceType* pf = f; pf != pf_end; ++pf)
+                            {
+                                *pf = EXPECT_RESULT(sa(si) == background, false) ? DistanceTraits::max() : DistanceTraits::zero();
+                                ++si.y;
+                            }
+
+                            column_transform(d, f, size.y);
+
+                            typename DistanceImageType::column_iterator ci(intermediate.columnBegin(x));
+                            for (const DistanceType* pd = d; pd != pd_end; ++pd)
+                            {
+                                *ci = *pd;
+                                ++ci;
+                                // IMPLEMENTATION NOTE
+                                //     Prefetching about halves the number of stalls per instruction of this loop.
+                                HINTED_PREFETCH(ci.operator->(), PREPARE_FOR_WRITE, HIGH_TEMPORAL_LOCALITY);
+                            }
+                        }
+
+#ifdef OPENMP
+#pragma omp for nowait schedule(guided)
+#endif
+                        for (int y = 0; y < size.y; ++y)
+                        {
+                            row_transform(d, &intermediate(0, y), size.x);
+                            DestImageIterator i(dest_upperleft + vigra::Diff2D(0, y));
+
+                            if (row_transform.id() == 2)
+                            {
+                                for (DistanceType* pd = d; pd != d + size.x; ++pd, ++i.x)
+                                {
+                                    da.set(sqrt(*pd), i);
+                                }
+                            }
+                            else
+                            {
+                                for (DistanceType* pd = d; pd != d + size.x; ++pd, ++i.x)
+                                {
+                                    da.set(*pd, i);
+                                }
+                            }
+                        }
+
+                        delete [] d;
+                        delete [] f;
+                    } // omp parallel
+                }
+
+
+                template <class SrcImageIterator, class SrcAccessor,
+                          class DestImageIterator, class DestAccessor,
+                          class ValueType, class Transform1dFunctor>
+                inline void
+                fhDistanceTransform(SrcImageIterator src_upperleft, SrcImageIterator src_lowerright, SrcAccessor sa,
+                                    DestImageIterator dest_upperleft, DestAccessor da,
+                                    ValueType background, Transform1dFunctor transform1d)
+                {
+                    fhDistanceTransform(src_upperleft, src_lowerright, sa,
+                                        dest_upperleft, da,
+                                        background,
+                                        transform1d, transform1d);
+                }
+
+
+                template <template <class> class Transform1dFunctor,
+                          template <class> class PeriodicTransform1dFunctor,
+                          class SrcImageIterator, class SrcAccessor,
+                          class DestImageIterator, class DestAccessor,
+                          class ValueType>
+                inline void
+                fhPeriodicDistanceTransform(SrcImageIterator src_upperleft, SrcImageIterator src_lowerright,
+                                            SrcAccessor sa,
+                                            DestImageIterator dest_upperleft, DestAccessor da,
+                                            ValueType background, bool wrap_x, bool wrap_y)
+                {
+                    typedef Transform1dFunctor<float> open_t;
+                    typedef PeriodicTransform1dFunctor<float> periodic_t;
+
+                    if (wrap_y)
+                    {
+                        if (wrap_x)
+                        {
+                            fhDistanceTransform(src_upperleft, src_lowerright, sa, dest_upperleft, da,
+                                                background, periodic_t(), periodic_t());
+                        }
+                        else
+                        {
+                            fhDistanceTransform(src_upperleft, src_lowerright, sa, dest_upperleft, da,
+                                                background, periodic_t(), open_t());
+                        }
+                    }
+                    else
+                    {
+                        if (wrap_x)
+                        {
+                            fhDistanceTransform(src_upperleft, src_lowerright, sa, dest_upperleft, da,
+                                                background, open_t(), periodic_t());
+                        }
+                        else
+                        {
+                            fhDistanceTransform(src_upperleft, src_lowerright, sa, dest_upperleft, da,
+                                                background, open_t(), open_t());
+                        }
+                    }
+                }
+            } // namespace detail
+        } // namespace fh
+
+
 #ifdef OPENMP
         template <class SrcImageIterator1, class SrcAccessor1,
                   class SrcImageIterator2, class SrcAccessor2,
@@ -242,199 +816,6 @@ namespace vigra
         }
 
 
-        namespace fh
-        {
-            namespace detail
-            {
-                template <class ValueType>
-                inline static ValueType
-                square(ValueType x)
-                {
-                    return x * x;
-                }
-
-
-                // Pedro F. Felzenszwalb, Daniel P. Huttenlocher
-                // "Distance Transforms of Sampled Functions"
-
-
-                template <class ValueType>
-                struct ChessboardTransform1D
-                {
-                    typedef ValueType value_type;
-
-                    int id() const {return 0;}
-
-                    void operator()(ValueType* /* RESTRICT d */, const ValueType* /* RESTRICT f */, int /* n */) const
-                    {
-                        vigra_fail("fh::detail::ChessboardTransform1D: not implemented");
-                    }
-                };
-
-
-                template <class ValueType>
-                struct ManhattanTransform1D
-                {
-                    typedef ValueType value_type;
-
-                    int id() const {return 1;}
-
-                    void operator()(ValueType* RESTRICT d, const ValueType* RESTRICT f, int n) const
-                    {
-                        const ValueType one = static_cast<ValueType>(1);
-
-                        d[0] = f[0];
-                        for (int q = 1; q < n; ++q)
-                        {
-                            d[q] = std::min<ValueType>(f[q], d[q - 1] + one);
-                        }
-                        for (int q = n - 2; q >= 0; --q)
-                        {
-                            d[q] = std::min<ValueType>(d[q], d[q + 1] + one);
-                        }
-                    }
-                };
-
-
-                template <class ValueType>
-                struct EuclideanTransform1D
-                {
-                    typedef ValueType value_type;
-
-                    int id() const {return 2;}
-
-                    void operator()(ValueType* RESTRICT d, const ValueType* RESTRICT f, int n) const
-                    {
-                        typedef float math_t;
-
-                        const math_t infinity = std::numeric_limits<math_t>::infinity();
-
-                        int* v = static_cast<int*>(::omp::malloc(n * sizeof(int)));
-                        math_t* z = static_cast<math_t*>(::omp::malloc((n + 1) * sizeof(math_t)));
-                        int k = 0;
-
-                        v[0] = 0;
-                        z[0] = -infinity;
-                        z[1] = infinity;
-
-                        for (int q = 1; q < n; ++q)
-                        {
-                            const math_t sum_q = static_cast<math_t>(f[q]) + square(static_cast<math_t>(q));
-                            math_t s = (sum_q - (f[v[k]] + square(v[k]))) / (2 * (q - v[k]));
-
-                            while (s <= z[k])
-                            {
-                                --k;
-                                // IMPLEMENTATION NOTE
-                                //     Prefetching improves performance because we must iterate from high to
-                                //     low addresses, i.e. against the cache's look-ahead algorithm.
-                                HINTED_PREFETCH(z + k - 2U, PREPARE_FOR_READ, HIGH_TEMPORAL_LOCALITY);
-                                s = (sum_q - (f[v[k]] + square(v[k]))) / (2 * (q - v[k]));
-                            }
-                            ++k;
-
-                            v[k] = q;
-                            z[k] = s;
-                            z[k + 1] = infinity;
-                        }
-
-                        k = 0;
-                        for (int q = 0; q < n; ++q)
-                        {
-                            while (z[k + 1] < static_cast<math_t>(q))
-                            {
-                                ++k;
-                            }
-                            d[q] = square(q - v[k]) + f[v[k]];
-                        }
-
-                        ::omp::free(z);
-                        ::omp::free(v);
-                    }
-                };
-
-
-                template <class SrcImageIterator, class SrcAccessor,
-                          class DestImageIterator, class DestAccessor,
-                          class ValueType, class Transform1dFunctor>
-                void
-                fhDistanceTransform(SrcImageIterator src_upperleft, SrcImageIterator src_lowerright, SrcAccessor sa,
-                                    DestImageIterator dest_upperleft, DestAccessor da,
-                                    ValueType background, Transform1dFunctor transform1d)
-                {
-                    typedef typename Transform1dFunctor::value_type DistanceType;
-                    typedef typename vigra::NumericTraits<DistanceType> DistanceTraits;
-                    typedef vigra::BasicImage<DistanceType> DistanceImageType;
-
-                    const vigra::Size2D size(src_lowerright - src_upperleft);
-                    const int greatest_length = std::max(size.x, size.y);
-                    DistanceImageType intermediate(size, vigra::SkipInitialization);
-
-#pragma omp parallel
-                    {
-                        DistanceType* const f = new DistanceType[greatest_length];
-                        DistanceType* const d = new DistanceType[greatest_length];
-
-                        DistanceType* const pf_end = f + size.y;
-                        const DistanceType* const pd_end = d + size.y;
-
-                        // IMPLEMENTATION NOTE
-                        //     We need "guided" schedule to reduce the waiting time at the
-                        //     (implicit) barriers.  This holds true for the next OpenMP
-                        //     parallelized "for" loop, too.
-#pragma omp for schedule(guided)
-                        for (int x = 0; x < size.x; ++x)
-                        {
-                            SrcImageIterator si(src_upperleft + vigra::Diff2D(x, 0));
-                            for (DistanceType* pf = f; pf != pf_end; ++pf)
-                            {
-                                *pf = EXPECT_RESULT(sa(si) == background, false) ? DistanceTraits::max() : DistanceTraits::zero();
-                                ++si.y;
-                            }
-
-                            transform1d(d, f, size.y);
-
-                            typename DistanceImageType::column_iterator ci(intermediate.columnBegin(x));
-                            for (const DistanceType* pd = d; pd != pd_end; ++pd)
-                            {
-                                *ci = *pd;
-                                ++ci;
-                                // IMPLEMENTATION NOTE
-                                //     Prefetching about halves the number of stalls per instruction of this loop.
-                                HINTED_PREFETCH(ci.operator->(), PREPARE_FOR_WRITE, HIGH_TEMPORAL_LOCALITY);
-                            }
-                        }
-
-#pragma omp for nowait schedule(guided)
-                        for (int y = 0; y < size.y; ++y)
-                        {
-                            transform1d(d, &intermediate(0, y), size.x);
-                            DestImageIterator i(dest_upperleft + vigra::Diff2D(0, y));
-
-                            if (transform1d.id() == 2)
-                            {
-                                for (DistanceType* pd = d; pd != d + size.x; ++pd, ++i.x)
-                                {
-                                    da.set(sqrt(*pd), i);
-                                }
-                            }
-                            else
-                            {
-                                for (DistanceType* pd = d; pd != d + size.x; ++pd, ++i.x)
-                                {
-                                    da.set(*pd, i);
-                                }
-                            }
-                        }
-
-                        delete [] d;
-                        delete [] f;
-                    } // omp parallel
-                }
-            } // namespace detail
-        } // namespace fh
-
-
         template <class SrcImageIterator, class SrcAccessor,
                   class DestImageIterator, class DestAccessor,
                   class ValueType>
@@ -601,6 +982,39 @@ namespace vigra
 #endif // OPENMP
 
 
+        // Distance transform of an image whose left and right edges
+        // (wrap_x) and/or top and bottom edges (wrap_y) are glued
+        // together.  Only the Manhattan (1) and the Euclidean (2) norm
+        // are available.
+        template <class SrcImageIterator, class SrcAccessor,
+                  class DestImageIterator, class DestAccessor,
+                  class ValueType>
+        void
+        periodicDistanceTransform(SrcImageIterator src_upperleft, SrcImageIterator src_lowerright, SrcAccessor sa,
+                                  DestImageIterator dest_upperleft, DestAccessor da,
+                                  ValueType background, int norm, bool wrap_x, bool wrap_y)
+        {
+            switch (norm)
+            {
+            case 1:
+                fh::detail::fhPeriodicDistanceTransform<fh::detail::ManhattanTransform1D,
+                                                        fh::detail::PeriodicManhattanTransform1D>
+                    (src_upperleft, src_lowerright, sa, dest_upperleft, da, background, wrap_x, wrap_y);
+                break;
+
+            case 0:
+                vigra_fail("vigra::omp::periodicDistanceTransform: chessboard norm not implemented");
+                break;
+
+            case 2: // FALLTHROUGH
+            default:
+                fh::detail::fhPeriodicDistanceTransform<fh::detail::EuclideanTransform1D,
+                                                        fh::detail::PeriodicEuclideanTransform1D>
+                    (src_upperleft, src_lowerright, sa, dest_upperleft, da, background, wrap_x, wrap_y);
+            }
+        }
+
+
         //
         // Argument Object Factory versions
         //
@@ -730,6 +1144,20 @@ namespace vigra
                                           dest.first, dest.second,
                                           background, norm);
         }
+
+
+        template <class SrcImageIterator, class SrcAccessor,
+                  class DestImageIterator, class DestAccessor,
+                  class ValueType>
+        inline void
+        periodicDistanceTransform(vigra::triple<SrcImageIterator, SrcImageIterator, SrcAccessor> src,
+                                  vigra::pair<DestImageIterator, DestAccessor> dest,
+                                  ValueType background, int norm, bool wrap_x, bool wrap_y)
+        {
+            vigra::omp::periodicDistanceTransform(src.first, src.second, src.third,
+                                                  dest.first, dest.second,
+                                                  background, norm, wrap_x, wrap_y);
+        }
     } // namespace omp
 } // namespace vigra
 
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2017 Christoph Spiel
+ *
+ * This file is part of Enblend.
+ *
+ * Enblend is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Enblend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Enblend; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef OVERLAP_H_INCLUDED
+#define OVERLAP_H_INCLUDED
+
+#include <vigra/numerictraits.hxx>
+#include <vigra/utilities.hxx>
+
+
+namespace enblend
+{
+    // Which of the two images of a pair cover a pixel.
+    typedef vigra::UInt8 OverlapPixelType;
+
+    enum overlap_t {
+        OVERLAP_NONE = 0,
+        OVERLAP_WHITE = 1,
+        OVERLAP_BLACK = 2,
+        OVERLAP_BOTH = OVERLAP_WHITE | OVERLAP_BLACK
+    };
+
+
+    // Analyze the overlap of a pair of images in a single sweep.
+    //
+    // For every pixel, write the overlap_t flags of the two masks to
+    // the flag image and the pixel difference to the destination.
+    // Outside of the intersection, the difference is the maximum of
+    // the destination type, which is what all seam-line optimizers
+    // want.  Both the seam generator and the optimizers share the
+    // results, so nobody needs to revisit the (possibly huge) source
+    // images or masks just to find out where the pair overlaps.
+    template <class SrcImageIterator1, class SrcAccessor1,
+              class SrcImageIterator2, class SrcAccessor2,
+              class MaskImageIterator1, class MaskAccessor1,
+              class MaskImageIterator2, class MaskAccessor2,
+              class DestImageIterator, class DestAccessor,
+              class FlagImageIterator, class FlagAccessor,
+              class Functor>
+    inline void
+    analyzeOverlap(SrcImageIterator1 src1_upperleft, SrcImageIterator1 src1_lowerright, SrcAccessor1 sa1,
+                   SrcImageIterator2 src2_upperleft, SrcAccessor2 sa2,
+                   MaskImageIterator1 mask1_upperleft, MaskAccessor1 ma1,
+                   MaskImageIterator2 mask2_upperleft, MaskAccessor2 ma2,
+                   DestImageIterator dest_upperleft, DestAccessor da,
+                   FlagImageIterator flag_upperleft, FlagAccessor fa,
+                   const Functor& difference)
+    {
+        typedef typename DestAccessor::value_type DestPixelType;
+        typedef typename MaskAccessor1::value_type MaskPixelType1;
+        typedef typename MaskAccessor2::value_type MaskPixelType2;
+
+        const vigra::Size2D size(src1_lowerright - src1_upperleft);
+        const DestPixelType noOverlap(vigra::NumericTraits<DestPixelType>::max());
+
+#ifdef OPENMP
+#pragma omp parallel
+#endif
+        {
+            Functor f(difference);
+
+#ifdef OPENMP
+#pragma omp for schedule(guided) nowait
+#endif
+            for (int y = 0; y < size.y; ++y)
+            {
+                const vigra::Diff2D begin(0, y);
+
+                typename SrcImageIterator1::row_iterator s1((src1_upperleft + begin).rowIterator());
+                typename SrcImageIterator2::row_iterator s2((src2_upperleft + begin).rowIterator());
+                typename MaskImageIterator1::row_iterator m1((mask1_upperleft + begin).rowIterator());
+                typename MaskImageIterator2::row_iterator m2((mask2_upperleft + begin).rowIterator());
+                typename DestImageIterator::row_iterator d((dest_upperleft + begin).rowIterator());
+                typename FlagImageIterator::row_iterator g((flag_upperleft + begin).rowIterator());
+
+                for (int x = 0; x < size.x; ++x, ++s1, ++s2, ++m1, ++m2, ++d, ++g)
+                {
+                    const OverlapPixelType flags =
+                        (ma1(m1) != vigra::NumericTraits<MaskPixelType1>::zero() ? OVERLAP_WHITE : OVERLAP_NONE) |
+                        (ma2(m2) != vigra::NumericTraits<MaskPixelType2>::zero() ? OVERLAP_BLACK : OVERLAP_NONE);
+
+                    fa.set(flags, g);
+                    da.set(flags == OVERLAP_BOTH ? DestPixelType(f(sa1(s1), sa2(s2))) : noOverlap, d);
+                }
+            }
+        } // omp parallel
+    }
+
+
+    template <class SrcImageIterator1, class SrcAccessor1,
+              class SrcImageIterator2, class SrcAccessor2,
+              class MaskImageIterator1, class MaskAccessor1,
+              class MaskImageIterator2, class MaskAccessor2,
+              class DestImageIterator, class DestAccessor,
+              class FlagImageIterator, class FlagAccessor,
+              class Functor>
+    inline void
+    analyzeOverlap(vigra::triple<SrcImageIterator1, SrcImageIterator1, SrcAccessor1> src1,
+                   vigra::pair<SrcImageIterator2, SrcAccessor2> src2,
+                   vigra::pair<MaskImageIterator1, MaskAccessor1> mask1,
+                   vigra::pair<MaskImageIterator2, MaskAccessor2> mask2,
+                   vigra::pair<DestImageIterator, DestAccessor> dest,
+                   vigra::pair<FlagImageIterator, FlagAccessor> flag,
+                   const Functor& difference)
+    {
+        analyzeOverlap(src1.first, src1.second, src1.third,
+                       src2.first, src2.second,
+                       mask1.first, mask1.second,
+                       mask2.first, mask2.second,
+                       dest.first, dest.second,
+                       flag.first, flag.second,
+                       difference);
+    }
+} // namespace enblend
+
+
+#endif /* OVERLAP_H_INCLUDED */
+
+
+// Local Variables:
+// mode: c++
+// End:
@@ -24,6 +24,7 @@
 #include <cctype>       // isalnum(), isalpha()
 #include <cerrno>       // errno
 #include <cstdlib>      // strtod(), strtol(), strtoul()
+#include <vector>
 
 #ifdef HAVE_UNORDERED_MAP
 #include <unordered_map>
@@ -506,4 +507,76 @@ namespace parameter
             return x->second.as_boolean();
         }
     }
+
+
+    //
+    // Typed Parameters
+    //
+
+    typedef std::vector<registered_parameter*> registry_t;
+
+
+    static registry_t&
+    registry()
+    {
+        static registry_t the_registry;
+        return the_registry;
+    }
+
+
+    registered_parameter::registered_parameter(const char* a_key) : key_(a_key), is_set_(false)
+    {
+        registry().push_back(this);
+    }
+
+
+    void
+    registered_parameter::resolve()
+    {
+        is_set_ = exists(key_);
+        if (is_set_)
+        {
+            try
+            {
+                load();
+            }
+            catch (conversion_error&)
+            {
+                is_set_ = false;
+                reset();
+                throw;
+            }
+        }
+        else
+        {
+            reset();
+        }
+    }
+
+
+    std::vector<std::string>
+    resolve_all()
+    {
+        std::vector<std::string> messages;
+
+        for (registry_t::iterator p = registry().begin(); p != registry().end(); ++p)
+        {
+            try
+            {
+                (*p)->resolve();
+            }
+            catch (conversion_error& e)
+            {
+                messages.push_back("parameter \"" + std::string((*p)->key()) + "\": " + e.what());
+            }
+        }
+
+        return messages;
+    }
+
+
+#define PARAMETER(a_type, an_identifier, a_key, a_default_value) \
+    a_type##_parameter an_identifier(a_key, a_default_value);
+#include "parameter_list.h"
+#undef PARAMETER
 } // end namespace parameter
@@ -23,6 +23,7 @@
 
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 
 namespace parameter
@@ -50,8 +51,8 @@ namespace parameter
     // NOTES
     //
     // * The access of parameters through parameter::as_* is
-    //   reasonably fast.  For time-critical parts of the code, the
-    //   parameter's value can always be copied into a local variable.
+    //   reasonably fast, but not fast enough for time-critical parts
+    //   of the code.  Those use the typed parameters further below.
     //
     // * The map from parameter keys to values is meant to be constant
     //   after the command line was parsed, i.e. neither the map
@@ -107,6 +108,124 @@ namespace parameter
 
     bool as_boolean(const std::string& a_key);
     bool as_boolean(const std::string& a_key, bool a_default_value);
+
+
+    // Typed Parameters
+    //
+    // Looking up a parameter by key costs a string construction
+    // and a hash-map search, which is too much for inner loops.
+    // Therefore every parameter the programs consult is listed in
+    // parameter_list.h with its type and default.  Each entry
+    // defines a global handle.  resolve_all() loads all handles from
+    // the parameter map once the command line has been parsed.
+    // After that reading a handle is a plain load.
+    //
+    //         if (parameter::debug_path.value()) {...}
+    //
+    // For parameters whose default is only known at the point of
+    // use, check is_set() or use value_or().
+    //
+    //         const unsigned d = parameter::blend_tree_parallel_depth.value_or(depth);
+    //
+    // Before resolve_all() runs, all handles yield their defaults.
+
+    class registered_parameter
+    {
+    public:
+        explicit registered_parameter(const char* a_key);
+        registered_parameter(const registered_parameter&) = delete;
+        registered_parameter& operator=(const registered_parameter&) = delete;
+        virtual ~registered_parameter() {}
+
+        const char* key() const {return key_;}
+        bool is_set() const {return is_set_;}
+
+        // Reload the parameter from the map.  Throw conversion_error
+        // if its value does not fit the parameter's type, leaving the
+        // parameter at its default.
+        void resolve();
+
+    protected:
+        virtual void load() = 0;
+        virtual void reset() = 0;
+
+    private:
+        const char* key_;
+        bool is_set_;
+    };
+
+
+    namespace detail
+    {
+        template <typename T> struct lookup;
+
+        template <> struct lookup<bool>
+        {
+            static bool get(const std::string& a_key) {return as_boolean(a_key);}
+        };
+
+        template <> struct lookup<int>
+        {
+            static int get(const std::string& a_key) {return as_integer(a_key);}
+        };
+
+        template <> struct lookup<unsigned>
+        {
+            static unsigned get(const std::string& a_key) {return as_unsigned(a_key);}
+        };
+
+        template <> struct lookup<double>
+        {
+            static double get(const std::string& a_key) {return as_double(a_key);}
+        };
+
+        template <> struct lookup<std::string>
+        {
+            static std::string get(const std::string& a_key) {return as_string(a_key);}
+        };
+    } // namespace detail
+
+
+    template <typename T>
+    class typed_parameter : public registered_parameter
+    {
+    public:
+        typedef T value_type;
+
+        typed_parameter(const char* a_key, const T& a_default_value) :
+            registered_parameter(a_key), default_value_(a_default_value), value_(a_default_value) {}
+
+        const T& value() const {return value_;}
+        T value_or(const T& a_fallback_value) const {return is_set() ? value_ : a_fallback_value;}
+        const T& default_value() const {return default_value_;}
+
+    protected:
+        void load() override {value_ = detail::lookup<T>::get(key());}
+        void reset() override {value_ = default_value_;}
+
+    private:
+        const T default_value_;
+        T value_;
+    };
+
+
+    typedef typed_parameter<bool> boolean_parameter;
+    typedef typed_parameter<int> integer_parameter;
+    typedef typed_parameter<unsigned> unsigned_parameter;
+    typedef typed_parameter<double> double_parameter;
+    typedef typed_parameter<std::string> string_parameter;
+
+
+    // Load all typed parameters.  Call this after the last
+    // modification of the parameter map.  A parameter whose value
+    // does not fit its type keeps its default, for the program may
+    // never consult it.  Answer a message for each of them.
+    std::vector<std::string> resolve_all();
+
+
+#define PARAMETER(a_type, an_identifier, a_key, a_default_value) extern a_type##_parameter an_identifier;
+#include "parameter_list.h"
+#undef PARAMETER
 } // namespace parameter
 
 
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2009-2017 Christoph Spiel
+ *
+ * This file is part of Enblend.
+ *
+ * Enblend is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Enblend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Enblend; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+// Every parameter that Enblend or Enfuse consults, as
+//     PARAMETER(type, identifier, key, default)
+// where type is one of boolean, integer, unsigned, double, or
+// string.  The entry defines the handle parameter::identifier.  See
+// parameter.h for how to use it.  doc/docstrings picks up the default
+// of every entry for the manuals as the value of its key, so do not
+// repeat it in a docstring.
+//
+// This file deliberately lacks an include guard.  Define PARAMETER
+// before including it.
+
+PARAMETER(boolean, adya_snake_points, "adya-snake-points", false)
+PARAMETER(boolean, assemble_ahead, "assemble-ahead", true)
+PARAMETER(unsigned, black_alpha_mask_check_isolated_points_threshold,
+          "black-alpha-mask-check-isolated-points-threshold", 2U)
+PARAMETER(string, blacklist_exif_keys, "blacklist-exif-keys", "")
+PARAMETER(string, blend_order, "blend-order", "sequential")
+// The effective default depends on the number of threads.  Each
+// level doubles the number of subtrees held in memory at the same
+// time, each with two image and alpha pairs the size of the input
+// union; enblend lowers the depth to fit into "--memory-limit" or
+// the physical memory.
+PARAMETER(unsigned, blend_tree_parallel_depth, "blend-tree-parallel-depth", 0U)
+
+PARAMETER(unsigned, ciecam_highlight_recovery_bracket_maximum_tries,
+          "ciecam-highlight-recovery-bracket-maximum-tries", 1000U)
+PARAMETER(double, ciecam_highlight_recovery_chroma_step_length,
+          "ciecam-highlight-recovery-chroma-step-length", 6.25)
+PARAMETER(unsigned, ciecam_highlight_recovery_iterations_per_leg,
+          "ciecam-highlight-recovery-iterations-per-leg", 50U)
+PARAMETER(double, ciecam_highlight_recovery_lightness_guess_factor,
+          "ciecam-highlight-recovery-lightness-guess-factor", 0.975)
+PARAMETER(double, ciecam_highlight_recovery_lightness_guess_offset,
+          "ciecam-highlight-recovery-lightness-guess-offset", 0.0)
+PARAMETER(double, ciecam_highlight_recovery_lightness_step_length,
+          "ciecam-highlight-recovery-lightness-step-length", 12.5)
+PARAMETER(unsigned, ciecam_highlight_recovery_maximum_iterations,
+          "ciecam-highlight-recovery-maximum-iterations", 100U)
+PARAMETER(unsigned, ciecam_highlight_recovery_maximum_legs,
+          "ciecam-highlight-recovery-maximum-legs", 10U)
+PARAMETER(double, ciecam_optimizer_deltae_goal, "ciecam-optimizer-deltae-goal", 0.5)
+PARAMETER(double, ciecam_optimizer_error, "ciecam-optimizer-error", 0.5 / 65536.0)
+PARAMETER(double, ciecam_shadow_disguised_as_highlight_lightness,
+          "ciecam-shadow-disguised-as-highlight-lightness", 1.0)
+PARAMETER(double, ciecam_shadow_recovery_chroma_chroma_guess_factor,
+          "ciecam-shadow-recovery-chroma-chroma-guess-factor", 1.33)
+PARAMETER(double, ciecam_shadow_recovery_chroma_guess_offset,
+          "ciecam-shadow-recovery-chroma-guess-offset", 0.0)
+PARAMETER(double, ciecam_shadow_recovery_chroma_lightness_guess_factor,
+          "ciecam-shadow-recovery-chroma-lightness-guess-factor", -0.604)
+PARAMETER(double, ciecam_shadow_recovery_chroma_step_length,
+          "ciecam-shadow-recovery-chroma-step-length", 1.25)
+PARAMETER(unsigned, ciecam_shadow_recovery_iterations_per_leg,
+          "ciecam-shadow-recovery-iterations-per-leg", 40U)
+PARAMETER(double, ciecam_shadow_recovery_lightness_chroma_guess_factor,
+          "ciecam-shadow-recovery-lightness-chroma-guess-factor", -0.136)
+PARAMETER(double, ciecam_shadow_recovery_lightness_guess_offset,
+          "ciecam-shadow-recovery-lightness-guess-offset", 0.0)
+PARAMETER(double, ciecam_shadow_recovery_lightness_lightness_guess_factor,
+          "ciecam-shadow-recovery-lightness-lightness-guess-factor", 1.24)
+PARAMETER(double, ciecam_shadow_recovery_lightness_step_length,
+          "ciecam-shadow-recovery-lightness-step-length", 0.625)
+PARAMETER(unsigned, ciecam_shadow_recovery_maximum_legs, "ciecam-shadow-recovery-maximum-legs", 5U)
+PARAMETER(unsigned, ciecam_shadow_recovery_maximum_tries, "ciecam-shadow-recovery-maximum-tries", 20U)
+
+PARAMETER(boolean, consult_opencl_user_exposure_weight_file, "consult-opencl-user-exposure-weight-file", true)
+PARAMETER(boolean, debug_path, "debug-path", false)
+PARAMETER(boolean, debug_path_compare, "debug-path-compare", false)
+PARAMETER(boolean, debug_seam_line, "debug-seam-line", false)
+// EuclideanDistance
+PARAMETER(unsigned, distance_transform_norm, "distance-transform-norm", 2U)
+PARAMETER(boolean, dump_exposure_weight_function, "dump-exposure-weight-function", false)
+PARAMETER(boolean, dump_global_variables, "dump-global-variables", false)
+PARAMETER(boolean, dump_nft_images, "dump-nft-images", false)
+PARAMETER(unsigned, entropy_bins, "entropy-bins", 0U)
+PARAMETER(integer, exposure_weight_function_points, "exposure-weight-function-points", 21)
+PARAMETER(string, fallback_output_file_type,
+          "fallback-output-file-type", "pnm")
+PARAMETER(string, fallback_output_mask_file_type,
+          "fallback-output-mask-file-type", "pbm")
+PARAMETER(boolean, force_opencl_anneal_float, "force-opencl-anneal-float", false)
+PARAMETER(boolean, fuse_blend_collapse, "fuse-blend-collapse", true)
+PARAMETER(boolean, gpu_kernel_anneal, "gpu-kernel-anneal", true)
+PARAMETER(boolean, gpu_kernel_dt, "gpu-kernel-dt", true)
+// The effective defaults of both thresholds depend on the pixel type.
+PARAMETER(double, import_alpha_lower_threshold, "import-alpha-lower-threshold", 0.0)
+PARAMETER(double, import_alpha_upper_threshold, "import-alpha-upper-threshold", 0.0)
+PARAMETER(boolean, import_alpha_save_threshed, "import-alpha-save-threshed", false)
+
+PARAMETER(double, lab_color_limit, "lab-color-limit", 200.0)
+PARAMETER(string, local_stddev_algorithm,
+          "local-stddev-algorithm", "integral")
+PARAMETER(unsigned, local_stddev_tile_size, "local-stddev-tile-size", 256U)
+PARAMETER(unsigned, lum_bracket_maximum_tries, "lum-bracket-maximum-tries", 500U)
+PARAMETER(double, lum_max_chroma_factor, "lum-max-chroma-factor", 20.0)
+PARAMETER(unsigned, lum_maximum_iterations, "lum-maximum-iterations", 50U)
+PARAMETER(double, lum_optimizer_deltae_goal, "lum-optimizer-deltae-goal", 0.5)
+PARAMETER(double, lum_optimizer_error, "lum-optimizer-error", 0.5 / 256.0)
+PARAMETER(unsigned, lum_polish_cache_size, "lum-polish-cache-size", 65536U)
+PARAMETER(double, lum_shadow_rgb_threshold, "lum-shadow-rgb-threshold", 0.0)
+PARAMETER(double, lum_suspicious_delta_e, "lum-suspicious-delta-e", 1.0)
+
+PARAMETER(string, mapped_storage_budget, "mapped-storage-budget", "0")
+PARAMETER(string, mapped_storage_directory, "mapped-storage-directory", "")
+PARAMETER(string, mapped_storage_threshold, "mapped-storage-threshold", "16M")
+PARAMETER(unsigned, mapped_storage_tile_rows, "mapped-storage-tile-rows", 64U)
+PARAMETER(boolean, mark_freaky_color_conversions, "mark-freaky-color-conversions", false)
+PARAMETER(string, mask_save_pixel_type, "mask-save-pixel-type", "float")
+PARAMETER(unsigned, mask_tile_size, "mask-tile-size", 64U)
+PARAMETER(boolean, metadata_pass_through, "metadata-pass-through", true)
+PARAMETER(unsigned, metadata_source_image_index, "metadata-source-image-index", 0U)
+PARAMETER(unsigned, minimum_pyramid_levels, "minimum-pyramid-levels", 1U)
+PARAMETER(unsigned, opencl_user_weight_samples, "opencl-user-weight-samples", 32U)
+PARAMETER(unsigned, overlap_check_threshold, "overlap-check-threshold", 2U)
+PARAMETER(string, polygon_filler, "polygon-filler", "new-active")
+PARAMETER(unsigned, polygon_filler_band_height, "polygon-filler-band-height", 64U)
+PARAMETER(boolean, profile_state_probabilities, "profile-state-probabilities", false)
+PARAMETER(unsigned, pyramid_strip_minimum_height,
+          "pyramid-strip-minimum-height", 64U)
+
+PARAMETER(unsigned, seam_refinement_corridor, "seam-refinement-corridor", 3U)
+PARAMETER(unsigned, seam_refinement_levels, "seam-refinement-levels", 0U)
+PARAMETER(boolean, skip_optimizer, "skip-optimizer", false)
+PARAMETER(boolean, skip_optimizer_chain, "skip-optimizer-chain", false)
+PARAMETER(string, skipsm_instruction_set, "skipsm-instruction-set", "auto")
+PARAMETER(unsigned, smallest_coarse_mask_size, "smallest-coarse-mask-size", 64U)
+PARAMETER(boolean, streaming_fusion, "streaming-fusion", false)
+PARAMETER(boolean, time_anneal_snake, "time-anneal-snake", false)
+PARAMETER(boolean, time_blend_collapse, "time-blend-collapse", false)
+PARAMETER(boolean, time_dijkstra_optimizer, "time-dijkstra-optimizer", false)
+PARAMETER(boolean, time_distance_transform, "time-distance-transform", false)
+PARAMETER(boolean, time_graph_cut, "time-graph-cut", false)
+PARAMETER(boolean, time_local_entropy, "time-local-entropy", false)
+PARAMETER(boolean, time_local_stddev, "time-local-stddev", false)
+PARAMETER(boolean, time_state_probabilities, "time-state-probabilities", false)
+
+// Local Variables:
+// mode: c++
+// End:
@@ -27,8 +27,11 @@
 #endif
 
 #include <array>
+#include <cassert>
 #include <iostream>
+#include <limits>
 #include <queue>
+#include <utility>
 #include <vector>
 
 
@@ -41,7 +44,7 @@ namespace enblend
         explicit PathCompareFunctor(const Image* an_image) : image_(an_image) {}
 
         bool operator()(const Point& a_point, const Point& another_point) const {
-            if (parameter::as_boolean("debug-path-compare", false)) {
+            if (parameter::debug_path_compare.value()) {
                 std::cout << "+ PathCompareFunctor::operator(): comparing "
                           << "cost(p1 = " << a_point << ") = " << (*image_)[a_point] << " and "
                           << "cost(p2 = " << another_point << ") = " << (*image_)[another_point]
@@ -56,6 +59,176 @@ namespace enblend
     }; // class PathCompareFunctor
 
 
+    // Monotone priority queue for non-negative integral keys,
+    // the "radix heap" of
+    //     Ravindra K. Ahuja, Kurt Mehlhorn, James B. Orlin, Robert E. Tarjan
+    //     "Faster Algorithms for the Shortest Path Problem"
+    //     Journal of the ACM 37(2), 1990
+    // Keys must never fall below the key popped last, which holds
+    // for Dijkstra's algorithm with non-negative edge weights.  Bucket
+    // i > 0 holds the keys whose highest bit that differs from the
+    // last popped key is bit i - 1; bucket 0 holds keys equal to it.
+    // Each entry moves down at most once per bit, so push and pop
+    // run in amortized O(log C) for the largest key C, independent of
+    // the number of entries and without any comparison callbacks.
+    // Entries with equal keys always share a bucket, and buckets
+    // keep their order when they are spread, so equal keys pop in
+    // the order they were pushed.
+    template <typename Value>
+    class RadixHeap
+    {
+    public:
+        typedef unsigned key_type;
+        typedef Value value_type;
+
+        RadixHeap() : last_(0U), size_(0U), head_(0U) {}
+
+        bool empty() const {return size_ == 0U;}
+        size_t size() const {return size_;}
+
+        void push(key_type a_key, const value_type& a_value)
+        {
+            assert(a_key >= last_);
+            buckets_[bucket_index(a_key)].push_back(entry(a_key, a_value));
+            ++size_;
+        }
+
+        // Remove the entry with the smallest key that was pushed
+        // first and answer its value.
+        value_type pop()
+        {
+            assert(!empty());
+            if (head_ == buckets_[0].size())
+            {
+                buckets_[0].clear();
+                head_ = 0U;
+                redistribute();
+            }
+
+            --size_;
+            return buckets_[0][head_++].second;
+        }
+
+    private:
+        typedef std::pair<key_type, value_type> entry;
+        typedef std::vector<entry> bucket;
+
+        enum {NUMBER_OF_BUCKETS = std::numeric_limits<key_type>::digits + 1};
+
+        static size_t bit_width(key_type x)
+        {
+#ifdef __GNUC__
+            return x == 0U ? 0U : static_cast<size_t>(std::numeric_limits<key_type>::digits - __builtin_clz(x));
+#else
+            size_t width = 0U;
+            while (x != 0U)
+            {
+                ++width;
+                x >>= 1;
+            }
+            return width;
+#endif
+        }
+
+        size_t bucket_index(key_type a_key) const {return bit_width(a_key ^ last_);}
+
+        // Move the smallest key of the first non-empty bucket into
+        // last_ and spread that bucket over the lower ones.
+        void redistribute()
+        {
+            size_t i = 1U;
+            while (buckets_[i].empty())
+            {
+                ++i;
+            }
+
+            bucket& source = buckets_[i];
+            key_type minimum = source.front().first;
+            for (typename bucket::const_iterator e = source.begin(); e != source.end(); ++e)
+            {
+                minimum = std::min(minimum, e->first);
+            }
+
+            last_ = minimum;
+            for (typename bucket::const_iterator e = source.begin(); e != source.end(); ++e)
+            {
+                buckets_[bucket_index(e->first)].push_back(*e);
+            }
+            source.clear();
+        }
+
+        key_type last_;
+        size_t size_;
+        size_t head_;           // next entry of bucket 0 to pop
+        std::array<bucket, NUMBER_OF_BUCKETS> buckets_;
+    }; // class RadixHeap
+
+
+    namespace detail
+    {
+        // Queue of the points minCostPath still has to visit, ordered
+        // by their costs so far.  Points must be pushed after their
+        // costs have been recorded in cost_so_far.
+        template <typename WorkingImageType, bool is_integral>
+        class PathQueue
+        {
+        public:
+            explicit PathQueue(const WorkingImageType* cost_so_far) :
+                // The doubled parentheses avoid "C++'s most-vexing parse", gosh!
+                queue_((PathCompareFunctor<vigra::Point2D, WorkingImageType>(cost_so_far))) {}
+
+            bool empty() const {return queue_.empty();}
+            void push(const vigra::Point2D& a_point) {queue_.push(a_point);}
+
+            vigra::Point2D pop()
+            {
+                const vigra::Point2D top(queue_.top());
+                queue_.pop();
+                return top;
+            }
+
+        private:
+            std::priority_queue<vigra::Point2D, std::vector<vigra::Point2D>,
+                                PathCompareFunctor<vigra::Point2D, WorkingImageType> > queue_;
+        };
+
+
+        // Integral costs use a radix heap keyed by cost, which stores
+        // flat pixel indices and never calls back into the cost image.
+        // It pops points of equal cost first in, first out, whereas
+        // the binary heap above pops them in no particular order.  A
+        // point's cost and next hop are fixed when it is first
+        // reached, so on ties the two queues may choose different,
+        // equally cheap seams.
+        template <typename WorkingImageType>
+        class PathQueue<WorkingImageType, true>
+        {
+        public:
+            explicit PathQueue(const WorkingImageType* cost_so_far) :
+                cost_so_far_(cost_so_far), width_(cost_so_far->width()) {}
+
+            bool empty() const {return queue_.empty();}
+
+            void push(const vigra::Point2D& a_point)
+            {
+                queue_.push(static_cast<unsigned>((*cost_so_far_)[a_point]),
+                            static_cast<unsigned>(a_point.y * width_ + a_point.x));
+            }
+
+            vigra::Point2D pop()
+            {
+                const unsigned index = queue_.pop();
+                return vigra::Point2D(static_cast<int>(index % width_), static_cast<int>(index / width_));
+            }
+
+        private:
+            const WorkingImageType* const cost_so_far_;
+            const unsigned width_;
+            RadixHeap<unsigned> queue_;
+        };
+    } // namespace detail
+
+
     template <class CostImageIterator, class CostAccessor>
     std::vector<vigra::Point2D>*
     minCostPath(CostImageIterator cost_upperleft, CostImageIterator cost_lowerright, CostAccessor cost_accessor,
@@ -64,8 +237,8 @@ namespace enblend
         typedef typename CostAccessor::value_type CostPixelType;
         typedef typename vigra::NumericTraits<CostPixelType>::Promote WorkingPixelType;
         typedef vigra::BasicImage<WorkingPixelType> WorkingImageType;
-        typedef std::priority_queue<vigra::Point2D, std::vector<vigra::Point2D>,
-                                    PathCompareFunctor<vigra::Point2D, WorkingImageType> > PriorityQueue;
+        typedef detail::PathQueue<WorkingImageType,
+                                  std::numeric_limits<WorkingPixelType>::is_integer> PriorityQueue;
 
         // 4-bit direction encoding {up, down, left, right}
         // A  8  9
@@ -83,11 +256,10 @@ namespace enblend
 
         vigra::UInt8Image pathNextHop(size);
         WorkingImageType costSoFar(size, vigra::NumericTraits<WorkingPixelType>::max());
-        // The doubled parentheses in the definition of `pq' avoid "C++'s most-vexing parse", gosh!
-        PriorityQueue pq((PathCompareFunctor<vigra::Point2D, WorkingImageType>(&costSoFar)));
+        PriorityQueue pq(&costSoFar);
         std::vector<vigra::Point2D>* result = new std::vector<vigra::Point2D>;
 
-        if (parameter::as_boolean("debug-path", false)) {
+        if (parameter::debug_path.value()) {
             std::cout << "+ minCostPath: size = " << size << "\n"
                       << "+ minCostPath: startingPoint = " << startingPoint
                       << (valid_region.contains(startingPoint) ? "" : " (invalid)")
@@ -104,15 +276,14 @@ namespace enblend
         }
 
         while (!pq.empty()) {
-            vigra::Point2D top = pq.top();
-            pq.pop();
-            if (parameter::as_boolean("debug-path", false)) {
+            vigra::Point2D top = pq.pop();
+            if (parameter::debug_path.value()) {
                 std::cout << "+ minCostPath: visiting point = " << top << std::endl;
             }
 
             if (top != startingPoint) {
                 WorkingPixelType costToTop = costSoFar[top];
-                if (parameter::as_boolean("debug-path", false)) {
+                if (parameter::debug_path.value()) {
                     std::cout << "+ minCostPath: costToTop = " << costToTop << std::endl;
                 }
 
@@ -130,7 +301,7 @@ namespace enblend
                     if (!valid_region.contains(neighborPoint)) {
                         continue;
                     }
-                    if (parameter::as_boolean("debug-path", false)) {
+                    if (parameter::debug_path.value()) {
                         std::cout << "+ minCostPath: neighbor = " << neighborPoint << std::endl;
                     }
 
@@ -138,7 +309,7 @@ namespace enblend
                     // If neighbor has maximal cost, it has not been visited.
                     // If so skip it.
                     WorkingPixelType neighborPreviousCost = costSoFar[neighborPoint];
-                    if (parameter::as_boolean("debug-path", false)) {
+                    if (parameter::debug_path.value()) {
                         std::cout <<
                             "+ minCostPath: neighborPreviousCost = " << neighborPreviousCost << std::endl;
                     }
@@ -149,7 +320,7 @@ namespace enblend
                     WorkingPixelType neighborCost =
                         std::max(vigra::NumericTraits<WorkingPixelType>::one(),
                                  vigra::NumericTraits<WorkingPixelType>::toPromote(cost_accessor(cost_upperleft + neighborPoint)));
-                    if (parameter::as_boolean("debug-path", false)) {
+                    if (parameter::debug_path.value()) {
                         std::cout << "+ minCostPath: neighborCost = " << neighborCost << std::endl;
                     }
                     if (neighborCost == vigra::NumericTraits<CostPixelType>::max()) {
@@ -28,6 +28,7 @@
 #include "anneal.h"
 #include "masktypedefs.h"
 #include "mask.h"
+#include "overlap.h"
 
 using vigra::functor::Arg1;
 using vigra::functor::Arg2;
@@ -41,7 +42,7 @@ namespace enblend
 {
 
     // Base abstract class for optimizer plugins
-    template <typename MismatchImageType, typename VisualizeImageType, typename AlphaType>
+    template <typename MismatchImageType, typename VisualizeImageType, typename OverlapImageType>
     class PostOptimizer
     {
     public:
@@ -52,13 +53,13 @@ namespace enblend
                       vigra::Diff2D* aUVBBStrideOffset, ContourVector* someContours,
                       const vigra::Rect2D* aUBB, vigra::Rect2D* aVBB,
                       std::vector<double>* someParameters,
-                      const AlphaType* aWhiteAlpha, const AlphaType* aBlackAlpha, const vigra::Rect2D* aUVBB) :
+                      const OverlapImageType* anOverlapImage) :
             mismatchImage(aMismatchImage), visualizeImage(aVisualizeImage),
             mismatchImageSize(aMismatchImageSize), mismatchImageStride(aMismatchImageStride),
             uvBBStrideOffset(aUVBBStrideOffset), contours(someContours),
             uBB(aUBB), vBB(aVBB),
             parameters(*someParameters),
-            whiteAlpha(aWhiteAlpha), blackAlpha(aBlackAlpha), uvBB(aUVBB) {}
+            overlapImage(anOverlapImage) {}
 
         PostOptimizer(PostOptimizer* other) = delete;
         PostOptimizer& operator=(const PostOptimizer &other) = delete;
@@ -78,17 +79,17 @@ namespace enblend
         const vigra::Rect2D* uBB;
         vigra::Rect2D* vBB;
         std::vector<double> parameters;
-        const AlphaType* whiteAlpha;
-        const AlphaType* blackAlpha;
-        const vigra::Rect2D* uvBB;
+        // overlap_t flags of the strided uvBB, which starts at
+        // uvBBStrideOffset in mismatchImage
+        const OverlapImageType* overlapImage;
     };
 
 
     // Optimizer strategy 1: Anneal optimizer
-    template <class MismatchImagePixelType, class MismatchImageType, class VisualizeImageType, class AlphaType>
-    class AnnealOptimizer : public PostOptimizer<MismatchImageType, VisualizeImageType, AlphaType> {
+    template <class MismatchImagePixelType, class MismatchImageType, class VisualizeImageType, class OverlapImageType>
+    class AnnealOptimizer : public PostOptimizer<MismatchImageType, VisualizeImageType, OverlapImageType> {
     public:
-        typedef PostOptimizer<MismatchImageType, VisualizeImageType, AlphaType> super;
+        typedef PostOptimizer<MismatchImageType, VisualizeImageType, OverlapImageType> super;
 
         AnnealOptimizer() = delete;
 
@@ -97,11 +98,11 @@ namespace enblend
                         vigra::Diff2D* uvBBStrideOffset, ContourVector* contours,
                         const vigra::Rect2D* uBB, vigra::Rect2D* vBB,
                         std::vector<double>* parameters,
-                        const AlphaType* whiteAlpha, const AlphaType* blackAlpha, const vigra::Rect2D* uvBB) :
+                        const OverlapImageType* overlapImage) :
             super(mismatchImage, visualizeImage,
                   mismatchImageSize, mismatchImageStride,
                   uvBBStrideOffset, contours,
-                  uBB, vBB, parameters, whiteAlpha, blackAlpha, uvBB) {}
+                  uBB, vBB, parameters, overlapImage) {}
 
         AnnealOptimizer(AnnealOptimizer* other) = delete;
         AnnealOptimizer& operator=(const AnnealOptimizer &other) = delete;
@@ -210,28 +211,14 @@ namespace enblend
         }
 
         virtual ~AnnealOptimizer() {}
-
-    private:
-        void configureOptimizer() {
-            // Areas other than intersection region have maximum cost.
-            vigra::omp::combineThreeImages(vigra_ext::stride(*this->mismatchImageStride,
-                                                             *this->mismatchImageStride,
-                                                             vigra_ext::apply(*this->uvBB, srcImageRange(*this->whiteAlpha))),
-                                           vigra_ext::stride(*this->mismatchImageStride,
-                                                             *this->mismatchImageStride,
-                                                             vigra_ext::apply(*this->uvBB, srcImage(*this->blackAlpha))),
-                                           srcIter((this->mismatchImage)->upperLeft() + *this->uvBBStrideOffset),
-                                           destIter((this->mismatchImage)->upperLeft() + *this->uvBBStrideOffset),
-                                           ifThenElse(Arg1() & Arg2(), Arg3(), Param(vigra::NumericTraits<MismatchImagePixelType>::max())));
-        }
     };
 
 
     // Optimizer Strategy 2: Dijkstra optimizer
-    template <class MismatchImagePixelType, class MismatchImageType, class VisualizeImageType, class AlphaType>
-    class DijkstraOptimizer : public PostOptimizer<MismatchImageType, VisualizeImageType, AlphaType> {
+    template <class MismatchImagePixelType, class MismatchImageType, class VisualizeImageType, class OverlapImageType>
+    class DijkstraOptimizer : public PostOptimizer<MismatchImageType, VisualizeImageType, OverlapImageType> {
     public:
-        typedef PostOptimizer<MismatchImageType, VisualizeImageType, AlphaType> super;
+        typedef PostOptimizer<MismatchImageType, VisualizeImageType, OverlapImageType> super;
 
         DijkstraOptimizer() = delete;
 
@@ -240,16 +227,20 @@ namespace enblend
                           vigra::Diff2D* uvBBStrideOffset, ContourVector* contours,
                           const vigra::Rect2D* uBB, vigra::Rect2D* vBB,
                           std::vector<double>* parameters,
-                          const AlphaType* whiteAlpha, const AlphaType* blackAlpha, const vigra::Rect2D* uvBB) :
+                          const OverlapImageType* overlapImage) :
             super(mismatchImage, visualizeImage,
                   mismatchImageSize, mismatchImageStride,
                   uvBBStrideOffset, contours,
-                  uBB, vBB, parameters, whiteAlpha, blackAlpha, uvBB) {}
+                  uBB, vBB, parameters, overlapImage) {}
 
         DijkstraOptimizer(DijkstraOptimizer* other) = delete;
         DijkstraOptimizer& operator=(const DijkstraOptimizer &other) = delete;
 
         virtual void runOptimizer() {
+            timer::WallClock wall_clock;
+
+            wall_clock.start();
+
             configureOptimizer();
 
             vigra::Rect2D withinMismatchImage(*this->mismatchImageSize);
@@ -369,29 +360,37 @@ namespace enblend
             if (Verbose >= VERBOSE_MASK_MESSAGES) {
                 std::cerr << std::endl;
             }
+
+            wall_clock.stop();
+            if (parameter::time_dijkstra_optimizer.value()) {
+                const std::ios::fmtflags flags(std::cerr.flags());
+                std::cerr <<
+                    command << ": timing: wall-clock runtime of `Dijkstra Optimizer': " <<
+                    std::setprecision(3) << 1000.0 * wall_clock.value() << " ms\n" <<
+                    command << ": timing: mismatch image size " << *this->mismatchImageSize << std::endl;
+                std::cerr.flags(flags);
+            }
         }
 
         virtual ~DijkstraOptimizer() {}
 
     private:
         void configureOptimizer() {
-            vigra::omp::combineThreeImages(vigra_ext::stride(*this->mismatchImageStride,
-                                                             *this->mismatchImageStride,
-                                                             vigra_ext::apply(*this->uvBB, srcImageRange(*this->whiteAlpha))),
-                                           vigra_ext::stride(*this->mismatchImageStride,
-                                                             *this->mismatchImageStride,
-                                                             vigra_ext::apply(*this->uvBB, srcImage(*this->blackAlpha))),
-                                           srcIter((this->mismatchImage)->upperLeft() + *this->uvBBStrideOffset),
-                                           destIter((this->mismatchImage)->upperLeft() + *this->uvBBStrideOffset),
-                                           ifThenElse(!(Arg1() || Arg2()), Param(vigra::NumericTraits<MismatchImagePixelType>::one()), Arg3()));
+            // Areas covered by neither image are cheap to cross.
+            vigra::omp::combineTwoImages(srcImageRange(*this->overlapImage),
+                                         srcIter((this->mismatchImage)->upperLeft() + *this->uvBBStrideOffset),
+                                         destIter((this->mismatchImage)->upperLeft() + *this->uvBBStrideOffset),
+                                         ifThenElse(Arg1() == Param(OverlapPixelType(OVERLAP_NONE)),
+                                                    Param(vigra::NumericTraits<MismatchImagePixelType>::one()),
+                                                    Arg2()));
         }
     };
 
 
-    template <class MismatchImagePixelType, class MismatchImageType, class VisualizeImageType, class AlphaType>
-    class OptimizerChain : public PostOptimizer<MismatchImageType, VisualizeImageType, AlphaType> {
+    template <class MismatchImagePixelType, class MismatchImageType, class VisualizeImageType, class OverlapImageType>
+    class OptimizerChain : public PostOptimizer<MismatchImageType, VisualizeImageType, OverlapImageType> {
     public:
-        typedef PostOptimizer<MismatchImageType, VisualizeImageType, AlphaType> super;
+        typedef PostOptimizer<MismatchImageType, VisualizeImageType, OverlapImageType> super;
         typedef std::vector<super*> optimizer_list_t;
         typedef typename optimizer_list_t::iterator optimizer_list_iterator;
 
@@ -402,11 +401,11 @@ namespace enblend
                        vigra::Diff2D* uvBBStrideOffset, ContourVector* contours,
                        const vigra::Rect2D* uBB, vigra::Rect2D* vBB,
                        std::vector<double>* parameters,
-                       const AlphaType* whiteAlpha, const AlphaType* blackAlpha, const vigra::Rect2D* uvBB) :
+                       const OverlapImageType* overlapImage) :
             super(mismatchImage, visualizeImage,
                   mismatchImageSize, mismatchImageStride,
                   uvBBStrideOffset, contours,
-                  uBB, vBB, parameters, whiteAlpha, blackAlpha, uvBB),
+                  uBB, vBB, parameters, overlapImage),
             currentOptimizer(0) {}
 
         OptimizerChain(OptimizerChain* other) = delete;
@@ -425,21 +424,21 @@ namespace enblend
 
             switch (id) {
             case ANNEAL_OPTIMIZER:
-                optimizerList.push_back(new AnnealOptimizer<MismatchImagePixelType, MismatchImageType, VisualizeImageType, AlphaType>
+                optimizerList.push_back(new AnnealOptimizer<MismatchImagePixelType, MismatchImageType, VisualizeImageType, OverlapImageType>
                                         (this->mismatchImage, this->visualizeImage,
                                          this->mismatchImageSize, this->mismatchImageStride, this->uvBBStrideOffset, this->contours,
                                          this->uBB, this->vBB,
                                          &this->parameters,
-                                         this->whiteAlpha, this->blackAlpha, this->uvBB));
+                                         this->overlapImage));
                 break;
 
             case DIJKSTRA_OPTIMIZER:
-                optimizerList.push_back(new DijkstraOptimizer<MismatchImagePixelType, MismatchImageType, VisualizeImageType, AlphaType>
+                optimizerList.push_back(new DijkstraOptimizer<MismatchImagePixelType, MismatchImageType, VisualizeImageType, OverlapImageType>
                                         (this->mismatchImage, this->visualizeImage,
                                          this->mismatchImageSize, this->mismatchImageStride, this->uvBBStrideOffset, this->contours,
                                          this->uBB, this->vBB,
                                          &this->parameters,
-                                         this->whiteAlpha, this->blackAlpha, this->uvBB));
+                                         this->overlapImage));
                 break;
 
             default:
@@ -25,10 +25,13 @@
 #include <config.h>
 #endif
 
+#include <algorithm>
 #include <functional>
 #include <vector>
 
+#include <vigra/basicimage.hxx>
 #include <vigra/convolution.hxx>
+#include <vigra/copyimage.hxx>
 #include <vigra/error.hxx>
 #include <vigra/inspectimage.hxx>
 #include <vigra/numerictraits.hxx>
@@ -37,6 +40,10 @@
 #include <vigra/transformimage.hxx>
 
 #include "fixmath.h"
+#include "mapped_storage.h"
+#include "openmp_def.h"
+#include "parameter.h"
+#include "skipsm_kernels.h"
 
 
 namespace enblend
@@ -64,6 +71,103 @@ filterHalfWidth(const unsigned int levels)
 }
 
 
+/** Answer the number of horizontal strips into which we cut a Reduce
+ *  or Expand whose destination has the given height.  A result of one
+ *  means: run serially.  Small levels -- the top of every pyramid --
+ *  are not worth the overhead of the strip boundaries.
+ */
+inline int
+pyramidStrips(int dest_height)
+{
+#ifdef OPENMP
+    if (omp_in_parallel() && !omp_get_nested()) {
+        return 1;
+    }
+
+    const int minimum_height =
+        std::max(8, static_cast<int>(parameter::pyramid_strip_minimum_height.value()));
+    const int strips = std::min(4 * omp_get_max_threads(), dest_height / minimum_height);
+
+    return std::max(1, strips);
+#else
+    (void) dest_height;
+    return 1;
+#endif
+}
+
+
+/** Row geometry of strip number strip out of number_of_strips of a
+ *  strip-parallel Reduce.
+ *
+ *  Destination rows [dest_begin, dest_end) are the core of the strip.
+ *  We reduce source rows [source_begin, source_end) on their own.
+ *  The core rows depend on source rows [2 * dest_begin - 2, 2 * dest_end),
+ *  however the SKIPSM algorithm treats the first and the last row of
+ *  the sub-reduction as image boundaries.  Therefore we reduce one
+ *  extra destination row at either end -- unless the strip touches
+ *  the image boundary -- and discard it.
+ */
+struct ReduceStrip
+{
+    ReduceStrip(int strip, int number_of_strips, int src_h, int dst_h) :
+        dest_begin(strip * dst_h / number_of_strips),
+        dest_end((strip + 1) * dst_h / number_of_strips),
+        source_begin(dest_begin == 0 ? 0 : 2 * dest_begin - 2),
+        source_end(std::min(src_h, 2 * dest_end + 1))
+    {}
+
+    // number of rows the sub-reduction writes
+    int height() const {return (source_end - source_begin + 1) / 2;}
+    // first core row relative to the sub-reduction
+    int skip() const {return dest_begin - source_begin / 2;}
+    int core_height() const {return dest_end - dest_begin;}
+
+    const int dest_begin;
+    const int dest_end;
+    const int source_begin;
+    const int source_end;
+};
+
+
+/** Row geometry of strip number strip out of number_of_strips of a
+ *  strip-parallel Expand.
+ *
+ *  We cut along the source rows; strip k owns the destination rows
+ *  [2 * source_core_begin, 2 * source_core_end) or up to dst_h for the
+ *  last strip.  Symmetric to ReduceStrip, the SKIPSM Expand treats the
+ *  first and last source row of a sub-expansion as image boundaries,
+ *  and the two destination rows next to either of them come out
+ *  differently.  We add one source row at either end and discard the
+ *  extra destination rows.
+ */
+struct ExpandStrip
+{
+    ExpandStrip(int strip, int number_of_strips, int src_h, int dst_h) :
+        last(strip == number_of_strips - 1),
+        source_core_begin(strip * src_h / number_of_strips),
+        source_core_end((strip + 1) * src_h / number_of_strips),
+        source_begin(std::max(0, source_core_begin - 1)),
+        source_end(last ? src_h : std::min(src_h, source_core_end + 1)),
+        dest_begin(2 * source_core_begin),
+        dest_end(last ? dst_h : 2 * source_core_end)
+    {}
+
+    // number of rows the sub-expansion writes
+    int height() const {return last ? dest_end - 2 * source_begin : 2 * (source_end - source_begin);}
+    // first core row relative to the sub-expansion
+    int skip() const {return dest_begin - 2 * source_begin;}
+    int core_height() const {return dest_end - dest_begin;}
+
+    const bool last;
+    const int source_core_begin;
+    const int source_core_end;
+    const int source_begin;
+    const int source_end;
+    const int dest_begin;
+    const int dest_end;
+};
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Burt & Adelson Reduce operation
@@ -205,6 +309,13 @@ reduce(bool wraparound,
     SKIPSMAlphaPixelType* asc1 = new SKIPSMAlphaPixelType[dst_w + 1];
     SKIPSMAlphaPixelType* ascp = new SKIPSMAlphaPixelType[dst_w + 1];
 
+    // Horizontally filtered values of the current row and the
+    // unnormalized outputs of even rows, see skipsm::reduceCombineRow()
+    SKIPSMImagePixelType* ihr = new SKIPSMImagePixelType[dst_w + 1];
+    SKIPSMImagePixelType* iout = new SKIPSMImagePixelType[dst_w + 1];
+    SKIPSMAlphaPixelType* ahr = new SKIPSMAlphaPixelType[dst_w + 1];
+    SKIPSMAlphaPixelType* aout = new SKIPSMAlphaPixelType[dst_w + 1];
+
     // Convenient constants
     const SKIPSMImagePixelType SKIPSMImageZero(vigra::NumericTraits<SKIPSMImagePixelType>::zero());
     const SKIPSMAlphaPixelType SKIPSMAlphaZero(vigra::NumericTraits<SKIPSMAlphaPixelType>::zero());
@@ -216,6 +327,7 @@ reduce(bool wraparound,
     DestImageIterator dy = dest_upperleft;
     DestImageIterator dx = dy;
     SrcImageIterator sy = src_upperleft;
+    const mapped_storage::row_prefetcher prefetchRow(sy, src_h);
     SrcImageIterator sx = sy;
     AlphaIterator ay = alpha_upperleft;
     AlphaIterator ax = ay;
@@ -318,6 +430,8 @@ reduce(bool wraparound,
     // Main Rows
     {
         for (evenY = false, srcy = 1; srcy < src_h; ++srcy, ++sy.y, ++ay.y) {
+            prefetchRow(sy);
+
             if (wraparound) {
                 asr0 = aa(ay, vigra::Diff2D(src_w - 2, 0)) ? SKIPSMAlphaOne : SKIPSMAlphaZero;
                 asr1 = SKIPSMAlphaZero;
@@ -360,30 +474,12 @@ reduce(bool wraparound,
                     SKIPSMAlphaPixelType mcurrent(aa(ax) ? SKIPSMAlphaOne : SKIPSMAlphaZero);
                     SKIPSMImagePixelType icurrent(aa(ax) ? SKIPSMImagePixelType(sa(sx)) : SKIPSMImageZero);
                     if (evenX) {
-                        SKIPSMAlphaPixelType ap = asc1[dstx] + amul6(asc0[dstx]) + ascp[dstx];
-                        asc1[dstx] = asc0[dstx] + ascp[dstx];
-                        asc0[dstx] = asr1 + amul6(asr0) + asrp + mcurrent;
+                        ahr[dstx] = asr1 + amul6(asr0) + asrp + mcurrent;
                         asr1 = asr0 + asrp;
                         asr0 = mcurrent;
-                        ap += asc0[dstx];
-
-                        SKIPSMImagePixelType ip = isc1[dstx] + imul6(isc0[dstx]) + iscp[dstx];
-                        isc1[dstx] = isc0[dstx] + iscp[dstx];
-                        isc0[dstx] = isr1 + imul6(isr0) + isrp + icurrent;
+                        ihr[dstx] = isr1 + imul6(isr0) + isrp + icurrent;
                         isr1 = isr0 + isrp;
                         isr0 = icurrent;
-                        if (ap) {
-                            ip += isc0[dstx]; // OVERFLOW!!!
-                            ip /= SKIPSMImagePixelType(ap);
-                            da.set(DestPixelType(ip), dx);
-                            daa.set(DestAlphaMax, dax);
-                        } else {
-                            da.set(DestImageZero, dx);
-                            daa.set(DestAlphaZero, dax);
-                        }
-
-                        ++dx.x;
-                        ++dax.x;
                     } else {
                         asrp = mcurrent * 4;
                         isrp = icurrent * 4;
@@ -396,57 +492,37 @@ reduce(bool wraparound,
                 if (!evenX) {
                     // previous srcx was even
                     ++dstx;
-
-                    SKIPSMAlphaPixelType ap = asc1[dstx] + amul6(asc0[dstx]) + ascp[dstx];
-                    asc1[dstx] = asc0[dstx] + ascp[dstx];
-                    if (wraparound) {
-                        asc0[dstx] = asr1 + amul6(asr0) + (aa(ay) ? (SKIPSMAlphaOne * 4) : SKIPSMAlphaZero) + (aa(ay, vigra::Diff2D(1,0)) ? SKIPSMAlphaOne : SKIPSMAlphaZero);
-                    } else {
-                        asc0[dstx] = asr1 + amul6(asr0);
-                    }
-                    ap += asc0[dstx];
-
-                    SKIPSMImagePixelType ip = isc1[dstx] + imul6(isc0[dstx]) + iscp[dstx];
-                    isc1[dstx] = isc0[dstx] + iscp[dstx];
                     if (wraparound) {
-                        isc0[dstx] =
+                        ahr[dstx] = asr1 + amul6(asr0) + (aa(ay) ? (SKIPSMAlphaOne * 4) : SKIPSMAlphaZero) + (aa(ay, vigra::Diff2D(1,0)) ? SKIPSMAlphaOne : SKIPSMAlphaZero);
+                        ihr[dstx] =
                             isr1 + imul6(isr0) +
                             (aa(ay) ?
                              vigra::NumericTraits<SKIPSMImagePixelType>::fromRealPromote(SKIPSMImagePixelType(sa(sy)) * 4) :
                              SKIPSMImageZero) +
                             (aa(ay, vigra::Diff2D(1, 0)) ? SKIPSMImagePixelType(sa(sy, vigra::Diff2D(1, 0))) : SKIPSMImageZero);
                     } else {
-                        isc0[dstx] = isr1 + imul6(isr0);
-                    }
-                    if (ap) {
-                        ip += isc0[dstx];
-                        ip /= SKIPSMImagePixelType(ap);
-                        da.set(DestPixelType(ip), dx);
-                        daa.set(DestAlphaMax, dax);
-                    } else {
-                        da.set(DestImageZero, dx);
-                        daa.set(DestAlphaZero, dax);
+                        ahr[dstx] = asr1 + amul6(asr0);
+                        ihr[dstx] = isr1 + imul6(isr0);
                     }
                 } else {
                     // Previous srcx was odd
-                    SKIPSMAlphaPixelType ap = asc1[dstx] + amul6(asc0[dstx]) + ascp[dstx];
-                    asc1[dstx] = asc0[dstx] + ascp[dstx];
                     if (wraparound) {
-                        asc0[dstx] = asr1 + amul6(asr0) + asrp + (aa(ay) ? SKIPSMAlphaOne : SKIPSMAlphaZero);
+                        ahr[dstx] = asr1 + amul6(asr0) + asrp + (aa(ay) ? SKIPSMAlphaOne : SKIPSMAlphaZero);
+                        ihr[dstx] = isr1 + imul6(isr0) + isrp + (aa(ay) ? SKIPSMImagePixelType(sa(sy)) : SKIPSMImageZero);
                     } else {
-                        asc0[dstx] = asr1 + amul6(asr0) + asrp;
+                        ahr[dstx] = asr1 + amul6(asr0) + asrp;
+                        ihr[dstx] = isr1 + imul6(isr0) + isrp;
                     }
-                    ap += asc0[dstx];
+                }
 
-                    SKIPSMImagePixelType ip = isc1[dstx] + imul6(isc0[dstx]) + iscp[dstx];
-                    isc1[dstx] = isc0[dstx] + iscp[dstx];
-                    if (wraparound) {
-                        isc0[dstx] = isr1 + imul6(isr0) + isrp + (aa(ay) ? SKIPSMImagePixelType(sa(sy)) : SKIPSMImageZero);
-                    } else {
-                        isc0[dstx] = isr1 + imul6(isr0) + isrp;
-                    }
+                // Vertical filter for the whole row
+                skipsm::reduceCombineRow(asc1 + 1, asc0 + 1, ascp + 1, ahr + 1, aout + 1, dst_w);
+                skipsm::reduceCombineRow(isc1 + 1, isc0 + 1, iscp + 1, ihr + 1, iout + 1, dst_w);
+
+                for (dstx = 1, dx = dy, dax = day; dstx < dst_w + 1; ++dstx, ++dx.x, ++dax.x) {
+                    const SKIPSMAlphaPixelType ap = aout[dstx];
                     if (ap) {
-                        ip += isc0[dstx];
+                        SKIPSMImagePixelType ip = iout[dstx];
                         ip /= SKIPSMImagePixelType(ap);
                         da.set(DestPixelType(ip), dx);
                         daa.set(DestAlphaMax, dax);
@@ -570,6 +646,74 @@ reduce(bool wraparound,
     delete [] asc0;
     delete [] asc1;
     delete [] ascp;
+
+    delete [] ihr;
+    delete [] iout;
+    delete [] ahr;
+    delete [] aout;
+}
+
+
+/** Strip-parallel version of reduce() for images with alpha
+ *  channels.  The strips, see ReduceStrip, go to different threads.
+ *  Each thread reduces into a private buffer and copies the core rows
+ *  to the destination.  The result is identical to the serial
+ *  reduce().
+ */
+template <typename SKIPSMImagePixelType, typename SKIPSMAlphaPixelType,
+          typename SrcImageIterator, typename SrcAccessor,
+          typename AlphaIterator, typename AlphaAccessor,
+          typename DestImageIterator, typename DestAccessor,
+          typename DestAlphaIterator, typename DestAlphaAccessor>
+void
+reduceInStrips(int number_of_strips, bool wraparound,
+               SrcImageIterator src_upperleft,
+               SrcImageIterator src_lowerright,
+               SrcAccessor sa,
+               AlphaIterator alpha_upperleft,
+               AlphaAccessor aa,
+               DestImageIterator dest_upperleft,
+               DestImageIterator dest_lowerright,
+               DestAccessor da,
+               DestAlphaIterator dest_alpha_upperleft,
+               DestAlphaIterator /* dest_alpha_lowerright */,
+               DestAlphaAccessor daa)
+{
+    typedef typename DestAccessor::value_type DestPixelType;
+    typedef typename DestAlphaAccessor::value_type DestAlphaPixelType;
+
+    const int src_w = src_lowerright.x - src_upperleft.x;
+    const int src_h = src_lowerright.y - src_upperleft.y;
+    const int dst_w = dest_lowerright.x - dest_upperleft.x;
+    const int dst_h = dest_lowerright.y - dest_upperleft.y;
+
+#ifdef OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int strip = 0; strip < number_of_strips; ++strip) {
+        const ReduceStrip geometry(strip, number_of_strips, src_h, dst_h);
+        const vigra::Diff2D source_begin(0, geometry.source_begin);
+        const vigra::Diff2D source_end(src_w, geometry.source_end);
+        const vigra::Diff2D core_begin(0, geometry.skip());
+        const vigra::Diff2D core_end(dst_w, geometry.skip() + geometry.core_height());
+        const vigra::Diff2D dest_begin(0, geometry.dest_begin);
+
+        vigra::BasicImage<DestPixelType> image(dst_w, geometry.height());
+        vigra::BasicImage<DestAlphaPixelType> alpha(dst_w, geometry.height());
+
+        reduce<SKIPSMImagePixelType, SKIPSMAlphaPixelType>(wraparound,
+                                                           src_upperleft + source_begin,
+                                                           src_upperleft + source_end,
+                                                           sa,
+                                                           alpha_upperleft + source_begin, aa,
+                                                           image.upperLeft(), image.lowerRight(), image.accessor(),
+                                                           alpha.upperLeft(), alpha.lowerRight(), alpha.accessor());
+
+        vigra::copyImage(image.upperLeft() + core_begin, image.upperLeft() + core_end, image.accessor(),
+                         dest_upperleft + dest_begin, da);
+        vigra::copyImage(alpha.upperLeft() + core_begin, alpha.upperLeft() + core_end, alpha.accessor(),
+                         dest_alpha_upperleft + dest_begin, daa);
+    }
 }
 
 
@@ -586,11 +730,21 @@ reduce(bool wraparound,
        vigra::triple<DestImageIterator, DestImageIterator, DestAccessor> dest,
        vigra::triple<DestAlphaIterator, DestAlphaIterator, DestAlphaAccessor> destMask)
 {
-    reduce<SKIPSMImagePixelType, SKIPSMAlphaPixelType>(wraparound,
-                                                       src.first, src.second, src.third,
-                                                       mask.first, mask.second,
-                                                       dest.first, dest.second, dest.third,
-                                                       destMask.first, destMask.second, destMask.third);
+    const int strips = pyramidStrips(dest.second.y - dest.first.y);
+
+    if (strips > 1) {
+        reduceInStrips<SKIPSMImagePixelType, SKIPSMAlphaPixelType>(strips, wraparound,
+                                                                   src.first, src.second, src.third,
+                                                                   mask.first, mask.second,
+                                                                   dest.first, dest.second, dest.third,
+                                                                   destMask.first, destMask.second, destMask.third);
+    } else {
+        reduce<SKIPSMImagePixelType, SKIPSMAlphaPixelType>(wraparound,
+                                                           src.first, src.second, src.third,
+                                                           mask.first, mask.second,
+                                                           dest.first, dest.second, dest.third,
+                                                           destMask.first, destMask.second, destMask.third);
+    }
 };
 
 
@@ -626,12 +780,18 @@ reduce(bool wraparound,
     SKIPSMImagePixelType* isc1 = new SKIPSMImagePixelType[dst_w + 1];
     SKIPSMImagePixelType* iscp = new SKIPSMImagePixelType[dst_w + 1];
 
+    // Horizontally filtered values of the current row and the
+    // unnormalized outputs of even rows, see skipsm::reduceCombineRow()
+    SKIPSMImagePixelType* ihr = new SKIPSMImagePixelType[dst_w + 1];
+    SKIPSMImagePixelType* iout = new SKIPSMImagePixelType[dst_w + 1];
+
     // Convenient constants
     const SKIPSMImagePixelType SKIPSMImageZero(vigra::NumericTraits<SKIPSMImagePixelType>::zero());
 
     DestImageIterator dy = dest_upperleft;
     DestImageIterator dx = dy;
     SrcImageIterator sy = src_upperleft;
+    const mapped_storage::row_prefetcher prefetchRow(sy, src_h);
     SrcImageIterator sx = sy;
 
     bool evenY = true;
@@ -698,6 +858,8 @@ reduce(bool wraparound,
     // Main Rows
     {
         for (evenY = false, srcy = 1; srcy < src_h; ++srcy, ++sy.y) {
+            prefetchRow(sy);
+
             if (wraparound) {
                 isr0 = SKIPSMImagePixelType(sa(sy, vigra::Diff2D(src_w - 2, 0)));
                 isr1 = SKIPSMImageZero;
@@ -723,15 +885,9 @@ reduce(bool wraparound,
                 for (evenX = false, srcx = 1, dstx = 0; srcx < src_w; ++srcx, ++sx.x) {
                     SKIPSMImagePixelType icurrent(SKIPSMImagePixelType(sa(sx)));
                     if (evenX) {
-                        SKIPSMImagePixelType ip = isc1[dstx] + imul6(isc0[dstx]) + iscp[dstx];
-                        isc1[dstx] = isc0[dstx] + iscp[dstx];
-                        isc0[dstx] = isr1 + imul6(isr0) + isrp + icurrent;
+                        ihr[dstx] = isr1 + imul6(isr0) + isrp + icurrent;
                         isr1 = isr0 + isrp;
                         isr0 = icurrent;
-                        ip += isc0[dstx];
-                        ip /= 256;
-                        da.set(DestPixelType(ip), dx);
-                        ++dx.x;
                     } else {
                         isrp = icurrent * 4;
                         ++dstx;
@@ -743,28 +899,26 @@ reduce(bool wraparound,
                 if (!evenX) {
                     // previous srcx was even
                     ++dstx;
-
-                    SKIPSMImagePixelType ip = isc1[dstx] + imul6(isc0[dstx]) + iscp[dstx];
-                    isc1[dstx] = isc0[dstx] + iscp[dstx];
                     if (wraparound) {
-                        isc0[dstx] = isr1 + imul6(isr0) + (SKIPSMImagePixelType(sa(sy)) * 4)
+                        ihr[dstx] = isr1 + imul6(isr0) + (SKIPSMImagePixelType(sa(sy)) * 4)
                             + SKIPSMImagePixelType(sa(sy, vigra::Diff2D(1, 0)));
                     } else {
-                        isc0[dstx] = isr1 + imul11(isr0);
+                        ihr[dstx] = isr1 + imul11(isr0);
                     }
-                    ip += isc0[dstx];
-                    ip /= 256;
-                    da.set(DestPixelType(ip), dx);
                 } else {
                     // Previous srcx was odd
-                    SKIPSMImagePixelType ip = isc1[dstx] + imul6(isc0[dstx]) + iscp[dstx];
-                    isc1[dstx] = isc0[dstx] + iscp[dstx];
                     if (wraparound) {
-                        isc0[dstx] = isr1 + imul6(isr0) + isrp + SKIPSMImagePixelType(sa(sy));
+                        ihr[dstx] = isr1 + imul6(isr0) + isrp + SKIPSMImagePixelType(sa(sy));
                     } else {
-                        isc0[dstx] = isr1 + imul6(isr0) + isrp + (isrp / 4);
+                        ihr[dstx] = isr1 + imul6(isr0) + isrp + (isrp / 4);
                     }
-                    ip += isc0[dstx];
+                }
+
+                // Vertical filter for the whole row
+                skipsm::reduceCombineRow(isc1 + 1, isc0 + 1, iscp + 1, ihr + 1, iout + 1, dst_w);
+
+                for (dstx = 1, dx = dy; dstx < dst_w + 1; ++dstx, ++dx.x) {
+                    SKIPSMImagePixelType ip = iout[dstx];
                     ip /= 256;
                     da.set(DestPixelType(ip), dx);
                 }
@@ -845,6 +999,54 @@ reduce(bool wraparound,
     delete [] isc0;
     delete [] isc1;
     delete [] iscp;
+
+    delete [] ihr;
+    delete [] iout;
+}
+
+
+/** Strip-parallel version of reduce() for images without alpha
+ *  channels.  See the version with alpha channels for details.
+ */
+template <typename SKIPSMImagePixelType,
+          typename SrcImageIterator, typename SrcAccessor,
+          typename DestImageIterator, typename DestAccessor>
+void
+reduceInStrips(int number_of_strips, bool wraparound,
+               SrcImageIterator src_upperleft,
+               SrcImageIterator src_lowerright,
+               SrcAccessor sa,
+               DestImageIterator dest_upperleft,
+               DestImageIterator dest_lowerright,
+               DestAccessor da)
+{
+    typedef typename DestAccessor::value_type DestPixelType;
+
+    const int src_w = src_lowerright.x - src_upperleft.x;
+    const int src_h = src_lowerright.y - src_upperleft.y;
+    const int dst_w = dest_lowerright.x - dest_upperleft.x;
+    const int dst_h = dest_lowerright.y - dest_upperleft.y;
+
+#ifdef OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int strip = 0; strip < number_of_strips; ++strip) {
+        const ReduceStrip geometry(strip, number_of_strips, src_h, dst_h);
+        const vigra::Diff2D core_begin(0, geometry.skip());
+
+        vigra::BasicImage<DestPixelType> image(dst_w, geometry.height());
+
+        reduce<SKIPSMImagePixelType>(wraparound,
+                                     src_upperleft + vigra::Diff2D(0, geometry.source_begin),
+                                     src_upperleft + vigra::Diff2D(src_w, geometry.source_end),
+                                     sa,
+                                     image.upperLeft(), image.lowerRight(), image.accessor());
+
+        vigra::copyImage(image.upperLeft() + core_begin,
+                         image.upperLeft() + core_begin + vigra::Diff2D(dst_w, geometry.core_height()),
+                         image.accessor(),
+                         dest_upperleft + vigra::Diff2D(0, geometry.dest_begin), da);
+    }
 }
 
 
@@ -857,9 +1059,17 @@ reduce(bool wraparound,
        vigra::triple<SrcImageIterator, SrcImageIterator, SrcAccessor> src,
        vigra::triple<DestImageIterator, DestImageIterator, DestAccessor> dest)
 {
-    reduce<SKIPSMImagePixelType>(wraparound,
-                                 src.first, src.second, src.third,
-                                 dest.first, dest.second, dest.third);
+    const int strips = pyramidStrips(dest.second.y - dest.first.y);
+
+    if (strips > 1) {
+        reduceInStrips<SKIPSMImagePixelType>(strips, wraparound,
+                                             src.first, src.second, src.third,
+                                             dest.first, dest.second, dest.third);
+    } else {
+        reduce<SKIPSMImagePixelType>(wraparound,
+                                     src.first, src.second, src.third,
+                                     dest.first, dest.second, dest.third);
+    }
 }
 
 
@@ -1130,6 +1340,14 @@ expand(bool add, bool wraparound,
     SKIPSMImagePixelType* sc1a = new SKIPSMImagePixelType[src_w + 1];
     SKIPSMImagePixelType* sc1b = new SKIPSMImagePixelType[src_w + 1];
 
+    // Source row and unnormalized outputs of the main rows, see
+    // skipsm::expandCombineRow()
+    SKIPSMImagePixelType* row = new SKIPSMImagePixelType[src_w + 1];
+    SKIPSMImagePixelType* rout00 = new SKIPSMImagePixelType[src_w + 1];
+    SKIPSMImagePixelType* rout10 = new SKIPSMImagePixelType[src_w + 1];
+    SKIPSMImagePixelType* rout01 = new SKIPSMImagePixelType[src_w + 1];
+    SKIPSMImagePixelType* rout11 = new SKIPSMImagePixelType[src_w + 1];
+
     // Convenient constants
     const SKIPSMImagePixelType SKIPSMImageZero(vigra::NumericTraits<SKIPSMImagePixelType>::zero());
 
@@ -1138,6 +1356,7 @@ expand(bool add, bool wraparound,
     DestImageIterator dx = dy;
     DestImageIterator dxx = dyy;
     SrcImageIterator sy = src_upperleft;
+    const mapped_storage::row_prefetcher prefetchRow(sy, src_h);
     SrcImageIterator sx = sy;
 
     int srcy = 0;
@@ -1300,6 +1519,12 @@ expand(bool add, bool wraparound,
         delete [] sc1a;
         delete [] sc1b;
 
+        delete [] row;
+        delete [] rout00;
+        delete [] rout10;
+        delete [] rout01;
+        delete [] rout11;
+
         return;
     }
 
@@ -1313,6 +1538,8 @@ expand(bool add, bool wraparound,
 
     // Main Rows
     for (srcy = 2, sx = sy; srcy < src_h; ++srcy, ++sy.y, dy.y += 2, dyy.y += 2) {
+        prefetchRow(sy);
+
         // First column
         srcx = 0;
         sx = sy;
@@ -1345,9 +1572,39 @@ expand(bool add, bool wraparound,
             }
 
             // Main columns
-            for (srcx = 2, ++sx.x; srcx < src_w; ++srcx, ++sx.x) {
-                SKIPSM_EXPAND(64, 64, 16, 16);
+            if (src_w > 2) {
+                SrcImageIterator sxx = sy;
+                for (srcx = 0; srcx < src_w; ++srcx, ++sxx.x) {
+                    row[srcx] = SKIPSMImagePixelType(sa(sxx));
+                }
+
+                skipsm::expandCombineRow(row, sc1a, sc0a, sc1b, sc0b,
+                                         rout00, rout10, rout01, rout11,
+                                         2, src_w);
+
+                for (srcx = 2; srcx < src_w; ++srcx) {
+                    out00 = rout00[srcx];
+                    out10 = rout10[srcx];
+                    out01 = rout01[srcx];
+                    out11 = rout11[srcx];
+                    out00 /= SKIPSMImagePixelType(64);
+                    out10 /= SKIPSMImagePixelType(64);
+                    out01 /= SKIPSMImagePixelType(16);
+                    out11 /= SKIPSMImagePixelType(16);
+                    da.set(cf(SKIPSMImagePixelType(da(dx)), out00), dx);
+                    ++dx.x;
+                    da.set(cf(SKIPSMImagePixelType(da(dx)), out10), dx);
+                    ++dx.x;
+                    da.set(cf(SKIPSMImagePixelType(da(dxx)), out01), dxx);
+                    ++dxx.x;
+                    da.set(cf(SKIPSMImagePixelType(da(dxx)), out11), dxx);
+                    ++dxx.x;
+                }
+
+                sr1 = row[src_w - 2];
+                sr0 = row[src_w - 1];
             }
+            srcx = src_w;
 
             // extra column at end of row
             if (wraparound) {
@@ -1416,6 +1673,12 @@ expand(bool add, bool wraparound,
     delete [] sc0b;
     delete [] sc1a;
     delete [] sc1b;
+
+    delete [] row;
+    delete [] rout00;
+    delete [] rout10;
+    delete [] rout01;
+    delete [] rout11;
 }
 
 
@@ -1432,6 +1695,94 @@ struct FromPromotePlusFunctorWrapper :
 };
 
 
+/** Strip-parallel version of expand().  The strips, see
+ *  ExpandStrip, go to different threads.  Each thread expands into a
+ *  private, zero-initialized buffer and combines the core rows with
+ *  the destination, so that every destination pixel is read and
+ *  written exactly once just like in the serial expand().
+ */
+template <typename SKIPSMImagePixelType,
+          typename SrcImageIterator, typename SrcAccessor,
+          typename DestImageIterator, typename DestAccessor,
+          typename CombineFunctor>
+void
+expandInStrips(int number_of_strips, bool add, bool wraparound,
+               SrcImageIterator src_upperleft,
+               SrcImageIterator src_lowerright,
+               SrcAccessor sa,
+               DestImageIterator dest_upperleft,
+               DestImageIterator dest_lowerright,
+               DestAccessor da,
+               CombineFunctor cf)
+{
+    typedef vigra::BasicImage<SKIPSMImagePixelType> BufferType;
+
+    const int src_w = src_lowerright.x - src_upperleft.x;
+    const int src_h = src_lowerright.y - src_upperleft.y;
+    const int dst_w = dest_lowerright.x - dest_upperleft.x;
+    const int dst_h = dest_lowerright.y - dest_upperleft.y;
+
+#ifdef OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int strip = 0; strip < number_of_strips; ++strip) {
+        const ExpandStrip geometry(strip, number_of_strips, src_h, dst_h);
+
+        BufferType buffer(dst_w, geometry.height());
+        expand<SKIPSMImagePixelType>(add, wraparound,
+                                     src_upperleft + vigra::Diff2D(0, geometry.source_begin),
+                                     src_upperleft + vigra::Diff2D(src_w, geometry.source_end),
+                                     sa,
+                                     buffer.upperLeft(), buffer.lowerRight(), buffer.accessor(),
+                                     std::plus<SKIPSMImagePixelType>());
+
+        typename BufferType::Accessor ba = buffer.accessor();
+        typename BufferType::traverser by = buffer.upperLeft() + vigra::Diff2D(0, geometry.skip());
+        DestImageIterator dy = dest_upperleft + vigra::Diff2D(0, geometry.dest_begin);
+        for (int y = 0; y < geometry.core_height(); ++y, ++by.y, ++dy.y) {
+            typename BufferType::traverser bx = by;
+            DestImageIterator dx = dy;
+            for (int x = 0; x < dst_w; ++x, ++bx.x, ++dx.x) {
+                da.set(cf(SKIPSMImagePixelType(da(dx)), ba(bx)), dx);
+            }
+        }
+    }
+}
+
+
+// Dispatch between expand() and expandInStrips().
+template <typename SKIPSMImagePixelType,
+          typename SrcImageIterator, typename SrcAccessor,
+          typename DestImageIterator, typename DestAccessor,
+          typename CombineFunctor>
+inline static void
+expandMaybeInStrips(bool add, bool wraparound,
+                    SrcImageIterator src_upperleft,
+                    SrcImageIterator src_lowerright,
+                    SrcAccessor sa,
+                    DestImageIterator dest_upperleft,
+                    DestImageIterator dest_lowerright,
+                    DestAccessor da,
+                    CombineFunctor cf)
+{
+    const int strips =
+        std::min(pyramidStrips(dest_lowerright.y - dest_upperleft.y),
+                 (src_lowerright.y - src_upperleft.y) / 2);
+
+    if (strips > 1) {
+        expandInStrips<SKIPSMImagePixelType>(strips, add, wraparound,
+                                             src_upperleft, src_lowerright, sa,
+                                             dest_upperleft, dest_lowerright, da,
+                                             cf);
+    } else {
+        expand<SKIPSMImagePixelType>(add, wraparound,
+                                     src_upperleft, src_lowerright, sa,
+                                     dest_upperleft, dest_lowerright, da,
+                                     cf);
+    }
+}
+
+
 // Version using argument object factories.
 template <typename SKIPSMImagePixelType,
           typename SrcImageIterator, typename SrcAccessor,
@@ -1444,15 +1795,15 @@ expand(bool add, bool wraparound,
     typedef typename DestAccessor::value_type DestPixelType;
 
     if (add) {
-        expand<SKIPSMImagePixelType>(add, wraparound,
-                                     src.first, src.second, src.third,
-                                     dest.first, dest.second, dest.third,
-                                     FromPromotePlusFunctorWrapper<DestPixelType, SKIPSMImagePixelType, DestPixelType>());
+        expandMaybeInStrips<SKIPSMImagePixelType>(add, wraparound,
+                                                  src.first, src.second, src.third,
+                                                  dest.first, dest.second, dest.third,
+                                                  FromPromotePlusFunctorWrapper<DestPixelType, SKIPSMImagePixelType, DestPixelType>());
     } else {
-        expand<SKIPSMImagePixelType>(add, wraparound,
-                                     src.first, src.second, src.third,
-                                     dest.first, dest.second, dest.third,
-                                     std::minus<SKIPSMImagePixelType>());
+        expandMaybeInStrips<SKIPSMImagePixelType>(add, wraparound,
+                                                  src.first, src.second, src.third,
+                                                  dest.first, dest.second, dest.third,
+                                                  std::minus<SKIPSMImagePixelType>());
     }
 }
 
@@ -0,0 +1,478 @@
+/*
+ * Copyright (C) 2009-2017 Christoph Spiel
+ *
+ * This file is part of Enblend.
+ *
+ * Enblend is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Enblend is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Enblend; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#ifndef SKIPSM_KERNELS_H_INCLUDED_
+#define SKIPSM_KERNELS_H_INCLUDED_
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include <vigra/numerictraits.hxx>
+#include <vigra/rgbvalue.hxx>
+#include <vigra/sized_int.hxx>
+
+#include "parameter.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SKIPSM_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#define SKIPSM_TARGET(m_isa) __attribute__((target(m_isa)))
+#endif
+
+
+// Row kernels for the SKIPSM implementations of Reduce and Expand in
+// pyramid.h.
+//
+// The SKIPSM state machines are separable: the horizontal part is
+// a short recursion that must run pixel after pixel, but the
+// vertical part -- the update of the column state arrays and the
+// combination into the output numerators -- is independent for
+// every column.  The kernels here perform exactly that vertical
+// part on whole rows, which lets us use SSE2, AVX2, or AVX-512 on
+// the pixel types we meet most often:
+//
+//     vigra::Int32, vigra::RGBValue<vigra::Int32>  (fixed-point pyramids)
+//     double, vigra::RGBValue<double>              (floating-point pyramids)
+//
+// The kernels never divide; the callers apply the SKIPSM
+// normalizations pixel by pixel with the very expressions they used
+// before.  Additions and the multiplications by 4 and 6 are exact in
+// two's-complement arithmetic, thus the fixed-point pyramids are
+// bit-for-bit identical to the scalar code.  The floating-point
+// kernels evaluate in the same order as the scalar code.
+//
+// The instruction set gets selected once at runtime.  Parameter
+// "skipsm-instruction-set" limits the choice to "generic", "sse2",
+// or "avx2" for comparisons and debugging; the default is "auto".
+
+
+namespace enblend
+{
+namespace skipsm
+{
+    enum InstructionSet {ISA_GENERIC, ISA_SSE2, ISA_AVX2, ISA_AVX512};
+
+
+    inline InstructionSet
+    detectInstructionSet()
+    {
+#ifdef SKIPSM_HAVE_X86_KERNELS
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f")) {
+            return ISA_AVX512;
+        } else if (__builtin_cpu_supports("avx2")) {
+            return ISA_AVX2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            return ISA_SSE2;
+        }
+#endif
+        return ISA_GENERIC;
+    }
+
+
+    inline InstructionSet
+    selectInstructionSet()
+    {
+        const std::string isa_name(parameter::skipsm_instruction_set.value());
+        InstructionSet limit = ISA_AVX512;
+
+        if (isa_name == "generic") {
+            limit = ISA_GENERIC;
+        } else if (isa_name == "sse2") {
+            limit = ISA_SSE2;
+        } else if (isa_name == "avx2") {
+            limit = ISA_AVX2;
+        } else if (isa_name != "auto" && isa_name != "avx512") {
+            std::cerr << command << ": warning: unknown SKIPSM instruction set \"" << isa_name <<
+                "\"; using \"auto\"" << std::endl;
+        }
+
+        return std::min(detectInstructionSet(), limit);
+    }
+
+
+    inline InstructionSet
+    instructionSet()
+    {
+        static const InstructionSet isa = selectInstructionSet();
+        return isa;
+    }
+
+
+    // Pixel types whose rows the vector kernels can process as flat
+    // arrays of components.
+    template <typename SKIPSMPixelType>
+    struct VectorTraits
+    {
+        typedef vigra::VigraFalseType is_vectorizable;
+    };
+
+
+#define SKIPSM_VECTOR_TRAITS(m_pixel_type, m_component_type, m_components) \
+    template <>                                                         \
+    struct VectorTraits<m_pixel_type>                                   \
+    {                                                                   \
+        typedef vigra::VigraTrueType is_vectorizable;                   \
+        typedef m_component_type component_type;                        \
+        enum {components = m_components};                               \
+        static_assert(sizeof(m_pixel_type) == m_components * sizeof(m_component_type), \
+                      "pixel type is not a packed array of its components"); \
+    }
+
+    SKIPSM_VECTOR_TRAITS(vigra::Int32, vigra::Int32, 1);
+    SKIPSM_VECTOR_TRAITS(vigra::RGBValue<vigra::Int32>, vigra::Int32, 3);
+    SKIPSM_VECTOR_TRAITS(double, double, 1);
+    SKIPSM_VECTOR_TRAITS(vigra::RGBValue<double>, double, 3);
+
+#undef SKIPSM_VECTOR_TRAITS
+
+
+    /** Combine the column state of Reduce with the horizontally
+     *  filtered values h[] of an even source row.
+     *
+     *  out[i] <= sc1[i] + 6*sc0[i] + scp[i] + h[i]
+     *  sc1[i] <= sc0[i] + scp[i]
+     *  sc0[i] <= h[i]
+     */
+    template <typename T>
+    inline void
+    reduceCombineRowGeneric(T* sc1, T* sc0, const T* scp, const T* h, T* out, int n)
+    {
+        for (int i = 0; i < n; ++i) {
+            T v = sc1[i] + T(6 * sc0[i]) + scp[i];
+            sc1[i] = sc0[i] + scp[i];
+            sc0[i] = h[i];
+            v += h[i];
+            out[i] = v;
+        }
+    }
+
+
+    /** Advance the column state of Expand by one source row and
+     *  compute the numerators of the four destination pixels per
+     *  source pixel.  Runs over the index range [begin, end).  Source
+     *  pixels x-1 and x-2 are at row[i - stride] and row[i - 2 * stride].
+     *
+     *  a <= row[x-2] + 6*row[x-1] + row[x]
+     *  b <= 4*(row[x-1] + row[x])
+     *  out00[i] <= sc1a[i] + 6*sc0a[i] + a      out10[i] <= sc1b[i] + 6*sc0b[i] + b
+     *  out01[i] <= sc0a[i] + a                  out11[i] <= sc0b[i] + b
+     *  sc1a[i] <= sc0a[i]    sc1b[i] <= sc0b[i]    sc0a[i] <= a    sc0b[i] <= b
+     */
+    template <typename T>
+    inline void
+    expandCombineRowGeneric(const T* row,
+                            T* sc1a, T* sc0a, T* sc1b, T* sc0b,
+                            T* out00, T* out10, T* out01, T* out11,
+                            int begin, int end, int stride)
+    {
+        for (int i = begin; i < end; ++i) {
+            const T a(row[i - 2 * stride] + T(6 * row[i - stride]) + row[i]);
+            const T b((row[i - stride] + row[i]) * 4);
+
+            out00[i] = sc1a[i] + T(6 * sc0a[i]);
+            out10[i] = sc1b[i] + T(6 * sc0b[i]);
+            out01[i] = sc0a[i];
+            out11[i] = sc0b[i];
+            sc1a[i] = sc0a[i];
+            sc1b[i] = sc0b[i];
+            sc0a[i] = a;
+            sc0b[i] = b;
+            out00[i] += a;
+            out10[i] += b;
+            out01[i] += a;
+            out11[i] += b;
+        }
+    }
+
+
+#ifdef SKIPSM_HAVE_X86_KERNELS
+
+    // The operations the kernels need, once per instruction set.
+    // All of them are overloaded for vigra::Int32 and double.  We
+    // multiply by 4 and 6 with additions only: for doubles 4x + 2x
+    // rounds exactly like 6 * x, and without a multiplication the
+    // compiler cannot contract anything into an FMA, which would
+    // change the rounding.
+
+    struct Sse2Operations
+    {
+        static SKIPSM_TARGET("sse2") inline __m128i load(const vigra::Int32* p)
+        {return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));}
+        static SKIPSM_TARGET("sse2") inline void store(vigra::Int32* p, __m128i x)
+        {_mm_storeu_si128(reinterpret_cast<__m128i*>(p), x);}
+        static SKIPSM_TARGET("sse2") inline __m128i add(__m128i x, __m128i y) {return _mm_add_epi32(x, y);}
+        static SKIPSM_TARGET("sse2") inline __m128i times2(__m128i x) {return _mm_add_epi32(x, x);}
+        static SKIPSM_TARGET("sse2") inline __m128i times4(__m128i x) {return times2(times2(x));}
+        static SKIPSM_TARGET("sse2") inline __m128i times6(__m128i x)
+        {return _mm_add_epi32(times4(x), times2(x));}
+
+        static SKIPSM_TARGET("sse2") inline __m128d load(const double* p) {return _mm_loadu_pd(p);}
+        static SKIPSM_TARGET("sse2") inline void store(double* p, __m128d x) {_mm_storeu_pd(p, x);}
+        static SKIPSM_TARGET("sse2") inline __m128d add(__m128d x, __m128d y) {return _mm_add_pd(x, y);}
+        static SKIPSM_TARGET("sse2") inline __m128d times2(__m128d x) {return _mm_add_pd(x, x);}
+        static SKIPSM_TARGET("sse2") inline __m128d times4(__m128d x) {return times2(times2(x));}
+        static SKIPSM_TARGET("sse2") inline __m128d times6(__m128d x) {return _mm_add_pd(times4(x), times2(x));}
+    };
+
+
+    struct Avx2Operations
+    {
+        static SKIPSM_TARGET("avx2") inline __m256i load(const vigra::Int32* p)
+        {return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));}
+        static SKIPSM_TARGET("avx2") inline void store(vigra::Int32* p, __m256i x)
+        {_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x);}
+        static SKIPSM_TARGET("avx2") inline __m256i add(__m256i x, __m256i y) {return _mm256_add_epi32(x, y);}
+        static SKIPSM_TARGET("avx2") inline __m256i times2(__m256i x) {return _mm256_add_epi32(x, x);}
+        static SKIPSM_TARGET("avx2") inline __m256i times4(__m256i x) {return times2(times2(x));}
+        static SKIPSM_TARGET("avx2") inline __m256i times6(__m256i x)
+        {return _mm256_add_epi32(times4(x), times2(x));}
+
+        static SKIPSM_TARGET("avx2") inline __m256d load(const double* p) {return _mm256_loadu_pd(p);}
+        static SKIPSM_TARGET("avx2") inline void store(double* p, __m256d x) {_mm256_storeu_pd(p, x);}
+        static SKIPSM_TARGET("avx2") inline __m256d add(__m256d x, __m256d y) {return _mm256_add_pd(x, y);}
+        static SKIPSM_TARGET("avx2") inline __m256d times2(__m256d x) {return _mm256_add_pd(x, x);}
+        static SKIPSM_TARGET("avx2") inline __m256d times4(__m256d x) {return times2(times2(x));}
+        static SKIPSM_TARGET("avx2") inline __m256d times6(__m256d x) {return _mm256_add_pd(times4(x), times2(x));}
+    };
+
+
+    struct Avx512Operations
+    {
+        static SKIPSM_TARGET("avx512f") inline __m512i load(const vigra::Int32* p) {return _mm512_loadu_si512(p);}
+        static SKIPSM_TARGET("avx512f") inline void store(vigra::Int32* p, __m512i x) {_mm512_storeu_si512(p, x);}
+        static SKIPSM_TARGET("avx512f") inline __m512i add(__m512i x, __m512i y) {return _mm512_add_epi32(x, y);}
+        static SKIPSM_TARGET("avx512f") inline __m512i times2(__m512i x) {return _mm512_add_epi32(x, x);}
+        static SKIPSM_TARGET("avx512f") inline __m512i times4(__m512i x) {return times2(times2(x));}
+        static SKIPSM_TARGET("avx512f") inline __m512i times6(__m512i x)
+        {return _mm512_add_epi32(times4(x), times2(x));}
+
+        static SKIPSM_TARGET("avx512f") inline __m512d load(const double* p) {return _mm512_loadu_pd(p);}
+        static SKIPSM_TARGET("avx512f") inline void store(double* p, __m512d x) {_mm512_storeu_pd(p, x);}
+        static SKIPSM_TARGET("avx512f") inline __m512d add(__m512d x, __m512d y) {return _mm512_add_pd(x, y);}
+        static SKIPSM_TARGET("avx512f") inline __m512d times2(__m512d x) {return _mm512_add_pd(x, x);}
+        static SKIPSM_TARGET("avx512f") inline __m512d times4(__m512d x) {return times2(times2(x));}
+        static SKIPSM_TARGET("avx512f") inline __m512d times6(__m512d x) {return _mm512_add_pd(times4(x), times2(x));}
+    };
+
+
+    // Vector versions of reduceCombineRowGeneric() and
+    // expandCombineRowGeneric() for one instruction set.  The
+    // generic functions mop up the tails of the rows.
+#define SKIPSM_DEFINE_ROW_KERNELS(m_target, m_operations)               \
+    template <typename T>                                               \
+    SKIPSM_TARGET(m_target) inline void                                 \
+    reduceCombineRow(T* sc1, T* sc0, const T* scp, const T* h, T* out, int n) \
+    {                                                                   \
+        typedef m_operations op;                                        \
+        typedef decltype(op::load(h)) vector_type;                      \
+        const int width = static_cast<int>(sizeof(vector_type) / sizeof(T)); \
+                                                                        \
+        int i = 0;                                                      \
+        for (; i + width <= n; i += width) {                            \
+            const vector_type c0(op::load(sc0 + i));                    \
+            const vector_type cp(op::load(scp + i));                    \
+            const vector_type hh(op::load(h + i));                      \
+            op::store(out + i, op::add(op::add(op::add(op::load(sc1 + i), op::times6(c0)), cp), hh)); \
+            op::store(sc1 + i, op::add(c0, cp));                        \
+            op::store(sc0 + i, hh);                                     \
+        }                                                               \
+        reduceCombineRowGeneric(sc1 + i, sc0 + i, scp + i, h + i, out + i, n - i); \
+    }                                                                   \
+                                                                        \
+    template <typename T>                                               \
+    SKIPSM_TARGET(m_target) inline void                                 \
+    expandCombineRow(const T* row,                                      \
+                     T* sc1a, T* sc0a, T* sc1b, T* sc0b,                \
+                     T* out00, T* out10, T* out01, T* out11,            \
+                     int begin, int end, int stride)                    \
+    {                                                                   \
+        typedef m_operations op;                                        \
+        typedef decltype(op::load(row)) vector_type;                    \
+        const int width = static_cast<int>(sizeof(vector_type) / sizeof(T)); \
+                                                                        \
+        int i = begin;                                                  \
+        for (; i + width <= end; i += width) {                          \
+            const vector_type current(op::load(row + i));               \
+            const vector_type r0(op::load(row + i - stride));           \
+            const vector_type r1(op::load(row + i - 2 * stride));       \
+            const vector_type a0(op::load(sc0a + i));                   \
+            const vector_type b0(op::load(sc0b + i));                   \
+            const vector_type a(op::add(op::add(r1, op::times6(r0)), current)); \
+            const vector_type b(op::times4(op::add(r0, current)));      \
+            op::store(out00 + i, op::add(op::add(op::load(sc1a + i), op::times6(a0)), a)); \
+            op::store(out10 + i, op::add(op::add(op::load(sc1b + i), op::times6(b0)), b)); \
+            op::store(out01 + i, op::add(a0, a));                       \
+            op::store(out11 + i, op::add(b0, b));                       \
+            op::store(sc1a + i, a0);                                    \
+            op::store(sc1b + i, b0);                                    \
+            op::store(sc0a + i, a);                                     \
+            op::store(sc0b + i, b);                                     \
+        }                                                               \
+        expandCombineRowGeneric(row, sc1a, sc0a, sc1b, sc0b,            \
+                                out00, out10, out01, out11,             \
+                                i, end, stride);                        \
+    }
+
+    namespace sse2 {SKIPSM_DEFINE_ROW_KERNELS("sse2", Sse2Operations)}
+    namespace avx2 {SKIPSM_DEFINE_ROW_KERNELS("avx2", Avx2Operations)}
+    namespace avx512 {SKIPSM_DEFINE_ROW_KERNELS("avx512f", Avx512Operations)}
+
+#undef SKIPSM_DEFINE_ROW_KERNELS
+
+#endif // SKIPSM_HAVE_X86_KERNELS
+
+
+    namespace detail
+    {
+        template <typename T>
+        inline void
+        reduceCombineRow(T* sc1, T* sc0, const T* scp, const T* h, T* out, int n,
+                         vigra::VigraFalseType)
+        {
+            reduceCombineRowGeneric(sc1, sc0, scp, h, out, n);
+        }
+
+
+        template <typename T>
+        inline void
+        reduceCombineRow(T* sc1, T* sc0, const T* scp, const T* h, T* out, int n,
+                         vigra::VigraTrueType)
+        {
+            typedef typename VectorTraits<T>::component_type C;
+
+            C* const c1 = reinterpret_cast<C*>(sc1);
+            C* const c0 = reinterpret_cast<C*>(sc0);
+            const C* const cp = reinterpret_cast<const C*>(scp);
+            const C* const ch = reinterpret_cast<const C*>(h);
+            C* const cout = reinterpret_cast<C*>(out);
+            const int m = n * VectorTraits<T>::components;
+
+            switch (instructionSet()) {
+#ifdef SKIPSM_HAVE_X86_KERNELS
+            case ISA_AVX512:
+                avx512::reduceCombineRow(c1, c0, cp, ch, cout, m);
+                break;
+            case ISA_AVX2:
+                avx2::reduceCombineRow(c1, c0, cp, ch, cout, m);
+                break;
+            case ISA_SSE2:
+                sse2::reduceCombineRow(c1, c0, cp, ch, cout, m);
+                break;
+#endif
+            default:
+                reduceCombineRowGeneric(c1, c0, cp, ch, cout, m);
+            }
+        }
+
+
+        template <typename T>
+        inline void
+        expandCombineRow(const T* row,
+                         T* sc1a, T* sc0a, T* sc1b, T* sc0b,
+                         T* out00, T* out10, T* out01, T* out11,
+                         int begin, int end,
+                         vigra::VigraFalseType)
+        {
+            expandCombineRowGeneric(row, sc1a, sc0a, sc1b, sc0b, out00, out10, out01, out11,
+                                    begin, end, 1);
+        }
+
+
+        template <typename T>
+        inline void
+        expandCombineRow(const T* row,
+                         T* sc1a, T* sc0a, T* sc1b, T* sc0b,
+                         T* out00, T* out10, T* out01, T* out11,
+                         int begin, int end,
+                         vigra::VigraTrueType)
+        {
+            typedef typename VectorTraits<T>::component_type C;
+            const int k = VectorTraits<T>::components;
+
+            const C* const r = reinterpret_cast<const C*>(row);
+            C* const a1 = reinterpret_cast<C*>(sc1a);
+            C* const a0 = reinterpret_cast<C*>(sc0a);
+            C* const b1 = reinterpret_cast<C*>(sc1b);
+            C* const b0 = reinterpret_cast<C*>(sc0b);
+            C* const o00 = reinterpret_cast<C*>(out00);
+            C* const o10 = reinterpret_cast<C*>(out10);
+            C* const o01 = reinterpret_cast<C*>(out01);
+            C* const o11 = reinterpret_cast<C*>(out11);
+
+            switch (instructionSet()) {
+#ifdef SKIPSM_HAVE_X86_KERNELS
+            case ISA_AVX512:
+                avx512::expandCombineRow(r, a1, a0, b1, b0, o00, o10, o01, o11, k * begin, k * end, k);
+                break;
+            case ISA_AVX2:
+                avx2::expandCombineRow(r, a1, a0, b1, b0, o00, o10, o01, o11, k * begin, k * end, k);
+                break;
+            case ISA_SSE2:
+                sse2::expandCombineRow(r, a1, a0, b1, b0, o00, o10, o01, o11, k * begin, k * end, k);
+                break;
+#endif
+            default:
+                expandCombineRowGeneric(r, a1, a0, b1, b0, o00, o10, o01, o11, k * begin, k * end, k);
+            }
+        }
+    } // namespace detail
+
+
+    /** Vertical step of Reduce for the n pixels of an even source row. */
+    template <typename SKIPSMPixelType>
+    inline void
+    reduceCombineRow(SKIPSMPixelType* sc1, SKIPSMPixelType* sc0, const SKIPSMPixelType* scp,
+                     const SKIPSMPixelType* h, SKIPSMPixelType* out, int n)
+    {
+        detail::reduceCombineRow(sc1, sc0, scp, h, out, n,
+                                 typename VectorTraits<SKIPSMPixelType>::is_vectorizable());
+    }
+
+
+    /** Interior step of Expand for source pixels begin, ..., end - 1 of a row.
+     *  Requires begin >= 2. */
+    template <typename SKIPSMPixelType>
+    inline void
+    expandCombineRow(const SKIPSMPixelType* row,
+                     SKIPSMPixelType* sc1a, SKIPSMPixelType* sc0a,
+                     SKIPSMPixelType* sc1b, SKIPSMPixelType* sc0b,
+                     SKIPSMPixelType* out00, SKIPSMPixelType* out10,
+                     SKIPSMPixelType* out01, SKIPSMPixelType* out11,
+                     int begin, int end)
+    {
+        detail::expandCombineRow(row, sc1a, sc0a, sc1b, sc0b, out00, out10, out01, out11,
+                                 begin, end,
+                                 typename VectorTraits<SKIPSMPixelType>::is_vectorizable());
+    }
+} // namespace skipsm
+} // namespace enblend
+
+
+#endif // SKIPSM_KERNELS_H_INCLUDED_
+
+
+// Local Variables:
+// mode: c++
+// End:
@@ -0,0 +1,360 @@
+// Check that the row-batched color conversions transformImageInRows()
+// and transformImageIfInRows(), and the parallel CIECAM02 back
+// conversion, agree with the converters' per-pixel operator().
+//
+// We measure the agreement as the color difference CIE76 delta-E in
+// CIELAB.  Results of the forward conversions are compared after the
+// per-pixel back conversion, results of the back conversions directly.
+// The largest delta-E must stay below maximumDeltaE, which is smaller
+// than a just noticeable difference of about 2.3, but allows an 8-bit
+// channel to round the other way.  We check CIELAB, CIELUV, and
+// CIECAM02 in both directions, each for an 8-bit and a floating-point
+// image.
+//
+// Build from the top-level directory with the same flags and
+// libraries as enblend, e.g.
+//     g++ -std=c++11 -I src -I <build>/src -o color_conversion_rows \
+//         test/color_conversion_rows.cc src/error_message.cc src/filenameparse.cc \
+//         src/mersenne.cc src/minimizer.cc src/parameter.cc \
+//         -lvigraimpex -llcms2 -lgsl -lgslcblas
+// and once more with -fopenmp -DOPENMP, which makes the row-batched
+// and the parallel paths convert on copies of the converter.
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <lcms2.h>
+
+#include "vigra/rgbvalue.hxx"
+#include "vigra/stdimage.hxx"
+
+#include "global.h"
+#include "parameter.h"
+
+// Globals that enblend defines before including its headers
+const std::string command("color_conversion_rows");
+int Verbose = 0;
+blend_colorspace_t BlendColorspace = UndeterminedColorspace;
+
+cmsHPROFILE InputProfile = nullptr;
+cmsHPROFILE XYZProfile = nullptr;
+cmsHPROFILE LabProfile = nullptr;
+cmsHTRANSFORM InputToXYZTransform = nullptr;
+cmsHTRANSFORM XYZToInputTransform = nullptr;
+cmsHTRANSFORM InputToLabTransform = nullptr;
+cmsHTRANSFORM LabToInputTransform = nullptr;
+cmsViewingConditions ViewingConditions;
+cmsHANDLE CIECAMTransform = nullptr;
+
+#include "common.h"
+#include "numerictraits.h"
+#include "openmp_vigra.h"
+#include "fixmath.h"
+
+using namespace std;
+using namespace vigra;
+
+
+// Build the same transforms enblend builds for an sRGB input image.
+static bool
+setUpTransforms()
+{
+    InputProfile = cmsCreate_sRGBProfile();
+    XYZProfile = cmsCreateXYZProfile();
+    LabProfile = cmsCreateLab2Profile(cmsD50_xyY());
+
+    InputToXYZTransform = cmsCreateTransform(InputProfile, TYPE_RGB_DBL, XYZProfile, TYPE_XYZ_DBL,
+                                             RENDERING_INTENT_FOR_BLENDING,
+                                             TRANSFORMATION_FLAGS_FOR_BLENDING);
+    XYZToInputTransform = cmsCreateTransform(XYZProfile, TYPE_XYZ_DBL, InputProfile, TYPE_RGB_DBL,
+                                             RENDERING_INTENT_FOR_BLENDING,
+                                             TRANSFORMATION_FLAGS_FOR_BLENDING);
+    InputToLabTransform = cmsCreateTransform(InputProfile, TYPE_RGB_DBL, LabProfile, TYPE_Lab_DBL,
+                                             RENDERING_INTENT_FOR_BLENDING,
+                                             TRANSFORMATION_FLAGS_FOR_BLENDING);
+    LabToInputTransform = cmsCreateTransform(LabProfile, TYPE_Lab_DBL, InputProfile, TYPE_RGB_DBL,
+                                             RENDERING_INTENT_FOR_BLENDING,
+                                             TRANSFORMATION_FLAGS_FOR_BLENDING);
+
+    // P2 Viewing Conditions: D50, 500 lumens
+    ViewingConditions.whitePoint.X = XYZ_SCALE * cmsD50_XYZ()->X;
+    ViewingConditions.whitePoint.Y = XYZ_SCALE * cmsD50_XYZ()->Y;
+    ViewingConditions.whitePoint.Z = XYZ_SCALE * cmsD50_XYZ()->Z;
+    ViewingConditions.Yb = 20.0;
+    ViewingConditions.La = 31.83;
+    ViewingConditions.surround = AVG_SURROUND;
+    ViewingConditions.D_value = 1.0;
+    CIECAMTransform = cmsCIECAM02Init(nullptr, &ViewingConditions);
+
+    return InputToXYZTransform != nullptr && XYZToInputTransform != nullptr &&
+        InputToLabTransform != nullptr && LabToInputTransform != nullptr &&
+        CIECAMTransform != nullptr;
+}
+
+
+static void
+tearDownTransforms()
+{
+    cmsCIECAM02Done(CIECAMTransform);
+    cmsDeleteTransform(LabToInputTransform);
+    cmsDeleteTransform(InputToLabTransform);
+    cmsDeleteTransform(XYZToInputTransform);
+    cmsDeleteTransform(InputToXYZTransform);
+    cmsCloseProfile(LabProfile);
+    cmsCloseProfile(XYZProfile);
+    cmsCloseProfile(InputProfile);
+}
+
+
+// Fill image with random colors over the whole range of its pixel
+// type, put black, white, and the primaries into the first row, and
+// mask out some pixels.
+template <class ImageType>
+static void
+randomImage(ImageType& image, BImage& mask)
+{
+    typedef typename ImageType::value_type PixelType;
+    typedef typename PixelType::value_type ComponentType;
+    typedef NumericTraits<ComponentType> Traits;
+
+    const double maximum = Traits::toRealPromote(Traits::max());
+
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            for (int c = 0; c < 3; ++c) {
+                image(x, y)[c] = Traits::fromRealPromote(maximum * (rand() / (RAND_MAX + 1.0)));
+            }
+            mask(x, y) = rand() % 4 == 0 ? 0 : 255;
+        }
+    }
+
+    const ComponentType zero = Traits::zero();
+    const ComponentType one = Traits::max();
+    const PixelType extremes[] = {
+        PixelType(zero, zero, zero), PixelType(one, one, one),
+        PixelType(one, zero, zero), PixelType(zero, one, zero), PixelType(zero, zero, one),
+        PixelType(zero, one, one), PixelType(one, zero, one), PixelType(one, one, zero)
+    };
+    for (int i = 0; i < 8 && i < image.width(); ++i) {
+        image(i, 0) = extremes[i];
+        mask(i, 0) = 255;
+    }
+}
+
+
+// Largest acceptable CIE76 color difference between the two paths
+static const double maximumDeltaE = 2.0;
+
+
+// Answer the CIELAB color of an image pixel.
+template <class PixelType>
+static cmsCIELab
+labOf(const PixelType& pixel)
+{
+    typedef NumericTraits<typename PixelType::value_type> Traits;
+
+    const double maximum = Traits::toRealPromote(Traits::max());
+    const double rgb[3] = {
+        Traits::toRealPromote(pixel.red()) / maximum,
+        Traits::toRealPromote(pixel.green()) / maximum,
+        Traits::toRealPromote(pixel.blue()) / maximum
+    };
+    cmsCIELab lab;
+
+    cmsDoTransform(InputToLabTransform, rgb, &lab, 1U);
+
+    return lab;
+}
+
+
+// Answer the largest delta-E between result and reference under mask.
+template <class ImageType>
+static double
+maximumDifference(const ImageType& result, const ImageType& reference, const BImage& mask)
+{
+    double maximum = 0.0;
+
+    for (int y = 0; y < result.height(); ++y) {
+        for (int x = 0; x < result.width(); ++x) {
+            if (mask(x, y)) {
+                const cmsCIELab lab_result = labOf(result(x, y));
+                const cmsCIELab lab_reference = labOf(reference(x, y));
+                maximum = std::max(maximum, cmsDeltaE(&lab_result, &lab_reference));
+            }
+        }
+    }
+
+    return maximum;
+}
+
+
+static bool
+report(const string& what, double delta_e)
+{
+    const bool ok = delta_e <= maximumDeltaE;
+
+    cout << what << ": maximum delta-E " << delta_e << (ok ? "" : ", too large") << endl;
+
+    return ok;
+}
+
+
+// Convert the masked pixels of pyramid back into an image pixel by
+// pixel.
+template <class Converter, class PyramidType, class ImageType>
+static void
+fromPyramidPerPixel(const PyramidType& pyramid, const BImage& mask, ImageType& image)
+{
+    const Converter convert;
+
+    for (int y = 0; y < pyramid.height(); ++y) {
+        for (int x = 0; x < pyramid.width(); ++x) {
+            if (mask(x, y)) {
+                image(x, y) = convert(pyramid(x, y));
+            }
+        }
+    }
+}
+
+
+// The paths enblend takes for the back conversions: CIELAB and
+// CIELUV go row by row, CIECAM02 pixel by pixel in parallel.
+struct InRows
+{
+    template <class Converter, class PyramidType, class ImageType>
+    static void
+    apply(const PyramidType& pyramid, const BImage& mask, ImageType& image)
+    {
+        enblend::transformImageIfInRows(pyramid.upperLeft(), pyramid.lowerRight(), pyramid.accessor(),
+                                        mask.upperLeft(), mask.accessor(),
+                                        image.upperLeft(), image.accessor(),
+                                        Converter());
+    }
+};
+
+
+struct InParallel
+{
+    template <class Converter, class PyramidType, class ImageType>
+    static void
+    apply(const PyramidType& pyramid, const BImage& mask, ImageType& image)
+    {
+        vigra::omp::transformImageIf(pyramid.upperLeft(), pyramid.lowerRight(), pyramid.accessor(),
+                                     mask.upperLeft(), mask.accessor(),
+                                     image.upperLeft(), image.accessor(),
+                                     Converter());
+    }
+};
+
+
+// Convert image into a pyramid image pixel by pixel and row by row.
+// Answer whether the two agree after the per-pixel back conversion
+// and leave the per-pixel result in pyramid.
+template <class Converter, class BackConverter, class ImageType, class PyramidType>
+static bool
+checkToPyramid(const ImageType& image, PyramidType& pyramid, const string& what)
+{
+    const Converter convert;
+    PyramidType rows(image.size());
+
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            pyramid(x, y) = convert(image(x, y));
+        }
+    }
+
+    enblend::transformImageInRows(image.upperLeft(), image.lowerRight(), image.accessor(),
+                                  rows.upperLeft(), rows.accessor(),
+                                  Converter());
+
+    const BImage all(image.size(), 255);
+    ImageType pixels_back(image.size());
+    ImageType rows_back(image.size());
+    fromPyramidPerPixel<BackConverter>(pyramid, all, pixels_back);
+    fromPyramidPerPixel<BackConverter>(rows, all, rows_back);
+
+    return report(what, maximumDifference(rows_back, pixels_back, all));
+}
+
+
+// Convert the masked pixels of pyramid back into an image pixel by
+// pixel and along Path, and answer whether the two agree.
+template <class Converter, class Path, class PyramidType, class ImageType>
+static bool
+checkFromPyramid(const PyramidType& pyramid, const BImage& mask, const string& what)
+{
+    ImageType pixels(pyramid.size());
+    ImageType path(pyramid.size());
+
+    fromPyramidPerPixel<Converter>(pyramid, mask, pixels);
+    Path::template apply<Converter>(pyramid, mask, path);
+
+    return report(what, maximumDifference(path, pixels, mask));
+}
+
+
+template <typename ComponentType>
+static bool
+checkConversions(const string& name)
+{
+    typedef RGBValue<ComponentType> ImagePixelType;
+    typedef enblend::EnblendNumericTraits<ImagePixelType> Traits;
+    typedef typename Traits::ImagePyramidPixelType PyramidPixelType;
+    typedef BasicImage<ImagePixelType> ImageType;
+    typedef BasicImage<PyramidPixelType> PyramidType;
+
+    enum {IntegerBits = Traits::ImagePyramidIntegerBits, FractionBits = Traits::ImagePyramidFractionBits};
+
+    typedef enblend::ConvertVectorToLabPyramidFunctor<ImagePixelType, PyramidPixelType,
+                                                      IntegerBits, FractionBits> ToLab;
+    typedef enblend::ConvertLabPyramidToVectorFunctor<ImagePixelType, PyramidPixelType,
+                                                      IntegerBits, FractionBits> FromLab;
+    typedef enblend::ConvertVectorToLuvPyramidFunctor<ImagePixelType, PyramidPixelType,
+                                                      IntegerBits, FractionBits> ToLuv;
+    typedef enblend::ConvertLuvPyramidToVectorFunctor<ImagePixelType, PyramidPixelType,
+                                                      IntegerBits, FractionBits> FromLuv;
+    typedef enblend::ConvertVectorToJCHPyramidFunctor<ImagePixelType, PyramidPixelType,
+                                                      IntegerBits, FractionBits> ToJCH;
+    typedef enblend::ConvertJCHPyramidToVectorFunctor<ImagePixelType, PyramidPixelType,
+                                                      IntegerBits, FractionBits> FromJCH;
+
+    // An odd width keeps the rows from lining up with any batch size.
+    ImageType image(257, 131);
+    BImage mask(image.size());
+    PyramidType pyramid(image.size());
+    bool ok = true;
+
+    randomImage(image, mask);
+
+    ok = checkToPyramid<ToLab, FromLab>(image, pyramid, name + " to CIELAB") && ok;
+    ok = checkFromPyramid<FromLab, InRows, PyramidType, ImageType>(pyramid, mask, name + " from CIELAB") && ok;
+
+    ok = checkToPyramid<ToLuv, FromLuv>(image, pyramid, name + " to CIELUV") && ok;
+    ok = checkFromPyramid<FromLuv, InRows, PyramidType, ImageType>(pyramid, mask, name + " from CIELUV") && ok;
+
+    ok = checkToPyramid<ToJCH, FromJCH>(image, pyramid, name + " to CIECAM02") && ok;
+    ok = checkFromPyramid<FromJCH, InParallel, PyramidType, ImageType>(pyramid, mask, name + " from CIECAM02") && ok;
+
+    return ok;
+}
+
+
+int main(void) {
+    if (!setUpTransforms()) {
+        cerr << command << ": cannot build color transforms" << endl;
+        return EXIT_FAILURE;
+    }
+
+    srand(1);
+
+    bool ok = checkConversions<UInt8>("8-bit image");
+    ok = checkConversions<float>("float image") && ok;
+
+    tearDownTransforms();
+
+    cout << (ok ? "PASSED" : "FAILED") << endl;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,144 @@
+// Check that fill_polygon_banded() fills exactly the same pixels as
+// fill_polygon_active() for random multi-ring polygons and band
+// heights.  Both fillers XOR the fill value into the mask like
+// enblend's fillContour() does.
+//
+// Build from the top-level directory, e.g.
+//     g++ -std=c++11 -I src -o fill_polygon_banded test/fill_polygon_banded.cc
+// and once more with -fopenmp -DOPENMP to exercise the parallel bands.
+
+#define HAVE_LRINT 1
+
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "vigra/diff2d.hxx"
+#include "vigra/stdimage.hxx"
+
+#define NEVER_REACHED(m_message) throw std::logic_error(m_message)
+
+#include "fillpolygon.hxx"
+
+using namespace std;
+using namespace vigra;
+
+
+// XOR the fill value into the mask, like XorAccessor in mask.h.
+struct XorAccessor
+{
+    typedef UInt8 value_type;
+
+    template <class Iterator, class Difference>
+    UInt8 operator()(const Iterator& i, Difference d) const {return i[d];}
+
+    template <class Value, class Iterator, class Difference>
+    void set(const Value& v, const Iterator& i, Difference d) const {i[d] ^= v;}
+};
+
+
+static int
+randomInt(int lower, int upper)
+{
+    return lower + rand() % (upper - lower + 1);
+}
+
+
+// Append a closed ring of n vertices around the image of the given
+// size.  Some vertices lie outside of the image; some edges are
+// horizontal or vertical.
+static void
+appendRing(vector<Point2D>& polygon, const Size2D& size, int n)
+{
+    const Point2D first(randomInt(-8, size.x + 8), randomInt(-8, size.y + 8));
+    Point2D p(first);
+
+    polygon.push_back(first);
+    for (int i = 1; i < n; ++i) {
+        switch (rand() % 4) {
+        case 0:
+            p = Point2D(randomInt(-8, size.x + 8), p.y);
+            break;
+        case 1:
+            p = Point2D(p.x, randomInt(-8, size.y + 8));
+            break;
+        default:
+            p = Point2D(randomInt(-8, size.x + 8), randomInt(-8, size.y + 8));
+        }
+        polygon.push_back(p);
+    }
+    polygon.push_back(first);
+}
+
+
+// Fill polygon with both fillers and answer whether they agree.
+// A filler that finds the polygon malformed must do so with the
+// other filler, too.
+static bool
+fillersAgree(const vector<Point2D>& polygon, const Size2D& size, int band_height)
+{
+    BImage active(size);
+    BImage banded(size);
+    bool active_failed = false;
+    bool banded_failed = false;
+
+    try {
+        vigra_ext::fill_polygon_active(active.upperLeft(), active.lowerRight(), XorAccessor(),
+                                       polygon.begin(), polygon.end(), UInt8(0xff));
+    } catch (vigra_ext::detail::malformed_polygon&) {
+        active_failed = true;
+    }
+
+    try {
+        vigra_ext::fill_polygon_banded(banded.upperLeft(), banded.lowerRight(), XorAccessor(),
+                                       polygon.begin(), polygon.end(), UInt8(0xff), band_height);
+    } catch (vigra_ext::detail::malformed_polygon&) {
+        banded_failed = true;
+    }
+
+    if (active_failed || banded_failed) {
+        return active_failed == banded_failed;
+    }
+
+    for (int y = 0; y < size.y; ++y) {
+        for (int x = 0; x < size.x; ++x) {
+            if (active(x, y) != banded(x, y)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+int main(void) {
+    int failures = 0;
+
+    srand(1);
+
+    for (int i = 0; i < 3000; ++i) {
+        const Size2D size(randomInt(1, 120), randomInt(1, 120));
+        const int band_height = randomInt(1, 40);
+        const int rings = randomInt(1, 4);
+        vector<Point2D> polygon;
+
+        for (int r = 0; r < rings; ++r) {
+            appendRing(polygon, size, randomInt(3, 12));
+            polygon.push_back(END_OF_SEGMENT_MARKER);
+        }
+
+        if (!fillersAgree(polygon, size, band_height)) {
+            cout << "polygon #" << i << " (" << size.x << "x" << size.y << ", " << rings <<
+                " rings, band height " << band_height << "): fillers disagree" << endl;
+            ++failures;
+        }
+    }
+
+    cout << (failures == 0 ? "PASSED" : "FAILED") << endl;
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,163 @@
+// Check localStdDevIntegralIf() against localStdDevIf() and against a
+// direct computation in double.
+//
+// localStdDevIf() accumulates in the RealPromote of the pixel type,
+// i.e. in float for float images, so it only agrees to about 1e-3.
+// localStdDevIntegralIf() must match the direct computation to float
+// precision, also on bright images where E[x^2] - E[x]^2 cancels.
+//
+// Build from the top-level directory, e.g.
+//     g++ -std=c++11 -I src -o local_stddev_integral test/local_stddev_integral.cc
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "vigra/stdimage.hxx"
+
+#include "local_stddev.h"
+
+using namespace std;
+using namespace vigra;
+
+
+// Standard deviation of the masked pixels in the window around (x, y).
+static double
+directStdDev(const FImage& src, const BImage& mask, int x, int y, const Size2D& size)
+{
+    double sum = 0.0;
+    double sumSqr = 0.0;
+    int n = 0;
+
+    for (int j = y - size.y / 2; j <= y + size.y / 2; ++j) {
+        for (int i = x - size.x / 2; i <= x + size.x / 2; ++i) {
+            if (mask(i, j)) {
+                sum += src(i, j);
+                ++n;
+            }
+        }
+    }
+    if (n <= 1) {
+        return 0.0;
+    }
+    const double mean = sum / n;
+    for (int j = y - size.y / 2; j <= y + size.y / 2; ++j) {
+        for (int i = x - size.x / 2; i <= x + size.x / 2; ++i) {
+            if (mask(i, j)) {
+                sumSqr += (src(i, j) - mean) * (src(i, j) - mean);
+            }
+        }
+    }
+    return sqrt(sumSqr / (n - 1));
+}
+
+
+// Compute the direct standard deviation wherever the window fits.
+static void
+directLocalStdDev(const FImage& src, const BImage& mask, FImage& dest, const Size2D& size)
+{
+    for (int y = size.y / 2; y < src.height() - size.y / 2; ++y) {
+        for (int x = size.x / 2; x < src.width() - size.x / 2; ++x) {
+            dest(x, y) = static_cast<float>(directStdDev(src, mask, x, y, size));
+        }
+    }
+}
+
+
+// Fill src with offset + spread * noise, and mask out some pixels.
+static void
+randomImage(FImage& src, BImage& mask, double offset, double spread)
+{
+    for (int y = 0; y < src.height(); ++y) {
+        for (int x = 0; x < src.width(); ++x) {
+            src(x, y) = static_cast<float>(offset + spread * (rand() / (RAND_MAX + 1.0)));
+            mask(x, y) = rand() % 8 == 0 ? 0 : 255;
+        }
+    }
+}
+
+
+// Answer the largest deviation of result from reference, relative to
+// the reference, over all masked pixels where the window fits.
+static double
+maximumDeviation(const FImage& result, const FImage& reference, const BImage& mask, const Size2D& size)
+{
+    double deviation = 0.0;
+
+    for (int y = size.y / 2; y < result.height() - size.y / 2; ++y) {
+        for (int x = size.x / 2; x < result.width() - size.x / 2; ++x) {
+            if (mask(x, y)) {
+                deviation = max(deviation,
+                                fabs(result(x, y) - reference(x, y)) / max(1e-6, fabs(double(reference(x, y)))));
+            }
+        }
+    }
+
+    return deviation;
+}
+
+
+int main(void) {
+    const int width = 613;
+    const int height = 411;
+    bool ok = true;
+
+    srand(1);
+
+    for (int windowSize = 3; windowSize <= 15; windowSize += 4) {
+        const Size2D size(windowSize, windowSize);
+        FImage src(width, height);
+        BImage mask(width, height);
+
+        // A normal float image, where both algorithms must agree.
+        randomImage(src, mask, 0.0, 1.0);
+
+        FImage classic(width, height);
+        FImage integral(width, height);
+        FImage direct(width, height);
+
+        enblend::localStdDevIf(src.upperLeft(), src.lowerRight(), src.accessor(),
+                               mask.upperLeft(), mask.accessor(),
+                               classic.upperLeft(), classic.accessor(),
+                               size);
+        enblend::localStdDevIntegralIf(src.upperLeft(), src.lowerRight(), src.accessor(),
+                                       mask.upperLeft(), mask.accessor(),
+                                       integral.upperLeft(), integral.accessor(),
+                                       size, 64);
+
+        directLocalStdDev(src, mask, direct, size);
+
+        const double deviation = maximumDeviation(integral, classic, mask, size);
+        cout << "window " << windowSize << ": integral vs. sliding-window: " << deviation << endl;
+        if (deviation > 1e-3) {
+            ok = false;
+        }
+
+        const double directDeviation = maximumDeviation(integral, direct, mask, size);
+        cout << "window " << windowSize << ": integral vs. direct: " << directDeviation << endl;
+        if (directDeviation > 1e-6) {
+            ok = false;
+        }
+
+        // A bright image with little contrast, where E[x^2] - E[x]^2
+        // cancels almost completely.
+        randomImage(src, mask, 20000.0, 4.0);
+
+        directLocalStdDev(src, mask, direct, size);
+        enblend::localStdDevIntegralIf(src.upperLeft(), src.lowerRight(), src.accessor(),
+                                       mask.upperLeft(), mask.accessor(),
+                                       integral.upperLeft(), integral.accessor(),
+                                       size, 64);
+
+        const double brightDeviation = maximumDeviation(integral, direct, mask, size);
+        cout << "window " << windowSize << ": integral vs. direct on bright image: " << brightDeviation << endl;
+        if (brightDeviation > 1e-6) {
+            ok = false;
+        }
+    }
+
+    cout << (ok ? "PASSED" : "FAILED") << endl;
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}